@@ -20,6 +20,7 @@
 
 #include "audio_buffers.h"
 #include "dcpomatic_assert.h"
+#include "buffer_pool.h"
 #include <cassert>
 #include <cstring>
 #include <cmath>
@@ -88,10 +89,7 @@ AudioBuffers::allocate (int channels, int32_t frames)
 	}
 
 	for (int i = 0; i < _channels; ++i) {
-		_data[i] = static_cast<float*> (malloc (frames * sizeof (float)));
-		if (!_data[i]) {
-			throw bad_alloc ();
-		}
+		_data[i] = static_cast<float*> (BufferPool::instance()->get(frames * sizeof(float)));
 	}
 }
 
@@ -99,7 +97,7 @@ void
 AudioBuffers::deallocate ()
 {
 	for (int i = 0; i < _channels; ++i) {
-		free (_data[i]);
+		BufferPool::instance()->put (_data[i], _allocated_frames * sizeof(float));
 	}
 
 	free (_data);
@@ -260,7 +258,7 @@ AudioBuffers::ensure_size (int32_t frames)
 	}
 
 	/* Round up frames to the next power of 2 to reduce the number
-	   of realloc()s that are necessary.
+	   of reallocations that are necessary.
 	*/
 	frames--;
 	frames |= frames >> 1;
@@ -271,10 +269,10 @@ AudioBuffers::ensure_size (int32_t frames)
 	frames++;
 
 	for (int i = 0; i < _channels; ++i) {
-		_data[i] = static_cast<float*> (realloc (_data[i], frames * sizeof (float)));
-		if (!_data[i]) {
-			throw bad_alloc ();
-		}
+		float* data = static_cast<float*> (BufferPool::instance()->get(frames * sizeof(float)));
+		memcpy (data, _data[i], _allocated_frames * sizeof(float));
+		BufferPool::instance()->put (_data[i], _allocated_frames * sizeof(float));
+		_data[i] = data;
 		for (int j = _allocated_frames; j < frames; ++j) {
 			_data[i][j] = 0;
 		}
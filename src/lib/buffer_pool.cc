@@ -0,0 +1,156 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/buffer_pool.cc
+ *  @brief BufferPool class.
+ */
+
+#include "buffer_pool.h"
+#include "util.h"
+extern "C" {
+#include <libavutil/mem.h>
+}
+#include <boost/foreach.hpp>
+
+using std::map;
+using std::vector;
+
+/** @param size Size of a request in bytes.
+ *  @return Size of the block that will be used for it; this is the size rounded up to a
+ *  multiple of a quarter of the power of 2 below it, so no more than 25% is wasted.
+ */
+size_t
+BufferPool::size_class (size_t size)
+{
+	size_t p = 64;
+	if (size <= p) {
+		return p;
+	}
+
+	while (p * 2 < size) {
+		p *= 2;
+	}
+
+	size_t const step = p / 4;
+	return ((size + step - 1) / step) * step;
+}
+
+/** @param size Size in bytes.
+ *  @return A block of at least `size' bytes, aligned as av_malloc() would align it.
+ *  The block must be given back with put(), passing the same size.
+ */
+void*
+BufferPool::get (size_t size)
+{
+	size_t const c = size_class (size);
+
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		map<size_t, vector<void*> >::iterator i = _free.find (c);
+		if (i != _free.end() && !i->second.empty()) {
+			void* block = i->second.back ();
+			i->second.pop_back ();
+			_counters.resident -= c;
+			++_counters.hits;
+			return block;
+		}
+		++_counters.misses;
+	}
+
+	return wrapped_av_malloc (c);
+}
+
+/** Give back a block that was obtained from get().
+ *  @param block Block, which may be 0 (in which case nothing is done).
+ *  @param size Size that was passed to get().
+ */
+void
+BufferPool::put (void* block, size_t size)
+{
+	if (!block) {
+		return;
+	}
+
+	size_t const c = size_class (size);
+
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		if (_counters.resident + c <= _limit) {
+			_free[c].push_back (block);
+			_counters.resident += c;
+			return;
+		}
+	}
+
+	av_free (block);
+}
+
+/** Free all the blocks that are waiting to be re-used */
+void
+BufferPool::clear ()
+{
+	boost::mutex::scoped_lock lm (_mutex);
+
+	for (map<size_t, vector<void*> >::iterator i = _free.begin(); i != _free.end(); ++i) {
+		BOOST_FOREACH (void* j, i->second) {
+			av_free (j);
+		}
+	}
+
+	_free.clear ();
+	_counters.resident = 0;
+}
+
+/** Set the maximum amount of memory to keep for re-use, freeing blocks if
+ *  we are already keeping more than that.
+ *  @param limit Limit in bytes.
+ */
+void
+BufferPool::set_limit (boost::uint64_t limit)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+
+	_limit = limit;
+
+	map<size_t, vector<void*> >::iterator i = _free.begin ();
+	while (_counters.resident > _limit && i != _free.end()) {
+		while (_counters.resident > _limit && !i->second.empty()) {
+			av_free (i->second.back ());
+			i->second.pop_back ();
+			_counters.resident -= i->first;
+		}
+		++i;
+	}
+}
+
+BufferPool::Counters
+BufferPool::counters () const
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	return _counters;
+}
+
+BufferPool*
+BufferPool::instance ()
+{
+	/* Images are made in many threads, so this must be safe to call from any of them */
+	static BufferPool* instance = new BufferPool ();
+	return instance;
+}
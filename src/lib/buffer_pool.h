@@ -0,0 +1,92 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/buffer_pool.h
+ *  @brief BufferPool class.
+ */
+
+#ifndef DCPOMATIC_BUFFER_POOL_H
+#define DCPOMATIC_BUFFER_POOL_H
+
+#include <boost/thread/mutex.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/cstdint.hpp>
+#include <map>
+#include <vector>
+
+/** @class BufferPool
+ *  @brief A singleton pool of memory blocks for image planes and audio channels.
+ *
+ *  Blocks are grouped into size classes, each at most 25% bigger than the requests
+ *  it serves, so that the images (and audio buffers) of a particular size that are
+ *  made and destroyed for every frame re-use the same memory rather than going back to
+ *  the system allocator.  Blocks that are given back are kept until they amount to
+ *  a limit, which Config sets from its buffer_pool_size(); after that they are freed.
+ *  The limit is pushed to us, rather than us asking Config for it, because put() is
+ *  called from destructors in any thread.
+ *
+ *  There is one pool for all threads, rather than one per thread, since blocks are
+ *  usually allocated in one thread (e.g. the player's) and given back in another
+ *  (e.g. an encoder's).
+ */
+class BufferPool : public boost::noncopyable
+{
+public:
+	void* get (size_t size);
+	void put (void* block, size_t size);
+	void clear ();
+	void set_limit (boost::uint64_t limit);
+
+	struct Counters
+	{
+		Counters ()
+			: hits (0)
+			, misses (0)
+			, resident (0)
+		{}
+
+		/** number of requests that were satisfied from the pool */
+		boost::uint64_t hits;
+		/** number of requests that needed a new block */
+		boost::uint64_t misses;
+		/** total size of the blocks held by the pool and waiting to be re-used, in bytes */
+		boost::uint64_t resident;
+	};
+
+	Counters counters () const;
+
+	static size_t size_class (size_t size);
+	static BufferPool* instance ();
+
+private:
+	BufferPool ()
+		: _limit (0)
+	{}
+
+	/** Mutex for everything below */
+	mutable boost::mutex _mutex;
+	/** Maximum total size of the blocks in _free, in bytes */
+	boost::uint64_t _limit;
+	/** Free blocks, keyed by size class */
+	std::map<size_t, std::vector<void*> > _free;
+	Counters _counters;
+};
+
+#endif
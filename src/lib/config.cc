@@ -33,6 +33,7 @@
 #include "dkdm_wrapper.h"
 #include "compose.hpp"
 #include "crypto.h"
+#include "buffer_pool.h"
 #include <dcp/raw_convert.h>
 #include <dcp/name_format.h>
 #include <dcp/certificate_chain.h>
@@ -88,6 +89,14 @@ Config::set_defaults ()
 	_use_any_servers = true;
 	_servers.clear ();
 	_only_servers_encode = false;
+	_compress_server_transfers = false;
+	_defer_video_decoding = false;
+	_j2k_cache = false;
+	_j2k_cache_directory = boost::none;
+	_j2k_cache_size = 16;
+	_parallel_reels = false;
+	_parallel_content_decoding = false;
+	_distribute_reels = false;
 	_tms_protocol = FILE_TRANSFER_PROTOCOL_SCP;
 	_tms_ip = "";
 	_tms_path = ".";
@@ -153,6 +162,11 @@ Config::set_defaults ()
 	   use about 240Mb with 72 encoding threads.
 	*/
 	_frames_in_memory_multiplier = 3;
+	_write_behind_buffer = 256;
+	_fsync_policy = FSYNC_NEVER;
+	_buffer_pool_size = 512;
+	_video_decode_threads = 0;
+	_video_decode_thread_type = VIDEO_DECODE_THREADS_FRAME_AND_SLICE;
 	_decode_reduction = optional<int>();
 	_default_notify = false;
 	for (int i = 0; i < NOTIFICATION_COUNT; ++i) {
@@ -286,6 +300,14 @@ try
 	}
 
 	_only_servers_encode = f.optional_bool_child ("OnlyServersEncode").get_value_or (false);
+	_compress_server_transfers = f.optional_bool_child ("CompressServerTransfers").get_value_or (false);
+	_defer_video_decoding = f.optional_bool_child ("DeferVideoDecoding").get_value_or (false);
+	_j2k_cache = f.optional_bool_child ("J2KCache").get_value_or (false);
+	_j2k_cache_directory = f.optional_string_child ("J2KCacheDirectory");
+	_j2k_cache_size = f.optional_number_child<int> ("J2KCacheSize").get_value_or (16);
+	_parallel_reels = f.optional_bool_child ("ParallelReels").get_value_or (false);
+	_parallel_content_decoding = f.optional_bool_child ("ParallelContentDecoding").get_value_or (false);
+	_distribute_reels = f.optional_bool_child ("DistributeReels").get_value_or (false);
 	_tms_protocol = static_cast<FileTransferProtocol>(f.optional_number_child<int>("TMSProtocol").get_value_or(static_cast<int>(FILE_TRANSFER_PROTOCOL_SCP)));
 	_tms_ip = f.string_child ("TMSIP");
 	_tms_path = f.string_child ("TMSPath");
@@ -534,6 +556,25 @@ try
 		}
 	}
 	_frames_in_memory_multiplier = f.optional_number_child<int>("FramesInMemoryMultiplier").get_value_or(3);
+	_write_behind_buffer = f.optional_number_child<int>("WriteBehindBuffer").get_value_or(256);
+	optional<string> fp = f.optional_string_child("FsyncPolicy");
+	if (!fp || *fp == "never") {
+		_fsync_policy = FSYNC_NEVER;
+	} else if (*fp == "asset") {
+		_fsync_policy = FSYNC_ASSET;
+	} else if (*fp == "periodic") {
+		_fsync_policy = FSYNC_PERIODIC;
+	}
+	_buffer_pool_size = f.optional_number_child<int>("BufferPoolSize").get_value_or(512);
+	_video_decode_threads = f.optional_number_child<int>("VideoDecodeThreads").get_value_or(0);
+	optional<string> dt = f.optional_string_child("VideoDecodeThreadType");
+	if (!dt || *dt == "frame-and-slice") {
+		_video_decode_thread_type = VIDEO_DECODE_THREADS_FRAME_AND_SLICE;
+	} else if (*dt == "frame") {
+		_video_decode_thread_type = VIDEO_DECODE_THREADS_FRAME;
+	} else if (*dt == "slice") {
+		_video_decode_thread_type = VIDEO_DECODE_THREADS_SLICE;
+	}
 	_decode_reduction = f.optional_number_child<int>("DecodeReduction");
 	_default_notify = f.optional_bool_child("DefaultNotify").get_value_or(false);
 
@@ -615,11 +656,26 @@ Config::instance ()
 	if (_instance == 0) {
 		_instance = new Config;
 		_instance->read ();
+		_instance->update_buffer_pool ();
 	}
 
 	return _instance;
 }
 
+void
+Config::set_buffer_pool_size (int s)
+{
+	maybe_set (_buffer_pool_size, s);
+	update_buffer_pool ();
+}
+
+/** Tell the BufferPool how much memory it may keep */
+void
+Config::update_buffer_pool () const
+{
+	BufferPool::instance()->set_limit (static_cast<boost::uint64_t> (_buffer_pool_size) * 1024 * 1024);
+}
+
 /** Write our configuration to disk */
 void
 Config::write () const
@@ -663,6 +719,40 @@ Config::write_config () const
 	   is done by the encoding servers.  0 to set the master to do some encoding as well as coordinating the job.
 	*/
 	root->add_child("OnlyServersEncode")->add_child_text (_only_servers_encode ? "1" : "0");
+	/* [XML] CompressServerTransfers 1 to losslessly compress image data sent to encoding servers which support it,
+	   0 to send it uncompressed.
+	*/
+	root->add_child("CompressServerTransfers")->add_child_text (_compress_server_transfers ? "1" : "0");
+	/* [XML] DeferVideoDecoding 1 to pass compressed frames of intra-frame video (e.g. ProRes) to the encoding
+	   threads and servers so that they decode them, 0 to decode all video in the master's decoder.
+	*/
+	root->add_child("DeferVideoDecoding")->add_child_text (_defer_video_decoding ? "1" : "0");
+	/* [XML] J2KCache 1 to keep the J2K data for encoded frames and re-use it whenever an identical frame is encoded
+	   again, in any film; 0 to encode every frame.
+	*/
+	root->add_child("J2KCache")->add_child_text (_j2k_cache ? "1" : "0");
+	if (_j2k_cache_directory) {
+		/* [XML:opt] J2KCacheDirectory Directory to keep the J2K cache in; if this is not given the cache is kept
+		   in the configuration directory.
+		*/
+		root->add_child("J2KCacheDirectory")->add_child_text (_j2k_cache_directory->string ());
+	}
+	/* [XML] J2KCacheSize Maximum size of the J2K cache in gigabytes; the least-recently-used frames are removed
+	   when it gets bigger.
+	*/
+	root->add_child("J2KCacheSize")->add_child_text (raw_convert<string> (_j2k_cache_size));
+	/* [XML] ParallelReels 1 to decode each reel of a DCP with its own player in its own thread, 0 to decode
+	   the whole DCP in one thread.
+	*/
+	root->add_child("ParallelReels")->add_child_text (_parallel_reels ? "1" : "0");
+	/* [XML] ParallelContentDecoding 1 to decode each piece of content in its own thread, ahead of the player,
+	   0 to decode all content in the player's thread.
+	*/
+	root->add_child("ParallelContentDecoding")->add_child_text (_parallel_content_decoding ? "1" : "0");
+	/* [XML] DistributeReels 1 to ask encoding servers, which must be able to see the film's directory and content
+	   at the same paths as the master, to make the picture for whole reels; 0 to send them individual frames.
+	*/
+	root->add_child("DistributeReels")->add_child_text (_distribute_reels ? "1" : "0");
 	/* [XML] TMSProtocol Protocol to use to copy files to a TMS; 0 to use SCP, 1 for FTP. */
 	root->add_child("TMSProtocol")->add_child_text (raw_convert<string> (static_cast<int> (_tms_protocol)));
 	/* [XML] TMSIP IP address of TMS. */
@@ -926,6 +1016,46 @@ Config::write_config () const
 	   frames to be held in memory at once.
 	*/
 	root->add_child("FramesInMemoryMultiplier")->add_child_text(raw_convert<string>(_frames_in_memory_multiplier));
+	/* [XML] WriteBehindBuffer maximum amount of data waiting to be written to picture and sound assets, in megabytes. */
+	root->add_child("WriteBehindBuffer")->add_child_text(raw_convert<string>(_write_behind_buffer));
+	/* [XML] FsyncPolicy <code>never</code> to leave writing of assets to disk to the operating system,
+	   <code>asset</code> to sync each asset when it is finished or <code>periodic</code> to sync each asset
+	   whenever <code>WriteBehindBuffer</code> megabytes have been written to it and when it is finished.
+	*/
+	switch (_fsync_policy) {
+	case FSYNC_NEVER:
+		root->add_child("FsyncPolicy")->add_child_text("never");
+		break;
+	case FSYNC_ASSET:
+		root->add_child("FsyncPolicy")->add_child_text("asset");
+		break;
+	case FSYNC_PERIODIC:
+		root->add_child("FsyncPolicy")->add_child_text("periodic");
+		break;
+	}
+	/* [XML] BufferPoolSize maximum amount of image and audio memory to keep for re-use once it has
+	   been finished with, in megabytes.
+	*/
+	root->add_child("BufferPoolSize")->add_child_text(raw_convert<string>(_buffer_pool_size));
+	/* [XML] VideoDecodeThreads number of threads that FFmpeg should use to decode each video stream,
+	   or 0 to decide automatically.
+	*/
+	root->add_child("VideoDecodeThreads")->add_child_text(raw_convert<string>(_video_decode_threads));
+	/* [XML] VideoDecodeThreadType <code>frame-and-slice</code> to let FFmpeg decode several frames at once,
+	   or several parts of each frame, whichever the codec allows; <code>frame</code> for only several frames
+	   at once or <code>slice</code> for only several parts of each frame.
+	*/
+	switch (_video_decode_thread_type) {
+	case VIDEO_DECODE_THREADS_FRAME_AND_SLICE:
+		root->add_child("VideoDecodeThreadType")->add_child_text("frame-and-slice");
+		break;
+	case VIDEO_DECODE_THREADS_FRAME:
+		root->add_child("VideoDecodeThreadType")->add_child_text("frame");
+		break;
+	case VIDEO_DECODE_THREADS_SLICE:
+		root->add_child("VideoDecodeThreadType")->add_child_text("slice");
+		break;
+	}
 
 	/* [XML] DecodeReduction power of 2 to reduce DCP images by before decoding in the player. */
 	if (_decode_reduction) {
@@ -1291,6 +1421,16 @@ Config::existing_template (string name) const
 	return boost::filesystem::exists (template_path (name));
 }
 
+boost::filesystem::path
+Config::j2k_cache_directory () const
+{
+	if (_j2k_cache_directory) {
+		return *_j2k_cache_directory;
+	}
+
+	return path ("j2k_cache");
+}
+
 boost::filesystem::path
 Config::template_path (string name) const
 {
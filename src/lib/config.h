@@ -117,6 +117,43 @@ public:
 		return _only_servers_encode;
 	}
 
+	/** @return true to compress image data sent to encoding servers */
+	bool compress_server_transfers () const {
+		return _compress_server_transfers;
+	}
+
+	/** @return true to leave decoding of intra-frame video to the encoding threads and servers */
+	bool defer_video_decoding () const {
+		return _defer_video_decoding;
+	}
+
+	/** @return true to keep J2K data for frames that we encode, and re-use it when the same frame is encoded again */
+	bool j2k_cache () const {
+		return _j2k_cache;
+	}
+
+	boost::filesystem::path j2k_cache_directory () const;
+
+	/** @return maximum size of the J2K cache in gigabytes */
+	int j2k_cache_size () const {
+		return _j2k_cache_size;
+	}
+
+	/** @return true to decode and write each reel of a DCP in its own thread */
+	bool parallel_reels () const {
+		return _parallel_reels;
+	}
+
+	/** @return true to decode each piece of content in its own thread, ahead of the player */
+	bool parallel_content_decoding () const {
+		return _parallel_content_decoding;
+	}
+
+	/** @return true to ask encoding servers to make the picture for whole reels */
+	bool distribute_reels () const {
+		return _distribute_reels;
+	}
+
 	FileTransferProtocol tms_protocol () const {
 		return _tms_protocol;
 	}
@@ -422,6 +459,49 @@ public:
 		return _frames_in_memory_multiplier;
 	}
 
+	/** @return maximum amount of data waiting to be written to assets, in megabytes */
+	int write_behind_buffer () const {
+		return _write_behind_buffer;
+	}
+
+	enum FsyncPolicy {
+		/** leave it to the operating system to write data to disk */
+		FSYNC_NEVER,
+		/** sync each asset when it has been finished */
+		FSYNC_ASSET,
+		/** sync each asset whenever write_behind_buffer() megabytes have been written to it, and when it has been finished */
+		FSYNC_PERIODIC
+	};
+
+	FsyncPolicy fsync_policy () const {
+		return _fsync_policy;
+	}
+
+	/** @return maximum amount of image and audio memory to keep for re-use, in megabytes */
+	int buffer_pool_size () const {
+		return _buffer_pool_size;
+	}
+
+	/** @return number of threads that FFmpeg should use to decode each video stream, or 0 to decide
+	 *  based on the number of processors and the number of video streams being decoded at once.
+	 */
+	int video_decode_threads () const {
+		return _video_decode_threads;
+	}
+
+	enum VideoDecodeThreadType {
+		/** decode several frames at once where the codec allows, otherwise several slices of each frame */
+		VIDEO_DECODE_THREADS_FRAME_AND_SLICE,
+		/** decode several frames at once */
+		VIDEO_DECODE_THREADS_FRAME,
+		/** decode several slices of each frame at once; this adds no delay, but not all sources have slices */
+		VIDEO_DECODE_THREADS_SLICE
+	};
+
+	VideoDecodeThreadType video_decode_thread_type () const {
+		return _video_decode_thread_type;
+	}
+
 	boost::optional<int> decode_reduction () const {
 		return _decode_reduction;
 	}
@@ -568,6 +648,38 @@ public:
 		maybe_set (_only_servers_encode, o);
 	}
 
+	void set_compress_server_transfers (bool c) {
+		maybe_set (_compress_server_transfers, c);
+	}
+
+	void set_defer_video_decoding (bool d) {
+		maybe_set (_defer_video_decoding, d);
+	}
+
+	void set_j2k_cache (bool c) {
+		maybe_set (_j2k_cache, c);
+	}
+
+	void set_j2k_cache_directory (boost::filesystem::path d) {
+		maybe_set (_j2k_cache_directory, d);
+	}
+
+	void set_j2k_cache_size (int s) {
+		maybe_set (_j2k_cache_size, s);
+	}
+
+	void set_parallel_reels (bool p) {
+		maybe_set (_parallel_reels, p);
+	}
+
+	void set_parallel_content_decoding (bool p) {
+		maybe_set (_parallel_content_decoding, p);
+	}
+
+	void set_distribute_reels (bool d) {
+		maybe_set (_distribute_reels, d);
+	}
+
 	void set_tms_protocol (FileTransferProtocol p) {
 		maybe_set (_tms_protocol, p);
 	}
@@ -852,6 +964,24 @@ public:
 		maybe_set (_frames_in_memory_multiplier, m);
 	}
 
+	void set_write_behind_buffer (int b) {
+		maybe_set (_write_behind_buffer, b);
+	}
+
+	void set_fsync_policy (FsyncPolicy p) {
+		maybe_set (_fsync_policy, p);
+	}
+
+	void set_buffer_pool_size (int s);
+
+	void set_video_decode_threads (int t) {
+		maybe_set (_video_decode_threads, t);
+	}
+
+	void set_video_decode_thread_type (VideoDecodeThreadType t) {
+		maybe_set (_video_decode_thread_type, t);
+	}
+
 	void set_decode_reduction (boost::optional<int> r) {
 		maybe_set (_decode_reduction, r);
 	}
@@ -1100,6 +1230,7 @@ private:
 	Config ();
 	void read ();
 	void set_defaults ();
+	void update_buffer_pool () const;
 	void set_kdm_email_to_default ();
 	void set_notification_email_to_default ();
 	void set_cover_sheet_to_default ();
@@ -1143,6 +1274,16 @@ private:
 	/** J2K encoding servers that should definitely be used */
 	std::vector<std::string> _servers;
 	bool _only_servers_encode;
+	bool _compress_server_transfers;
+	bool _defer_video_decoding;
+	bool _j2k_cache;
+	/** Directory for the J2K cache, or empty to use the default */
+	boost::optional<boost::filesystem::path> _j2k_cache_directory;
+	/** Maximum size of the J2K cache in gigabytes */
+	int _j2k_cache_size;
+	bool _parallel_reels;
+	bool _parallel_content_decoding;
+	bool _distribute_reels;
 	FileTransferProtocol _tms_protocol;
 	/** The IP address of a TMS that we can copy DCPs to */
 	std::string _tms_ip;
@@ -1241,6 +1382,11 @@ private:
 	boost::optional<KDMWriteType> _last_kdm_write_type;
 	boost::optional<DKDMWriteType> _last_dkdm_write_type;
 	int _frames_in_memory_multiplier;
+	int _write_behind_buffer;
+	FsyncPolicy _fsync_policy;
+	int _buffer_pool_size;
+	int _video_decode_threads;
+	VideoDecodeThreadType _video_decode_thread_type;
 	boost::optional<int> _decode_reduction;
 	bool _default_notify;
 	bool _notification[NOTIFICATION_COUNT];
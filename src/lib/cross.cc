@@ -31,6 +31,11 @@ extern "C" {
 #ifdef DCPOMATIC_LINUX
 #include <unistd.h>
 #include <mntent.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/fs.h>
 #endif
 #ifdef DCPOMATIC_WINDOWS
 #include <windows.h>
@@ -46,11 +51,14 @@ extern "C" {
 #endif
 #ifdef DCPOMATIC_POSIX
 #include <sys/types.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <ifaddrs.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #endif
 #include <fstream>
+#include <algorithm>
 
 #include "i18n.h"
 
@@ -501,3 +509,127 @@ command_and_read (string cmd)
 
 	return "";
 }
+
+/** Try to make a copy-on-write clone of a file, which takes no time and no space
+ *  on filesystems (like Btrfs and XFS) that support it.  `to' must not already exist.
+ *  @return true if the clone was made, false if not, in which case `to' will not have been created.
+ */
+bool
+clone_file (boost::filesystem::path from, boost::filesystem::path to)
+{
+#if defined(DCPOMATIC_LINUX) && defined(FICLONE)
+	int const f = open (from.string().c_str(), O_RDONLY);
+	if (f < 0) {
+		return false;
+	}
+
+	int const t = open (to.string().c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+	if (t < 0) {
+		close (f);
+		return false;
+	}
+
+	bool const ok = ioctl (t, FICLONE, f) == 0;
+	close (f);
+	close (t);
+
+	if (!ok) {
+		boost::system::error_code ec;
+		boost::filesystem::remove (to, ec);
+	}
+
+	return ok;
+#else
+	return false;
+#endif
+}
+
+/** Try to copy a file using the kernel, so that the data does not have to pass through
+ *  our memory and (on network filesystems that support it) may not even have to leave
+ *  the server.  `to' must not already exist.
+ *  @return true if the copy was made, false if not, in which case `to' will not have been created.
+ */
+bool
+kernel_copy_file (boost::filesystem::path from, boost::filesystem::path to, boost::function<void (float)> progress)
+{
+#if defined(DCPOMATIC_LINUX) && defined(__NR_copy_file_range)
+	int const f = open (from.string().c_str(), O_RDONLY);
+	if (f < 0) {
+		return false;
+	}
+
+	struct stat st;
+	if (fstat (f, &st) < 0) {
+		close (f);
+		return false;
+	}
+
+	int const t = open (to.string().c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+	if (t < 0) {
+		close (f);
+		return false;
+	}
+
+	/* on the order of a second's worth of copying, so that we can report progress */
+	int64_t const chunk = 256 * 1024 * 1024;
+	int64_t const total = st.st_size;
+	int64_t remaining = total;
+	bool ok = true;
+
+	while (remaining > 0) {
+		ssize_t const r = syscall (__NR_copy_file_range, f, 0, t, 0, std::min (chunk, remaining), 0);
+		if (r <= 0) {
+			/* Either this is not supported for these files or something went wrong; either way
+			   the caller can try another method.
+			*/
+			ok = false;
+			break;
+		}
+		remaining -= r;
+		progress (1 - float(remaining) / total);
+	}
+
+	close (f);
+	close (t);
+
+	if (!ok) {
+		boost::system::error_code ec;
+		boost::filesystem::remove (to, ec);
+	}
+
+	return ok;
+#else
+	return false;
+#endif
+}
+
+/** Ask the operating system to write any data for a file that it is holding in its cache to disk,
+ *  and wait until it has done so.
+ *  @return true if the data was written, otherwise false.
+ */
+bool
+sync_file (boost::filesystem::path file)
+{
+#ifdef DCPOMATIC_POSIX
+	int const f = open (file.string().c_str(), O_RDONLY);
+	if (f < 0) {
+		return false;
+	}
+
+	bool const ok = fsync (f) == 0;
+	close (f);
+	return ok;
+#endif
+
+#ifdef DCPOMATIC_WINDOWS
+	/* FlushFileBuffers needs a handle with write access */
+	HANDLE h = CreateFileW (file.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+	if (h == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	bool const ok = FlushFileBuffers (h);
+	CloseHandle (h);
+	return ok;
+#endif
+}
@@ -29,6 +29,7 @@
 #include <IOKit/pwr_mgt/IOPMLib.h>
 #endif
 #include <boost/filesystem.hpp>
+#include <boost/function.hpp>
 
 #ifdef DCPOMATIC_WINDOWS
 #define WEXITSTATUS(w) (w)
@@ -51,6 +52,9 @@ extern void maybe_open_console ();
 extern boost::filesystem::path shared_path ();
 extern FILE * fopen_boost (boost::filesystem::path, std::string);
 extern int dcpomatic_fseek (FILE *, int64_t, int);
+extern bool clone_file (boost::filesystem::path from, boost::filesystem::path to);
+extern bool kernel_copy_file (boost::filesystem::path from, boost::filesystem::path to, boost::function<void (float)> progress);
+extern bool sync_file (boost::filesystem::path file);
 extern void start_batch_converter (boost::filesystem::path dcpomatic);
 extern void start_player (boost::filesystem::path dcpomatic);
 extern uint64_t thread_id ();
@@ -37,7 +37,13 @@
 #include "referenced_reel_asset.h"
 #include "text_content.h"
 #include "player_video.h"
+#include "audio_buffers.h"
+#include "config.h"
+#include "remote_reel_encoder.h"
+#include "exceptions.h"
+#include "dcpomatic_log.h"
 #include <boost/signals2.hpp>
+#include <boost/thread.hpp>
 #include <boost/foreach.hpp>
 #include <iostream>
 
@@ -46,6 +52,8 @@
 using std::string;
 using std::cout;
 using std::list;
+using std::min;
+using std::set;
 using boost::shared_ptr;
 using boost::weak_ptr;
 using boost::dynamic_pointer_cast;
@@ -60,6 +68,10 @@ DCPEncoder::DCPEncoder (shared_ptr<const Film> film, weak_ptr<Job> job)
 	, _finishing (false)
 	, _non_burnt_subtitles (false)
 {
+	if (Config::instance()->defer_video_decoding()) {
+		_player->set_defer_video_decoding ();
+	}
+
 	_player_video_connection = _player->Video.connect (bind (&DCPEncoder::video, this, _1, _2));
 	_player_audio_connection = _player->Audio.connect (bind (&DCPEncoder::audio, this, _1, _2));
 	_player_text_connection = _player->Text.connect (bind (&DCPEncoder::text, this, _1, _2, _3, _4));
@@ -84,6 +96,18 @@ DCPEncoder::~DCPEncoder ()
 void
 DCPEncoder::go ()
 {
+	set<size_t> remote;
+	if (Config::instance()->distribute_reels()) {
+		/* This must happen before the Writer is made so that it sees the picture assets that the servers write */
+		remote = RemoteReelEncoder(_film, _job).go ();
+	}
+
+	bool const all_remote = !remote.empty() && remote.size() == _film->reels().size();
+	if (all_remote) {
+		/* We don't need to decode any video; we just copy the servers' frames into the Writer */
+		_player->set_ignore_video ();
+	}
+
 	_writer.reset (new Writer (_film, _job));
 	_writer->start ();
 
@@ -111,7 +135,15 @@ DCPEncoder::go ()
 		_writer->write (fonts);
 	}
 
-	while (!_player->pass ()) {}
+	if (Config::instance()->parallel_reels() && _film->reels().size() > 1 && !all_remote) {
+		encode_reels ();
+	} else {
+		while (!_player->pass ()) {}
+	}
+
+	if (all_remote) {
+		write_remote_picture ();
+	}
 
 	BOOST_FOREACH (ReferencedReelAsset i, _player->get_reel_assets ()) {
 		_writer->write (i);
@@ -122,6 +154,170 @@ DCPEncoder::go ()
 	_writer->finish ();
 }
 
+/** Give every frame of the picture to the Writer when all the picture assets
+ *  have been made by encoding servers.
+ */
+void
+DCPEncoder::write_remote_picture ()
+{
+	Frame const frames = _film->length().frames_round (_film->video_frame_rate ());
+	list<Eyes> eyes;
+	if (_film->three_d ()) {
+		eyes.push_back (EYES_LEFT);
+		eyes.push_back (EYES_RIGHT);
+	} else {
+		eyes.push_back (EYES_BOTH);
+	}
+
+	for (Frame i = 0; i < frames; ++i) {
+		BOOST_FOREACH (Eyes j, eyes) {
+			if (_writer->can_fake_write (i)) {
+				_writer->fake_write (i, j);
+			} else {
+				optional<dcp::Data> data = _writer->existing_frame (i, j);
+				if (!data) {
+					throw EncodeError (String::compose ("frame %1 is missing from a reel made by an encoding server", i));
+				}
+				_writer->write (*data, i, j);
+			}
+		}
+		boost::this_thread::interruption_point ();
+	}
+}
+
+/** Encode each reel using its own Player in its own thread, so that decoding of
+ *  different parts of the film can happen at the same time.  The reels share our
+ *  J2KEncoder and Writer.
+ */
+void
+DCPEncoder::encode_reels ()
+{
+	list<DCPTimePeriod> const reels = _film->reels ();
+	LOG_GENERAL ("Encoding %1 reels in parallel", reels.size());
+
+	_reel_progress.assign (reels.size(), DCPTime());
+
+	boost::thread_group threads;
+
+	try {
+		size_t n = 0;
+		BOOST_FOREACH (DCPTimePeriod i, reels) {
+			threads.create_thread (boost::bind (&DCPEncoder::encode_reel, this, n++, i));
+		}
+		threads.join_all ();
+	} catch (...) {
+		/* Probably the job has been cancelled; stop our threads before we go away */
+		threads.interrupt_all ();
+		threads.join_all ();
+		throw;
+	}
+
+	rethrow ();
+}
+
+/** Thread to encode one reel.
+ *  @param index Reel index.
+ *  @param period Reel period.
+ */
+void
+DCPEncoder::encode_reel (size_t index, DCPTimePeriod period)
+try
+{
+	Reel reel (index, period);
+
+	shared_ptr<Player> player (new Player (_film, _film->playlist ()));
+	if (Config::instance()->defer_video_decoding()) {
+		player->set_defer_video_decoding ();
+	}
+	boost::signals2::scoped_connection video = player->Video.connect (bind (&DCPEncoder::reel_video, this, &reel, _1, _2));
+	boost::signals2::scoped_connection audio = player->Audio.connect (bind (&DCPEncoder::reel_audio, this, &reel, _1, _2));
+	boost::signals2::scoped_connection text = player->Text.connect (bind (&DCPEncoder::reel_text, this, &reel, _1, _2, _3, _4));
+
+	player->seek (period.from, true);
+	while (!(reel.video_done && reel.audio_done) && !player->pass ()) {
+		boost::this_thread::interruption_point ();
+	}
+}
+catch (boost::thread_interrupted &)
+{
+	/* We have been asked to stop */
+}
+catch (...)
+{
+	store_current ();
+}
+
+void
+DCPEncoder::reel_video (Reel* reel, shared_ptr<PlayerVideo> data, DCPTime time)
+{
+	if (time >= reel->period.to) {
+		reel->video_done = true;
+	}
+
+	if (reel->period.contains (time)) {
+		video (data, time);
+	}
+}
+
+void
+DCPEncoder::reel_audio (Reel* reel, shared_ptr<AudioBuffers> data, DCPTime time)
+{
+	int const afr = _film->audio_frame_rate ();
+	DCPTime const end = time + DCPTime::from_frames (data->frames(), afr);
+
+	if (end >= reel->period.to) {
+		reel->audio_done = true;
+	}
+
+	optional<DCPTimePeriod> overlap = DCPTimePeriod (time, end).overlap (reel->period);
+	if (!overlap) {
+		return;
+	}
+
+	/* Trim off anything that is outside the reel */
+	Frame const offset = (overlap->from - time).frames_round (afr);
+	Frame const frames = min (static_cast<Frame> (data->frames()) - offset, overlap->duration().frames_round (afr));
+	if (offset != 0 || frames != data->frames()) {
+		shared_ptr<AudioBuffers> part (new AudioBuffers (data->channels(), frames));
+		part->copy_from (data.get(), frames, offset, 0);
+		data = part;
+	}
+
+	_writer->write (data, reel->index);
+
+	{
+		boost::mutex::scoped_lock lm (_reel_progress_mutex);
+		_reel_progress[reel->index] = overlap->to - reel->period.from;
+	}
+
+	set_progress ();
+}
+
+void
+DCPEncoder::reel_text (Reel* reel, PlayerText data, TextType type, optional<DCPTextTrack> track, DCPTimePeriod period)
+{
+	/* Text goes in the reel where it starts, as it does when we use one Player for everything */
+	if (reel->period.contains (period.from) && (type == TEXT_CLOSED_CAPTION || _non_burnt_subtitles)) {
+		_writer->write (data, type, track, period, reel->index);
+	}
+}
+
+void
+DCPEncoder::set_progress ()
+{
+	DCPTime done;
+	{
+		boost::mutex::scoped_lock lm (_reel_progress_mutex);
+		BOOST_FOREACH (DCPTime i, _reel_progress) {
+			done += i;
+		}
+	}
+
+	shared_ptr<Job> job = _job.lock ();
+	DCPOMATIC_ASSERT (job);
+	job->set_progress (float(done.get()) / _film->length().get());
+}
+
 void
 DCPEncoder::video (shared_ptr<PlayerVideo> data, DCPTime time)
 {
@@ -170,3 +366,14 @@ DCPEncoder::frames_done () const
 
 	return _j2k_encoder->video_frames_enqueued ();
 }
+
+/** @return Number of frames whose J2K data was taken from an earlier encode of the film */
+Frame
+DCPEncoder::frames_reused () const
+{
+	if (!_j2k_encoder) {
+		return 0;
+	}
+
+	return _j2k_encoder->video_frames_reused ();
+}
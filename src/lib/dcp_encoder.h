@@ -22,7 +22,11 @@
 #include "player_text.h"
 #include "dcp_text_track.h"
 #include "encoder.h"
+#include "exception_store.h"
+#include "dcpomatic_time.h"
 #include <boost/weak_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <vector>
 
 class Film;
 class J2KEncoder;
@@ -33,7 +37,7 @@ class PlayerVideo;
 class AudioBuffers;
 
 /** @class DCPEncoder */
-class DCPEncoder : public Encoder
+class DCPEncoder : public Encoder, public ExceptionStore
 {
 public:
 	DCPEncoder (boost::shared_ptr<const Film> film, boost::weak_ptr<Job> job);
@@ -43,6 +47,7 @@ public:
 
 	float current_rate () const;
 	Frame frames_done () const;
+	Frame frames_reused () const;
 
 	/** @return true if we are in the process of calling Encoder::process_end */
 	bool finishing () const {
@@ -55,11 +60,42 @@ private:
 	void audio (boost::shared_ptr<AudioBuffers>, DCPTime);
 	void text (PlayerText, TextType, boost::optional<DCPTextTrack>, DCPTimePeriod);
 
+	/** State of a reel which is being encoded by its own Player */
+	struct Reel
+	{
+		Reel (size_t index_, DCPTimePeriod period_)
+			: index (index_)
+			, period (period_)
+			, video_done (false)
+			, audio_done (false)
+		{}
+
+		size_t index;
+		DCPTimePeriod period;
+		/** true if the player has given us video from after the end of the reel */
+		bool video_done;
+		/** true if the player has given us audio up to the end of the reel */
+		bool audio_done;
+	};
+
+	void write_remote_picture ();
+	void encode_reels ();
+	void encode_reel (size_t index, DCPTimePeriod period);
+	void reel_video (Reel* reel, boost::shared_ptr<PlayerVideo>, DCPTime);
+	void reel_audio (Reel* reel, boost::shared_ptr<AudioBuffers>, DCPTime);
+	void reel_text (Reel* reel, PlayerText, TextType, boost::optional<DCPTextTrack>, DCPTimePeriod);
+	void set_progress ();
+
 	boost::shared_ptr<Writer> _writer;
 	boost::shared_ptr<J2KEncoder> _j2k_encoder;
 	bool _finishing;
 	bool _non_burnt_subtitles;
 
+	/** mutex for _reel_progress */
+	boost::mutex _reel_progress_mutex;
+	/** amount of each reel that has been done, when reels are being encoded by their own Players */
+	std::vector<DCPTime> _reel_progress;
+
 	boost::signals2::scoped_connection _player_video_connection;
 	boost::signals2::scoped_connection _player_audio_connection;
 	boost::signals2::scoped_connection _player_text_connection;
@@ -39,6 +39,8 @@
 #include "cross.h"
 #include "player_video.h"
 #include "compose.hpp"
+#include "digester.h"
+#include "direct_xyz.h"
 #include <libcxml/cxml.h>
 #include <dcp/raw_convert.h>
 #include <dcp/openjpeg_image.h>
@@ -56,6 +58,7 @@
 using std::string;
 using std::cout;
 using boost::shared_ptr;
+using boost::optional;
 using dcp::Size;
 using dcp::Data;
 using dcp::raw_convert;
@@ -91,10 +94,18 @@ DCPVideo::DCPVideo (shared_ptr<const PlayerVideo> frame, shared_ptr<const cxml::
 shared_ptr<dcp::OpenJPEGImage>
 DCPVideo::convert_to_xyz (shared_ptr<const PlayerVideo> frame, dcp::NoteHandler note)
 {
-	shared_ptr<dcp::OpenJPEGImage> xyz;
+	shared_ptr<dcp::OpenJPEGImage> xyz = frame->direct_xyz (note);
+	if (xyz) {
+		return xyz;
+	}
 
 	shared_ptr<Image> image = frame->image (bind (&PlayerVideo::keep_xyz_or_rgb, _1), true, false);
-	if (frame->colour_conversion()) {
+	if (frame->colour_conversion() && image->pixel_format() == AV_PIX_FMT_RGB48LE) {
+		/* Any fade has already been applied to image, and it needs no crop */
+		xyz = convert_directly_to_xyz (
+			image, Crop(), image->size(), frame->colour_conversion()->yuv_to_rgb(), frame->colour_conversion().get(), optional<double>(), note
+			);
+	} else if (frame->colour_conversion()) {
 		xyz = dcp::rgb_to_xyz (
 			image->data()[0],
 			image->size(),
@@ -157,22 +168,9 @@ DCPVideo::encode_remotely (EncodeServerDescription serv, int timeout)
 
 	socket->connect (*endpoint_iterator);
 
-	/* Collect all XML metadata */
-	xmlpp::Document doc;
-	xmlpp::Element* root = doc.create_root_node ("EncodingRequest");
-	root->add_child("Version")->add_child_text (raw_convert<string> (SERVER_LINK_VERSION));
-	add_metadata (root);
-
 	LOG_DEBUG_ENCODE (N_("Sending frame %1 to remote"), _index);
 
-	/* Send XML metadata */
-	string xml = doc.write_to_string ("UTF-8");
-	socket->write (xml.length() + 1);
-	socket->write ((uint8_t *) xml.c_str(), xml.length() + 1);
-
-	/* Send binary data */
-	LOG_TIMING("start-remote-send thread=%1", thread_id ());
-	_frame->send_binary (socket);
+	send_request (socket, serv);
 
 	/* Read the response (JPEG2000-encoded data); this blocks until the data
 	   is ready and sent back.
@@ -188,14 +186,57 @@ DCPVideo::encode_remotely (EncodeServerDescription serv, int timeout)
 	return e;
 }
 
+/** Send an encoding request for this frame (XML metadata followed by binary image data)
+ *  down a socket.
+ *  @param socket Socket to write to.
+ *  @param server Server that we are sending to.
+ *  @param tag Tag to identify this frame within a pipelined session, or none if this
+ *  is a single-frame request.
+ */
 void
-DCPVideo::add_metadata (xmlpp::Element* el) const
+DCPVideo::send_request (shared_ptr<Socket> socket, EncodeServerDescription server, optional<uint32_t> tag) const
+{
+	shared_ptr<const PlayerVideo> frame = _frame;
+	if (frame->minimum_link_version() > server.link_version()) {
+		/* This server can't understand our image, so decode it here */
+		frame = frame->decoded_copy ();
+	}
+
+	TransportCompression compression = TRANSPORT_COMPRESSION_NONE;
+	if (Config::instance()->compress_server_transfers() && server.compressed_transport()) {
+		compression = TRANSPORT_COMPRESSION_ZLIB;
+	}
+
+	/* Collect all XML metadata */
+	xmlpp::Document doc;
+	xmlpp::Element* root = doc.create_root_node ("EncodingRequest");
+	root->add_child("Version")->add_child_text (raw_convert<string> (server.link_version()));
+	if (tag) {
+		root->add_child("Tag")->add_child_text (raw_convert<string> (tag.get()));
+	}
+	if (compression != TRANSPORT_COMPRESSION_NONE) {
+		root->add_child("TransportCompression")->add_child_text (transport_compression_to_string (compression));
+	}
+	add_metadata (root, frame);
+
+	/* Send XML metadata */
+	string xml = doc.write_to_string ("UTF-8");
+	socket->write (xml.length() + 1);
+	socket->write ((uint8_t *) xml.c_str(), xml.length() + 1);
+
+	/* Send binary data */
+	LOG_TIMING("start-remote-send thread=%1", thread_id ());
+	frame->send_binary (socket, compression);
+}
+
+void
+DCPVideo::add_metadata (xmlpp::Element* el, shared_ptr<const PlayerVideo> frame) const
 {
 	el->add_child("Index")->add_child_text (raw_convert<string> (_index));
 	el->add_child("FramesPerSecond")->add_child_text (raw_convert<string> (_frames_per_second));
 	el->add_child("J2KBandwidth")->add_child_text (raw_convert<string> (_j2k_bandwidth));
 	el->add_child("Resolution")->add_child_text (raw_convert<string> (int (_resolution)));
-	_frame->add_metadata (el);
+	frame->add_metadata (el);
 }
 
 Eyes
@@ -218,3 +259,24 @@ DCPVideo::same (shared_ptr<const DCPVideo> other) const
 
 	return _frame->same (other->_frame);
 }
+
+/** @return A digest of everything that affects the J2K data that we will produce, so
+ *  that two DCPVideos with the same digest will give the same J2K data.  Our index
+ *  is not included.
+ */
+string
+DCPVideo::digest () const
+{
+	boost::mutex::scoped_lock lm (_digest_mutex);
+
+	if (!_digest) {
+		Digester digester;
+		_frame->add_digest (digester);
+		digester.add (_frames_per_second);
+		digester.add (_j2k_bandwidth);
+		digester.add (static_cast<int> (_resolution));
+		_digest = digester.get ();
+	}
+
+	return *_digest;
+}
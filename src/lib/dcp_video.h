@@ -22,6 +22,8 @@
 #include "encode_server_description.h"
 #include <libcxml/cxml.h>
 #include <dcp/data.h>
+#include <boost/thread/mutex.hpp>
+#include <boost/optional.hpp>
 
 /** @file  src/dcp_video_frame.h
  *  @brief A single frame of video destined for a DCP.
@@ -29,6 +31,7 @@
 
 class Log;
 class PlayerVideo;
+class Socket;
 
 /** @class DCPVideo
  *  @brief A single frame of video destined for a DCP.
@@ -47,6 +50,7 @@ public:
 
 	dcp::Data encode_locally ();
 	dcp::Data encode_remotely (EncodeServerDescription, int timeout = 30);
+	void send_request (boost::shared_ptr<Socket> socket, EncodeServerDescription server, boost::optional<uint32_t> tag = boost::optional<uint32_t>()) const;
 
 	int index () const {
 		return _index;
@@ -55,16 +59,21 @@ public:
 	Eyes eyes () const;
 
 	bool same (boost::shared_ptr<const DCPVideo> other) const;
+	std::string digest () const;
 
 	static boost::shared_ptr<dcp::OpenJPEGImage> convert_to_xyz (boost::shared_ptr<const PlayerVideo> frame, dcp::NoteHandler note);
 
 private:
 
-	void add_metadata (xmlpp::Element *) const;
+	void add_metadata (xmlpp::Element *, boost::shared_ptr<const PlayerVideo> frame) const;
 
 	boost::shared_ptr<const PlayerVideo> _frame;
 	int _index;			 ///< frame index within the DCP's intrinsic duration
 	int _frames_per_second;		 ///< Frames per second that we will use for the DCP
 	int _j2k_bandwidth;		 ///< J2K bandwidth to use
 	Resolution _resolution;          ///< Resolution (2K or 4K)
+
+	mutable boost::mutex _digest_mutex;
+	/** Result of digest(), once it has been worked out */
+	mutable boost::optional<std::string> _digest;
 };
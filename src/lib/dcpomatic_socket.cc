@@ -23,6 +23,8 @@
 #include "exceptions.h"
 #include <boost/bind.hpp>
 #include <boost/lambda/lambda.hpp>
+#include <boost/scoped_array.hpp>
+#include <zlib.h>
 #include <iostream>
 
 #include "i18n.h"
@@ -32,6 +34,8 @@ Socket::Socket (int timeout)
 	: _deadline (_io_service)
 	, _socket (_io_service)
 	, _timeout (timeout)
+	, _bytes_read (0)
+	, _uncompressed_bytes_read (0)
 {
 	_deadline.expires_at (boost::posix_time::pos_infin);
 	check ();
@@ -117,6 +121,9 @@ Socket::read (uint8_t* data, int size)
 	if (ec) {
 		throw NetworkError (String::compose (_("error during async_read (%1)"), ec.value ()));
 	}
+
+	_bytes_read += size;
+	_uncompressed_bytes_read += size;
 }
 
 uint32_t
@@ -126,3 +133,61 @@ Socket::read_uint32 ()
 	read (reinterpret_cast<uint8_t *> (&v), 4);
 	return ntohl (v);
 }
+
+/** Blocking write of a block of data, possibly compressed.  The other end
+ *  must read it with read_block(), passing the same size and compression.
+ *  @param data Buffer to write.
+ *  @param size Number of bytes to write.
+ *  @param compression Compression to use.
+ */
+void
+Socket::write_block (uint8_t const * data, int size, TransportCompression compression)
+{
+	switch (compression) {
+	case TRANSPORT_COMPRESSION_NONE:
+		write (data, size);
+		break;
+	case TRANSPORT_COMPRESSION_ZLIB:
+	{
+		uLongf compressed_size = compressBound (size);
+		boost::scoped_array<uint8_t> compressed (new uint8_t[compressed_size]);
+		int const r = compress2 (compressed.get(), &compressed_size, data, size, Z_BEST_SPEED);
+		if (r != Z_OK) {
+			throw NetworkError (String::compose (_("could not compress data for sending (%1)"), r));
+		}
+		write (compressed_size);
+		write (compressed.get(), compressed_size);
+		break;
+	}
+	}
+}
+
+/** Blocking read of a block of data written by write_block().
+ *  @param data Buffer to read to.
+ *  @param size Number of bytes to read once any compression is removed.
+ *  @param compression Compression that was used to write the block.
+ */
+void
+Socket::read_block (uint8_t* data, int size, TransportCompression compression)
+{
+	switch (compression) {
+	case TRANSPORT_COMPRESSION_NONE:
+		read (data, size);
+		break;
+	case TRANSPORT_COMPRESSION_ZLIB:
+	{
+		uint32_t const compressed_size = read_uint32 ();
+		boost::scoped_array<uint8_t> compressed (new uint8_t[compressed_size]);
+		read (compressed.get(), compressed_size);
+		uLongf uncompressed_size = size;
+		int const r = uncompress (data, &uncompressed_size, compressed.get(), compressed_size);
+		if (r != Z_OK || uncompressed_size != static_cast<uLongf> (size)) {
+			throw NetworkError (String::compose (_("could not decompress received data (%1)"), r));
+		}
+		/* read() counted the length and compressed data; count them at their real size instead */
+		_uncompressed_bytes_read -= compressed_size + 4;
+		_uncompressed_bytes_read += size;
+		break;
+	}
+	}
+}
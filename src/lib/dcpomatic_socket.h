@@ -18,6 +18,7 @@
 
 */
 
+#include "types.h"
 #include <boost/asio.hpp>
 #include <boost/noncopyable.hpp>
 
@@ -46,6 +47,21 @@ public:
 	void read (uint8_t* data, int size);
 	uint32_t read_uint32 ();
 
+	void write_block (uint8_t const * data, int size, TransportCompression compression);
+	void read_block (uint8_t* data, int size, TransportCompression compression);
+
+	/** @return Total number of bytes that have been read from the network */
+	uint64_t bytes_read () const {
+		return _bytes_read;
+	}
+
+	/** @return Total number of bytes that have been read, counting data from
+	 *  compressed blocks at their uncompressed size.
+	 */
+	uint64_t uncompressed_bytes_read () const {
+		return _uncompressed_bytes_read;
+	}
+
 private:
 	void check ();
 
@@ -55,4 +71,6 @@ private:
 	boost::asio::deadline_timer _deadline;
 	boost::asio::ip::tcp::socket _socket;
 	int _timeout;
+	uint64_t _bytes_read;
+	uint64_t _uncompressed_bytes_read;
 };
@@ -0,0 +1,159 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/decoder_thread.cc
+ *  @brief DecoderThread class.
+ */
+
+#include "decoder_thread.h"
+#include "decoder.h"
+#include <boost/foreach.hpp>
+
+using boost::shared_ptr;
+
+/** @param decoder Decoder to run.
+ *  @param passes Maximum number of the decoder's passes to have waiting to be replayed.
+ */
+DecoderThread::DecoderThread (shared_ptr<Decoder> decoder, int passes)
+	: _decoder (decoder)
+	, _passes (passes)
+	, _position (decoder->position ())
+	, _busy (false)
+	, _paused (false)
+	, _done (false)
+	, _finish (false)
+{
+
+}
+
+DecoderThread::~DecoderThread ()
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	_finish = true;
+	_condition.notify_all ();
+	lm.unlock ();
+
+	if (_thread.joinable ()) {
+		_thread.join ();
+	}
+}
+
+void
+DecoderThread::start ()
+{
+	_thread = boost::thread (boost::bind (&DecoderThread::thread, this));
+#ifdef DCPOMATIC_LINUX
+	pthread_setname_np (_thread.native_handle(), "decoder");
+#endif
+}
+
+void
+DecoderThread::thread ()
+{
+	while (true) {
+		boost::mutex::scoped_lock lm (_mutex);
+		while (!_finish && (_paused || _done || int (_queue.size()) >= _passes)) {
+			_condition.wait (lm);
+		}
+
+		if (_finish) {
+			return;
+		}
+
+		_busy = true;
+		lm.unlock ();
+
+		Pass pass;
+		try {
+			pass.done = _decoder->pass ();
+			pass.position = _decoder->position ();
+		} catch (...) {
+			pass.exception = boost::current_exception ();
+			pass.done = true;
+		}
+		pass.emissions.swap (_emissions);
+
+		lm.lock ();
+		_busy = false;
+		_done = pass.done;
+		_queue.push_back (pass);
+		_condition.notify_all ();
+	}
+}
+
+/** Replay what the decoder emitted during its next pass, waiting for the pass to happen if necessary.
+ *  @return true if the decoder will emit no more data unless a seek() happens.
+ */
+bool
+DecoderThread::pass ()
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	while (_queue.empty ()) {
+		if (_done) {
+			return true;
+		}
+		_condition.wait (lm);
+	}
+
+	Pass pass = _queue.front ();
+	_queue.pop_front ();
+	_condition.notify_all ();
+	lm.unlock ();
+
+	if (pass.exception) {
+		boost::rethrow_exception (pass.exception);
+	}
+
+	BOOST_FOREACH (boost::function<void ()> i, pass.emissions) {
+		i ();
+	}
+
+	_position = pass.position;
+	return pass.done;
+}
+
+/** Seek the decoder, discarding anything that it has emitted but which has not yet been replayed */
+void
+DecoderThread::seek (ContentTime time, bool accurate)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	_paused = true;
+	while (_busy) {
+		_condition.wait (lm);
+	}
+	_queue.clear ();
+	lm.unlock ();
+
+	/* Our thread will not touch the decoder while _paused is true */
+	try {
+		_decoder->seek (time, accurate);
+		_position = _decoder->position ();
+	} catch (...) {
+		lm.lock ();
+		_paused = false;
+		_condition.notify_all ();
+		throw;
+	}
+
+	lm.lock ();
+	_done = false;
+	_paused = false;
+	_condition.notify_all ();
+}
@@ -0,0 +1,139 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef DCPOMATIC_DECODER_THREAD_H
+#define DCPOMATIC_DECODER_THREAD_H
+
+/** @file  src/lib/decoder_thread.h
+ *  @brief DecoderThread class.
+ */
+
+#include "dcpomatic_time.h"
+#include <boost/shared_ptr.hpp>
+#include <boost/function.hpp>
+#include <boost/bind.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/condition.hpp>
+#include <boost/exception_ptr.hpp>
+#include <list>
+
+class Decoder;
+
+/** @class DecoderThread
+ *  @brief A thread which runs a Decoder ahead of whatever is using it.
+ *
+ *  The thread calls pass() on the decoder and records what the decoder emits
+ *  during each pass, until a given number of passes are waiting to be used.  The
+ *  user of the decoder calls our pass(), position() and seek() in place of the
+ *  decoder's; our pass() replays what the decoder emitted during its next pass,
+ *  so the user sees exactly the same thing as it would if it were calling the
+ *  decoder directly.
+ *
+ *  Anything that would be connected to one of the decoder's signals should be
+ *  passed through defer() first, and start() must be called once that has been done.
+ */
+class DecoderThread : public boost::noncopyable
+{
+public:
+	DecoderThread (boost::shared_ptr<Decoder> decoder, int passes);
+	~DecoderThread ();
+
+	void start ();
+
+	bool pass ();
+	void seek (ContentTime time, bool accurate);
+
+	/** @return The decoder's position after the last pass that was replayed by pass() */
+	ContentTime position () const {
+		return _position;
+	}
+
+	/** @param handler Handler for a signal with one parameter.
+	 *  @return Handler to connect to the decoder's signal instead of handler.
+	 */
+	template <class A>
+	boost::function<void (A)> defer (boost::function<void (A)> handler) {
+		return boost::bind (&DecoderThread::record1<A>, this, handler, _1);
+	}
+
+	/** @param handler Handler for a signal with two parameters.
+	 *  @return Handler to connect to the decoder's signal instead of handler.
+	 */
+	template <class A, class B>
+	boost::function<void (A, B)> defer (boost::function<void (A, B)> handler) {
+		return boost::bind (&DecoderThread::record2<A, B>, this, handler, _1, _2);
+	}
+
+private:
+	/** What happened during one pass of the decoder */
+	struct Pass
+	{
+		Pass ()
+			: done (false)
+		{}
+
+		/** calls to make to the handlers that were passed to defer() */
+		std::list<boost::function<void ()> > emissions;
+		/** decoder's position after the pass */
+		ContentTime position;
+		/** value returned from the decoder's pass() */
+		bool done;
+		/** exception thrown by the decoder's pass(), if there was one */
+		boost::exception_ptr exception;
+	};
+
+	template <class A>
+	void record1 (boost::function<void (A)> handler, A a) {
+		_emissions.push_back (boost::bind (handler, a));
+	}
+
+	template <class A, class B>
+	void record2 (boost::function<void (A, B)> handler, A a, B b) {
+		_emissions.push_back (boost::bind (handler, a, b));
+	}
+
+	void thread ();
+
+	boost::shared_ptr<Decoder> _decoder;
+	/** maximum number of passes to have waiting */
+	int _passes;
+	/** position to report from position(); only used by the user's thread */
+	ContentTime _position;
+	/** emissions during the pass that our thread is doing; only used by our thread */
+	std::list<boost::function<void ()> > _emissions;
+
+	/** mutex for everything below here */
+	boost::mutex _mutex;
+	boost::condition _condition;
+	std::list<Pass> _queue;
+	/** true if our thread is calling the decoder's pass() */
+	bool _busy;
+	/** true if our thread should not start another pass, because we are seeking */
+	bool _paused;
+	/** true if the decoder has nothing more to emit until there is a seek */
+	bool _done;
+	/** true if our thread should finish */
+	bool _finish;
+
+	boost::thread _thread;
+};
+
+#endif
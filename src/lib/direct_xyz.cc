@@ -0,0 +1,375 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/direct_xyz.cc
+ *  @brief Conversion of YUV or RGB images straight to XYZ for JPEG2000 encoding.
+ *
+ *  The usual route from a decoded image to the XYZ data that we give to the JPEG2000
+ *  encoder is to crop, scale and convert it to RGB48LE with swscale, then to pass that
+ *  to dcp::rgb_to_xyz.  Here we do the YUV to RGB conversion, input transfer function,
+ *  RGB to XYZ matrix and output transfer function in one pass over an image that has
+ *  already been cropped and scaled (if necessary) in its own pixel format, writing the
+ *  OpenJPEG component planes directly.  The RGB to XYZ part is done by a shared XYZTransform.
+ */
+
+#include "direct_xyz.h"
+#include "image.h"
+#include "xyz_transform.h"
+#include "colour_conversion.h"
+#include "dcpomatic_assert.h"
+#include "compose.hpp"
+#include <dcp/openjpeg_image.h>
+extern "C" {
+#include <libavutil/pixdesc.h>
+}
+#include <algorithm>
+#include <vector>
+
+using std::min;
+using std::max;
+using std::vector;
+using boost::shared_ptr;
+using boost::optional;
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+/* Build an AVX2 version of the conversion as well as the generic one, and choose between them at run time */
+#define DCPOMATIC_DIRECT_XYZ_AVX2
+#endif
+
+#ifdef __GNUC__
+#define DCPOMATIC_ALWAYS_INLINE inline __attribute__ ((always_inline))
+#else
+#define DCPOMATIC_ALWAYS_INLINE inline
+#endif
+
+namespace {
+
+/** Everything that the conversion of each row needs to know */
+struct Job
+{
+	enum Source {
+		YUV_8,
+		YUV_16,
+		RGB24,
+		RGB48
+	};
+
+	Image const * image;
+	Source source;
+	int chroma_x_shift;
+	int chroma_y_shift;
+	Crop crop;
+	/** size of the part of the image that we are converting */
+	dcp::Size size;
+	float fade;
+
+	/** @name Coefficients to convert limited-range YUV to RGB in the range [0, 1] */
+	/** @{ */
+	float y_scale;
+	float y_offset;
+	float c_scale;
+	float c_offset;
+	float rv;
+	float gu;
+	float gv;
+	float bu;
+	/** @} */
+
+	XYZTransform const * transform;
+};
+
+}
+
+static int
+component_depth (AVPixFmtDescriptor const * d, int c)
+{
+#ifdef DCPOMATIC_HAVE_AVCOMPONENTDESCRIPTOR_DEPTH_MINUS1
+	return d->comp[c].depth_minus1 + 1;
+#else
+	return d->comp[c].depth;
+#endif
+}
+
+/** @return true if convert_directly_to_xyz() can convert images in a given pixel format */
+bool
+can_convert_directly_to_xyz (AVPixelFormat format)
+{
+	if (format == AV_PIX_FMT_RGB24 || format == AV_PIX_FMT_RGB48LE) {
+		return true;
+	}
+
+	AVPixFmtDescriptor const * d = av_pix_fmt_desc_get (format);
+	if (!d) {
+		return false;
+	}
+
+	int const unsupported = AV_PIX_FMT_FLAG_RGB | AV_PIX_FMT_FLAG_BE | AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_BITSTREAM;
+	if ((d->flags & unsupported) || !(d->flags & AV_PIX_FMT_FLAG_PLANAR)) {
+		return false;
+	}
+
+	if (d->nb_components < 3 || d->log2_chroma_w > 1 || d->log2_chroma_h > 1) {
+		return false;
+	}
+
+	for (int i = 0; i < 3; ++i) {
+		int const depth = component_depth (d, i);
+		if (d->comp[i].plane != i || d->comp[i].shift != 0 || depth < 8 || depth > 16 || depth != component_depth (d, 0)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/** @return 12-bit index into the input transfer function LUT for a component value in [0, 1],
+ *  rounded as swscale would write it to RGB48, then faded as Image::fade would do it and
+ *  truncated to 12 bits as dcp::rgb_to_xyz does.
+ */
+static DCPOMATIC_ALWAYS_INLINE int
+lut_index (float c, float fade)
+{
+	c = min (1.0f, max (0.0f, c));
+	int const v = int (float (int (c * 65535 + 0.5f)) * fade);
+	return v >> 4;
+}
+
+template <class T>
+static DCPOMATIC_ALWAYS_INLINE void
+yuv_row (Job const & job, int y, int* r, int* g, int* b)
+{
+	Image const * im = job.image;
+	int const cy = (y + job.crop.top) >> job.chroma_y_shift;
+	T const * Y = reinterpret_cast<T const *> (im->data()[0] + (y + job.crop.top) * im->stride()[0]) + job.crop.left;
+	T const * U = reinterpret_cast<T const *> (im->data()[1] + cy * im->stride()[1]);
+	T const * V = reinterpret_cast<T const *> (im->data()[2] + cy * im->stride()[2]);
+
+	for (int x = 0; x < job.size.width; ++x) {
+		/* XXX: this takes the nearest chroma sample, whereas swscale interpolates */
+		int const cx = (x + job.crop.left) >> job.chroma_x_shift;
+		float const luma = Y[x] * job.y_scale + job.y_offset;
+		float const cb = U[cx] * job.c_scale + job.c_offset;
+		float const cr = V[cx] * job.c_scale + job.c_offset;
+		r[x] = lut_index (luma + job.rv * cr, job.fade);
+		g[x] = lut_index (luma + job.gu * cb + job.gv * cr, job.fade);
+		b[x] = lut_index (luma + job.bu * cb, job.fade);
+	}
+}
+
+static DCPOMATIC_ALWAYS_INLINE void
+rgb24_row (Job const & job, int y, int* r, int* g, int* b)
+{
+	Image const * im = job.image;
+	uint8_t const * p = im->data()[0] + (y + job.crop.top) * im->stride()[0] + job.crop.left * 3;
+
+	for (int x = 0; x < job.size.width; ++x) {
+		/* swscale expands 8-bit to 16-bit by repeating the byte */
+		r[x] = int (float (p[0] * 257) * job.fade) >> 4;
+		g[x] = int (float (p[1] * 257) * job.fade) >> 4;
+		b[x] = int (float (p[2] * 257) * job.fade) >> 4;
+		p += 3;
+	}
+}
+
+static DCPOMATIC_ALWAYS_INLINE void
+rgb48_row (Job const & job, int y, int* r, int* g, int* b)
+{
+	Image const * im = job.image;
+	uint16_t const * p = reinterpret_cast<uint16_t const *> (im->data()[0] + (y + job.crop.top) * im->stride()[0]) + job.crop.left * 3;
+
+	for (int x = 0; x < job.size.width; ++x) {
+		r[x] = int (float (p[0]) * job.fade) >> 4;
+		g[x] = int (float (p[1]) * job.fade) >> 4;
+		b[x] = int (float (p[2]) * job.fade) >> 4;
+		p += 3;
+	}
+}
+
+/** Convert all the rows of a job.
+ *  @param rgb Scratch space for 3 * job.size.width ints.
+ *  @param X Output X data for the top-left of the converted area; similarly Y and Z.
+ *  @param out_width Width of the output image.
+ *  @return number of XYZ values that had to be clamped.
+ */
+static DCPOMATIC_ALWAYS_INLINE int
+convert_rows_body (Job const & job, int* rgb, int* X, int* Y, int* Z, int out_width)
+{
+	int* r = rgb;
+	int* g = rgb + job.size.width;
+	int* b = rgb + job.size.width * 2;
+
+	int clamped = 0;
+	for (int y = 0; y < job.size.height; ++y) {
+		switch (job.source) {
+		case Job::YUV_8:
+			yuv_row<uint8_t> (job, y, r, g, b);
+			break;
+		case Job::YUV_16:
+			yuv_row<uint16_t> (job, y, r, g, b);
+			break;
+		case Job::RGB24:
+			rgb24_row (job, y, r, g, b);
+			break;
+		case Job::RGB48:
+			rgb48_row (job, y, r, g, b);
+			break;
+		}
+
+		int const offset = y * out_width;
+		clamped += job.transform->transform_row (r, g, b, X + offset, Y + offset, Z + offset, job.size.width);
+	}
+
+	return clamped;
+}
+
+static int
+convert_rows_generic (Job const & job, int* rgb, int* X, int* Y, int* Z, int out_width)
+{
+	return convert_rows_body (job, rgb, X, Y, Z, out_width);
+}
+
+#ifdef DCPOMATIC_DIRECT_XYZ_AVX2
+/* No FMA here, so that the results are the same as the generic version */
+__attribute__ ((target ("avx2")))
+static int
+convert_rows_avx2 (Job const & job, int* rgb, int* X, int* Y, int* Z, int out_width)
+{
+	return convert_rows_body (job, rgb, X, Y, Z, out_width);
+}
+#endif
+
+typedef int (*ConvertRows) (Job const &, int *, int *, int *, int *, int);
+
+static ConvertRows
+choose_convert_rows ()
+{
+#ifdef DCPOMATIC_DIRECT_XYZ_AVX2
+	__builtin_cpu_init ();
+	if (__builtin_cpu_supports ("avx2")) {
+		return convert_rows_avx2;
+	}
+#endif
+	return convert_rows_generic;
+}
+
+/** Convert an image to XYZ in one pass; this gives the same result as cropping it, converting
+ *  it to RGB48LE with Image::crop_scale_window, fading it with Image::fade and converting it
+ *  with dcp::rgb_to_xyz, except that sub-sampled chroma is not interpolated (so the results
+ *  for YUV images may differ slightly near sharp colour edges).
+ *
+ *  @param image Image, which must be in a format for which can_convert_directly_to_xyz() returns true.
+ *  @param crop Crop to apply to image; no scaling is done, so the cropped image is the one that will appear in the output.
+ *  @param out_size Size of the output image; the cropped image is placed in the middle of this, surrounded by black.
+ *  @param yuv_to_rgb Conversion to use from YUV to RGB, if required.
+ *  @param conversion Colour conversion from RGB to XYZ.
+ *  @param fade Fade to apply, if any.
+ *  @param note Handler for any notes (e.g. about clamped values).
+ */
+shared_ptr<dcp::OpenJPEGImage>
+convert_directly_to_xyz (
+	shared_ptr<const Image> image,
+	Crop crop,
+	dcp::Size out_size,
+	dcp::YUVToRGB yuv_to_rgb,
+	ColourConversion const & conversion,
+	optional<double> fade,
+	dcp::NoteHandler note
+	)
+{
+	static ConvertRows const convert_rows = choose_convert_rows ();
+
+	DCPOMATIC_ASSERT (can_convert_directly_to_xyz (image->pixel_format()));
+
+	Job job;
+	job.image = image.get ();
+	job.crop = crop;
+	job.size = dcp::Size (image->size().width - crop.left - crop.right, image->size().height - crop.top - crop.bottom);
+	job.fade = fade.get_value_or (1);
+
+	DCPOMATIC_ASSERT (job.size.width > 0 && job.size.height > 0);
+	DCPOMATIC_ASSERT (out_size.width >= job.size.width && out_size.height >= job.size.height);
+
+	AVPixFmtDescriptor const * d = av_pix_fmt_desc_get (image->pixel_format());
+	DCPOMATIC_ASSERT (d);
+
+	switch (image->pixel_format()) {
+	case AV_PIX_FMT_RGB24:
+		job.source = Job::RGB24;
+		break;
+	case AV_PIX_FMT_RGB48LE:
+		job.source = Job::RGB48;
+		break;
+	default:
+	{
+		int const depth = component_depth (d, 0);
+		job.source = depth > 8 ? Job::YUV_16 : Job::YUV_8;
+
+		/* Limited-range YUV, as Image::crop_scale_window asks swscale to assume */
+		float const scale = 1 << (depth - 8);
+		job.y_scale = 1 / (219 * scale);
+		job.y_offset = -16.0 / 219;
+		job.c_scale = 1 / (224 * scale);
+		job.c_offset = -128.0 / 224;
+
+		DCPOMATIC_ASSERT (yuv_to_rgb < dcp::YUV_TO_RGB_COUNT);
+		float const kr = yuv_to_rgb == dcp::YUV_TO_RGB_REC601 ? 0.299 : 0.2126;
+		float const kb = yuv_to_rgb == dcp::YUV_TO_RGB_REC601 ? 0.114 : 0.0722;
+		float const kg = 1 - kr - kb;
+		job.rv = 2 * (1 - kr);
+		job.gu = -2 * kb * (1 - kb) / kg;
+		job.gv = -2 * kr * (1 - kr) / kg;
+		job.bu = 2 * (1 - kb);
+		break;
+	}
+	}
+
+	job.chroma_x_shift = d->log2_chroma_w;
+	job.chroma_y_shift = d->log2_chroma_h;
+
+	shared_ptr<const XYZTransform> transform = XYZTransform::get (conversion);
+	job.transform = transform.get ();
+
+	shared_ptr<dcp::OpenJPEGImage> xyz (new dcp::OpenJPEGImage (out_size));
+
+	/* Black borders; XYZ black is 0 */
+	int const corner_x = (out_size.width - job.size.width) / 2;
+	int const corner_y = (out_size.height - job.size.height) / 2;
+	for (int c = 0; c < 3; ++c) {
+		int* p = xyz->data (c);
+		for (int y = 0; y < out_size.height; ++y) {
+			if (y < corner_y || y >= (corner_y + job.size.height)) {
+				std::fill (p, p + out_size.width, 0);
+			} else {
+				std::fill (p, p + corner_x, 0);
+				std::fill (p + corner_x + job.size.width, p + out_size.width, 0);
+			}
+			p += out_size.width;
+		}
+	}
+
+	vector<int> rgb (job.size.width * 3);
+	int const offset = corner_y * out_size.width + corner_x;
+	int const clamped = convert_rows (job, &rgb[0], xyz->data(0) + offset, xyz->data(1) + offset, xyz->data(2) + offset, out_size.width);
+	if (clamped) {
+		note (dcp::DCP_NOTE, String::compose ("%1 XYZ value(s) clamped", clamped));
+	}
+
+	return xyz;
+}
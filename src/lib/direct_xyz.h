@@ -0,0 +1,55 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/direct_xyz.h
+ *  @brief Conversion of YUV or RGB images straight to XYZ for JPEG2000 encoding.
+ */
+
+#ifndef DCPOMATIC_DIRECT_XYZ_H
+#define DCPOMATIC_DIRECT_XYZ_H
+
+#include "types.h"
+extern "C" {
+#include <libavutil/pixfmt.h>
+}
+#include <dcp/types.h>
+#include <boost/shared_ptr.hpp>
+#include <boost/optional.hpp>
+
+namespace dcp {
+	class OpenJPEGImage;
+}
+
+class Image;
+class ColourConversion;
+
+extern bool can_convert_directly_to_xyz (AVPixelFormat format);
+
+extern boost::shared_ptr<dcp::OpenJPEGImage> convert_directly_to_xyz (
+	boost::shared_ptr<const Image> image,
+	Crop crop,
+	dcp::Size out_size,
+	dcp::YUVToRGB yuv_to_rgb,
+	ColourConversion const & conversion,
+	boost::optional<double> fade,
+	dcp::NoteHandler note
+	);
+
+#endif
@@ -0,0 +1,503 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/encode_scheduler.cc
+ *  @brief EncodeScheduler class.
+ */
+
+#include "encode_scheduler.h"
+#include "dcp_video.h"
+#include "dcpomatic_assert.h"
+#include "dcpomatic_log.h"
+#include "util.h"
+#include <boost/foreach.hpp>
+#include <sys/time.h>
+#include <algorithm>
+#include <cmath>
+
+using std::map;
+using std::list;
+using std::vector;
+using std::string;
+using std::min;
+using std::max;
+using boost::shared_ptr;
+using boost::optional;
+
+/** Number of seconds of work that we try to keep queued for each worker */
+static float const queue_seconds = 2;
+/** Depth of queue for a worker whose rate is not yet known */
+static int const initial_depth = 2;
+/** Largest queue that we will give to any worker */
+static int const maximum_depth = 16;
+/** Number of recent frame latencies to keep for each worker */
+static int const latency_history = 32;
+/** Number of latencies that we need before we will decide that a frame is overdue */
+static int const minimum_latencies = 4;
+/** A frame is overdue when it has taken this many times a worker's 90th-percentile latency... */
+static double const overdue_factor = 2;
+/** ...and at least this many seconds */
+static double const minimum_overdue = 2;
+
+static double
+now ()
+{
+	struct timeval tv;
+	gettimeofday (&tv, 0);
+	return seconds (tv);
+}
+
+static bool
+index_less (shared_ptr<DCPVideo> a, shared_ptr<DCPVideo> b)
+{
+	return a->index() < b->index();
+}
+
+EncodeScheduler::EncodeScheduler ()
+	: _next_id (0)
+{
+
+}
+
+/** Add a worker.
+ *  @param name Name of the worker, for logging.
+ *  @return ID to pass to our other methods.
+ */
+int
+EncodeScheduler::add_worker (string name)
+{
+	int const id = _next_id++;
+	_workers[id].reset (new Worker (name));
+	return id;
+}
+
+/** Remove a worker; any frames in its queue are made available to the others.
+ *  This must not be called while the worker is in wait().
+ */
+void
+EncodeScheduler::remove_worker (int worker)
+{
+	map<int, shared_ptr<Worker> >::iterator i = _workers.find (worker);
+	DCPOMATIC_ASSERT (i != _workers.end());
+
+	BOOST_FOREACH (shared_ptr<DCPVideo> j, i->second->queue) {
+		add_to_returned (j);
+	}
+
+	/* Give back anything that this worker had taken and which nobody else is working on */
+	for (map<shared_ptr<DCPVideo>, map<int, double> >::iterator j = _in_progress.begin(); j != _in_progress.end(); ) {
+		map<shared_ptr<DCPVideo>, map<int, double> >::iterator k = j;
+		++j;
+		k->second.erase (worker);
+		if (k->second.empty()) {
+			add_to_returned (k->first);
+			_in_progress.erase (k);
+		}
+	}
+
+	_workers.erase (i);
+	wake_all ();
+}
+
+/** Say whether a worker is currently failing (for example because it cannot reach its
+ *  server).  Such a worker is given no new frames, and anything in its queue is made
+ *  available to the others, though it may still pop() frames when it is ready to try again.
+ */
+void
+EncodeScheduler::set_backoff (int worker, bool backoff)
+{
+	map<int, shared_ptr<Worker> >::iterator i = _workers.find (worker);
+	DCPOMATIC_ASSERT (i != _workers.end());
+
+	i->second->backoff = backoff;
+	if (backoff) {
+		return_queue (i->second);
+	}
+}
+
+/** Say that a worker should be given no more frames because it is going to go away once
+ *  it has finished what it is doing.  Anything in its queue is made available to the others.
+ */
+void
+EncodeScheduler::retire (int worker)
+{
+	map<int, shared_ptr<Worker> >::iterator i = _workers.find (worker);
+	DCPOMATIC_ASSERT (i != _workers.end());
+
+	i->second->retired = true;
+	return_queue (i->second);
+}
+
+/** Add a new frame.  Frames must be added in index order. */
+void
+EncodeScheduler::push (shared_ptr<DCPVideo> frame)
+{
+	/* Guess a rate for workers whose rate we do not yet know */
+	float total_rate = 0;
+	int known = 0;
+	for (map<int, shared_ptr<Worker> >::const_iterator i = _workers.begin(); i != _workers.end(); ++i) {
+		float const r = i->second->history.rate ();
+		if (r > 0) {
+			total_rate += r;
+			++known;
+		}
+	}
+
+	float const default_rate = known ? (total_rate / known) : 1;
+
+	/* Find the worker that should be able to start on this frame soonest, preferring
+	   those which have room in their queues.
+	*/
+	shared_ptr<Worker> best;
+	bool best_has_room = false;
+	float best_wait = 0;
+	for (map<int, shared_ptr<Worker> >::const_iterator i = _workers.begin(); i != _workers.end(); ++i) {
+		shared_ptr<Worker> w = i->second;
+		if (w->backoff || w->retired) {
+			continue;
+		}
+
+		float r = w->history.rate ();
+		if (r == 0) {
+			r = default_rate;
+		}
+
+		bool const has_room = static_cast<int> (w->queue.size()) < depth (w);
+		float const wait = (w->queue.size() + (w->waiting ? 0 : 1)) / r;
+		if (!best || (has_room && !best_has_room) || (has_room == best_has_room && wait < best_wait)) {
+			best = w;
+			best_has_room = has_room;
+			best_wait = wait;
+		}
+	}
+
+	if (!best) {
+		/* Nobody can take it at the moment */
+		add_to_returned (frame);
+		return;
+	}
+
+	best->queue.push_back (frame);
+	best->condition.notify_one ();
+}
+
+/** Give back a frame that a worker took but could not encode.  If another worker is
+ *  still working on the frame, or has already finished it, it is not queued again.
+ */
+void
+EncodeScheduler::push_back (int worker, shared_ptr<DCPVideo> frame)
+{
+	map<shared_ptr<DCPVideo>, map<int, double> >::iterator i = _in_progress.find (frame);
+	if (i == _in_progress.end()) {
+		/* Somebody else has finished it */
+		return;
+	}
+
+	i->second.erase (worker);
+	if (!i->second.empty()) {
+		return;
+	}
+
+	_in_progress.erase (i);
+	add_to_returned (frame);
+	wake_one ();
+}
+
+/** Get the next frame that a worker should encode.
+ *  @return Frame, or 0 if there is nothing to do.
+ */
+shared_ptr<DCPVideo>
+EncodeScheduler::pop (int worker)
+{
+	map<int, shared_ptr<Worker> >::iterator i = _workers.find (worker);
+	DCPOMATIC_ASSERT (i != _workers.end());
+	shared_ptr<Worker> w = i->second;
+
+	shared_ptr<DCPVideo> frame;
+
+	if (!_returned.empty() && (w->queue.empty() || _returned.front()->index() <= w->queue.front()->index())) {
+		frame = _returned.front ();
+		_returned.pop_front ();
+	} else if (!w->queue.empty()) {
+		frame = w->queue.front ();
+		w->queue.pop_front ();
+	} else {
+		/* Steal the frame that will be needed soonest */
+		shared_ptr<Worker> victim;
+		for (map<int, shared_ptr<Worker> >::const_iterator j = _workers.begin(); j != _workers.end(); ++j) {
+			if (!j->second->queue.empty() && (!victim || index_less (j->second->queue.front(), victim->queue.front()))) {
+				victim = j->second;
+			}
+		}
+
+		if (victim) {
+			frame = victim->queue.front ();
+			victim->queue.pop_front ();
+			++w->stolen;
+		}
+	}
+
+	if (frame) {
+		_in_progress[frame][worker] = now ();
+	} else {
+		frame = speculate (worker);
+	}
+
+	return frame;
+}
+
+/** Note that a worker has finished encoding a frame.
+ *  @return true if this worker is the first to finish it, in which case the caller should
+ *  use the result, or false if another worker has already finished it.
+ */
+bool
+EncodeScheduler::finish (int worker, shared_ptr<DCPVideo> frame)
+{
+	map<shared_ptr<DCPVideo>, map<int, double> >::iterator i = _in_progress.find (frame);
+	if (i == _in_progress.end()) {
+		return false;
+	}
+
+	map<int, double>::const_iterator j = i->second.find (worker);
+	DCPOMATIC_ASSERT (j != i->second.end());
+
+	map<int, shared_ptr<Worker> >::iterator k = _workers.find (worker);
+	DCPOMATIC_ASSERT (k != _workers.end());
+	shared_ptr<Worker> w = k->second;
+
+	w->history.event ();
+	++w->done;
+	w->latencies.push_back (now() - j->second);
+	if (static_cast<int> (w->latencies.size()) > latency_history) {
+		w->latencies.pop_front ();
+	}
+
+	_in_progress.erase (i);
+	return true;
+}
+
+/** Find an overdue frame which another worker is working on, so that a worker which
+ *  would otherwise be idle can start on it too.
+ *  @return Frame, or 0 if there is nothing overdue.
+ */
+shared_ptr<DCPVideo>
+EncodeScheduler::speculate (int worker)
+{
+	double const t = now ();
+
+	shared_ptr<DCPVideo> frame;
+	int owner = 0;
+	for (map<shared_ptr<DCPVideo>, map<int, double> >::const_iterator i = _in_progress.begin(); i != _in_progress.end(); ++i) {
+		/* Only make one extra copy of any frame */
+		if (i->second.size() != 1 || i->second.begin()->first == worker) {
+			continue;
+		}
+
+		map<int, shared_ptr<Worker> >::const_iterator w = _workers.find (i->second.begin()->first);
+		DCPOMATIC_ASSERT (w != _workers.end());
+		optional<double> overdue = overdue_time (w->second);
+		if (overdue && (t - i->second.begin()->second) > *overdue && (!frame || index_less (i->first, frame))) {
+			frame = i->first;
+			owner = w->first;
+		}
+	}
+
+	if (frame) {
+		LOG_GENERAL (
+			"Frame %1 is overdue on %2; also giving it to %3",
+			frame->index(), _workers[owner]->name, _workers[worker]->name
+			);
+		_in_progress[frame][worker] = t;
+		++_workers[worker]->speculated;
+	}
+
+	return frame;
+}
+
+/** @return Time after which a frame that a worker is working on should be considered overdue,
+ *  or none if we do not yet know enough about the worker.
+ */
+optional<double>
+EncodeScheduler::overdue_time (shared_ptr<const Worker> worker) const
+{
+	if (static_cast<int> (worker->latencies.size()) < minimum_latencies) {
+		return optional<double> ();
+	}
+
+	vector<double> sorted (worker->latencies.begin(), worker->latencies.end());
+	vector<double>::iterator p90 = sorted.begin() + (sorted.size() * 9) / 10;
+	std::nth_element (sorted.begin(), p90, sorted.end());
+	return max (minimum_overdue, *p90 * overdue_factor);
+}
+
+/** Wait until there may be work for a worker.  We wake up every so often regardless, so that
+ *  the caller can check whether any frames have become overdue.  This is a boost thread
+ *  interruption point.
+ *  @param lock Lock on the mutex which the caller uses to protect this object.
+ */
+void
+EncodeScheduler::wait (int worker, boost::mutex::scoped_lock& lock)
+{
+	map<int, shared_ptr<Worker> >::iterator i = _workers.find (worker);
+	DCPOMATIC_ASSERT (i != _workers.end());
+	shared_ptr<Worker> w = i->second;
+
+	w->waiting = true;
+	try {
+		w->condition.timed_wait (lock, boost::posix_time::seconds (1));
+	} catch (...) {
+		w->waiting = false;
+		throw;
+	}
+	w->waiting = false;
+}
+
+void
+EncodeScheduler::wake_all ()
+{
+	for (map<int, shared_ptr<Worker> >::const_iterator i = _workers.begin(); i != _workers.end(); ++i) {
+		i->second->condition.notify_one ();
+	}
+}
+
+void
+EncodeScheduler::wake_one ()
+{
+	for (map<int, shared_ptr<Worker> >::const_iterator i = _workers.begin(); i != _workers.end(); ++i) {
+		if (i->second->waiting) {
+			i->second->condition.notify_one ();
+			return;
+		}
+	}
+}
+
+/** Remove all frames from all queues.
+ *  @return The frames, in index order.
+ */
+list<shared_ptr<DCPVideo> >
+EncodeScheduler::take_all ()
+{
+	list<shared_ptr<DCPVideo> > all;
+	all.swap (_returned);
+
+	for (map<int, shared_ptr<Worker> >::iterator i = _workers.begin(); i != _workers.end(); ++i) {
+		all.insert (all.end(), i->second->queue.begin(), i->second->queue.end());
+		i->second->queue.clear ();
+	}
+
+	all.sort (index_less);
+	return all;
+}
+
+/** @return true if the caller should wait for some frames to be taken before pushing another */
+bool
+EncodeScheduler::full () const
+{
+	int capacity = 0;
+	for (map<int, shared_ptr<Worker> >::const_iterator i = _workers.begin(); i != _workers.end(); ++i) {
+		capacity += depth (i->second);
+	}
+
+	/* Allow one thing to be queued even if there are no workers */
+	return static_cast<int> (size()) >= capacity + 1;
+}
+
+bool
+EncodeScheduler::empty () const
+{
+	return size() == 0;
+}
+
+/** @return Number of frames that workers have taken but not yet finished */
+size_t
+EncodeScheduler::in_progress () const
+{
+	return _in_progress.size ();
+}
+
+/** @return Total number of frames waiting to be taken by workers */
+size_t
+EncodeScheduler::size () const
+{
+	size_t n = _returned.size ();
+	for (map<int, shared_ptr<Worker> >::const_iterator i = _workers.begin(); i != _workers.end(); ++i) {
+		n += i->second->queue.size ();
+	}
+	return n;
+}
+
+vector<EncodeWorkerStatus>
+EncodeScheduler::status () const
+{
+	vector<EncodeWorkerStatus> s;
+	for (map<int, shared_ptr<Worker> >::const_iterator i = _workers.begin(); i != _workers.end(); ++i) {
+		EncodeWorkerStatus w;
+		w.name = i->second->name;
+		w.rate = i->second->history.rate ();
+		w.depth = depth (i->second);
+		w.queued = i->second->queue.size ();
+		w.done = i->second->done;
+		w.stolen = i->second->stolen;
+		w.speculated = i->second->speculated;
+		s.push_back (w);
+	}
+	return s;
+}
+
+/** @return Number of frames that we will queue for a worker */
+int
+EncodeScheduler::depth (shared_ptr<const Worker> worker) const
+{
+	if (worker->backoff || worker->retired) {
+		return 0;
+	}
+
+	float const rate = worker->history.rate ();
+	if (rate == 0) {
+		return initial_depth;
+	}
+
+	return max (1, min (maximum_depth, static_cast<int> (lrintf (rate * queue_seconds))));
+}
+
+/** Make the frames in a worker's queue available to the other workers */
+void
+EncodeScheduler::return_queue (shared_ptr<Worker> worker)
+{
+	if (worker->queue.empty()) {
+		return;
+	}
+
+	BOOST_FOREACH (shared_ptr<DCPVideo> i, worker->queue) {
+		add_to_returned (i);
+	}
+	worker->queue.clear ();
+	wake_all ();
+}
+
+void
+EncodeScheduler::add_to_returned (shared_ptr<DCPVideo> frame)
+{
+	list<shared_ptr<DCPVideo> >::iterator i = _returned.begin ();
+	while (i != _returned.end() && !index_less (frame, *i)) {
+		++i;
+	}
+	_returned.insert (i, frame);
+}
@@ -0,0 +1,165 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef DCPOMATIC_ENCODE_SCHEDULER_H
+#define DCPOMATIC_ENCODE_SCHEDULER_H
+
+/** @file  src/lib/encode_scheduler.h
+ *  @brief EncodeScheduler class.
+ */
+
+#include "event_history.h"
+#include <boost/shared_ptr.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition.hpp>
+#include <boost/optional.hpp>
+#include <deque>
+#include <list>
+#include <map>
+#include <vector>
+#include <string>
+
+class DCPVideo;
+
+/** Summary of what an EncodeScheduler worker has been doing */
+struct EncodeWorkerStatus
+{
+	EncodeWorkerStatus ()
+		: rate (0)
+		, depth (0)
+		, queued (0)
+		, done (0)
+		, stolen (0)
+		, speculated (0)
+	{}
+
+	std::string name;
+	/** Recent frames per second, or 0 if not yet known */
+	float rate;
+	/** Number of frames that we are currently prepared to queue for this worker */
+	int depth;
+	/** Number of frames currently queued for this worker */
+	int queued;
+	/** Number of frames that this worker has encoded */
+	int done;
+	/** Number of frames that this worker has taken from other workers' queues */
+	int stolen;
+	/** Number of overdue frames that this worker has started while another worker was still on them */
+	int speculated;
+};
+
+/** @class EncodeScheduler
+ *  @brief Distributor of frames between the workers of a J2KEncoder.
+ *
+ *  Each worker (a local encoding thread or a thread talking to a remote server)
+ *  has its own queue, whose depth is set from the rate at which that worker has
+ *  recently been finishing frames.  New frames go to the worker which should
+ *  get to them soonest, and a worker whose queue is empty takes the lowest-indexed
+ *  frame that is waiting elsewhere.  Frames are pushed in index order, so the
+ *  lowest-indexed frame is always the one which the Writer will need first.
+ *
+ *  When there is nothing waiting at all, an idle worker is given a copy of a
+ *  frame which another worker has had for much longer than that worker usually
+ *  takes; whichever copy is finished first is the one that is used.
+ *
+ *  This class is not thread-safe; callers must hold the mutex that they pass to
+ *  wait() whenever they call any other method.
+ */
+class EncodeScheduler : public boost::noncopyable
+{
+public:
+	EncodeScheduler ();
+
+	int add_worker (std::string name);
+	void remove_worker (int worker);
+	void set_backoff (int worker, bool backoff);
+	void retire (int worker);
+
+	void push (boost::shared_ptr<DCPVideo> frame);
+	void push_back (int worker, boost::shared_ptr<DCPVideo> frame);
+	boost::shared_ptr<DCPVideo> pop (int worker);
+	bool finish (int worker, boost::shared_ptr<DCPVideo> frame);
+
+	void wait (int worker, boost::mutex::scoped_lock& lock);
+	void wake_all ();
+
+	std::list<boost::shared_ptr<DCPVideo> > take_all ();
+
+	bool full () const;
+	bool empty () const;
+	size_t size () const;
+	size_t in_progress () const;
+
+	std::vector<EncodeWorkerStatus> status () const;
+
+private:
+	struct Worker
+	{
+		Worker (std::string name_)
+			: name (name_)
+			, history (8)
+			, waiting (false)
+			, backoff (false)
+			, retired (false)
+			, done (0)
+			, stolen (0)
+			, speculated (0)
+		{}
+
+		std::string name;
+		std::deque<boost::shared_ptr<DCPVideo> > queue;
+		EventHistory history;
+		/** Times in seconds that this worker has recently taken to finish frames */
+		std::deque<double> latencies;
+		/** condition which is signalled when there may be work for this worker */
+		boost::condition condition;
+		/** true if this worker is waiting on condition */
+		bool waiting;
+		/** true if this worker is failing and should not be given any frames */
+		bool backoff;
+		/** true if this worker is finishing what it has and will then go away */
+		bool retired;
+		int done;
+		int stolen;
+		int speculated;
+	};
+
+	int depth (boost::shared_ptr<const Worker> worker) const;
+	void return_queue (boost::shared_ptr<Worker> worker);
+	void add_to_returned (boost::shared_ptr<DCPVideo> frame);
+	void wake_one ();
+	boost::shared_ptr<DCPVideo> speculate (int worker);
+	boost::optional<double> overdue_time (boost::shared_ptr<const Worker> worker) const;
+
+	int _next_id;
+	std::map<int, boost::shared_ptr<Worker> > _workers;
+	/** Frames which are not assigned to any worker, either because they were
+	 *  returned after a failure or because their worker went away; kept in
+	 *  index order.
+	 */
+	std::list<boost::shared_ptr<DCPVideo> > _returned;
+	/** Frames which workers have taken but not yet finished, with the workers that
+	 *  are working on them and the times (in seconds) that they started.
+	 */
+	std::map<boost::shared_ptr<DCPVideo>, std::map<int, double> > _in_progress;
+};
+
+#endif
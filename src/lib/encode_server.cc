@@ -35,7 +35,11 @@
 #include "log.h"
 #include "dcpomatic_log.h"
 #include "encoded_log_entry.h"
+#include "exceptions.h"
 #include "version.h"
+#include "film.h"
+#include "player.h"
+#include "reel_writer.h"
 #include <dcp/raw_convert.h>
 #include <libcxml/cxml.h>
 #include <libxml++/libxml++.h>
@@ -57,6 +61,9 @@ using std::list;
 using std::cout;
 using std::cerr;
 using std::fixed;
+using std::pair;
+using std::make_pair;
+using std::map;
 using boost::shared_ptr;
 using boost::thread;
 using boost::bind;
@@ -85,6 +92,7 @@ EncodeServer::~EncodeServer ()
 		_terminate = true;
 		_empty_condition.notify_all ();
 		_full_condition.notify_all ();
+		_done_condition.notify_all ();
 	}
 
 	BOOST_FOREACH (boost::thread* i, _worker_threads) {
@@ -97,6 +105,13 @@ EncodeServer::~EncodeServer ()
 		delete i;
 	}
 
+	BOOST_FOREACH (shared_ptr<Session> i, _sessions) {
+		if (i->thread->joinable ()) {
+			i->thread->join ();
+		}
+		delete i->thread;
+	}
+
 	{
 		boost::mutex::scoped_lock lm (_broadcast.mutex);
 		if (_broadcast.socket) {
@@ -118,29 +133,80 @@ EncodeServer::~EncodeServer ()
 	}
 }
 
+/** Read the binary part of an encoding request from a socket.
+ *  @param xml XML part of the request.
+ *  @param compression Filled in with the compression that the master used.
+ *  @param compression_ratio Filled in with the ratio of the uncompressed size of the binary data
+ *  to the number of bytes that were received.
+ */
+static shared_ptr<PlayerVideo>
+read_player_video (shared_ptr<cxml::Document> xml, shared_ptr<Socket> socket, TransportCompression& compression, double& compression_ratio)
+{
+	compression = string_to_transport_compression (
+		xml->optional_string_child("TransportCompression").get_value_or(transport_compression_to_string(TRANSPORT_COMPRESSION_NONE))
+		);
+
+	uint64_t const before = socket->bytes_read ();
+	uint64_t const before_uncompressed = socket->uncompressed_bytes_read ();
+
+	shared_ptr<PlayerVideo> pvf (new PlayerVideo (xml, socket));
+
+	uint64_t const received = socket->bytes_read() - before;
+	compression_ratio = received > 0 ? double (socket->uncompressed_bytes_read() - before_uncompressed) / received : 1;
+	return pvf;
+}
+
 /** @param after_read Filled in with gettimeofday() after reading the input from the network.
  *  @param after_encode Filled in with gettimeofday() after encoding the image.
+ *  @param compression Filled in with the compression used to send the input.
+ *  @param compression_ratio Filled in with the ratio of the uncompressed size of the input to the size that was received.
  */
 int
-EncodeServer::process (shared_ptr<Socket> socket, struct timeval& after_read, struct timeval& after_encode)
+EncodeServer::process (
+	shared_ptr<Socket> socket, struct timeval& after_read, struct timeval& after_encode, TransportCompression& compression, double& compression_ratio
+	)
 {
 	uint32_t length = socket->read_uint32 ();
 	scoped_array<char> buffer (new char[length]);
 	socket->read (reinterpret_cast<uint8_t*> (buffer.get()), length);
 
 	string s (buffer.get());
-	shared_ptr<cxml::Document> xml (new cxml::Document ("EncodingRequest"));
+	shared_ptr<cxml::Document> xml (new cxml::Document ());
 	xml->read_string (s);
 	/* This is a double-check; the server shouldn't even be on the candidate list
 	   if it is the wrong version, but it doesn't hurt to make sure here.
 	*/
-	if (xml->number_child<int> ("Version") != SERVER_LINK_VERSION) {
+	int const version = xml->number_child<int> ("Version");
+
+	if (xml->name() == "EncodingSession") {
+		if (version < PIPELINED_SERVER_LINK_VERSION || version > SERVER_LINK_VERSION) {
+			cerr << "Mismatched server/client versions\n";
+			LOG_ERROR_NC ("Mismatched server/client versions");
+			return -1;
+		}
+		/* This connection will carry many frames, so hand it over to its own thread */
+		start_session (socket, xml->number_child<int> ("Window"));
+		return -1;
+	}
+
+	if (xml->name() == "ReelEncodingRequest") {
+		if (version < REEL_SERVER_LINK_VERSION || version > SERVER_LINK_VERSION) {
+			cerr << "Mismatched server/client versions\n";
+			LOG_ERROR_NC ("Mismatched server/client versions");
+			return -1;
+		}
+		/* This will take a long time, so give it its own thread */
+		start_reel (socket, xml);
+		return -1;
+	}
+
+	if (xml->name() != "EncodingRequest" || version < MINIMUM_SERVER_LINK_VERSION || version > SERVER_LINK_VERSION) {
 		cerr << "Mismatched server/client versions\n";
 		LOG_ERROR_NC ("Mismatched server/client versions");
 		return -1;
 	}
 
-	shared_ptr<PlayerVideo> pvf (new PlayerVideo (xml, socket));
+	shared_ptr<PlayerVideo> pvf = read_player_video (xml, socket, compression, compression_ratio);
 
 	DCPVideo dcp_video_frame (pvf, xml);
 
@@ -167,7 +233,7 @@ EncodeServer::worker_thread ()
 {
 	while (true) {
 		boost::mutex::scoped_lock lock (_mutex);
-		while (_queue.empty () && !_terminate) {
+		while (_queue.empty () && _session_queue.empty () && !_terminate) {
 			_empty_condition.wait (lock);
 		}
 
@@ -175,6 +241,35 @@ EncodeServer::worker_thread ()
 			return;
 		}
 
+		if (!_session_queue.empty ()) {
+			/* Frames from sessions have already been read, so deal with them first */
+			SessionFrame frame = _session_queue.front ();
+			_session_queue.pop_front ();
+
+			if (frame.session->finished) {
+				/* Nobody is waiting for this any more */
+				continue;
+			}
+
+			lock.unlock ();
+
+			try {
+				frame.encoded = frame.video->encode_locally ();
+			} catch (std::exception& e) {
+				cerr << "Error: " << e.what() << "\n";
+				LOG_ERROR ("Error: %1", e.what());
+			}
+
+			gettimeofday (&frame.after_encode, 0);
+
+			lock.lock ();
+			if (!frame.session->finished) {
+				frame.session->done.push_back (frame);
+				_done_condition.notify_all ();
+			}
+			continue;
+		}
+
 		shared_ptr<Socket> socket = _queue.front ();
 		_queue.pop_front ();
 
@@ -187,11 +282,13 @@ EncodeServer::worker_thread ()
 		struct timeval after_read;
 		struct timeval after_encode;
 		struct timeval end;
+		TransportCompression compression = TRANSPORT_COMPRESSION_NONE;
+		double compression_ratio = 1;
 
 		gettimeofday (&start, 0);
 
 		try {
-			frame = process (socket, after_read, after_encode);
+			frame = process (socket, after_read, after_encode, compression, compression_ratio);
 			ip = socket->socket().remote_endpoint().address().to_string();
 		} catch (std::exception& e) {
 			cerr << "Error: " << e.what() << "\n";
@@ -213,7 +310,8 @@ EncodeServer::worker_thread ()
 					frame, ip,
 					seconds(after_read) - seconds(start),
 					seconds(after_encode) - seconds(after_read),
-					seconds(end) - seconds(after_encode)
+					seconds(end) - seconds(after_encode),
+					compression, compression_ratio
 					)
 				);
 
@@ -228,6 +326,496 @@ EncodeServer::worker_thread ()
 	}
 }
 
+/** Start a thread to look after a pipelined session.
+ *  @param socket Socket that the session is using.
+ *  @param window Maximum number of frames that the master will have in flight.
+ */
+void
+EncodeServer::start_session (shared_ptr<Socket> socket, int window)
+{
+	shared_ptr<Session> session (new Session (socket, std::max (1, window)));
+
+	boost::mutex::scoped_lock lm (_mutex);
+
+	tidy_sessions ();
+
+	session->thread = new thread (bind (&EncodeServer::session_thread, this, session));
+#ifdef DCPOMATIC_LINUX
+	pthread_setname_np (session->thread->native_handle(), "encode-server-session");
+#endif
+	_sessions.push_back (session);
+}
+
+/** Join and remove any sessions which have finished.  This must be called with _mutex held */
+void
+EncodeServer::tidy_sessions ()
+{
+	list<shared_ptr<Session> >::iterator i = _sessions.begin ();
+	while (i != _sessions.end ()) {
+		if ((*i)->finished) {
+			(*i)->thread->join ();
+			delete (*i)->thread;
+			i = _sessions.erase (i);
+		} else {
+			++i;
+		}
+	}
+}
+
+/** Thread to read frames from a pipelined session and give them to the worker
+ *  threads, sending encoded data back whenever the master is waiting for it.
+ */
+void
+EncodeServer::session_thread (shared_ptr<Session> session)
+{
+	try {
+		/* Number of frames that we have read but not yet sent back */
+		int outstanding = 0;
+
+		while (true) {
+			uint32_t length = session->socket->read_uint32 ();
+			scoped_array<char> buffer (new char[length]);
+			session->socket->read (reinterpret_cast<uint8_t*> (buffer.get()), length);
+
+			shared_ptr<cxml::Document> xml (new cxml::Document ());
+			xml->read_string (string (buffer.get()));
+
+			if (xml->name() == "EncodingEnd") {
+				break;
+			} else if (xml->name() == "EncodingFlush") {
+				if (outstanding == 0 || !send_session_reply (session)) {
+					break;
+				}
+				--outstanding;
+			} else if (xml->name() == "EncodingRequest") {
+				SessionFrame frame;
+				gettimeofday (&frame.start, 0);
+				frame.session = session;
+				frame.tag = xml->number_child<uint32_t> ("Tag");
+				shared_ptr<PlayerVideo> pvf = read_player_video (xml, session->socket, frame.compression, frame.compression_ratio);
+				frame.video.reset (new DCPVideo (pvf, xml));
+				gettimeofday (&frame.after_read, 0);
+
+				{
+					boost::mutex::scoped_lock lm (_mutex);
+					_session_queue.push_back (frame);
+					_empty_condition.notify_all ();
+				}
+
+				++outstanding;
+				if (outstanding >= session->window) {
+					/* The master will now wait for something to come back */
+					if (!send_session_reply (session)) {
+						break;
+					}
+					--outstanding;
+				}
+			} else {
+				throw NetworkError (String::compose ("unexpected message %1 in encoding session", xml->name()));
+			}
+		}
+	} catch (std::exception& e) {
+		cerr << "Error: " << e.what() << "\n";
+		LOG_ERROR ("Error: %1", e.what());
+	}
+
+	boost::mutex::scoped_lock lm (_mutex);
+	/* Break the reference cycle between the session and its frames */
+	session->done.clear ();
+	session->finished = true;
+}
+
+/** Wait for a frame from a session to be encoded, then send it back to the master.
+ *  @return true if all is well, false if the session should be closed.
+ */
+bool
+EncodeServer::send_session_reply (shared_ptr<Session> session)
+{
+	boost::mutex::scoped_lock lock (_mutex);
+	while (session->done.empty() && !_terminate) {
+		_done_condition.wait (lock);
+	}
+
+	if (_terminate) {
+		return false;
+	}
+
+	SessionFrame frame = session->done.front ();
+	session->done.pop_front ();
+	lock.unlock ();
+
+	if (!frame.encoded) {
+		/* Closing the session will make the master re-queue the frames that it had sent us */
+		return false;
+	}
+
+	try {
+		session->socket->write (frame.tag);
+		session->socket->write (frame.encoded->size());
+		session->socket->write (frame.encoded->data().get(), frame.encoded->size());
+	} catch (std::exception& e) {
+		cerr << "Send failed; frame " << frame.video->index() << "\n";
+		LOG_ERROR ("Send failed; frame %1", frame.video->index());
+		throw;
+	}
+
+	struct timeval end;
+	gettimeofday (&end, 0);
+
+	shared_ptr<EncodedLogEntry> e (
+		new EncodedLogEntry (
+			frame.video->index(), session->socket->socket().remote_endpoint().address().to_string(),
+			seconds(frame.after_read) - seconds(frame.start),
+			seconds(frame.after_encode) - seconds(frame.after_read),
+			seconds(end) - seconds(frame.after_encode),
+			frame.compression, frame.compression_ratio
+			)
+		);
+
+	if (_verbose) {
+		cout << e->get() << "\n";
+	}
+
+	dcpomatic_log->log (e);
+	return true;
+}
+
+static void
+write_message (shared_ptr<Socket> socket, string xml)
+{
+	socket->write (xml.length() + 1);
+	socket->write ((uint8_t *) xml.c_str(), xml.length() + 1);
+}
+
+/** Seconds between the progress reports that we send to a master which has asked us for a reel */
+static int const reel_progress_interval = 5;
+
+/** State of a reel which we are encoding for a master */
+struct EncodeServer::ReelEncode
+{
+	ReelEncode (shared_ptr<Session> session_, shared_ptr<const Film> film_, int index_, DCPTimePeriod period_)
+		: session (session_)
+		, film (film_)
+		, index (index_)
+		, period (period_)
+		, next_tag (0)
+		, video_done (false)
+		, frames_written (0)
+		, master_gone (false)
+	{}
+
+	/** A frame which is to be written to the reel */
+	struct Pending
+	{
+		Frame frame;
+		Eyes eyes;
+		/** tag of the SessionFrame that is encoding it, or none if it is already in the asset */
+		boost::optional<uint32_t> tag;
+	};
+
+	shared_ptr<Session> session;
+	shared_ptr<const Film> film;
+	int index;
+	DCPTimePeriod period;
+	shared_ptr<ReelWriter> writer;
+	/** frames to write, in the order that they must be written */
+	list<Pending> pending;
+	/** encoded data which has come back from the worker threads, indexed by tag */
+	map<uint32_t, Data> encoded;
+	uint32_t next_tag;
+	/** true if the player has given us video from after the end of the reel */
+	bool video_done;
+
+	/** mutex for the things below, which the heartbeat thread uses */
+	boost::mutex mutex;
+	/** number of whole frames (i.e. counting both eyes of a 3D frame as one) that have been written */
+	Frame frames_written;
+	/** true if we could not send a progress report, so nobody wants this reel any more */
+	bool master_gone;
+};
+
+/** Start a thread to encode the picture for a whole reel of a film.  The film's
+ *  directory and content must be on storage that we share with the master.
+ *  @param socket Socket to the master, which we reply on when the reel is done.
+ *  @param xml Request from the master.
+ */
+void
+EncodeServer::start_reel (shared_ptr<Socket> socket, shared_ptr<cxml::Document> xml)
+{
+	shared_ptr<Session> session (new Session (socket, _num_threads * 2));
+
+	boost::mutex::scoped_lock lm (_mutex);
+
+	tidy_sessions ();
+
+	session->thread = new thread (bind (&EncodeServer::reel_thread, this, session, xml));
+#ifdef DCPOMATIC_LINUX
+	pthread_setname_np (session->thread->native_handle(), "encode-server-reel");
+#endif
+	_sessions.push_back (session);
+}
+
+void
+EncodeServer::reel_thread (shared_ptr<Session> session, shared_ptr<cxml::Document> xml)
+{
+	xmlpp::Document doc;
+	xmlpp::Element* root = doc.create_root_node ("ReelEncodingResponse");
+
+	try {
+		/* Make the film from the master's metadata, but with its directory on our shared storage */
+		shared_ptr<Film> film (new Film (boost::filesystem::path (xml->string_child ("Film"))));
+		boost::filesystem::path metadata = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path ();
+		{
+			FILE* f = fopen_boost (metadata, "w");
+			if (!f) {
+				throw OpenFileError (metadata, errno, OpenFileError::WRITE);
+			}
+			string const m = xml->string_child ("Metadata");
+			checked_fwrite (m.c_str(), m.length(), f, metadata);
+			fclose (f);
+		}
+		film->read_metadata (metadata);
+		boost::filesystem::remove (metadata);
+
+		string const attempt = xml->string_child ("Attempt");
+		if (attempt.empty() || attempt.length() > 32 || attempt.find_first_not_of ("0123456789abcdef") != string::npos) {
+			/* This will be part of a filename */
+			throw NetworkError (String::compose ("bad attempt identifier %1", attempt));
+		}
+
+		int const index = xml->number_child<int> ("Reel");
+		list<DCPTimePeriod> const reels = film->reels ();
+		list<DCPTimePeriod>::const_iterator period = reels.begin ();
+		for (int i = 0; i < index && period != reels.end(); ++i) {
+			++period;
+		}
+		if (index < 0 || period == reels.end()) {
+			throw NetworkError (String::compose ("reel %1 requested from a film with %2 reels", index, reels.size()));
+		}
+
+		LOG_GENERAL ("Encoding reel %1 of %2", index + 1, film->directory()->string());
+		if (_verbose) {
+			cout << "Encoding reel " << (index + 1) << " of " << film->directory()->string() << "\n";
+		}
+
+		ReelEncode reel (session, film, index, *period);
+
+		/* Keep the master informed from another thread, as some of what we do (setting up the
+		   ReelWriter, seeking and finalizing the asset) can take a long time without any frames
+		   being written.
+		*/
+		thread heartbeat (bind (&EncodeServer::reel_heartbeat_thread, this, &reel));
+		try {
+			reel.writer.reset (new ReelWriter (film, *period, shared_ptr<Job>(), index, reels.size(), film->content_summary(*period), attempt));
+			encode_reel (&reel);
+			reel.writer->finalize_picture ();
+		} catch (...) {
+			heartbeat.interrupt ();
+			heartbeat.join ();
+			reel.writer.reset ();
+			/* Nobody will move these into place now */
+			boost::system::error_code ec;
+			boost::filesystem::remove (ReelWriter::attempt_file (film->internal_video_asset_dir() / film->internal_video_asset_filename(*period), attempt), ec);
+			boost::filesystem::remove (ReelWriter::attempt_file (film->info_file(*period), attempt), ec);
+			throw;
+		}
+
+		heartbeat.interrupt ();
+		heartbeat.join ();
+
+		root->add_child("Frames")->add_child_text (raw_convert<string> (reel.frames_written));
+	} catch (std::exception& e) {
+		cerr << "Error: " << e.what() << "\n";
+		LOG_ERROR ("Error: %1", e.what());
+		root->add_child("Error")->add_child_text (e.what());
+	}
+
+	try {
+		write_message (session->socket, doc.write_to_string ("UTF-8"));
+	} catch (std::exception& e) {
+		LOG_ERROR ("Could not send reel result (%1)", e.what());
+	}
+
+	boost::mutex::scoped_lock lm (_mutex);
+	session->done.clear ();
+	session->finished = true;
+}
+
+/** Thread to tell the master how we are getting on with a reel every few seconds, until
+ *  it is interrupted.
+ */
+void
+EncodeServer::reel_heartbeat_thread (ReelEncode* reel)
+try
+{
+	while (true) {
+		boost::this_thread::sleep (boost::posix_time::seconds (reel_progress_interval));
+
+		Frame frames;
+		{
+			boost::mutex::scoped_lock lm (reel->mutex);
+			frames = reel->frames_written;
+		}
+
+		xmlpp::Document doc;
+		xmlpp::Element* root = doc.create_root_node ("ReelEncodingProgress");
+		root->add_child("Frames")->add_child_text (raw_convert<string> (frames));
+		write_message (reel->session->socket, doc.write_to_string ("UTF-8"));
+	}
+}
+catch (boost::thread_interrupted &)
+{
+
+}
+catch (std::exception& e)
+{
+	LOG_ERROR ("Could not send reel progress; giving up on reel %1 (%2)", reel->index + 1, e.what());
+	boost::mutex::scoped_lock lm (reel->mutex);
+	reel->master_gone = true;
+}
+
+/** Decode a reel with our own Player and give its frames to the worker threads,
+ *  writing them to the picture asset in order as they come back.
+ */
+void
+EncodeServer::encode_reel (ReelEncode* reel)
+{
+	shared_ptr<Player> player (new Player (reel->film, reel->film->playlist ()));
+	player->set_ignore_audio ();
+	if (Config::instance()->defer_video_decoding()) {
+		/* Let our worker threads do the decoding */
+		player->set_defer_video_decoding ();
+	}
+	boost::signals2::scoped_connection connection = player->Video.connect (bind (&EncodeServer::reel_video, this, reel, _1, _2));
+
+	player->seek (reel->period.from, true);
+	while (!reel->video_done && !player->pass ()) {}
+
+	write_reel_frames (reel, true);
+}
+
+void
+EncodeServer::reel_video (ReelEncode* reel, shared_ptr<PlayerVideo> video, DCPTime time)
+{
+	if (time >= reel->period.to) {
+		reel->video_done = true;
+		return;
+	}
+
+	if (!reel->period.contains (time)) {
+		return;
+	}
+
+	shared_ptr<const Film> film = reel->film;
+
+	if (!film->three_d() && video->eyes() == EYES_LEFT) {
+		/* Use left-eye images for both eyes */
+		video->set_eyes (EYES_BOTH);
+	}
+
+	Frame const position = time.frames_floor (film->video_frame_rate ());
+	Frame const frame = position - reel->writer->start ();
+
+	ReelEncode::Pending pending;
+	pending.frame = frame;
+	pending.eyes = video->eyes ();
+
+	if (frame == 0 || frame >= reel->writer->first_nonexistant_frame()) {
+		SessionFrame f;
+		gettimeofday (&f.start, 0);
+		f.after_read = f.start;
+		f.session = reel->session;
+		f.tag = reel->next_tag++;
+		f.video.reset (new DCPVideo (video, position, film->video_frame_rate(), film->j2k_bandwidth(), film->resolution()));
+		f.compression = TRANSPORT_COMPRESSION_NONE;
+		f.compression_ratio = 1;
+		pending.tag = f.tag;
+
+		boost::mutex::scoped_lock lm (_mutex);
+		_session_queue.push_back (f);
+		_empty_condition.notify_all ();
+	}
+
+	reel->pending.push_back (pending);
+	write_reel_frames (reel, false);
+}
+
+/** Write whatever frames of a reel we can, in order, and tell the master how we are getting on.
+ *  @param all true to wait until everything has been written, false to wait only until
+ *  there is room to give the worker threads another frame.
+ */
+void
+EncodeServer::write_reel_frames (ReelEncode* reel, bool all)
+{
+	shared_ptr<const Film> film = reel->film;
+	boost::mutex::scoped_lock lm (_mutex);
+
+	while (true) {
+		BOOST_FOREACH (SessionFrame const& i, reel->session->done) {
+			if (!i.encoded) {
+				throw EncodeError (String::compose ("could not encode frame %1", i.video->index()));
+			}
+			reel->encoded[i.tag] = *i.encoded;
+		}
+		reel->session->done.clear ();
+		lm.unlock ();
+
+		int in_flight = 0;
+		while (!reel->pending.empty ()) {
+			ReelEncode::Pending const& p = reel->pending.front ();
+			Eyes const eyes[2] = { film->three_d() && p.eyes == EYES_BOTH ? EYES_LEFT : p.eyes, EYES_RIGHT };
+			int const writes = film->three_d() && p.eyes == EYES_BOTH ? 2 : 1;
+
+			if (p.tag) {
+				map<uint32_t, Data>::iterator i = reel->encoded.find (*p.tag);
+				if (i == reel->encoded.end ()) {
+					break;
+				}
+				for (int j = 0; j < writes; ++j) {
+					reel->writer->write (i->second, p.frame, eyes[j]);
+				}
+				reel->encoded.erase (i);
+			} else {
+				for (int j = 0; j < writes; ++j) {
+					reel->writer->fake_write (p.frame, eyes[j], reel->writer->read_frame_info(p.frame, eyes[j]).size);
+				}
+			}
+
+			if (p.eyes != EYES_LEFT) {
+				boost::mutex::scoped_lock rm (reel->mutex);
+				++reel->frames_written;
+			}
+			reel->pending.pop_front ();
+		}
+
+		BOOST_FOREACH (ReelEncode::Pending const& i, reel->pending) {
+			if (i.tag) {
+				++in_flight;
+			}
+		}
+
+		{
+			boost::mutex::scoped_lock rm (reel->mutex);
+			if (reel->master_gone) {
+				throw NetworkError ("the master is no longer waiting for this reel");
+			}
+		}
+
+		if ((all && reel->pending.empty()) || (!all && in_flight < reel->session->window)) {
+			return;
+		}
+
+		lm.lock ();
+		while (reel->session->done.empty() && !_terminate) {
+			_done_condition.wait (lm);
+		}
+
+		if (_terminate) {
+			throw NetworkError ("server is shutting down");
+		}
+	}
+}
+
 void
 EncodeServer::run ()
 {
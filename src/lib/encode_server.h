@@ -27,13 +27,23 @@
 
 #include "server.h"
 #include "exception_store.h"
+#include "dcpomatic_time.h"
 #include <boost/thread.hpp>
 #include <boost/asio.hpp>
 #include <boost/thread/condition.hpp>
+#include <boost/optional.hpp>
+#include <dcp/data.h>
 #include <string>
 
 class Socket;
 class Log;
+class DCPVideo;
+class PlayerVideo;
+class Film;
+
+namespace cxml {
+	class Document;
+}
 
 /** @class EncodeServer
  *  @brief A class to run a server which can accept requests to perform JPEG2000
@@ -48,14 +58,73 @@ public:
 	void run ();
 
 private:
+	class Session;
+
+	/** A frame from a pipelined session which is waiting to be encoded, or which
+	 *  has been encoded and is waiting to be sent back.
+	 */
+	struct SessionFrame
+	{
+		boost::shared_ptr<Session> session;
+		uint32_t tag;
+		boost::shared_ptr<DCPVideo> video;
+		struct timeval start;
+		struct timeval after_read;
+		struct timeval after_encode;
+		TransportCompression compression;
+		double compression_ratio;
+		/** encoded data, or empty if encoding failed */
+		boost::optional<dcp::Data> encoded;
+	};
+
+	/** @class Session
+	 *  @brief State of a pipelined session with a master; see EncodeServerConnection
+	 *  for details of the protocol.
+	 */
+	class Session
+	{
+	public:
+		Session (boost::shared_ptr<Socket> s, int w)
+			: socket (s)
+			, window (w)
+			, thread (0)
+			, finished (false)
+		{}
+
+		boost::shared_ptr<Socket> socket;
+		int window;
+		boost::thread* thread;
+		/** true when thread has finished and can be joined; protected by EncodeServer::_mutex */
+		bool finished;
+		/** encoded frames ready to send back; protected by EncodeServer::_mutex */
+		std::list<SessionFrame> done;
+	};
+
+	struct ReelEncode;
+
 	void handle (boost::shared_ptr<Socket>);
 	void worker_thread ();
-	int process (boost::shared_ptr<Socket> socket, struct timeval &, struct timeval &);
+	int process (boost::shared_ptr<Socket> socket, struct timeval &, struct timeval &, TransportCompression &, double &);
+	void start_session (boost::shared_ptr<Socket> socket, int window);
+	void session_thread (boost::shared_ptr<Session> session);
+	bool send_session_reply (boost::shared_ptr<Session> session);
+	void tidy_sessions ();
+	void start_reel (boost::shared_ptr<Socket> socket, boost::shared_ptr<cxml::Document> xml);
+	void reel_thread (boost::shared_ptr<Session> session, boost::shared_ptr<cxml::Document> xml);
+	void reel_heartbeat_thread (ReelEncode* reel);
+	void encode_reel (ReelEncode* reel);
+	void reel_video (ReelEncode* reel, boost::shared_ptr<PlayerVideo> video, DCPTime time);
+	void write_reel_frames (ReelEncode* reel, bool all);
 	void broadcast_thread ();
 	void broadcast_received ();
 
 	std::vector<boost::thread *> _worker_threads;
 	std::list<boost::shared_ptr<Socket> > _queue;
+	/** frames from pipelined sessions which are waiting to be encoded */
+	std::list<SessionFrame> _session_queue;
+	std::list<boost::shared_ptr<Session> > _sessions;
+	/** condition to wake session threads when a frame has been encoded */
+	boost::condition _done_condition;
 	boost::condition _full_condition;
 	boost::condition _empty_condition;
 	bool _verbose;
@@ -0,0 +1,165 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/encode_server_connection.cc
+ *  @brief EncodeServerConnection class.
+ */
+
+#include "encode_server_connection.h"
+#include "dcpomatic_socket.h"
+#include "dcp_video.h"
+#include "config.h"
+#include "exceptions.h"
+#include "dcpomatic_assert.h"
+#include "log.h"
+#include "dcpomatic_log.h"
+#include "cross.h"
+#include "compose.hpp"
+#include <dcp/raw_convert.h>
+#include <libxml++/libxml++.h>
+#include <boost/asio.hpp>
+
+#include "i18n.h"
+
+using std::string;
+using std::pair;
+using std::make_pair;
+using std::list;
+using std::map;
+using boost::shared_ptr;
+using dcp::Data;
+using dcp::raw_convert;
+
+/** Connect to a server and start a pipelined session.
+ *  @param server Server to connect to; must support pipelined sessions.
+ *  @param window Maximum number of frames that may be in flight at once.
+ *  @param timeout Socket timeout in seconds.
+ */
+EncodeServerConnection::EncodeServerConnection (EncodeServerDescription server, int window, int timeout)
+	: _server (server)
+	, _socket (new Socket (timeout))
+	, _window (window)
+	, _next_tag (0)
+	, _last_used (time(0))
+{
+	DCPOMATIC_ASSERT (_server.pipelined());
+	DCPOMATIC_ASSERT (_window > 0);
+
+	boost::asio::io_service io_service;
+	boost::asio::ip::tcp::resolver resolver (io_service);
+	boost::asio::ip::tcp::resolver::query query (_server.host_name(), raw_convert<string> (ENCODE_FRAME_PORT));
+	boost::asio::ip::tcp::resolver::iterator endpoint_iterator = resolver.resolve (query);
+
+	_socket->connect (*endpoint_iterator);
+
+	xmlpp::Document doc;
+	xmlpp::Element* root = doc.create_root_node ("EncodingSession");
+	root->add_child("Version")->add_child_text (raw_convert<string> (_server.link_version()));
+	root->add_child("Window")->add_child_text (raw_convert<string> (_window));
+	write_message (doc.write_to_string ("UTF-8"));
+
+	LOG_GENERAL ("Opened pipelined session with %1 (window %2)", _server.host_name(), _window);
+}
+
+EncodeServerConnection::~EncodeServerConnection ()
+{
+	if (!_in_flight.empty ()) {
+		/* The server still has work from us that nobody will read, so just drop the connection */
+		return;
+	}
+
+	try {
+		xmlpp::Document doc;
+		doc.create_root_node ("EncodingEnd");
+		write_message (doc.write_to_string ("UTF-8"));
+	} catch (...) {
+		/* We're finished with the server anyway */
+	}
+}
+
+void
+EncodeServerConnection::write_message (string xml)
+{
+	_socket->write (xml.length() + 1);
+	_socket->write ((uint8_t *) xml.c_str(), xml.length() + 1);
+}
+
+/** Send a frame to the server.  The frame is counted as in flight even if this
+ *  method throws, so that the caller can recover it using in_flight().
+ */
+void
+EncodeServerConnection::send (shared_ptr<DCPVideo> frame)
+{
+	DCPOMATIC_ASSERT (!full ());
+
+	uint32_t const tag = _next_tag++;
+	_in_flight[tag] = frame;
+	_last_used = time (0);
+
+	LOG_DEBUG_ENCODE (N_("Sending frame %1 to %2 with tag %3"), frame->index(), _server.host_name(), tag);
+	frame->send_request (_socket, _server, tag);
+}
+
+/** Wait for the server to return one encoded frame.  If the window is not full
+ *  the server is first asked to send whatever it has.
+ *  @return Frame which was encoded and its J2K data.
+ */
+pair<shared_ptr<DCPVideo>, Data>
+EncodeServerConnection::receive ()
+{
+	DCPOMATIC_ASSERT (!idle ());
+
+	if (!full ()) {
+		xmlpp::Document doc;
+		doc.create_root_node ("EncodingFlush");
+		write_message (doc.write_to_string ("UTF-8"));
+	}
+
+	LOG_TIMING ("start-remote-encode thread=%1", thread_id ());
+	uint32_t const tag = _socket->read_uint32 ();
+	map<uint32_t, shared_ptr<DCPVideo> >::iterator i = _in_flight.find (tag);
+	if (i == _in_flight.end()) {
+		throw NetworkError (String::compose (_("unexpected frame tag %1 from %2"), tag, _server.host_name()));
+	}
+
+	Data e (_socket->read_uint32 ());
+	LOG_TIMING ("start-remote-receive thread=%1", thread_id ());
+	_socket->read (e.data().get(), e.size());
+	LOG_TIMING ("finish-remote-receive thread=%1", thread_id ());
+
+	shared_ptr<DCPVideo> frame = i->second;
+	_in_flight.erase (i);
+	_last_used = time (0);
+
+	LOG_DEBUG_ENCODE (N_("Finished remotely-encoded frame %1"), frame->index());
+
+	return make_pair (frame, e);
+}
+
+/** @return Frames which have been sent but not received, in the order that they were sent */
+list<shared_ptr<DCPVideo> >
+EncodeServerConnection::in_flight () const
+{
+	list<shared_ptr<DCPVideo> > frames;
+	for (map<uint32_t, shared_ptr<DCPVideo> >::const_iterator i = _in_flight.begin(); i != _in_flight.end(); ++i) {
+		frames.push_back (i->second);
+	}
+	return frames;
+}
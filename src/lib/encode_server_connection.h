@@ -0,0 +1,98 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef DCPOMATIC_ENCODE_SERVER_CONNECTION_H
+#define DCPOMATIC_ENCODE_SERVER_CONNECTION_H
+
+/** @file  src/lib/encode_server_connection.h
+ *  @brief EncodeServerConnection class.
+ */
+
+#include "encode_server_description.h"
+#include <dcp/data.h>
+#include <boost/shared_ptr.hpp>
+#include <boost/noncopyable.hpp>
+#include <map>
+#include <list>
+#include <ctime>
+#include <stdint.h>
+
+class Socket;
+class DCPVideo;
+
+/** @class EncodeServerConnection
+ *  @brief A long-lived, pipelined connection to an EncodeServer.
+ *
+ *  Up to `window' frames can be sent before any encoded data is read back,
+ *  so that the transfer of one frame can overlap the encoding of others.
+ *  Each frame is tagged so that replies (which may arrive in any order)
+ *  can be matched with the frames that they belong to.
+ *
+ *  The session protocol is:
+ *
+ *  client: EncodingSession header giving the window size
+ *  client: up to `window' EncodingRequests, each with a Tag and followed by binary data
+ *  server: one reply (tag, length, J2K data) once `window' frames are outstanding
+ *  client: EncodingFlush if it wants a reply without filling the window
+ *  client: EncodingEnd to finish the session
+ *
+ *  Methods of this class must be called from a single thread.
+ */
+class EncodeServerConnection : public boost::noncopyable
+{
+public:
+	EncodeServerConnection (EncodeServerDescription server, int window, int timeout = 30);
+	~EncodeServerConnection ();
+
+	void send (boost::shared_ptr<DCPVideo> frame);
+	std::pair<boost::shared_ptr<DCPVideo>, dcp::Data> receive ();
+
+	std::list<boost::shared_ptr<DCPVideo> > in_flight () const;
+
+	/** @return true if we cannot send any more frames until we receive one */
+	bool full () const {
+		return static_cast<int> (_in_flight.size()) >= _window;
+	}
+
+	/** @return true if there are no frames in flight */
+	bool idle () const {
+		return _in_flight.empty ();
+	}
+
+	/** @return true if this connection has been idle for long enough that the
+	 *  server may have given up on it.
+	 */
+	bool stale () const {
+		return idle() && (time(0) - _last_used) > 15;
+	}
+
+private:
+	void write_message (std::string xml);
+
+	EncodeServerDescription _server;
+	boost::shared_ptr<Socket> _socket;
+	int _window;
+	uint32_t _next_tag;
+	/** Frames that have been sent but not yet received, indexed by tag */
+	std::map<uint32_t, boost::shared_ptr<DCPVideo> > _in_flight;
+	time_t _last_used;
+};
+
+#endif
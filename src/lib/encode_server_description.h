@@ -60,8 +60,29 @@ public:
 		return _threads;
 	}
 
+	/** @return server link (i.e. protocol) version number */
+	int link_version () const {
+		return _link_version;
+	}
+
+	/** @return true if we can talk to this server */
 	bool current_link_version () const {
-		return _link_version == SERVER_LINK_VERSION;
+		return _link_version >= MINIMUM_SERVER_LINK_VERSION && _link_version <= SERVER_LINK_VERSION;
+	}
+
+	/** @return true if this server accepts compressed image data */
+	bool compressed_transport () const {
+		return _link_version >= COMPRESSED_TRANSPORT_SERVER_LINK_VERSION;
+	}
+
+	/** @return true if this server accepts pipelined sessions */
+	bool pipelined () const {
+		return _link_version >= PIPELINED_SERVER_LINK_VERSION;
+	}
+
+	/** @return true if this server can encode whole reels */
+	bool reel_encoding () const {
+		return _link_version >= REEL_SERVER_LINK_VERSION;
 	}
 
 	void set_host_name (std::string n) {
@@ -23,13 +23,17 @@
 
 using std::string;
 
-EncodedLogEntry::EncodedLogEntry (int frame, string ip, double receive, double encode, double send)
+EncodedLogEntry::EncodedLogEntry (
+	int frame, string ip, double receive, double encode, double send, TransportCompression compression, double compression_ratio
+	)
 	: LogEntry (LogEntry::TYPE_GENERAL)
 	, _frame (frame)
 	, _ip (ip)
 	, _receive (receive)
 	, _encode (encode)
 	, _send (send)
+	, _compression (compression)
+	, _compression_ratio (compression_ratio)
 {
 
 }
@@ -38,6 +42,13 @@ string
 EncodedLogEntry::message () const
 {
 	char buffer[256];
-	snprintf (buffer, sizeof(buffer), "Encoded frame %d from %s: receive %.2fs encode %.2fs send %.2fs.", _frame, _ip.c_str(), _receive, _encode, _send);
+	if (_compression == TRANSPORT_COMPRESSION_NONE) {
+		snprintf (buffer, sizeof(buffer), "Encoded frame %d from %s: receive %.2fs encode %.2fs send %.2fs.", _frame, _ip.c_str(), _receive, _encode, _send);
+	} else {
+		snprintf (
+			buffer, sizeof(buffer), "Encoded frame %d from %s: receive %.2fs (%s, ratio %.2f) encode %.2fs send %.2fs.",
+			_frame, _ip.c_str(), _receive, transport_compression_to_string(_compression).c_str(), _compression_ratio, _encode, _send
+			);
+	}
 	return buffer;
 }
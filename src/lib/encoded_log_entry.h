@@ -19,11 +19,15 @@
 */
 
 #include "log_entry.h"
+#include "types.h"
 
 class EncodedLogEntry : public LogEntry
 {
 public:
-	EncodedLogEntry (int frame, std::string ip, double receive, double encode, double send);
+	EncodedLogEntry (
+		int frame, std::string ip, double receive, double encode, double send,
+		TransportCompression compression = TRANSPORT_COMPRESSION_NONE, double compression_ratio = 1
+		);
 
 	std::string message () const;
 
@@ -33,4 +37,7 @@ private:
 	double _receive;
 	double _encode;
 	double _send;
+	TransportCompression _compression;
+	/** ratio of the uncompressed size of the received data to the number of bytes that came over the network */
+	double _compression_ratio;
 };
@@ -29,6 +29,7 @@
 #include "ffmpeg_audio_stream.h"
 #include "digester.h"
 #include "compose.hpp"
+#include "config.h"
 #include <dcp/raw_convert.h>
 extern "C" {
 #include <libavcodec/avcodec.h>
@@ -37,6 +38,7 @@ extern "C" {
 }
 #include <boost/algorithm/string.hpp>
 #include <boost/foreach.hpp>
+#include <boost/thread.hpp>
 #include <iostream>
 
 #include "i18n.h"
@@ -45,11 +47,14 @@ using std::string;
 using std::cout;
 using std::cerr;
 using std::vector;
+using std::min;
+using std::max;
 using boost::shared_ptr;
 using boost::optional;
 using dcp::raw_convert;
 
 boost::mutex FFmpeg::_mutex;
+int FFmpeg::_video_decoders = 0;
 
 FFmpeg::FFmpeg (boost::shared_ptr<const FFmpegContent> c)
 	: _ffmpeg_content (c)
@@ -58,6 +63,7 @@ FFmpeg::FFmpeg (boost::shared_ptr<const FFmpegContent> c)
 	, _avio_context (0)
 	, _format_context (0)
 	, _frame (0)
+	, _counted_video_decoder (false)
 {
 	setup_general ();
 	setup_decoders ();
@@ -71,6 +77,10 @@ FFmpeg::~FFmpeg ()
 		avcodec_close (_format_context->streams[i]->codec);
 	}
 
+	if (_counted_video_decoder) {
+		--_video_decoders;
+	}
+
 	av_frame_free (&_frame);
 	avformat_close_input (&_format_context);
 }
@@ -192,6 +202,8 @@ FFmpeg::setup_decoders ()
 {
 	boost::mutex::scoped_lock lm (_mutex);
 
+	bool video = false;
+
 	for (uint32_t i = 0; i < _format_context->nb_streams; ++i) {
 		AVCodecContext* context = _format_context->streams[i]->codec;
 
@@ -211,6 +223,13 @@ FFmpeg::setup_decoders ()
 			/* Enable following of links in files */
 			av_dict_set_int (&options, "enable_drefs", 1, 0);
 
+			if (_video_stream && static_cast<int>(i) == _video_stream.get()) {
+				setup_video_decode_threads (context);
+				video = true;
+				/* Give us our own references to decoded frames so that Image can use them without copying */
+				context->refcounted_frames = 1;
+			}
+
 			if (avcodec_open2 (context, codec, &options) < 0) {
 				throw DecodeError (N_("could not open decoder"));
 			}
@@ -218,6 +237,45 @@ FFmpeg::setup_decoders ()
 			dcpomatic_log->log (String::compose ("No codec found for stream %1", i), LogEntry::TYPE_WARNING);
 		}
 	}
+
+	/* Only count ourselves once everything has opened, since if anything above throws
+	   our destructor will not be called to take us off again.
+	*/
+	if (video) {
+		++_video_decoders;
+		_counted_video_decoder = true;
+	}
+}
+
+/** Set up a video codec context so that it decodes using several threads (if its codec can)
+ *  according to the configuration.  This must be called with _mutex held.
+ */
+void
+FFmpeg::setup_video_decode_threads (AVCodecContext* context)
+{
+	int threads = Config::instance()->video_decode_threads ();
+	if (threads == 0) {
+		/* Share the processors between the video decoders that are open at the same time
+		   (e.g. when reels are decoded in parallel).  FFmpeg advises against more than 16.
+		*/
+		threads = max (1, min (16, int (boost::thread::hardware_concurrency()) / (_video_decoders + 1)));
+	}
+
+	context->thread_count = threads;
+
+	switch (Config::instance()->video_decode_thread_type ()) {
+	case Config::VIDEO_DECODE_THREADS_FRAME_AND_SLICE:
+		context->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+		break;
+	case Config::VIDEO_DECODE_THREADS_FRAME:
+		context->thread_type = FF_THREAD_FRAME;
+		break;
+	case Config::VIDEO_DECODE_THREADS_SLICE:
+		context->thread_type = FF_THREAD_SLICE;
+		break;
+	}
+
+	LOG_GENERAL ("Decoding video with up to %1 threads", threads);
 }
 
 AVCodecContext *
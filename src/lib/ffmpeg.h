@@ -82,6 +82,12 @@ protected:
 private:
 	void setup_general ();
 	void setup_decoders ();
+	void setup_video_decode_threads (AVCodecContext* context);
+
+	/** true if we are counted in _video_decoders */
+	bool _counted_video_decoder;
+	/** number of FFmpeg objects which have a video decoder open; protected by _mutex */
+	static int _video_decoders;
 
 	static void ffmpeg_log_callback (void* ptr, int level, const char* fmt, va_list vl);
 	static boost::weak_ptr<Log> _ffmpeg_log;
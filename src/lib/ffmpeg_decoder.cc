@@ -36,6 +36,7 @@
 #include "audio_buffers.h"
 #include "ffmpeg_content.h"
 #include "raw_image_proxy.h"
+#include "ffmpeg_packet_image_proxy.h"
 #include "video_decoder.h"
 #include "film.h"
 #include "audio_decoder.h"
@@ -79,6 +80,7 @@ using dcp::Size;
 FFmpegDecoder::FFmpegDecoder (shared_ptr<const Film> film, shared_ptr<const FFmpegContent> c, bool fast)
 	: FFmpeg (c)
 	, Decoder (film)
+	, _defer_video_decoding (false)
 	, _have_current_subtitle (false)
 {
 	if (c->video) {
@@ -499,6 +501,10 @@ FFmpegDecoder::decode_video_packet ()
 {
 	DCPOMATIC_ASSERT (_video_stream);
 
+	if (_defer_video_decoding && _ffmpeg_content->filters().empty() && FFmpegPacketImageProxy::can_decode_independently(video_codec_context())) {
+		return defer_video_packet ();
+	}
+
 	int frame_finished;
 	if (avcodec_decode_video2 (video_codec_context(), _frame, &frame_finished, &_packet) < 0 || !frame_finished) {
 		return false;
@@ -524,6 +530,8 @@ FFmpegDecoder::decode_video_packet ()
 	}
 
 	list<pair<shared_ptr<Image>, int64_t> > images = graph->process (_frame);
+	/* Any Images that are using _frame's data have their own references to it */
+	av_frame_unref (_frame);
 
 	for (list<pair<shared_ptr<Image>, int64_t> >::iterator i = images.begin(); i != images.end(); ++i) {
 
@@ -545,6 +553,46 @@ FFmpegDecoder::decode_video_packet ()
 	return true;
 }
 
+/** @param d true to pass packets from intra-frame video streams on without decoding them
+ *  (when there are no filters), so that the J2K encoder threads or servers decode them.
+ */
+void
+FFmpegDecoder::set_defer_video_decoding (bool d)
+{
+	_defer_video_decoding = d;
+}
+
+/** Emit the current video packet without decoding it, so that the decode can
+ *  happen later in whatever thread (or on whatever server) needs the image.
+ *  This must only be used for streams whose packets can be decoded independently,
+ *  and when there are no filters to apply.
+ *  @return true if a frame was emitted.
+ */
+bool
+FFmpegDecoder::defer_video_packet ()
+{
+	if (_packet.size == 0) {
+		/* We are being flushed, but we don't have anything buffered */
+		return false;
+	}
+
+	int64_t const timestamp = _packet.pts != AV_NOPTS_VALUE ? _packet.pts : _packet.dts;
+	if (timestamp == AV_NOPTS_VALUE) {
+		LOG_WARNING_NC ("Dropping frame without PTS");
+		return true;
+	}
+
+	double const pts = timestamp * av_q2d (_format_context->streams[_video_stream.get()]->time_base) + _pts_offset.seconds ();
+
+	video->emit (
+		film(),
+		shared_ptr<ImageProxy> (new FFmpegPacketImageProxy (video_codec_context(), &_packet)),
+		llrint(pts * _ffmpeg_content->active_video_frame_rate(film()))
+		);
+
+	return true;
+}
+
 void
 FFmpegDecoder::decode_subtitle_packet ()
 {
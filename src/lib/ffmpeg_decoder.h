@@ -50,6 +50,8 @@ public:
 	bool pass ();
 	void seek (ContentTime time, bool);
 
+	void set_defer_video_decoding (bool d);
+
 private:
 	friend struct ::ffmpeg_pts_offset_test;
 
@@ -59,6 +61,7 @@ private:
 	int bytes_per_audio_sample (boost::shared_ptr<FFmpegAudioStream> stream) const;
 
 	bool decode_video_packet ();
+	bool defer_video_packet ();
 	void decode_audio_packet ();
 	void decode_subtitle_packet ();
 
@@ -72,6 +75,8 @@ private:
 	boost::mutex _filter_graphs_mutex;
 
 	ContentTime _pts_offset;
+	/** true to emit packets from intra-frame video streams without decoding them */
+	bool _defer_video_decoding;
 	boost::optional<ContentTime> _current_subtitle_to;
 	/** true if we have a subtitle which has not had emit_stop called for it yet */
 	bool _have_current_subtitle;
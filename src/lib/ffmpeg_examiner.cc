@@ -103,9 +103,11 @@ FFmpegExaminer::FFmpegExaminer (shared_ptr<const FFmpegContent> c, shared_ptr<Jo
 	 */
 
 	int64_t const len = _file_group.length ();
+	bool eof = false;
 	while (true) {
 		int r = av_read_frame (_format_context, &_packet);
 		if (r < 0) {
+			eof = true;
 			break;
 		}
 
@@ -142,6 +144,15 @@ FFmpegExaminer::FFmpegExaminer (shared_ptr<const FFmpegContent> c, shared_ptr<Jo
 		}
 	}
 
+	if (eof && _video_stream && _need_video_length) {
+		/* Get any frames that the decoder is still holding; particularly when it is
+		   using several threads there may be a few of these at the end of the file.
+		*/
+		_packet.data = 0;
+		_packet.size = 0;
+		while (video_packet (_format_context->streams[_video_stream.get()]->codec)) {}
+	}
+
 	if (_video_stream) {
 		/* This code taken from get_rotation() in ffmpeg:cmdutils.c */
 		AVStream* stream = _format_context->streams[*_video_stream];
@@ -167,26 +178,32 @@ FFmpegExaminer::FFmpegExaminer (shared_ptr<const FFmpegContent> c, shared_ptr<Jo
 	}
 }
 
-void
+/** @return true if a frame was decoded */
+bool
 FFmpegExaminer::video_packet (AVCodecContext* context)
 {
 	DCPOMATIC_ASSERT (_video_stream);
 
 	if (_first_video && !_need_video_length) {
-		return;
+		return false;
 	}
 
 	int frame_finished;
-	if (avcodec_decode_video2 (context, _frame, &frame_finished, &_packet) >= 0 && frame_finished) {
-		if (!_first_video) {
-			_first_video = frame_time (_format_context->streams[_video_stream.get()]);
-		}
-		if (_need_video_length) {
-			_video_length = frame_time (
-				_format_context->streams[_video_stream.get()]
-				).get_value_or (ContentTime ()).frames_round (video_frame_rate().get ());
-		}
+	if (avcodec_decode_video2 (context, _frame, &frame_finished, &_packet) < 0 || !frame_finished) {
+		return false;
+	}
+
+	if (!_first_video) {
+		_first_video = frame_time (_format_context->streams[_video_stream.get()]);
+	}
+	if (_need_video_length) {
+		_video_length = frame_time (
+			_format_context->streams[_video_stream.get()]
+			).get_value_or (ContentTime ()).frames_round (video_frame_rate().get ());
 	}
+
+	av_frame_unref (_frame);
+	return true;
 }
 
 void
@@ -76,7 +76,7 @@ public:
 	}
 
 private:
-	void video_packet (AVCodecContext *);
+	bool video_packet (AVCodecContext *);
 	void audio_packet (AVCodecContext *, boost::shared_ptr<FFmpegAudioStream>);
 
 	std::string stream_name (AVStream* s) const;
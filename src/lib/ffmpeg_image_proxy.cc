@@ -19,6 +19,7 @@
 */
 
 #include "ffmpeg_image_proxy.h"
+#include "digester.h"
 #include "cross.h"
 #include "exceptions.h"
 #include "dcpomatic_socket.h"
@@ -168,6 +169,9 @@ FFmpegImageProxy::image (optional<dcp::Size>) const
 	AVCodec* codec = avcodec_find_decoder (codec_context->codec_id);
 	DCPOMATIC_ASSERT (codec);
 
+	/* Let our Image keep the decoded data after the decoder has gone */
+	codec_context->refcounted_frames = 1;
+
 	if (avcodec_open2 (codec_context, codec, 0) < 0) {
 		throw DecodeError (N_("could not open decoder"));
 	}
@@ -202,7 +206,7 @@ FFmpegImageProxy::add_metadata (xmlpp::Node* node) const
 }
 
 void
-FFmpegImageProxy::send_binary (shared_ptr<Socket> socket) const
+FFmpegImageProxy::send_binary (shared_ptr<Socket> socket, TransportCompression) const
 {
 	socket->write (_data.size());
 	socket->write (_data.data().get(), _data.size());
@@ -223,6 +227,13 @@ FFmpegImageProxy::same (shared_ptr<const ImageProxy> other) const
 	return memcmp (_data.data().get(), mp->_data.data().get(), _data.size()) == 0;
 }
 
+void
+FFmpegImageProxy::add_digest (Digester& digester) const
+{
+	digester.add (string ("FFmpeg"));
+	digester.add (_data.data().get(), _data.size());
+}
+
 size_t
 FFmpegImageProxy::memory_used () const
 {
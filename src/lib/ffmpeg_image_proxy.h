@@ -35,8 +35,9 @@ public:
 		) const;
 
 	void add_metadata (xmlpp::Node *) const;
-	void send_binary (boost::shared_ptr<Socket>) const;
+	void send_binary (boost::shared_ptr<Socket>, TransportCompression) const;
 	bool same (boost::shared_ptr<const ImageProxy> other) const;
+	void add_digest (Digester& digester) const;
 	size_t memory_used () const;
 
 	int avio_read (uint8_t* buffer, int const amount);
@@ -0,0 +1,280 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "ffmpeg_packet_image_proxy.h"
+#include "digester.h"
+#include "dcpomatic_socket.h"
+#include "exceptions.h"
+#include "image.h"
+#include "compose.hpp"
+#include <dcp/raw_convert.h>
+#include <libcxml/cxml.h>
+#include <libxml++/libxml++.h>
+#include <boost/thread/tss.hpp>
+
+#include "i18n.h"
+
+using std::string;
+using std::pair;
+using std::make_pair;
+using boost::shared_ptr;
+using boost::optional;
+using boost::dynamic_pointer_cast;
+using dcp::raw_convert;
+
+/** @param context Codec context of the stream that the packet came from.
+ *  @param packet Packet; its data will be copied.
+ */
+FFmpegPacketImageProxy::FFmpegPacketImageProxy (AVCodecContext const * context, AVPacket const * packet)
+	: _codec_id (context->codec_id)
+	, _size (context->width, context->height)
+	, _pixel_format (context->pix_fmt)
+	, _bits_per_coded_sample (context->bits_per_coded_sample)
+	, _codec_tag (context->codec_tag)
+	, _extradata (context->extradata, context->extradata_size)
+	, _packet (packet->data, packet->size)
+{
+
+}
+
+FFmpegPacketImageProxy::FFmpegPacketImageProxy (shared_ptr<cxml::Node> xml, shared_ptr<Socket> socket)
+{
+	_codec_id = static_cast<AVCodecID> (xml->number_child<int> ("CodecID"));
+	_size = dcp::Size (xml->number_child<int> ("Width"), xml->number_child<int> ("Height"));
+	_pixel_format = static_cast<AVPixelFormat> (xml->number_child<int> ("PixelFormat"));
+	_bits_per_coded_sample = xml->number_child<int> ("BitsPerCodedSample");
+	_codec_tag = xml->number_child<unsigned int> ("CodecTag");
+
+	_extradata = dcp::Data (socket->read_uint32 ());
+	socket->read (_extradata.data().get(), _extradata.size());
+	_packet = dcp::Data (socket->read_uint32 ());
+	socket->read (_packet.data().get(), _packet.size());
+}
+
+/** @return true if packets from a stream using this context can be decoded without
+ *  reference to any other packets.
+ */
+bool
+FFmpegPacketImageProxy::can_decode_independently (AVCodecContext const * context)
+{
+	AVCodecDescriptor const * d = avcodec_descriptor_get (context->codec_id);
+	return d && (d->props & AV_CODEC_PROP_INTRA_ONLY);
+}
+
+/** A decoder which is kept open by a thread so that it can decode any number of packets
+ *  from the same stream without setting up FFmpeg each time.
+ */
+class PacketDecoder
+{
+public:
+	PacketDecoder ()
+		: codec_id (AV_CODEC_ID_NONE)
+		, pixel_format (AV_PIX_FMT_NONE)
+		, bits_per_coded_sample (0)
+		, codec_tag (0)
+		, context (0)
+	{}
+
+	~PacketDecoder ()
+	{
+		avcodec_free_context (&context);
+	}
+
+	AVCodecID codec_id;
+	dcp::Size size;
+	AVPixelFormat pixel_format;
+	int bits_per_coded_sample;
+	unsigned int codec_tag;
+	dcp::Data extradata;
+	AVCodecContext* context;
+};
+
+/** The decoder that the current thread last used, if any */
+static boost::thread_specific_ptr<PacketDecoder> packet_decoder;
+
+/** @return A decoder for our stream which belongs to the calling thread; it is
+ *  created, or replaced if it was set up for a different stream, as required.
+ */
+AVCodecContext *
+FFmpegPacketImageProxy::decoder () const
+{
+	PacketDecoder* d = packet_decoder.get ();
+	if (
+		d && d->codec_id == _codec_id && d->size == _size && d->pixel_format == _pixel_format &&
+		d->bits_per_coded_sample == _bits_per_coded_sample && d->codec_tag == _codec_tag &&
+		d->extradata.size() == _extradata.size() &&
+		memcmp (d->extradata.data().get(), _extradata.data().get(), _extradata.size()) == 0
+		) {
+		return d->context;
+	}
+
+	/* Get rid of any decoder for some other stream */
+	packet_decoder.reset ();
+
+	AVCodec* codec = avcodec_find_decoder (_codec_id);
+	if (!codec) {
+		throw DecodeError (String::compose (_("could not find decoder for codec %1"), static_cast<int> (_codec_id)));
+	}
+
+	AVCodecContext* context = avcodec_alloc_context3 (codec);
+	if (!context) {
+		throw DecodeError (N_("could not allocate codec context"));
+	}
+
+	context->width = _size.width;
+	context->height = _size.height;
+	context->pix_fmt = _pixel_format;
+	context->bits_per_coded_sample = _bits_per_coded_sample;
+	context->codec_tag = _codec_tag;
+	if (_extradata.size() > 0) {
+		/* FFmpeg needs padding after extradata, and will free it with the context */
+		context->extradata = static_cast<uint8_t*> (av_mallocz (_extradata.size() + AV_INPUT_BUFFER_PADDING_SIZE));
+		memcpy (context->extradata, _extradata.data().get(), _extradata.size());
+		context->extradata_size = _extradata.size();
+	}
+
+	/* Let our Images keep their decoded data however long the decoder lives */
+	context->refcounted_frames = 1;
+
+	if (avcodec_open2 (context, codec, 0) < 0) {
+		avcodec_free_context (&context);
+		throw DecodeError (N_("could not open decoder"));
+	}
+
+	d = new PacketDecoder ();
+	d->codec_id = _codec_id;
+	d->size = _size;
+	d->pixel_format = _pixel_format;
+	d->bits_per_coded_sample = _bits_per_coded_sample;
+	d->codec_tag = _codec_tag;
+	d->extradata = _extradata;
+	d->context = context;
+	packet_decoder.reset (d);
+
+	return context;
+}
+
+pair<shared_ptr<Image>, int>
+FFmpegPacketImageProxy::image (optional<dcp::Size>) const
+{
+	boost::mutex::scoped_lock lm (_mutex);
+
+	if (_image) {
+		return make_pair (_image, 0);
+	}
+
+	AVCodecContext* context = decoder ();
+
+	/* The packet data also needs padding */
+	dcp::Data padded (_packet.size() + AV_INPUT_BUFFER_PADDING_SIZE);
+	memcpy (padded.data().get(), _packet.data().get(), _packet.size());
+	memset (padded.data().get() + _packet.size(), 0, AV_INPUT_BUFFER_PADDING_SIZE);
+
+	AVPacket packet;
+	av_init_packet (&packet);
+	packet.data = padded.data().get();
+	packet.size = _packet.size();
+
+	AVFrame* frame = av_frame_alloc ();
+	if (!frame) {
+		throw DecodeError (N_("could not allocate frame"));
+	}
+
+	int frame_finished;
+	if (avcodec_decode_video2 (context, frame, &frame_finished, &packet) < 0 || !frame_finished) {
+		av_frame_free (&frame);
+		/* Start again with a fresh decoder next time in case this one is in a bad state */
+		packet_decoder.reset ();
+		throw DecodeError (N_("could not decode video"));
+	}
+
+	_image.reset (new Image (frame));
+
+	av_frame_free (&frame);
+
+	return make_pair (_image, 0);
+}
+
+void
+FFmpegPacketImageProxy::add_metadata (xmlpp::Node* node) const
+{
+	node->add_child("Type")->add_child_text (N_("FFmpegPacket"));
+	node->add_child("CodecID")->add_child_text (raw_convert<string> (static_cast<int> (_codec_id)));
+	node->add_child("Width")->add_child_text (raw_convert<string> (_size.width));
+	node->add_child("Height")->add_child_text (raw_convert<string> (_size.height));
+	node->add_child("PixelFormat")->add_child_text (raw_convert<string> (static_cast<int> (_pixel_format)));
+	node->add_child("BitsPerCodedSample")->add_child_text (raw_convert<string> (_bits_per_coded_sample));
+	node->add_child("CodecTag")->add_child_text (raw_convert<string> (_codec_tag));
+}
+
+void
+FFmpegPacketImageProxy::send_binary (shared_ptr<Socket> socket, TransportCompression) const
+{
+	socket->write (_extradata.size());
+	socket->write (_extradata.data().get(), _extradata.size());
+	socket->write (_packet.size());
+	socket->write (_packet.data().get(), _packet.size());
+}
+
+bool
+FFmpegPacketImageProxy::same (shared_ptr<const ImageProxy> other) const
+{
+	shared_ptr<const FFmpegPacketImageProxy> mp = dynamic_pointer_cast<const FFmpegPacketImageProxy> (other);
+	if (!mp) {
+		return false;
+	}
+
+	if (_codec_id != mp->_codec_id || _packet.size() != mp->_packet.size() || _extradata.size() != mp->_extradata.size()) {
+		return false;
+	}
+
+	return memcmp (_packet.data().get(), mp->_packet.data().get(), _packet.size()) == 0 &&
+		memcmp (_extradata.data().get(), mp->_extradata.data().get(), _extradata.size()) == 0;
+}
+
+void
+FFmpegPacketImageProxy::add_digest (Digester& digester) const
+{
+	digester.add (string ("FFmpegPacket"));
+	digester.add (static_cast<int> (_codec_id));
+	digester.add (_size.width);
+	digester.add (_size.height);
+	digester.add (static_cast<int> (_pixel_format));
+	digester.add (_bits_per_coded_sample);
+	digester.add (_codec_tag);
+	digester.add (_extradata.data().get(), _extradata.size());
+	digester.add (_packet.data().get(), _packet.size());
+}
+
+size_t
+FFmpegPacketImageProxy::memory_used () const
+{
+	size_t m = _packet.size() + _extradata.size();
+	if (_image) {
+		m += _image->memory_used();
+	}
+	return m;
+}
+
+int
+FFmpegPacketImageProxy::minimum_link_version () const
+{
+	return PACKET_TRANSPORT_SERVER_LINK_VERSION;
+}
@@ -0,0 +1,72 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef DCPOMATIC_FFMPEG_PACKET_IMAGE_PROXY_H
+#define DCPOMATIC_FFMPEG_PACKET_IMAGE_PROXY_H
+
+#include "image_proxy.h"
+#include <dcp/data.h>
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+#include <boost/thread/mutex.hpp>
+
+/** @class FFmpegPacketImageProxy
+ *  @brief An ImageProxy which holds a single compressed packet from a video stream
+ *  whose frames can be decoded independently (such as ProRes or DNxHD).
+ *
+ *  This means that decoding can happen in encoder threads or on an encoding server,
+ *  rather than in the single-threaded decoder, and that only compressed data
+ *  need be sent over the network.
+ */
+class FFmpegPacketImageProxy : public ImageProxy
+{
+public:
+	FFmpegPacketImageProxy (AVCodecContext const * context, AVPacket const * packet);
+	FFmpegPacketImageProxy (boost::shared_ptr<cxml::Node> xml, boost::shared_ptr<Socket> socket);
+
+	std::pair<boost::shared_ptr<Image>, int> image (
+		boost::optional<dcp::Size> size = boost::optional<dcp::Size> ()
+		) const;
+
+	void add_metadata (xmlpp::Node *) const;
+	void send_binary (boost::shared_ptr<Socket>, TransportCompression) const;
+	bool same (boost::shared_ptr<const ImageProxy> other) const;
+	void add_digest (Digester& digester) const;
+	size_t memory_used () const;
+	int minimum_link_version () const;
+
+	static bool can_decode_independently (AVCodecContext const * context);
+
+private:
+	AVCodecContext* decoder () const;
+
+	AVCodecID _codec_id;
+	dcp::Size _size;
+	AVPixelFormat _pixel_format;
+	int _bits_per_coded_sample;
+	unsigned int _codec_tag;
+	dcp::Data _extradata;
+	dcp::Data _packet;
+	mutable boost::shared_ptr<Image> _image;
+	mutable boost::mutex _mutex;
+};
+
+#endif
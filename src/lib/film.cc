@@ -54,6 +54,7 @@
 #include "cinema.h"
 #include "change_signaller.h"
 #include "check_content_change_job.h"
+#include "frame_info_index.h"
 #include <libcxml/cxml.h>
 #include <dcp/cpl.h>
 #include <dcp/certificate_chain.h>
@@ -251,6 +252,133 @@ Film::info_file (DCPTimePeriod period) const
 	return file (p);
 }
 
+/** @return The file to write a description of the picture segments of a reel to */
+boost::filesystem::path
+Film::video_segments_file (DCPTimePeriod period) const
+{
+	boost::filesystem::path p = info_file (period);
+	p += ".segments";
+	return p;
+}
+
+/** @return An identifier for the settings which affect every frame of the video,
+ *  but not including anything about the content.
+ */
+string
+Film::video_settings_identifier () const
+{
+	DCPOMATIC_ASSERT (container ());
+
+	string s = container()->id()
+		+ "_" + resolution_to_string (_resolution)
+		+ "_" + raw_convert<string>(_video_frame_rate)
+		+ "_" + raw_convert<string>(j2k_bandwidth())
+		+ (encrypted() ? "_E" : "_P")
+		+ (_interop ? "_I" : "_S");
+
+	if (_three_d) {
+		s += "_3D";
+	}
+
+	return s;
+}
+
+/** Record which content makes up each part of the picture in a reel, so that a later
+ *  encode of the same reel can tell which of its frames are still valid.
+ *  @param period Reel period.
+ */
+void
+Film::write_video_segments (DCPTimePeriod period) const
+{
+	xmlpp::Document doc;
+	xmlpp::Element* root = doc.create_root_node ("VideoSegments");
+	root->add_child("Settings")->add_child_text (video_settings_identifier ());
+
+	typedef pair<DCPTimePeriod, string> Segment;
+	BOOST_FOREACH (Segment i, _playlist->video_segments (shared_from_this(), period)) {
+		xmlpp::Element* s = root->add_child ("Segment");
+		s->add_child("From")->add_child_text (raw_convert<string> (i.first.from.get()));
+		s->add_child("To")->add_child_text (raw_convert<string> (i.first.to.get()));
+		s->add_child("Identifier")->add_child_text (i.second);
+	}
+
+	doc.write_to_file_formatted (video_segments_file(period).string());
+}
+
+/** Look for the most recent picture asset which was written for the same reel period
+ *  and with the same settings, but with different content, and work out which parts
+ *  of it are still valid.
+ *  @param period Reel period.
+ *  @return Details of the asset, or none if there isn't one with anything useful in it.
+ */
+optional<PreviousVideoAsset>
+Film::previous_video_asset (DCPTimePeriod period) const
+{
+	if (encrypted ()) {
+		/* Frames of an old asset would be encrypted with a different key */
+		return optional<PreviousVideoAsset> ();
+	}
+
+	string const settings = video_settings_identifier ();
+	string const suffix = "_" + raw_convert<string> (period.from.get()) + "_" + raw_convert<string> (period.to.get()) + ".segments";
+	boost::filesystem::path const current = video_segments_file (period);
+
+	typedef pair<DCPTimePeriod, string> Segment;
+	list<Segment> const now = _playlist->video_segments (shared_from_this(), period);
+
+	optional<PreviousVideoAsset> best;
+	std::time_t best_time = 0;
+
+	boost::system::error_code ec;
+	for (boost::filesystem::directory_iterator i (current.parent_path(), ec); !ec && i != boost::filesystem::directory_iterator(); i.increment(ec)) {
+		boost::filesystem::path const segments = i->path ();
+		string const leaf = segments.filename().string();
+		if (segments == current || !boost::algorithm::ends_with (leaf, suffix)) {
+			continue;
+		}
+
+		PreviousVideoAsset previous;
+		previous.info = segments;
+		previous.info.replace_extension ();
+		previous.asset = internal_video_asset_dir() / (previous.info.filename().string() + ".mxf");
+
+		std::time_t const time = boost::filesystem::last_write_time (previous.asset, ec);
+		if (ec || !boost::filesystem::exists (previous.info) || (best && time <= best_time)) {
+			ec.clear ();
+			continue;
+		}
+
+		try {
+			cxml::Document f ("VideoSegments");
+			f.read_file (segments);
+			if (f.string_child ("Settings") != settings) {
+				continue;
+			}
+
+			BOOST_FOREACH (cxml::ConstNodePtr j, f.node_children ("Segment")) {
+				DCPTimePeriod const then (DCPTime (j->number_child<DCPTime::Type> ("From")), DCPTime (j->number_child<DCPTime::Type> ("To")));
+				string const id = j->string_child ("Identifier");
+				BOOST_FOREACH (Segment k, now) {
+					optional<DCPTimePeriod> const o = then.overlap (k.first);
+					if (o && k.second == id) {
+						previous.unchanged.push_back (o.get ());
+					}
+				}
+			}
+		} catch (std::exception& e) {
+			LOG_GENERAL ("Could not read %1 (%2)", segments.string(), e.what());
+			continue;
+		}
+
+		if (!previous.unchanged.empty ()) {
+			best = previous;
+			best_time = time;
+		}
+	}
+
+	return best;
+}
+
 boost::filesystem::path
 Film::internal_video_asset_dir () const
 {
@@ -1040,30 +1168,20 @@ Film::set_isdcf_date_today ()
 	_isdcf_date = boost::gregorian::day_clock::local_day ();
 }
 
+/** @param reel Reel index.
+ *  @return Path of the file that the Writer uses for frames of the reel that it cannot hold in memory.
+ */
 boost::filesystem::path
-Film::j2c_path (int reel, Frame frame, Eyes eyes, bool tmp) const
+Film::spill_path (int reel) const
 {
 	boost::filesystem::path p;
 	p /= "j2c";
 	p /= video_identifier ();
 
 	char buffer[256];
-	snprintf(buffer, sizeof(buffer), "%08d_%08" PRId64, reel, frame);
-	string s (buffer);
-
-	if (eyes == EYES_LEFT) {
-		s += ".L";
-	} else if (eyes == EYES_RIGHT) {
-		s += ".R";
-	}
+	snprintf(buffer, sizeof(buffer), "%08d.spill", reel);
+	p /= buffer;
 
-	s += ".j2c";
-
-	if (tmp) {
-		s += ".tmp";
-	}
-
-	p /= s;
 	return file (p);
 }
 
@@ -1702,36 +1820,20 @@ Film::closed_caption_tracks () const
 	return tt;
 }
 
-shared_ptr<InfoFileHandle>
-Film::info_file_handle (DCPTimePeriod period, bool read) const
-{
-	return shared_ptr<InfoFileHandle> (new InfoFileHandle(_info_file_mutex, info_file(period), read));
-}
-
-InfoFileHandle::InfoFileHandle (boost::mutex& mutex, boost::filesystem::path file, bool read)
-	: _lock (mutex)
-	, _file (file)
+/** @param period Reel period.
+ *  @return Index of the frame info of the reel's picture asset.
+ */
+shared_ptr<FrameInfoIndex>
+Film::frame_info_index (DCPTimePeriod period) const
 {
-	if (read) {
-		_handle = fopen_boost (file, "rb");
-		if (!_handle) {
-			throw OpenFileError (file, errno, OpenFileError::READ);
-		}
-	} else {
-		bool const exists = boost::filesystem::exists (file);
-		if (exists) {
-			_handle = fopen_boost (file, "r+b");
-		} else {
-			_handle = fopen_boost (file, "wb");
-		}
+	boost::filesystem::path const file = info_file (period);
 
-		if (!_handle) {
-			throw OpenFileError (file, errno, exists ? OpenFileError::READ_WRITE : OpenFileError::WRITE);
-		}
+	boost::mutex::scoped_lock lm (_frame_info_indices_mutex);
+	shared_ptr<FrameInfoIndex> index = _frame_info_indices[file].lock ();
+	if (!index) {
+		index.reset (new FrameInfoIndex (file));
+		_frame_info_indices[file] = index;
 	}
-}
 
-InfoFileHandle::~InfoFileHandle ()
-{
-	fclose (_handle);
+	return index;
 }
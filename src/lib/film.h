@@ -59,29 +59,19 @@ class Ratio;
 class Job;
 class ScreenKDM;
 class Film;
+class FrameInfoIndex;
 struct isdcf_name_test;
 
-class InfoFileHandle
+/** @class PreviousVideoAsset
+ *  @brief Details of a picture asset written by an earlier encode of a reel,
+ *  and the parts of it whose frames are still valid.
+ */
+struct PreviousVideoAsset
 {
-public:
-	~InfoFileHandle ();
-
-	FILE* get () const {
-		return _handle;
-	}
-
-	boost::filesystem::path file () const {
-		return _file;
-	}
-
-private:
-	friend class Film;
-
-	InfoFileHandle (boost::mutex& mutex, boost::filesystem::path file, bool read);
-
-	boost::mutex::scoped_lock _lock;
-	FILE* _handle;
-	boost::filesystem::path _file;
+	boost::filesystem::path asset;
+	boost::filesystem::path info;
+	/** Periods of the DCP whose pictures have not changed since the asset was written */
+	std::list<DCPTimePeriod> unchanged;
 };
 
 /** @class Film
@@ -97,10 +87,13 @@ public:
 	explicit Film (boost::optional<boost::filesystem::path> dir);
 	~Film ();
 
-	boost::shared_ptr<InfoFileHandle> info_file_handle (DCPTimePeriod period, bool read) const;
-	boost::filesystem::path j2c_path (int, Frame, Eyes, bool) const;
+	boost::shared_ptr<FrameInfoIndex> frame_info_index (DCPTimePeriod period) const;
+	boost::filesystem::path info_file (DCPTimePeriod p) const;
+	boost::filesystem::path spill_path (int reel) const;
 	boost::filesystem::path internal_video_asset_dir () const;
 	boost::filesystem::path internal_video_asset_filename (DCPTimePeriod p) const;
+	void write_video_segments (DCPTimePeriod period) const;
+	boost::optional<PreviousVideoAsset> previous_video_asset (DCPTimePeriod period) const;
 
 	boost::filesystem::path audio_analysis_path (boost::shared_ptr<const Playlist>) const;
 
@@ -371,11 +364,12 @@ private:
 	friend struct ::isdcf_name_test;
 	template <typename> friend class ChangeSignaller;
 
-	boost::filesystem::path info_file (DCPTimePeriod p) const;
+	boost::filesystem::path video_segments_file (DCPTimePeriod p) const;
 
 	void signal_change (ChangeType, Property);
 	void signal_change (ChangeType, int);
 	std::string video_identifier () const;
+	std::string video_settings_identifier () const;
 	void playlist_change (ChangeType);
 	void playlist_order_changed ();
 	void playlist_content_change (ChangeType type, boost::weak_ptr<Content>, int, bool frequent);
@@ -443,7 +437,10 @@ private:
 	boost::shared_ptr<Film> _template_film;
 
 
-	mutable boost::mutex _info_file_mutex;
+	/** mutex for _frame_info_indices */
+	mutable boost::mutex _frame_info_indices_mutex;
+	/** frame info indices which are in use, so that everything that uses one sees the same data */
+	mutable std::map<boost::filesystem::path, boost::weak_ptr<FrameInfoIndex> > _frame_info_indices;
 
 	boost::signals2::scoped_connection _playlist_change_connection;
 	boost::signals2::scoped_connection _playlist_order_changed_connection;
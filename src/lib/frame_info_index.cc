@@ -0,0 +1,353 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/frame_info_index.cc
+ *  @brief FrameInfoIndex class.
+ */
+
+#include "frame_info_index.h"
+#include "cross.h"
+#include "exceptions.h"
+#include "dcpomatic_assert.h"
+#include "dcpomatic_log.h"
+#include "compose.hpp"
+#include <cerrno>
+
+using std::string;
+using std::vector;
+using std::min;
+using std::max;
+using boost::optional;
+
+int const FrameInfoIndex::current_version = 2;
+
+/** Start of the file header, followed by the version and the size of each record as 32-bit integers */
+static char const magic[8] = { 'D', 'O', 'M', 'I', 'N', 'F', 'O', '\0' };
+static size_t const header_size = 16;
+static size_t const record_size = 28;
+/** Size of each record in a file with no header */
+static size_t const legacy_record_size = 48;
+/** Number of changed records that we will hold before we write them to the file */
+static size_t const batch_size = 64;
+
+static int
+hex_digit (char c)
+{
+	if (c >= '0' && c <= '9') {
+		return c - '0';
+	} else if (c >= 'a' && c <= 'f') {
+		return c - 'a' + 10;
+	} else if (c >= 'A' && c <= 'F') {
+		return c - 'A' + 10;
+	}
+
+	return -1;
+}
+
+/** @return true if hex was a valid 32-character MD5 digest */
+static bool
+hash_from_hex (char const * hex, uint8_t* hash)
+{
+	for (int i = 0; i < 16; ++i) {
+		int const a = hex_digit (hex[i * 2]);
+		int const b = hex_digit (hex[i * 2 + 1]);
+		if (a < 0 || b < 0) {
+			return false;
+		}
+		hash[i] = (a << 4) | b;
+	}
+
+	return true;
+}
+
+static string
+hash_to_hex (uint8_t const * hash)
+{
+	char const digits[] = "0123456789abcdef";
+	string hex;
+	for (int i = 0; i < 16; ++i) {
+		hex += digits[hash[i] >> 4];
+		hex += digits[hash[i] & 0xf];
+	}
+	return hex;
+}
+
+/** @param file Index file, which need not exist yet */
+FrameInfoIndex::FrameInfoIndex (boost::filesystem::path file)
+	: _file (file)
+	, _dirty_from (0)
+	, _dirty_to (0)
+{
+	read ();
+}
+
+FrameInfoIndex::~FrameInfoIndex ()
+{
+	try {
+		flush ();
+	} catch (std::exception& e) {
+		LOG_ERROR ("Could not write frame info to %1 (%2)", _file.string(), e.what());
+	}
+}
+
+size_t
+FrameInfoIndex::position (Frame frame, Eyes eyes)
+{
+	switch (eyes) {
+	case EYES_BOTH:
+		return frame;
+	case EYES_LEFT:
+		return frame * 2;
+	case EYES_RIGHT:
+		return frame * 2 + 1;
+	default:
+		DCPOMATIC_ASSERT (false);
+	}
+
+	DCPOMATIC_ASSERT (false);
+}
+
+void
+FrameInfoIndex::read ()
+{
+	boost::system::error_code ec;
+	boost::uintmax_t const length = boost::filesystem::file_size (_file, ec);
+	if (ec || length == 0) {
+		return;
+	}
+
+	FILE* f = fopen_boost (_file, "rb");
+	if (!f) {
+		throw OpenFileError (_file, errno, OpenFileError::READ);
+	}
+
+	vector<uint8_t> data (length);
+	size_t const r = fread (&data[0], 1, length, f);
+	fclose (f);
+	if (r != length) {
+		throw ReadFileError (_file, errno);
+	}
+
+	if (length < header_size || memcmp (&data[0], magic, sizeof (magic)) != 0) {
+		/* This was written by an earlier version; convert it */
+		LOG_GENERAL ("Converting frame info file %1 to version %2", _file.string(), current_version);
+		read_legacy (data);
+		write_all ();
+		return;
+	}
+
+	uint32_t version;
+	uint32_t size;
+	memcpy (&version, &data[8], sizeof (version));
+	memcpy (&size, &data[12], sizeof (size));
+	if (version != static_cast<uint32_t> (current_version) || size != record_size) {
+		/* We don't know how to read this, so start again.  Leave the file alone until we have
+		   something to write, as it may belong to a newer version of DCP-o-matic and we might
+		   not get as far as writing anything.
+		*/
+		LOG_GENERAL ("Ignoring frame info file %1 with version %2 and record size %3", _file.string(), version, size);
+		_unreadable_version = version;
+		return;
+	}
+
+	_records.resize ((length - header_size) / record_size);
+	uint8_t const * p = &data[header_size];
+	for (size_t i = 0; i < _records.size(); ++i) {
+		Record& r = _records[i];
+		memcpy (&r.offset, p, sizeof (r.offset));
+		memcpy (&r.size, p + 8, sizeof (r.size));
+		memcpy (r.hash, p + 12, sizeof (r.hash));
+		p += record_size;
+	}
+}
+
+/** Read the contents of an index file with no header: records of a 64-bit offset,
+ *  64-bit size and a 32-character hex hash.
+ */
+void
+FrameInfoIndex::read_legacy (vector<uint8_t> const & data)
+{
+	_records.resize (data.size() / legacy_record_size);
+	uint8_t const * p = &data[0];
+	for (size_t i = 0; i < _records.size(); ++i) {
+		Record& r = _records[i];
+		int64_t size;
+		memcpy (&r.offset, p, sizeof (r.offset));
+		memcpy (&size, p + 8, sizeof (size));
+		r.size = size;
+		if (!hash_from_hex (reinterpret_cast<char const *> (p + 16), r.hash)) {
+			/* This frame will fail its hash check, which is what we want */
+			memset (r.hash, 0, sizeof (r.hash));
+		}
+		p += legacy_record_size;
+	}
+}
+
+/** @param frame reel-relative frame.
+ *  @return Info for the frame, or none if we have nothing for it.
+ */
+optional<dcp::FrameInfo>
+FrameInfoIndex::get (Frame frame, Eyes eyes) const
+{
+	boost::mutex::scoped_lock lm (_mutex);
+
+	size_t const p = position (frame, eyes);
+	if (p >= _records.size ()) {
+		return optional<dcp::FrameInfo> ();
+	}
+
+	Record const & r = _records[p];
+	return dcp::FrameInfo (r.offset, r.size, hash_to_hex (r.hash));
+}
+
+/** @param frame reel-relative frame */
+void
+FrameInfoIndex::set (Frame frame, Eyes eyes, dcp::FrameInfo const & info)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+
+	size_t const p = position (frame, eyes);
+	if (p >= _records.size ()) {
+		_records.resize (p + 1);
+	}
+
+	Record& r = _records[p];
+	r.offset = info.offset;
+	r.size = info.size;
+	DCPOMATIC_ASSERT (info.hash.length() == 32);
+	if (!hash_from_hex (info.hash.c_str(), r.hash)) {
+		throw ProgrammingError (__FILE__, __LINE__, String::compose ("bad frame hash %1", info.hash));
+	}
+
+	if (_dirty_from == _dirty_to) {
+		_dirty_from = p;
+		_dirty_to = p + 1;
+	} else {
+		_dirty_from = min (_dirty_from, p);
+		_dirty_to = max (_dirty_to, p + 1);
+	}
+
+	if (_dirty_to - _dirty_from >= batch_size) {
+		lm.unlock ();
+		flush ();
+	}
+}
+
+/** Write any changed records to the file */
+void
+FrameInfoIndex::flush ()
+{
+	boost::mutex::scoped_lock lm (_mutex);
+
+	if (_dirty_from == _dirty_to) {
+		return;
+	}
+
+	if (_unreadable_version) {
+		/* Keep the file that we could not read, in case whatever wrote it wants it back */
+		boost::filesystem::path aside = _file;
+		aside += String::compose (".v%1", *_unreadable_version);
+		LOG_GENERAL ("Moving unreadable frame info file %1 to %2", _file.string(), aside.string());
+		boost::filesystem::rename (_file, aside);
+		_unreadable_version = optional<uint32_t> ();
+	}
+
+	boost::system::error_code ec;
+	boost::uintmax_t const length = boost::filesystem::file_size (_file, ec);
+	if (ec || length < header_size) {
+		/* There's no file yet */
+		write_all ();
+		return;
+	}
+
+	FILE* f = fopen_boost (_file, "r+b");
+	if (!f) {
+		throw OpenFileError (_file, errno, OpenFileError::READ_WRITE);
+	}
+
+	if (dcpomatic_fseek (f, header_size + _dirty_from * record_size, SEEK_SET)) {
+		int const e = errno;
+		fclose (f);
+		throw WriteFileError (_file, e);
+	}
+
+	write_records (f, _dirty_from, _dirty_to);
+	fclose (f);
+
+	_dirty_from = _dirty_to = 0;
+}
+
+/** Write the whole index to the file.  This must be called with _mutex held */
+void
+FrameInfoIndex::write_all ()
+{
+	boost::filesystem::path tmp = _file;
+	tmp += ".tmp";
+
+	FILE* f = fopen_boost (tmp, "wb");
+	if (!f) {
+		throw OpenFileError (tmp, errno, OpenFileError::WRITE);
+	}
+
+	uint8_t header[header_size];
+	uint32_t const version = current_version;
+	uint32_t const size = record_size;
+	memcpy (header, magic, sizeof (magic));
+	memcpy (header + 8, &version, sizeof (version));
+	memcpy (header + 12, &size, sizeof (size));
+	if (fwrite (header, sizeof (header), 1, f) != 1) {
+		int const e = errno;
+		fclose (f);
+		throw WriteFileError (tmp, e);
+	}
+
+	write_records (f, 0, _records.size ());
+	fclose (f);
+
+	boost::filesystem::rename (tmp, _file);
+	_dirty_from = _dirty_to = 0;
+}
+
+/** Write some records to a file in one go, closing the file if there is an error.
+ *  This must be called with _mutex held.
+ */
+void
+FrameInfoIndex::write_records (FILE* f, size_t from, size_t to) const
+{
+	if (from == to) {
+		return;
+	}
+
+	vector<uint8_t> data ((to - from) * record_size);
+	uint8_t* p = &data[0];
+	for (size_t i = from; i < to; ++i) {
+		Record const & r = _records[i];
+		memcpy (p, &r.offset, sizeof (r.offset));
+		memcpy (p + 8, &r.size, sizeof (r.size));
+		memcpy (p + 12, r.hash, sizeof (r.hash));
+		p += record_size;
+	}
+
+	if (fwrite (&data[0], data.size(), 1, f) != 1) {
+		int const e = errno;
+		fclose (f);
+		throw WriteFileError (_file, e);
+	}
+}
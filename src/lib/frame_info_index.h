@@ -0,0 +1,105 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef DCPOMATIC_FRAME_INFO_INDEX_H
+#define DCPOMATIC_FRAME_INFO_INDEX_H
+
+/** @file  src/lib/frame_info_index.h
+ *  @brief FrameInfoIndex class.
+ */
+
+#include "types.h"
+#include <dcp/picture_asset_writer.h>
+#include <boost/filesystem.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/optional.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/cstdint.hpp>
+#include <vector>
+#include <cstring>
+
+/** @class FrameInfoIndex
+ *  @brief The dcp::FrameInfo of each frame of a picture asset that we have written.
+ *
+ *  This is kept in a file alongside the asset so that a later encode can tell which
+ *  frames of the asset are usable.  The whole index is held in memory; changes are
+ *  written to the file in batches, and when flush() is called.
+ *
+ *  The file starts with a header giving its version.  Files written by earlier versions
+ *  of DCP-o-matic have no header and 48-byte records; these are converted when they
+ *  are opened.
+ */
+class FrameInfoIndex : public boost::noncopyable
+{
+public:
+	explicit FrameInfoIndex (boost::filesystem::path file);
+	~FrameInfoIndex ();
+
+	boost::optional<dcp::FrameInfo> get (Frame frame, Eyes eyes) const;
+	void set (Frame frame, Eyes eyes, dcp::FrameInfo const & info);
+	void flush ();
+
+	/** @return Number of records in the index; for 3D this counts left and right eyes separately */
+	int size () const {
+		boost::mutex::scoped_lock lm (_mutex);
+		return _records.size ();
+	}
+
+	boost::filesystem::path file () const {
+		return _file;
+	}
+
+	static int const current_version;
+
+private:
+	struct Record
+	{
+		Record ()
+			: offset (0)
+			, size (0)
+		{
+			memset (hash, 0, sizeof (hash));
+		}
+
+		uint64_t offset;
+		uint32_t size;
+		/** MD5 digest, as bytes rather than hex */
+		uint8_t hash[16];
+	};
+
+	static size_t position (Frame frame, Eyes eyes);
+	void read ();
+	void read_legacy (std::vector<uint8_t> const & data);
+	void write_all ();
+	void write_records (FILE* f, size_t from, size_t to) const;
+
+	boost::filesystem::path _file;
+	/** mutex for everything below */
+	mutable boost::mutex _mutex;
+	std::vector<Record> _records;
+	/** first record which has changed since it was last written to the file */
+	size_t _dirty_from;
+	/** record after the last one which has changed since it was last written to the file */
+	size_t _dirty_to;
+	/** version of _file if it is one that we cannot read; it is moved aside when we first flush */
+	boost::optional<uint32_t> _unreadable_version;
+};
+
+#endif
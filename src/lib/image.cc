@@ -29,6 +29,10 @@
 #include "util.h"
 #include "compose.hpp"
 #include "dcpomatic_socket.h"
+#include "digester.h"
+#include "buffer_pool.h"
+#include "sws_context_cache.h"
+#include "image_kernels.h"
 #include <dcp/rgb_xyz.h>
 #include <dcp/transfer_function.h>
 extern "C" {
@@ -38,6 +42,7 @@ extern "C" {
 #include <libavutil/frame.h>
 }
 #include <png.h>
+#include <boost/scoped_array.hpp>
 #if HAVE_VALGRIND_MEMCHECK_H
 #include <valgrind/memcheck.h>
 #endif
@@ -51,8 +56,8 @@ using std::max;
 using std::cout;
 using std::cerr;
 using std::list;
-using std::runtime_error;
 using boost::shared_ptr;
+using boost::scoped_array;
 using dcp::Size;
 
 int
@@ -141,45 +146,12 @@ Image::crop_scale_window (
 	DCPOMATIC_ASSERT (out_size.height >= inter_size.height);
 
 	shared_ptr<Image> out (new Image(out_format, out_size, out_aligned));
-	out->make_black ();
 
 	/* Size of the image after any crop */
 	dcp::Size const cropped_size = crop.apply (size ());
 
-	/* Scale context for a scale from cropped_size to inter_size */
-	struct SwsContext* scale_context = sws_getContext (
-			cropped_size.width, cropped_size.height, pixel_format(),
-			inter_size.width, inter_size.height, out_format,
-			fast ? SWS_FAST_BILINEAR : SWS_BICUBIC, 0, 0, 0
-		);
-
-	if (!scale_context) {
-		throw runtime_error (N_("Could not allocate SwsContext"));
-	}
-
-	DCPOMATIC_ASSERT (yuv_to_rgb < dcp::YUV_TO_RGB_COUNT);
-	int const lut[dcp::YUV_TO_RGB_COUNT] = {
-		SWS_CS_ITU601,
-		SWS_CS_ITU709
-	};
-
-	/* The 3rd parameter here is:
-	   0 -> source range MPEG (i.e. "video", 16-235)
-	   1 -> source range JPEG (i.e. "full", 0-255)
-	   And the 5th:
-	   0 -> destination range MPEG (i.e. "video", 16-235)
-	   1 -> destination range JPEG (i.e. "full", 0-255)
-
-	   But remember: sws_setColorspaceDetails ignores
-	   these parameters unless the image isYUV or isGray
-	   (if it's neither, it uses video range for source
-	   and destination).
-	*/
-	sws_setColorspaceDetails (
-		scale_context,
-		sws_getCoefficients (lut[yuv_to_rgb]), 0,
-		sws_getCoefficients (lut[yuv_to_rgb]), 0,
-		0, 1 << 16, 1 << 16
+	ScopedSwsContext scale_context (
+		SwsContextCache::Key (cropped_size, pixel_format(), inter_size, out_format, fast ? SWS_FAST_BILINEAR : SWS_BICUBIC, yuv_to_rgb)
 		);
 
 	AVPixFmtDescriptor const * in_desc = av_pix_fmt_desc_get (_pixel_format);
@@ -202,6 +174,9 @@ Image::crop_scale_window (
 	/* Corner of the image within out_size */
 	Position<int> const corner ((out_size.width - inter_size.width) / 2, (out_size.height - inter_size.height) / 2);
 
+	/* sws_scale() will fill in the middle, so we only need to blacken the rest */
+	out->make_black_outside (corner, inter_size);
+
 	AVPixFmtDescriptor const * out_desc = av_pix_fmt_desc_get (out_format);
 	if (!out_desc) {
 		throw PixelFormatError ("crop_scale_window()", out_format);
@@ -215,14 +190,12 @@ Image::crop_scale_window (
 	}
 
 	sws_scale (
-		scale_context,
+		scale_context.get(),
 		scale_in_data, stride(),
 		0, cropped_size.height,
 		scale_out_data, out->stride()
 		);
 
-	sws_freeContext (scale_context);
-
 	if (crop != Crop() && cropped_size == inter_size && _pixel_format == out_format) {
 		/* We are cropping without any scaling or pixel format conversion, so FFmpeg may have left some
 		   data behind in our image.  Clear it out.  It may get to the point where we should just stop
@@ -257,46 +230,19 @@ Image::scale (dcp::Size out_size, dcp::YUVToRGB yuv_to_rgb, AVPixelFormat out_fo
 
 	shared_ptr<Image> scaled (new Image (out_format, out_size, out_aligned));
 
-	struct SwsContext* scale_context = sws_getContext (
-		size().width, size().height, pixel_format(),
-		out_size.width, out_size.height, out_format,
-		(fast ? SWS_FAST_BILINEAR : SWS_BICUBIC) | SWS_ACCURATE_RND, 0, 0, 0
-		);
-
-	DCPOMATIC_ASSERT (yuv_to_rgb < dcp::YUV_TO_RGB_COUNT);
-	int const lut[dcp::YUV_TO_RGB_COUNT] = {
-		SWS_CS_ITU601,
-		SWS_CS_ITU709
-	};
-
-	/* The 3rd parameter here is:
-	   0 -> source range MPEG (i.e. "video", 16-235)
-	   1 -> source range JPEG (i.e. "full", 0-255)
-	   And the 5th:
-	   0 -> destination range MPEG (i.e. "video", 16-235)
-	   1 -> destination range JPEG (i.e. "full", 0-255)
-
-	   But remember: sws_setColorspaceDetails ignores
-	   these parameters unless the image isYUV or isGray
-	   (if it's neither, it uses video range for source
-	   and destination).
-	*/
-	sws_setColorspaceDetails (
-		scale_context,
-		sws_getCoefficients (lut[yuv_to_rgb]), 0,
-		sws_getCoefficients (lut[yuv_to_rgb]), 0,
-		0, 1 << 16, 1 << 16
+	ScopedSwsContext scale_context (
+		SwsContextCache::Key (
+			size(), pixel_format(), out_size, out_format, (fast ? SWS_FAST_BILINEAR : SWS_BICUBIC) | SWS_ACCURATE_RND, yuv_to_rgb
+			)
 		);
 
 	sws_scale (
-		scale_context,
+		scale_context.get(),
 		data(), stride(),
 		0, size().height,
 		scaled->data(), scaled->stride()
 		);
 
-	sws_freeContext (scale_context);
-
 	return scaled;
 }
 
@@ -304,15 +250,15 @@ Image::scale (dcp::Size out_size, dcp::YUVToRGB yuv_to_rgb, AVPixelFormat out_fo
 void
 Image::yuv_16_black (uint16_t v, bool alpha)
 {
+	ImageKernels const * kernels = ImageKernels::best ();
+
 	memset (data()[0], 0, sample_size(0).height * stride()[0]);
 	for (int i = 1; i < 3; ++i) {
-		int16_t* p = reinterpret_cast<int16_t*> (data()[i]);
+		uint16_t* p = reinterpret_cast<uint16_t*> (data()[i]);
 		int const lines = sample_size(i).height;
 		for (int y = 0; y < lines; ++y) {
 			/* We divide by 2 here because we are writing 2 bytes at a time */
-			for (int x = 0; x < line_size()[i] / 2; ++x) {
-				p[x] = v;
-			}
+			kernels->fill_16 (p, line_size()[i] / 2, v);
 			p += stride()[i] / 2;
 		}
 	}
@@ -331,6 +277,8 @@ Image::swap_16 (uint16_t v)
 void
 Image::make_part_black (int x, int w)
 {
+	make_writable ();
+
 	switch (_pixel_format) {
 	case AV_PIX_FMT_RGB24:
 	case AV_PIX_FMT_ARGB:
@@ -361,6 +309,8 @@ Image::make_part_black (int x, int w)
 void
 Image::make_black ()
 {
+	make_writable ();
+
 	/* U/V black value for 8-bit colour */
 	static uint8_t const eight_bit_uv =	(1 << 7) - 1;
 	/* U/V black value for 9-bit colour */
@@ -482,9 +432,56 @@ Image::make_black ()
 	}
 }
 
+/** Make the part of this image outside a rectangle black.  Lines or columns at the edges of the
+ *  rectangle may be blackened too, if they are shared with the outside by sub-sampling.
+ *  @param corner Top-left corner of the rectangle.
+ *  @param inside Size of the rectangle.
+ */
+void
+Image::make_black_outside (Position<int> corner, dcp::Size inside)
+{
+	if (corner.x == 0 && corner.y == 0 && inside == size()) {
+		return;
+	}
+
+	make_writable ();
+
+	AVPixFmtDescriptor const * d = av_pix_fmt_desc_get (_pixel_format);
+	if (!d) {
+		throw PixelFormatError ("make_black_outside()", _pixel_format);
+	}
+
+	/* A black image with our line sizes, and enough lines to have at least one of each component, to copy from */
+	Image black (_pixel_format, dcp::Size (size().width, 1 << d->log2_chroma_h), false);
+	black.make_black ();
+
+	for (int c = 0; c < planes(); ++c) {
+		int const lines = sample_size(c).height;
+		int const top = corner.y / vertical_factor(c);
+		int const bottom = min (lines, top + inside.height / vertical_factor(c));
+		/* Work out the horizontal extent in the same way as crop_scale_window() */
+		int const left = lrintf (bytes_per_pixel(c) * corner.x) & ~ ((int) d->log2_chroma_w);
+		int const right = min (line_size()[c], left + static_cast<int> (bytes_per_pixel(c) * inside.width));
+
+		uint8_t* p = data()[c];
+		uint8_t const * q = black.data()[c];
+		for (int y = 0; y < lines; ++y) {
+			if (y < top || y >= bottom) {
+				memcpy (p, q, line_size()[c]);
+			} else {
+				memcpy (p, q, left);
+				memcpy (p + right, q + right, line_size()[c] - right);
+			}
+			p += stride()[c];
+		}
+	}
+}
+
 void
 Image::make_transparent ()
 {
+	make_writable ();
+
 	if (_pixel_format != AV_PIX_FMT_BGRA && _pixel_format != AV_PIX_FMT_RGBA) {
 		throw PixelFormatError ("make_transparent()", _pixel_format);
 	}
@@ -495,6 +492,8 @@ Image::make_transparent ()
 void
 Image::alpha_blend (shared_ptr<const Image> other, Position<int> position)
 {
+	make_writable ();
+
 	/* We're blending RGBA or BGRA images */
 	DCPOMATIC_ASSERT (other->pixel_format() == AV_PIX_FMT_BGRA || other->pixel_format() == AV_PIX_FMT_RGBA);
 	int const blue = other->pixel_format() == AV_PIX_FMT_BGRA ? 0 : 2;
@@ -518,6 +517,10 @@ Image::alpha_blend (shared_ptr<const Image> other, Position<int> position)
 		start_ty = 0;
 	}
 
+	ImageKernels const * kernels = ImageKernels::best ();
+	/* Number of pixels of each line that overlap */
+	int const width = min (size().width - start_tx, other->size().width - start_ox);
+
 	switch (_pixel_format) {
 	case AV_PIX_FMT_RGB24:
 	{
@@ -525,16 +528,8 @@ Image::alpha_blend (shared_ptr<const Image> other, Position<int> position)
 		int const this_bpp = 3;
 		for (int ty = start_ty, oy = start_oy; ty < size().height && oy < other->size().height; ++ty, ++oy) {
 			uint8_t* tp = data()[0] + ty * stride()[0] + start_tx * this_bpp;
-			uint8_t* op = other->data()[0] + oy * other->stride()[0];
-			for (int tx = start_tx, ox = start_ox; tx < size().width && ox < other->size().width; ++tx, ++ox) {
-				float const alpha = float (op[3]) / 255;
-				tp[0] = op[red] * alpha + tp[0] * (1 - alpha);
-				tp[1] = op[1] * alpha + tp[1] * (1 - alpha);
-				tp[2] = op[blue] * alpha + tp[2] * (1 - alpha);
-
-				tp += this_bpp;
-				op += other_bpp;
-			}
+			uint8_t* op = other->data()[0] + oy * other->stride()[0] + start_ox * other_bpp;
+			kernels->alpha_blend_24 (tp, op, width, red == 2);
 		}
 		break;
 	}
@@ -543,17 +538,8 @@ Image::alpha_blend (shared_ptr<const Image> other, Position<int> position)
 		int const this_bpp = 4;
 		for (int ty = start_ty, oy = start_oy; ty < size().height && oy < other->size().height; ++ty, ++oy) {
 			uint8_t* tp = data()[0] + ty * stride()[0] + start_tx * this_bpp;
-			uint8_t* op = other->data()[0] + oy * other->stride()[0];
-			for (int tx = start_tx, ox = start_ox; tx < size().width && ox < other->size().width; ++tx, ++ox) {
-				float const alpha = float (op[3]) / 255;
-				tp[0] = op[blue] * alpha + tp[0] * (1 - alpha);
-				tp[1] = op[1] * alpha + tp[1] * (1 - alpha);
-				tp[2] = op[red] * alpha + tp[2] * (1 - alpha);
-				tp[3] = op[3] * alpha + tp[3] * (1 - alpha);
-
-				tp += this_bpp;
-				op += other_bpp;
-			}
+			uint8_t* op = other->data()[0] + oy * other->stride()[0] + start_ox * other_bpp;
+			kernels->alpha_blend_32 (tp, op, width, blue == 2);
 		}
 		break;
 	}
@@ -562,17 +548,8 @@ Image::alpha_blend (shared_ptr<const Image> other, Position<int> position)
 		int const this_bpp = 4;
 		for (int ty = start_ty, oy = start_oy; ty < size().height && oy < other->size().height; ++ty, ++oy) {
 			uint8_t* tp = data()[0] + ty * stride()[0] + start_tx * this_bpp;
-			uint8_t* op = other->data()[0] + oy * other->stride()[0];
-			for (int tx = start_tx, ox = start_ox; tx < size().width && ox < other->size().width; ++tx, ++ox) {
-				float const alpha = float (op[3]) / 255;
-				tp[0] = op[red] * alpha + tp[0] * (1 - alpha);
-				tp[1] = op[1] * alpha + tp[1] * (1 - alpha);
-				tp[2] = op[blue] * alpha + tp[2] * (1 - alpha);
-				tp[3] = op[3] * alpha + tp[3] * (1 - alpha);
-
-				tp += this_bpp;
-				op += other_bpp;
-			}
+			uint8_t* op = other->data()[0] + oy * other->stride()[0] + start_ox * other_bpp;
+			kernels->alpha_blend_32 (tp, op, width, red == 2);
 		}
 		break;
 	}
@@ -581,17 +558,8 @@ Image::alpha_blend (shared_ptr<const Image> other, Position<int> position)
 		int const this_bpp = 6;
 		for (int ty = start_ty, oy = start_oy; ty < size().height && oy < other->size().height; ++ty, ++oy) {
 			uint8_t* tp = data()[0] + ty * stride()[0] + start_tx * this_bpp;
-			uint8_t* op = other->data()[0] + oy * other->stride()[0];
-			for (int tx = start_tx, ox = start_ox; tx < size().width && ox < other->size().width; ++tx, ++ox) {
-				float const alpha = float (op[3]) / 255;
-				/* Blend high bytes */
-				tp[1] = op[red] * alpha + tp[1] * (1 - alpha);
-				tp[3] = op[1] * alpha + tp[3] * (1 - alpha);
-				tp[5] = op[blue] * alpha + tp[5] * (1 - alpha);
-
-				tp += this_bpp;
-				op += other_bpp;
-			}
+			uint8_t* op = other->data()[0] + oy * other->stride()[0] + start_ox * other_bpp;
+			kernels->alpha_blend_48 (tp, op, width, red == 2);
 		}
 		break;
 	}
@@ -741,6 +709,8 @@ Image::alpha_blend (shared_ptr<const Image> other, Position<int> position)
 void
 Image::copy (shared_ptr<const Image> other, Position<int> position)
 {
+	make_writable ();
+
 	/* Only implemented for RGB24 onto RGB24 so far */
 	DCPOMATIC_ASSERT (_pixel_format == AV_PIX_FMT_RGB24 && other->pixel_format() == AV_PIX_FMT_RGB24);
 	DCPOMATIC_ASSERT (position.x >= 0 && position.y >= 0);
@@ -753,29 +723,94 @@ Image::copy (shared_ptr<const Image> other, Position<int> position)
 	}
 }
 
+/** @param c Component index.
+ *  @return Distance in bytes between corresponding samples of adjacent pixels in a line
+ *  of component c; this is used to filter image data before it is compressed.
+ */
+int
+Image::delta_distance (int c) const
+{
+	return max (1, static_cast<int> (lrintf (bytes_per_pixel(c) * horizontal_factor(c))));
+}
+
+/** Read image data from a socket.
+ *  @param socket Socket to read from.
+ *  @param compression Compression that was passed to write_to_socket() by the sender.
+ */
 void
-Image::read_from_socket (shared_ptr<Socket> socket)
+Image::read_from_socket (shared_ptr<Socket> socket, TransportCompression compression)
 {
+	make_writable ();
+
+	if (compression == TRANSPORT_COMPRESSION_NONE) {
+		for (int i = 0; i < planes(); ++i) {
+			uint8_t* p = data()[i];
+			int const lines = sample_size(i).height;
+			for (int y = 0; y < lines; ++y) {
+				socket->read (p, line_size()[i]);
+				p += stride()[i];
+			}
+		}
+		return;
+	}
+
 	for (int i = 0; i < planes(); ++i) {
-		uint8_t* p = data()[i];
 		int const lines = sample_size(i).height;
+		int const ls = line_size()[i];
+		scoped_array<uint8_t> buffer (new uint8_t[ls * lines]);
+		socket->read_block (buffer.get(), ls * lines, compression);
+
+		/* Undo the filter that write_to_socket() applied */
+		int const d = delta_distance (i);
+		uint8_t* p = data()[i];
+		uint8_t const * q = buffer.get();
 		for (int y = 0; y < lines; ++y) {
-			socket->read (p, line_size()[i]);
+			memcpy (p, q, min (d, ls));
+			for (int x = d; x < ls; ++x) {
+				p[x] = q[x] + p[x - d];
+			}
 			p += stride()[i];
+			q += ls;
 		}
 	}
 }
 
+/** Write image data to a socket.
+ *  @param socket Socket to write to.
+ *  @param compression Compression to use; the data are filtered so that each byte is replaced
+ *  by its difference from the same byte in the previous pixel, then compressed.
+ */
 void
-Image::write_to_socket (shared_ptr<Socket> socket) const
+Image::write_to_socket (shared_ptr<Socket> socket, TransportCompression compression) const
 {
+	if (compression == TRANSPORT_COMPRESSION_NONE) {
+		for (int i = 0; i < planes(); ++i) {
+			uint8_t* p = data()[i];
+			int const lines = sample_size(i).height;
+			for (int y = 0; y < lines; ++y) {
+				socket->write (p, line_size()[i]);
+				p += stride()[i];
+			}
+		}
+		return;
+	}
+
 	for (int i = 0; i < planes(); ++i) {
-		uint8_t* p = data()[i];
 		int const lines = sample_size(i).height;
+		int const ls = line_size()[i];
+		int const d = delta_distance (i);
+		scoped_array<uint8_t> buffer (new uint8_t[ls * lines]);
+		uint8_t const * p = data()[i];
+		uint8_t* q = buffer.get();
 		for (int y = 0; y < lines; ++y) {
-			socket->write (p, line_size()[i]);
+			memcpy (q, p, min (d, ls));
+			for (int x = d; x < ls; ++x) {
+				q[x] = p[x] - p[x - d];
+			}
 			p += stride()[i];
+			q += ls;
 		}
+		socket->write_block (buffer.get(), ls * lines, compression);
 	}
 }
 
@@ -835,25 +870,44 @@ Image::bytes_per_pixel (int c) const
 Image::Image (AVPixelFormat p, dcp::Size s, bool aligned)
 	: _size (s)
 	, _pixel_format (p)
+	, _frame (0)
 	, _aligned (aligned)
 {
 	allocate ();
 }
 
+/** Clear our plane pointers and strides, and fill in the line sizes */
 void
-Image::allocate ()
+Image::setup_line_sizes ()
 {
-	_data = (uint8_t **) wrapped_av_malloc (4 * sizeof (uint8_t *));
 	_data[0] = _data[1] = _data[2] = _data[3] = 0;
-
-	_line_size = (int *) wrapped_av_malloc (4 * sizeof (int));
 	_line_size[0] = _line_size[1] = _line_size[2] = _line_size[3] = 0;
-
-	_stride = (int *) wrapped_av_malloc (4 * sizeof (int));
 	_stride[0] = _stride[1] = _stride[2] = _stride[3] = 0;
 
 	for (int i = 0; i < planes(); ++i) {
 		_line_size[i] = ceil (_size.width * bytes_per_pixel(i));
+	}
+}
+
+void
+Image::allocate ()
+{
+	setup_line_sizes ();
+	allocate_planes ();
+}
+
+/** @return Number of bytes to allocate for a plane, given its stride; see allocate_planes() */
+size_t
+Image::plane_allocation (int plane) const
+{
+	return _stride[plane] * (sample_size(plane).height + 1) + 32;
+}
+
+/** Allocate memory for each of our planes from the BufferPool; setup_line_sizes() must have been called first */
+void
+Image::allocate_planes ()
+{
+	for (int i = 0; i < planes(); ++i) {
 		_stride[i] = stride_round_up (i, _line_size, _aligned ? 32 : 1);
 
 		/* The assembler function ff_rgb24ToY_avx (in libswscale/x86/input.asm)
@@ -893,12 +947,12 @@ Image::allocate ()
 		   |XXXwrittenXXX|<------line-size------------->|XXXwrittenXXXXXXwrittenXXX
 		                                                               ^^^^ out of bounds
 		*/
-		_data[i] = (uint8_t *) wrapped_av_malloc (_stride[i] * (sample_size(i).height + 1) + 32);
+		_data[i] = static_cast<uint8_t*> (BufferPool::instance()->get(plane_allocation(i)));
 #if HAVE_VALGRIND_MEMCHECK_H
 		/* The data between the end of the line size and the stride is undefined but processed by
 		   libswscale, causing lots of valgrind errors.  Mark it all defined to quell these errors.
 		*/
-		VALGRIND_MAKE_MEM_DEFINED (_data[i], _stride[i] * (sample_size(i).height + 1) + 32);
+		VALGRIND_MAKE_MEM_DEFINED (_data[i], plane_allocation(i));
 #endif
 	}
 }
@@ -907,6 +961,7 @@ Image::Image (Image const & other)
 	: boost::enable_shared_from_this<Image>(other)
 	, _size (other._size)
 	, _pixel_format (other._pixel_format)
+	, _frame (0)
 	, _aligned (other._aligned)
 {
 	allocate ();
@@ -923,12 +978,33 @@ Image::Image (Image const & other)
 	}
 }
 
+/** Construct an Image from an FFmpeg frame.  If the frame's buffers are reference-counted
+ *  and laid out as allocate() would have done it we take a reference to them rather than
+ *  copying the data; otherwise the data are copied.  Either way the caller remains responsible
+ *  for the frame that is passed in.
+ */
 Image::Image (AVFrame* frame)
 	: _size (frame->width, frame->height)
 	, _pixel_format (static_cast<AVPixelFormat> (frame->format))
+	, _frame (0)
 	, _aligned (true)
 {
-	allocate ();
+	setup_line_sizes ();
+
+	if (can_wrap (frame)) {
+		_frame = av_frame_clone (frame);
+	}
+
+	if (_frame) {
+		for (int i = 0; i < planes(); ++i) {
+			_data[i] = _frame->data[i];
+			/* AVFrame's linesize is what we call `stride' */
+			_stride[i] = _frame->linesize[i];
+		}
+		return;
+	}
+
+	allocate_planes ();
 
 	for (int i = 0; i < planes(); ++i) {
 		uint8_t* p = _data[i];
@@ -946,6 +1022,7 @@ Image::Image (AVFrame* frame)
 Image::Image (shared_ptr<const Image> other, bool aligned)
 	: _size (other->_size)
 	, _pixel_format (other->_pixel_format)
+	, _frame (0)
 	, _aligned (aligned)
 {
 	allocate ();
@@ -987,19 +1064,72 @@ Image::swap (Image & other)
 		std::swap (_stride[i], other._stride[i]);
 	}
 
+	std::swap (_frame, other._frame);
 	std::swap (_aligned, other._aligned);
 }
 
-/** Destroy a Image */
-Image::~Image ()
+/** @return true if we can use the data in `frame' directly, without copying it; this means
+ *  that the frame must be reference-counted, and that each of its planes must be aligned,
+ *  padded and over-allocated in the same way that allocate() would have done.
+ */
+bool
+Image::can_wrap (AVFrame const * frame) const
 {
+	if (!frame->buf[0] || _pixel_format == AV_PIX_FMT_PAL8) {
+		return false;
+	}
+
+	AVPixFmtDescriptor const * d = av_pix_fmt_desc_get(_pixel_format);
+	if (!d || (d->flags & AV_PIX_FMT_FLAG_HWACCEL)) {
+		return false;
+	}
+
 	for (int i = 0; i < planes(); ++i) {
-		av_free (_data[i]);
+		uint8_t const * data = frame->data[i];
+		int const stride = frame->linesize[i];
+		if (!data || stride < _line_size[i] || (stride % 32) != 0 || (reinterpret_cast<uintptr_t> (data) % 32) != 0) {
+			return false;
+		}
+
+		/* See the comment in allocate_planes() for why we need an extra line and 32 bytes at the end of each plane */
+		AVBufferRef* buffer = av_frame_get_plane_buffer (const_cast<AVFrame*> (frame), i);
+		if (!buffer || data < buffer->data) {
+			return false;
+		}
+		int64_t const needed = (data - buffer->data) + static_cast<int64_t> (stride) * (sample_size(i).height + 1) + 32;
+		if (needed > static_cast<int64_t> (buffer->size)) {
+			return false;
+		}
 	}
 
-	av_free (_data);
-	av_free (_line_size);
-	av_free (_stride);
+	return true;
+}
+
+/** Make sure that we can write to our data without affecting anybody else; if we are
+ *  referencing a frame that is still in use elsewhere (e.g. as a reference picture in a
+ *  decoder) we take a private copy of it first.
+ */
+void
+Image::make_writable ()
+{
+	if (!_frame || av_frame_is_writable (_frame)) {
+		return;
+	}
+
+	Image tmp (*this);
+	swap (tmp);
+}
+
+/** Destroy a Image */
+Image::~Image ()
+{
+	if (_frame) {
+		av_frame_free (&_frame);
+	} else {
+		for (int i = 0; i < planes(); ++i) {
+			BufferPool::instance()->put (_data[i], plane_allocation(i));
+		}
+	}
 }
 
 uint8_t * const *
@@ -1091,11 +1221,15 @@ operator== (Image const & a, Image const & b)
 void
 Image::fade (float f)
 {
+	make_writable ();
+
 	/* U/V black value for 8-bit colour */
 	static int const eight_bit_uv =    (1 << 7) - 1;
 	/* U/V black value for 10-bit colour */
 	static uint16_t const ten_bit_uv = (1 << 9) - 1;
 
+	ImageKernels const * kernels = ImageKernels::best ();
+
 	switch (_pixel_format) {
 	case AV_PIX_FMT_YUV420P:
 	{
@@ -1103,11 +1237,7 @@ Image::fade (float f)
 		uint8_t* p = data()[0];
 		int const lines = sample_size(0).height;
 		for (int y = 0; y < lines; ++y) {
-			uint8_t* q = p;
-			for (int x = 0; x < line_size()[0]; ++x) {
-				*q = int(float(*q) * f);
-				++q;
-			}
+			kernels->fade_8 (p, line_size()[0], f, 0);
 			p += stride()[0];
 		}
 
@@ -1116,11 +1246,7 @@ Image::fade (float f)
 			uint8_t* p = data()[c];
 			int const lines = sample_size(c).height;
 			for (int y = 0; y < lines; ++y) {
-				uint8_t* q = p;
-				for (int x = 0; x < line_size()[c]; ++x) {
-					*q = eight_bit_uv + int((int(*q) - eight_bit_uv) * f);
-					++q;
-				}
+				kernels->fade_8 (p, line_size()[c], f, eight_bit_uv);
 				p += stride()[c];
 			}
 		}
@@ -1134,11 +1260,7 @@ Image::fade (float f)
 		uint8_t* p = data()[0];
 		int const lines = sample_size(0).height;
 		for (int y = 0; y < lines; ++y) {
-			uint8_t* q = p;
-			for (int x = 0; x < line_size()[0]; ++x) {
-				*q = int (float (*q) * f);
-				++q;
-			}
+			kernels->fade_8 (p, line_size()[0], f, 0);
 			p += stride()[0];
 		}
 		break;
@@ -1153,11 +1275,7 @@ Image::fade (float f)
 			uint16_t* p = reinterpret_cast<uint16_t*> (data()[c]);
 			int const lines = sample_size(c).height;
 			for (int y = 0; y < lines; ++y) {
-				uint16_t* q = p;
-				for (int x = 0; x < line_size_pixels; ++x) {
-					*q = int (float (*q) * f);
-					++q;
-				}
+				kernels->fade_16 (p, line_size_pixels, f, 0);
 				p += stride_pixels;
 			}
 		}
@@ -1172,11 +1290,7 @@ Image::fade (float f)
 			uint16_t* p = reinterpret_cast<uint16_t*> (data()[0]);
 			int const lines = sample_size(0).height;
 			for (int y = 0; y < lines; ++y) {
-				uint16_t* q = p;
-				for (int x = 0; x < line_size_pixels; ++x) {
-					*q = int(float(*q) * f);
-					++q;
-				}
+				kernels->fade_16 (p, line_size_pixels, f, 0);
 				p += stride_pixels;
 			}
 		}
@@ -1188,11 +1302,7 @@ Image::fade (float f)
 			uint16_t* p = reinterpret_cast<uint16_t*> (data()[c]);
 			int const lines = sample_size(c).height;
 			for (int y = 0; y < lines; ++y) {
-				uint16_t* q = p;
-				for (int x = 0; x < line_size_pixels; ++x) {
-					*q = ten_bit_uv + int((int(*q) - ten_bit_uv) * f);
-					++q;
-				}
+				kernels->fade_16 (p, line_size_pixels, f, ten_bit_uv);
 				p += stride_pixels;
 			}
 		}
@@ -1225,6 +1335,24 @@ Image::memory_used () const
 	return m;
 }
 
+/** Add our format, size and pixel data (but not any padding) to a Digester */
+void
+Image::add_digest (Digester& digester) const
+{
+	digester.add (static_cast<int> (_pixel_format));
+	digester.add (_size.width);
+	digester.add (_size.height);
+
+	for (int i = 0; i < planes(); ++i) {
+		uint8_t* p = _data[i];
+		int const lines = sample_size(i).height;
+		for (int y = 0; y < lines; ++y) {
+			digester.add (p, _line_size[i]);
+			p += _stride[i];
+		}
+	}
+}
+
 class Memory
 {
 public:
@@ -37,6 +37,7 @@ extern "C" {
 
 struct AVFrame;
 class Socket;
+class Digester;
 
 class Image : public boost::enable_shared_from_this<Image>
 {
@@ -72,14 +73,15 @@ public:
 	void copy (boost::shared_ptr<const Image> image, Position<int> pos);
 	void fade (float);
 
-	void read_from_socket (boost::shared_ptr<Socket>);
-	void write_to_socket (boost::shared_ptr<Socket>) const;
+	void read_from_socket (boost::shared_ptr<Socket>, TransportCompression compression = TRANSPORT_COMPRESSION_NONE);
+	void write_to_socket (boost::shared_ptr<Socket>, TransportCompression compression = TRANSPORT_COMPRESSION_NONE) const;
 
 	AVPixelFormat pixel_format () const {
 		return _pixel_format;
 	}
 
 	size_t memory_used () const;
+	void add_digest (Digester& digester) const;
 
 	dcp::Data as_png () const;
 
@@ -90,17 +92,26 @@ public:
 private:
 	friend struct pixel_formats_test;
 
+	void setup_line_sizes ();
 	void allocate ();
+	void allocate_planes ();
+	size_t plane_allocation (int) const;
+	bool can_wrap (AVFrame const * frame) const;
+	void make_writable ();
 	void swap (Image &);
+	int delta_distance (int c) const;
 	void make_part_black (int x, int w);
+	void make_black_outside (Position<int> corner, dcp::Size inside);
 	void yuv_16_black (uint16_t, bool);
 	static uint16_t swap_16 (uint16_t);
 
 	dcp::Size _size;
 	AVPixelFormat _pixel_format; ///< FFmpeg's way of describing the pixel format of this Image
-	uint8_t** _data; ///< array of pointers to components
-	int* _line_size; ///< array of sizes of the data in each line, in bytes (without any alignment padding bytes)
-	int* _stride; ///< array of strides for each line, in bytes (including any alignment padding bytes)
+	uint8_t* _data[4]; ///< array of pointers to components
+	int _line_size[4]; ///< array of sizes of the data in each line, in bytes (without any alignment padding bytes)
+	int _stride[4]; ///< array of strides for each line, in bytes (including any alignment padding bytes)
+	/** FFmpeg frame whose buffers _data points into, or 0 if _data is our own allocation */
+	AVFrame* _frame;
 	bool _aligned;
 };
 
@@ -0,0 +1,139 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/image_kernels.cc
+ *  @brief ImageKernels struct.
+ *
+ *  The plain versions are written in the same way as the loops in Image that they replaced,
+ *  and the others do the same arithmetic in the same order (and without fused multiply-adds)
+ *  so that the results are identical.
+ */
+
+#include "image_kernels.h"
+
+using std::vector;
+
+void
+fade_8_plain (uint8_t* p, int n, float f, int centre)
+{
+	for (int i = 0; i < n; ++i) {
+		p[i] = centre + int((int(p[i]) - centre) * f);
+	}
+}
+
+void
+fade_16_plain (uint16_t* p, int n, float f, int centre)
+{
+	for (int i = 0; i < n; ++i) {
+		p[i] = centre + int((int(p[i]) - centre) * f);
+	}
+}
+
+void
+fill_16_plain (uint16_t* p, int n, uint16_t v)
+{
+	for (int i = 0; i < n; ++i) {
+		p[i] = v;
+	}
+}
+
+void
+alpha_blend_32_plain (uint8_t* p, uint8_t const * other, int n, bool swap)
+{
+	int const first = swap ? 2 : 0;
+	int const third = swap ? 0 : 2;
+	for (int i = 0; i < n; ++i) {
+		float const alpha = float (other[3]) / 255;
+		p[0] = other[first] * alpha + p[0] * (1 - alpha);
+		p[1] = other[1] * alpha + p[1] * (1 - alpha);
+		p[2] = other[third] * alpha + p[2] * (1 - alpha);
+		p[3] = other[3] * alpha + p[3] * (1 - alpha);
+		p += 4;
+		other += 4;
+	}
+}
+
+void
+alpha_blend_24_plain (uint8_t* p, uint8_t const * other, int n, bool swap)
+{
+	int const first = swap ? 2 : 0;
+	int const third = swap ? 0 : 2;
+	for (int i = 0; i < n; ++i) {
+		float const alpha = float (other[3]) / 255;
+		p[0] = other[first] * alpha + p[0] * (1 - alpha);
+		p[1] = other[1] * alpha + p[1] * (1 - alpha);
+		p[2] = other[third] * alpha + p[2] * (1 - alpha);
+		p += 3;
+		other += 4;
+	}
+}
+
+void
+alpha_blend_48_plain (uint8_t* p, uint8_t const * other, int n, bool swap)
+{
+	int const first = swap ? 2 : 0;
+	int const third = swap ? 0 : 2;
+	for (int i = 0; i < n; ++i) {
+		float const alpha = float (other[3]) / 255;
+		/* Blend high bytes */
+		p[1] = other[first] * alpha + p[1] * (1 - alpha);
+		p[3] = other[1] * alpha + p[3] * (1 - alpha);
+		p[5] = other[third] * alpha + p[5] * (1 - alpha);
+		p += 6;
+		other += 4;
+	}
+}
+
+static ImageKernels const plain_kernels = {
+	"plain",
+	fade_8_plain,
+	fade_16_plain,
+	fill_16_plain,
+	alpha_blend_32_plain,
+	alpha_blend_24_plain,
+	alpha_blend_48_plain
+};
+
+/** @return All the sets of kernels that this CPU can run, slowest first */
+vector<ImageKernels const *>
+ImageKernels::all ()
+{
+	vector<ImageKernels const *> k;
+	k.push_back (&plain_kernels);
+#ifdef DCPOMATIC_IMAGE_KERNELS_X86
+	__builtin_cpu_init ();
+	if (__builtin_cpu_supports ("sse2")) {
+		k.push_back (&sse2_image_kernels);
+	}
+	if (__builtin_cpu_supports ("avx2")) {
+		k.push_back (&avx2_image_kernels);
+	}
+#endif
+	return k;
+}
+
+/** @return Fastest set of kernels that this CPU can run */
+ImageKernels const *
+ImageKernels::best ()
+{
+	/* Images are processed in many threads, so this must be safe to call from any of them */
+	static ImageKernels const * best = all().back ();
+	return best;
+}
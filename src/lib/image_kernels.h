@@ -0,0 +1,90 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/image_kernels.h
+ *  @brief ImageKernels struct.
+ */
+
+#ifndef DCPOMATIC_IMAGE_KERNELS_H
+#define DCPOMATIC_IMAGE_KERNELS_H
+
+#include <vector>
+#include <stdint.h>
+
+/** @struct ImageKernels
+ *  @brief A set of functions which each do an Image operation on a row of samples or pixels.
+ *
+ *  There is a plain C++ set, and on x86 there are also SSE2 and AVX2 sets.  Every set gives
+ *  exactly the same results as the plain one.  best() returns the fastest set that the CPU
+ *  can run.
+ */
+struct ImageKernels
+{
+	/** Name of the instruction set that these kernels use */
+	char const * name;
+
+	/** Fade 8-bit samples towards a centre value, setting each sample v to centre + int((v - centre) * f).
+	 *  @param p Samples.
+	 *  @param n Number of samples.
+	 *  @param f Fade, from 0 (all samples become centre) to 1 (no change).
+	 *  @param centre Value to fade towards.
+	 */
+	void (*fade_8) (uint8_t* p, int n, float f, int centre);
+
+	/** As fade_8 for 16-bit samples in the machine's byte order */
+	void (*fade_16) (uint16_t* p, int n, float f, int centre);
+
+	/** Set n 16-bit samples to v */
+	void (*fill_16) (uint16_t* p, int n, uint16_t v);
+
+	/** Blend RGBA or BGRA pixels onto 4-byte pixels (RGBA or BGRA) using the alpha of the
+	 *  overlaid pixels, blending the alpha channel too.
+	 *  @param p Pixels to blend onto.
+	 *  @param other Pixels to blend.
+	 *  @param n Number of pixels.
+	 *  @param swap true to swap the first and third components of other to match p.
+	 */
+	void (*alpha_blend_32) (uint8_t* p, uint8_t const * other, int n, bool swap);
+
+	/** As alpha_blend_32 onto 3-byte (RGB24) pixels */
+	void (*alpha_blend_24) (uint8_t* p, uint8_t const * other, int n, bool swap);
+
+	/** As alpha_blend_32 onto the high bytes of 6-byte (RGB48LE) pixels */
+	void (*alpha_blend_48) (uint8_t* p, uint8_t const * other, int n, bool swap);
+
+	static ImageKernels const * best ();
+	static std::vector<ImageKernels const *> all ();
+};
+
+/* The plain kernels, which the others use for any samples left over at the end of a row */
+extern void fade_8_plain (uint8_t* p, int n, float f, int centre);
+extern void fade_16_plain (uint16_t* p, int n, float f, int centre);
+extern void fill_16_plain (uint16_t* p, int n, uint16_t v);
+extern void alpha_blend_32_plain (uint8_t* p, uint8_t const * other, int n, bool swap);
+extern void alpha_blend_24_plain (uint8_t* p, uint8_t const * other, int n, bool swap);
+extern void alpha_blend_48_plain (uint8_t* p, uint8_t const * other, int n, bool swap);
+
+#ifdef DCPOMATIC_IMAGE_KERNELS_X86
+/* These are in files of their own so that wscript can build them with the flags that they need */
+extern ImageKernels const sse2_image_kernels;
+extern ImageKernels const avx2_image_kernels;
+#endif
+
+#endif
@@ -0,0 +1,209 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/image_kernels_avx2.cc
+ *  @brief ImageKernels which use AVX2.
+ *
+ *  This file is compiled with -mavx2 (see wscript), so it must only be run on CPUs which
+ *  support it.
+ */
+
+#include "image_kernels.h"
+#include <immintrin.h>
+#include <cstring>
+
+/** Fade 8 samples held as 32-bit integers */
+static inline __m256i
+fade_8_avx2 (__m256i v, __m256 f, __m256i centre)
+{
+	return _mm256_add_epi32 (centre, _mm256_cvttps_epi32 (_mm256_mul_ps (_mm256_cvtepi32_ps (_mm256_sub_epi32 (v, centre)), f)));
+}
+
+/** Pack 4 vectors of 8 32-bit integers in [0, 255] to 32 bytes in the same order */
+static inline __m256i
+pack_32_avx2 (__m256i a, __m256i b, __m256i c, __m256i d)
+{
+	/* The packs work within each 128-bit lane, so the 4-byte groups come out as a0 b0 c0 d0 a1 b1 c1 d1 */
+	__m256i const packed = _mm256_packus_epi16 (_mm256_packs_epi32 (a, b), _mm256_packs_epi32 (c, d));
+	return _mm256_permutevar8x32_epi32 (packed, _mm256_setr_epi32 (0, 4, 1, 5, 2, 6, 3, 7));
+}
+
+static void
+fade_8_avx2 (uint8_t* p, int n, float f, int centre)
+{
+	__m256 const fv = _mm256_set1_ps (f);
+	__m256i const cv = _mm256_set1_epi32 (centre);
+
+	int i = 0;
+	for (; i + 32 <= n; i += 32) {
+		__m256i v[4];
+		for (int j = 0; j < 4; ++j) {
+			v[j] = fade_8_avx2 (_mm256_cvtepu8_epi32 (_mm_loadl_epi64 (reinterpret_cast<__m128i const *> (p + i + j * 8))), fv, cv);
+		}
+		_mm256_storeu_si256 (reinterpret_cast<__m256i *> (p + i), pack_32_avx2 (v[0], v[1], v[2], v[3]));
+	}
+
+	fade_8_plain (p + i, n - i, f, centre);
+}
+
+static void
+fade_16_avx2 (uint16_t* p, int n, float f, int centre)
+{
+	__m256 const fv = _mm256_set1_ps (f);
+	__m256i const cv = _mm256_set1_epi32 (centre);
+
+	int i = 0;
+	for (; i + 16 <= n; i += 16) {
+		__m256i const a = fade_8_avx2 (_mm256_cvtepu16_epi32 (_mm_loadu_si128 (reinterpret_cast<__m128i const *> (p + i))), fv, cv);
+		__m256i const b = fade_8_avx2 (_mm256_cvtepu16_epi32 (_mm_loadu_si128 (reinterpret_cast<__m128i const *> (p + i + 8))), fv, cv);
+		/* The pack gives a0-3 b0-3 a4-7 b4-7, so put the middle two 64-bit groups back in order */
+		__m256i const packed = _mm256_permute4x64_epi64 (_mm256_packus_epi32 (a, b), _MM_SHUFFLE (3, 1, 2, 0));
+		_mm256_storeu_si256 (reinterpret_cast<__m256i *> (p + i), packed);
+	}
+
+	fade_16_plain (p + i, n - i, f, centre);
+}
+
+static void
+fill_16_avx2 (uint16_t* p, int n, uint16_t v)
+{
+	__m256i const vv = _mm256_set1_epi16 (v);
+
+	int i = 0;
+	for (; i + 16 <= n; i += 16) {
+		_mm256_storeu_si256 (reinterpret_cast<__m256i *> (p + i), vv);
+	}
+
+	fill_16_plain (p + i, n - i, v);
+}
+
+/** Blend two pixels held as 8 32-bit integers onto two others */
+static inline __m256i
+alpha_blend_2_avx2 (__m256i other, __m256i p, bool swap)
+{
+	if (swap) {
+		other = _mm256_shuffle_epi32 (other, _MM_SHUFFLE (3, 0, 1, 2));
+	}
+	__m256 const of = _mm256_cvtepi32_ps (other);
+	/* This shuffle works within each 128-bit lane, so each pixel gets its own alpha */
+	__m256 const alpha = _mm256_div_ps (_mm256_shuffle_ps (of, of, _MM_SHUFFLE (3, 3, 3, 3)), _mm256_set1_ps (255));
+	__m256 const blended = _mm256_add_ps (
+		_mm256_mul_ps (of, alpha),
+		_mm256_mul_ps (_mm256_cvtepi32_ps (p), _mm256_sub_ps (_mm256_set1_ps (1), alpha))
+		);
+	return _mm256_cvttps_epi32 (blended);
+}
+
+/** Blend 4 RGBA/BGRA pixels onto 4 pixels which have been spread out to 4 bytes each.
+ *  @return Blended pixels, 4 bytes each.
+ */
+static inline __m128i
+alpha_blend_4_avx2 (__m128i other, __m128i p, bool swap)
+{
+	__m256i const a = alpha_blend_2_avx2 (_mm256_cvtepu8_epi32 (other), _mm256_cvtepu8_epi32 (p), swap);
+	__m256i const b = alpha_blend_2_avx2 (_mm256_cvtepu8_epi32 (_mm_srli_si128 (other, 8)), _mm256_cvtepu8_epi32 (_mm_srli_si128 (p, 8)), swap);
+	/* This gives pixels 0 and 2 in the low lane and 1 and 3 in the high one */
+	__m256i const packed = _mm256_packus_epi16 (_mm256_packs_epi32 (a, b), _mm256_setzero_si256 ());
+	return _mm_unpacklo_epi32 (_mm256_castsi256_si128 (packed), _mm256_extracti128_si256 (packed, 1));
+}
+
+static void
+alpha_blend_32_avx2 (uint8_t* p, uint8_t const * other, int n, bool swap)
+{
+	int i = 0;
+	for (; i + 8 <= n; i += 8) {
+		uint8_t* tp = p + i * 4;
+		uint8_t const * op = other + i * 4;
+		__m256i r[4];
+		for (int j = 0; j < 4; ++j) {
+			r[j] = alpha_blend_2_avx2 (
+				_mm256_cvtepu8_epi32 (_mm_loadl_epi64 (reinterpret_cast<__m128i const *> (op + j * 8))),
+				_mm256_cvtepu8_epi32 (_mm_loadl_epi64 (reinterpret_cast<__m128i const *> (tp + j * 8))),
+				swap
+				);
+		}
+		_mm256_storeu_si256 (reinterpret_cast<__m256i *> (tp), pack_32_avx2 (r[0], r[1], r[2], r[3]));
+	}
+
+	alpha_blend_32_plain (p + i * 4, other + i * 4, n - i, swap);
+}
+
+static void
+alpha_blend_24_avx2 (uint8_t* p, uint8_t const * other, int n, bool swap)
+{
+	/* Spread 4 3-byte pixels out to 4 bytes each, and back again */
+	__m128i const spread = _mm_setr_epi8 (0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+	__m128i const gather = _mm_setr_epi8 (0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+	int i = 0;
+	/* We load 16 bytes, so make sure that there are 6 pixels left, not just 4 */
+	for (; i + 6 <= n; i += 4) {
+		uint8_t* tp = p + i * 3;
+		__m128i const t = _mm_loadu_si128 (reinterpret_cast<__m128i const *> (tp));
+		__m128i const o = _mm_loadu_si128 (reinterpret_cast<__m128i const *> (other + i * 4));
+		__m128i const blended = _mm_shuffle_epi8 (alpha_blend_4_avx2 (o, _mm_shuffle_epi8 (t, spread), swap), gather);
+		/* Store just the 12 bytes that we changed; storing 16 would mean that the next load
+		   overlaps this store, and that is slow.
+		*/
+		_mm_storel_epi64 (reinterpret_cast<__m128i *> (tp), blended);
+		int32_t const last = _mm_cvtsi128_si32 (_mm_srli_si128 (blended, 8));
+		memcpy (tp + 8, &last, 4);
+	}
+
+	alpha_blend_24_plain (p + i * 3, other + i * 4, n - i, swap);
+}
+
+static void
+alpha_blend_48_avx2 (uint8_t* p, uint8_t const * other, int n, bool swap)
+{
+	/* 4 6-byte pixels are 24 bytes, which we load as bytes 0-15 and 8-23.  These shuffles
+	   pick out the high bytes of each component, and put them back again.
+	*/
+	__m128i const spread_lo = _mm_setr_epi8 (1, 3, 5, -1, 7, 9, 11, -1, 13, 15, -1, -1, -1, -1, -1, -1);
+	__m128i const spread_hi = _mm_setr_epi8 (-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 9, -1, 11, 13, 15, -1);
+	__m128i const gather_lo = _mm_setr_epi8 (-1, 0, -1, 1, -1, 2, -1, 4, -1, 5, -1, 6, -1, 8, -1, 9);
+	__m128i const gather_hi = _mm_setr_epi8 (-1, 5, -1, 6, -1, 8, -1, 9, -1, 10, -1, 12, -1, 13, -1, 14);
+	__m128i const low_bytes = _mm_set1_epi16 (0xff);
+
+	int i = 0;
+	for (; i + 4 <= n; i += 4) {
+		uint8_t* tp = p + i * 6;
+		__m128i const t_lo = _mm_loadu_si128 (reinterpret_cast<__m128i const *> (tp));
+		__m128i const t_hi = _mm_loadu_si128 (reinterpret_cast<__m128i const *> (tp + 8));
+		__m128i const o = _mm_loadu_si128 (reinterpret_cast<__m128i const *> (other + i * 4));
+		__m128i const t = _mm_or_si128 (_mm_shuffle_epi8 (t_lo, spread_lo), _mm_shuffle_epi8 (t_hi, spread_hi));
+		__m128i const blended = alpha_blend_4_avx2 (o, t, swap);
+		/* These two stores overlap, but they write the same values to bytes 8-15 */
+		_mm_storeu_si128 (reinterpret_cast<__m128i *> (tp), _mm_or_si128 (_mm_shuffle_epi8 (blended, gather_lo), _mm_and_si128 (t_lo, low_bytes)));
+		_mm_storeu_si128 (reinterpret_cast<__m128i *> (tp + 8), _mm_or_si128 (_mm_shuffle_epi8 (blended, gather_hi), _mm_and_si128 (t_hi, low_bytes)));
+	}
+
+	alpha_blend_48_plain (p + i * 6, other + i * 4, n - i, swap);
+}
+
+ImageKernels const avx2_image_kernels = {
+	"AVX2",
+	fade_8_avx2,
+	fade_16_avx2,
+	fill_16_avx2,
+	alpha_blend_32_avx2,
+	alpha_blend_24_avx2,
+	alpha_blend_48_avx2
+};
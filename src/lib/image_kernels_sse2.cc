@@ -0,0 +1,150 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/image_kernels_sse2.cc
+ *  @brief ImageKernels which use SSE2.
+ *
+ *  This file is compiled with -msse2 (see wscript), so it must only be run on CPUs which
+ *  support it.
+ */
+
+#include "image_kernels.h"
+#include <emmintrin.h>
+
+/** Fade 4 samples held as 32-bit integers */
+static inline __m128i
+fade_4_sse2 (__m128i v, __m128 f, __m128i centre)
+{
+	return _mm_add_epi32 (centre, _mm_cvttps_epi32 (_mm_mul_ps (_mm_cvtepi32_ps (_mm_sub_epi32 (v, centre)), f)));
+}
+
+static void
+fade_8_sse2 (uint8_t* p, int n, float f, int centre)
+{
+	__m128i const zero = _mm_setzero_si128 ();
+	__m128 const fv = _mm_set1_ps (f);
+	__m128i const cv = _mm_set1_epi32 (centre);
+
+	int i = 0;
+	for (; i + 16 <= n; i += 16) {
+		__m128i const v = _mm_loadu_si128 (reinterpret_cast<__m128i const *> (p + i));
+		__m128i const lo = _mm_unpacklo_epi8 (v, zero);
+		__m128i const hi = _mm_unpackhi_epi8 (v, zero);
+		__m128i const a = fade_4_sse2 (_mm_unpacklo_epi16 (lo, zero), fv, cv);
+		__m128i const b = fade_4_sse2 (_mm_unpackhi_epi16 (lo, zero), fv, cv);
+		__m128i const c = fade_4_sse2 (_mm_unpacklo_epi16 (hi, zero), fv, cv);
+		__m128i const d = fade_4_sse2 (_mm_unpackhi_epi16 (hi, zero), fv, cv);
+		_mm_storeu_si128 (reinterpret_cast<__m128i *> (p + i), _mm_packus_epi16 (_mm_packs_epi32 (a, b), _mm_packs_epi32 (c, d)));
+	}
+
+	fade_8_plain (p + i, n - i, f, centre);
+}
+
+static void
+fade_16_sse2 (uint16_t* p, int n, float f, int centre)
+{
+	__m128i const zero = _mm_setzero_si128 ();
+	__m128 const fv = _mm_set1_ps (f);
+	__m128i const cv = _mm_set1_epi32 (centre);
+	/* SSE2 can only pack 32-bit values to signed 16-bit ones, so shift the range down for packing and back afterwards */
+	__m128i const bias_32 = _mm_set1_epi32 (32768);
+	__m128i const bias_16 = _mm_set1_epi16 (-32768);
+
+	int i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m128i const v = _mm_loadu_si128 (reinterpret_cast<__m128i const *> (p + i));
+		__m128i const a = fade_4_sse2 (_mm_unpacklo_epi16 (v, zero), fv, cv);
+		__m128i const b = fade_4_sse2 (_mm_unpackhi_epi16 (v, zero), fv, cv);
+		__m128i const packed = _mm_packs_epi32 (_mm_sub_epi32 (a, bias_32), _mm_sub_epi32 (b, bias_32));
+		_mm_storeu_si128 (reinterpret_cast<__m128i *> (p + i), _mm_xor_si128 (packed, bias_16));
+	}
+
+	fade_16_plain (p + i, n - i, f, centre);
+}
+
+static void
+fill_16_sse2 (uint16_t* p, int n, uint16_t v)
+{
+	__m128i const vv = _mm_set1_epi16 (v);
+
+	int i = 0;
+	for (; i + 8 <= n; i += 8) {
+		_mm_storeu_si128 (reinterpret_cast<__m128i *> (p + i), vv);
+	}
+
+	fill_16_plain (p + i, n - i, v);
+}
+
+/** Blend one pixel held as 4 32-bit integers onto another */
+static inline __m128i
+alpha_blend_1_sse2 (__m128i other, __m128i p)
+{
+	__m128 const of = _mm_cvtepi32_ps (other);
+	__m128 const alpha = _mm_div_ps (_mm_shuffle_ps (of, of, _MM_SHUFFLE (3, 3, 3, 3)), _mm_set1_ps (255));
+	return _mm_cvttps_epi32 (_mm_add_ps (_mm_mul_ps (of, alpha), _mm_mul_ps (_mm_cvtepi32_ps (p), _mm_sub_ps (_mm_set1_ps (1), alpha))));
+}
+
+static void
+alpha_blend_32_sse2 (uint8_t* p, uint8_t const * other, int n, bool swap)
+{
+	__m128i const zero = _mm_setzero_si128 ();
+
+	int i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m128i const o = _mm_loadu_si128 (reinterpret_cast<__m128i const *> (other + i * 4));
+		__m128i const t = _mm_loadu_si128 (reinterpret_cast<__m128i const *> (p + i * 4));
+		__m128i const o_lo = _mm_unpacklo_epi8 (o, zero);
+		__m128i const o_hi = _mm_unpackhi_epi8 (o, zero);
+		__m128i const t_lo = _mm_unpacklo_epi8 (t, zero);
+		__m128i const t_hi = _mm_unpackhi_epi8 (t, zero);
+
+		__m128i os[4] = {
+			_mm_unpacklo_epi16 (o_lo, zero),
+			_mm_unpackhi_epi16 (o_lo, zero),
+			_mm_unpacklo_epi16 (o_hi, zero),
+			_mm_unpackhi_epi16 (o_hi, zero)
+		};
+
+		if (swap) {
+			for (int j = 0; j < 4; ++j) {
+				os[j] = _mm_shuffle_epi32 (os[j], _MM_SHUFFLE (3, 0, 1, 2));
+			}
+		}
+
+		__m128i const a = alpha_blend_1_sse2 (os[0], _mm_unpacklo_epi16 (t_lo, zero));
+		__m128i const b = alpha_blend_1_sse2 (os[1], _mm_unpackhi_epi16 (t_lo, zero));
+		__m128i const c = alpha_blend_1_sse2 (os[2], _mm_unpacklo_epi16 (t_hi, zero));
+		__m128i const d = alpha_blend_1_sse2 (os[3], _mm_unpackhi_epi16 (t_hi, zero));
+		_mm_storeu_si128 (reinterpret_cast<__m128i *> (p + i * 4), _mm_packus_epi16 (_mm_packs_epi32 (a, b), _mm_packs_epi32 (c, d)));
+	}
+
+	alpha_blend_32_plain (p + i * 4, other + i * 4, n - i, swap);
+}
+
+/* SSE2 has no byte shuffle to gather 3- and 6-byte pixels, so those use the plain versions */
+ImageKernels const sse2_image_kernels = {
+	"SSE2",
+	fade_8_sse2,
+	fade_16_sse2,
+	fill_16_sse2,
+	alpha_blend_32_sse2,
+	alpha_blend_24_plain,
+	alpha_blend_48_plain
+};
@@ -22,6 +22,7 @@
 #include "raw_image_proxy.h"
 #include "ffmpeg_image_proxy.h"
 #include "j2k_image_proxy.h"
+#include "ffmpeg_packet_image_proxy.h"
 #include "image.h"
 #include "exceptions.h"
 #include "cross.h"
@@ -36,14 +37,16 @@ using std::string;
 using boost::shared_ptr;
 
 shared_ptr<ImageProxy>
-image_proxy_factory (shared_ptr<cxml::Node> xml, shared_ptr<Socket> socket)
+image_proxy_factory (shared_ptr<cxml::Node> xml, shared_ptr<Socket> socket, TransportCompression compression)
 {
 	if (xml->string_child("Type") == N_("Raw")) {
-		return shared_ptr<ImageProxy> (new RawImageProxy (xml, socket));
+		return shared_ptr<ImageProxy> (new RawImageProxy (xml, socket, compression));
 	} else if (xml->string_child("Type") == N_("FFmpeg")) {
 		return shared_ptr<FFmpegImageProxy> (new FFmpegImageProxy(xml, socket));
 	} else if (xml->string_child("Type") == N_("J2K")) {
 		return shared_ptr<J2KImageProxy> (new J2KImageProxy (xml, socket));
+	} else if (xml->string_child("Type") == N_("FFmpegPacket")) {
+		return shared_ptr<FFmpegPacketImageProxy> (new FFmpegPacketImageProxy (xml, socket));
 	}
 
 	throw NetworkError (_("Unexpected image type received by server"));
@@ -28,6 +28,7 @@
 extern "C" {
 #include <libavutil/pixfmt.h>
 }
+#include "types.h"
 #include <dcp/types.h>
 #include <boost/shared_ptr.hpp>
 #include <boost/optional.hpp>
@@ -35,6 +36,7 @@ extern "C" {
 
 class Image;
 class Socket;
+class Digester;
 
 namespace xmlpp {
 	class Node;
@@ -72,17 +74,30 @@ public:
 		) const = 0;
 
 	virtual void add_metadata (xmlpp::Node *) const = 0;
-	virtual void send_binary (boost::shared_ptr<Socket>) const = 0;
+	/** Send our binary data down a socket.
+	 *  @param compression Compression that may be applied to uncompressed image data.
+	 */
+	virtual void send_binary (boost::shared_ptr<Socket>, TransportCompression compression) const = 0;
 	/** @return true if our image is definitely the same as another, false if it is probably not */
 	virtual bool same (boost::shared_ptr<const ImageProxy>) const = 0;
+	/** Add something to a Digester which identifies our image, such that two proxies
+	 *  which give the same digest will always give the same image.
+	 */
+	virtual void add_digest (Digester& digester) const = 0;
 	/** Do any useful work that would speed up a subsequent call to ::image().
 	 *  This method may be called in a different thread to image().
 	 *  @return log2 of any scaling down that will be applied to the image.
 	 */
 	virtual int prepare (boost::optional<dcp::Size> = boost::optional<dcp::Size>()) const { return 0; }
 	virtual size_t memory_used () const = 0;
+	/** @return the oldest server link version which can accept this proxy */
+	virtual int minimum_link_version () const {
+		return MINIMUM_SERVER_LINK_VERSION;
+	}
 };
 
-boost::shared_ptr<ImageProxy> image_proxy_factory (boost::shared_ptr<cxml::Node> xml, boost::shared_ptr<Socket> socket);
+boost::shared_ptr<ImageProxy> image_proxy_factory (
+	boost::shared_ptr<cxml::Node> xml, boost::shared_ptr<Socket> socket, TransportCompression compression = TRANSPORT_COMPRESSION_NONE
+	);
 
 #endif
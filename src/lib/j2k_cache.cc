@@ -0,0 +1,296 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/j2k_cache.cc
+ *  @brief J2KCache class.
+ */
+
+#include "j2k_cache.h"
+#include "config.h"
+#include "dcpomatic_log.h"
+#include "digester.h"
+#include "version.h"
+#include <dcp/version.h>
+#include <openjpeg.h>
+#include <boost/foreach.hpp>
+#include <vector>
+#include <algorithm>
+#include <ctime>
+
+using std::string;
+using std::vector;
+using std::list;
+using boost::optional;
+using dcp::Data;
+
+J2KCache* J2KCache::_instance = 0;
+
+/** Minimum time in seconds between updates of an entry's modification time.  Doing it
+ *  on every use would mean a disk write for each hit, and the LRU order only needs to
+ *  be roughly right between runs.
+ */
+static time_t const touch_interval = 60 * 60;
+
+J2KCache::J2KCache ()
+	: _size (0)
+{
+
+}
+
+/** @return J2K data for a digest, or none if we do not have it */
+optional<Data>
+J2KCache::get (string digest)
+{
+	string const k = key (digest);
+	boost::filesystem::path f;
+	bool touch = false;
+
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+
+		check_directory ();
+
+		std::map<string, list<Entry>::iterator>::iterator i = _index.find (k);
+		if (i == _index.end()) {
+			return optional<Data> ();
+		}
+
+		f = file (k);
+
+		time_t const now = time (0);
+		if ((now - i->second->used) > touch_interval) {
+			i->second->used = now;
+			touch = true;
+		}
+
+		/* Move to the most-recently-used end */
+		_entries.splice (_entries.end(), _entries, i->second);
+	}
+
+	try {
+		Data data (f);
+		if (touch) {
+			/* Record the use so that it will be remembered next time */
+			boost::filesystem::last_write_time (f, time (0));
+		}
+		return data;
+	} catch (std::exception& e) {
+		LOG_ERROR ("Could not read J2K cache file %1 (%2)", f.string(), e.what());
+	}
+
+	boost::mutex::scoped_lock lm (_mutex);
+	std::map<string, list<Entry>::iterator>::iterator i = _index.find (k);
+	if (i != _index.end()) {
+		_size -= i->second->size;
+		_entries.erase (i->second);
+		_index.erase (i);
+	}
+
+	return optional<Data> ();
+}
+
+/** Add J2K data for a digest, removing old entries if the cache is then too big */
+void
+J2KCache::put (string digest, Data data)
+{
+	string const k = key (digest);
+	boost::filesystem::path f;
+
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+
+		check_directory ();
+
+		if (_index.find (k) != _index.end()) {
+			return;
+		}
+
+		f = file (k);
+	}
+
+	try {
+		/* Other threads may be writing the same frame, so each needs its own temporary file */
+		boost::filesystem::path temp = f.parent_path() / boost::filesystem::unique_path (k + ".%%%%-%%%%.tmp");
+		data.write_via_temp (temp, f);
+	} catch (std::exception& e) {
+		LOG_ERROR ("Could not write to J2K cache (%1)", e.what());
+		return;
+	}
+
+	list<boost::filesystem::path> evicted;
+
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+
+		if (_index.find (k) != _index.end()) {
+			/* Someone else got there first */
+			return;
+		}
+
+		_entries.push_back (Entry (k, data.size(), time (0)));
+		_index[k] = --_entries.end();
+		_size += data.size();
+
+		evicted = evict ();
+	}
+
+	remove (evicted);
+}
+
+/** Remove everything from the cache */
+void
+J2KCache::clear ()
+{
+	list<boost::filesystem::path> files;
+
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+
+		check_directory ();
+
+		BOOST_FOREACH (Entry const& i, _entries) {
+			files.push_back (file (i.key));
+		}
+
+		_entries.clear ();
+		_index.clear ();
+		_size = 0;
+	}
+
+	remove (files);
+}
+
+bool
+J2KCache::older (Entry const & a, Entry const & b)
+{
+	return a.used < b.used;
+}
+
+/** Make sure that _entries describes the configured cache directory, reading
+ *  the directory if it does not.  _mutex must be held.
+ */
+void
+J2KCache::check_directory ()
+{
+	boost::filesystem::path const dir = Config::instance()->j2k_cache_directory ();
+	if (_directory && *_directory == dir) {
+		return;
+	}
+
+	_directory = dir;
+	_entries.clear ();
+	_index.clear ();
+	_size = 0;
+
+	vector<Entry> found;
+
+	try {
+		boost::filesystem::create_directories (dir);
+		for (boost::filesystem::directory_iterator i = boost::filesystem::directory_iterator (dir); i != boost::filesystem::directory_iterator(); ++i) {
+			boost::filesystem::path const p = i->path ();
+			if (p.extension() == ".tmp") {
+				/* Left over from an interrupted write */
+				boost::system::error_code ec;
+				boost::filesystem::remove (p, ec);
+			} else if (p.extension() == ".j2c") {
+				found.push_back (Entry (p.stem().string(), boost::filesystem::file_size (p), boost::filesystem::last_write_time (p)));
+			}
+		}
+	} catch (std::exception& e) {
+		LOG_ERROR ("Could not read J2K cache directory %1 (%2)", dir.string(), e.what());
+	}
+
+	std::stable_sort (found.begin(), found.end(), older);
+
+	for (vector<Entry>::const_iterator i = found.begin(); i != found.end(); ++i) {
+		_entries.push_back (*i);
+		_index[i->key] = --_entries.end();
+		_size += i->size;
+	}
+
+	LOG_GENERAL ("J2K cache in %1 has %2 frames (%3 bytes)", dir.string(), _entries.size(), _size);
+
+	/* This only happens when the directory changes, so it's not worth avoiding doing this with the lock held */
+	remove (evict ());
+}
+
+/** Remove least-recently-used entries until we are within the configured size.  _mutex must be held.
+ *  @return Files of the entries that were removed; the caller should delete them, ideally after releasing _mutex.
+ */
+list<boost::filesystem::path>
+J2KCache::evict ()
+{
+	boost::uintmax_t const limit = static_cast<boost::uintmax_t> (Config::instance()->j2k_cache_size()) * 1024 * 1024 * 1024;
+
+	list<boost::filesystem::path> files;
+
+	while (_size > limit && !_entries.empty ()) {
+		Entry const& e = _entries.front ();
+		files.push_back (file (e.key));
+		_size -= e.size;
+		_index.erase (e.key);
+		_entries.pop_front ();
+	}
+
+	return files;
+}
+
+/** Delete some files, ignoring any errors */
+void
+J2KCache::remove (list<boost::filesystem::path> const & files)
+{
+	BOOST_FOREACH (boost::filesystem::path const& i, files) {
+		boost::system::error_code ec;
+		boost::filesystem::remove (i, ec);
+	}
+}
+
+/** @return Path of the file holding the data for a key.  _mutex must be held. */
+boost::filesystem::path
+J2KCache::file (string key) const
+{
+	return *_directory / (key + ".j2c");
+}
+
+/** @param digest DCPVideo::digest() of a frame.
+ *  @return Key to use for that frame's data from this build of the encoder.
+ */
+string
+J2KCache::key (string digest)
+{
+	Digester digester;
+	digester.add (digest);
+	digester.add (string (dcpomatic_version));
+	digester.add (string (dcpomatic_git_commit));
+	digester.add (string (dcp::version));
+	digester.add (string (dcp::git_commit));
+	digester.add (string (opj_version ()));
+	return digester.get ();
+}
+
+J2KCache *
+J2KCache::instance ()
+{
+	if (!_instance) {
+		_instance = new J2KCache ();
+	}
+
+	return _instance;
+}
@@ -0,0 +1,99 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef DCPOMATIC_J2K_CACHE_H
+#define DCPOMATIC_J2K_CACHE_H
+
+/** @file  src/lib/j2k_cache.h
+ *  @brief J2KCache class.
+ */
+
+#include <dcp/data.h>
+#include <boost/filesystem.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/optional.hpp>
+#include <boost/cstdint.hpp>
+#include <list>
+#include <map>
+#include <string>
+#include <ctime>
+
+/** @class J2KCache
+ *  @brief A singleton on-disk store of J2K data, keyed by DCPVideo::digest().
+ *
+ *  The cache is kept in Config::j2k_cache_directory(), and shared between all films.
+ *  Entries are also keyed by the versions of the code that made them, so that
+ *  a new encoder never gets J2K data from an old one.  When the cache grows beyond
+ *  Config::j2k_cache_size() the least-recently-used entries are removed; each entry's
+ *  modification time is (roughly) its last use, so that this order survives between runs.
+ */
+class J2KCache : public boost::noncopyable
+{
+public:
+	boost::optional<dcp::Data> get (std::string digest);
+	void put (std::string digest, dcp::Data data);
+	void clear ();
+
+	static J2KCache* instance ();
+
+private:
+	J2KCache ();
+
+	void check_directory ();
+	std::list<boost::filesystem::path> evict ();
+	boost::filesystem::path file (std::string key) const;
+
+	static std::string key (std::string digest);
+	static void remove (std::list<boost::filesystem::path> const & files);
+
+	struct Entry
+	{
+		Entry (std::string k, boost::uintmax_t s, time_t u)
+			: key (k)
+			, size (s)
+			, used (u)
+		{}
+
+		std::string key;
+		boost::uintmax_t size;
+		/** Last use that we have recorded in the file's modification time */
+		time_t used;
+	};
+
+	static bool older (Entry const & a, Entry const & b);
+
+	/** Mutex for everything below.  It is not held while entries' files are read or
+	 *  written, so a file may disappear under a reader; that just looks like a miss.
+	 */
+	boost::mutex _mutex;
+	/** Directory that _entries describes */
+	boost::optional<boost::filesystem::path> _directory;
+	/** Entries in order of use, least recent first */
+	std::list<Entry> _entries;
+	/** Iterators into _entries, indexed by key */
+	std::map<std::string, std::list<Entry>::iterator> _index;
+	/** Total size of the files in _entries in bytes */
+	boost::uintmax_t _size;
+
+	static J2KCache* _instance;
+};
+
+#endif
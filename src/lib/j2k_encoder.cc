@@ -35,6 +35,8 @@
 #include "player.h"
 #include "player_video.h"
 #include "encode_server_description.h"
+#include "encode_server_connection.h"
+#include "j2k_cache.h"
 #include "compose.hpp"
 #include <libcxml/cxml.h>
 #include <boost/foreach.hpp>
@@ -43,6 +45,9 @@
 #include "i18n.h"
 
 using std::list;
+using std::vector;
+using std::string;
+using std::pair;
 using std::cout;
 using std::exception;
 using boost::shared_ptr;
@@ -50,13 +55,20 @@ using boost::weak_ptr;
 using boost::optional;
 using dcp::Data;
 
+/** Number of frames that each pipelined connection to a server may have in flight */
+static int const pipeline_window = 2;
+
 /** @param film Film that we are encoding.
  *  @param writer Writer that we are using.
  */
 J2KEncoder::J2KEncoder (shared_ptr<const Film> film, shared_ptr<Writer> writer)
 	: _film (film)
 	, _history (200)
+	, _cache_hits (0)
+	, _cache_misses (0)
 	, _writer (writer)
+	, _video_frames_enqueued (0)
+	, _video_frames_reused (0)
 {
 	servers_list_changed ();
 }
@@ -100,13 +112,26 @@ J2KEncoder::end ()
 {
 	boost::mutex::scoped_lock lock (_queue_mutex);
 
-	LOG_GENERAL (N_("Clearing queue of %1"), _queue.size ());
+	LOG_GENERAL (N_("Clearing queue of %1"), _scheduler.size ());
 
-	/* Keep waking workers until the queue is empty */
-	while (!_queue.empty ()) {
+	/* Keep waking workers until the queue is empty and every frame has been finished;
+	   while we wait, idle workers may be given copies of frames which are overdue elsewhere.
+	*/
+	while (!_scheduler.empty () || _scheduler.in_progress ()) {
 		rethrow ();
-		_empty_condition.notify_all ();
-		_full_condition.wait (lock);
+		_scheduler.wake_all ();
+		_full_condition.timed_wait (lock, boost::posix_time::seconds (1));
+	}
+
+	BOOST_FOREACH (EncodeWorkerStatus i, _scheduler.status ()) {
+		LOG_GENERAL (
+			N_("Encode worker %1 did %2 frames (%3 stolen, %4 speculative); recent rate %5fps"),
+			i.name, i.done, i.stolen, i.speculated, i.rate
+			);
+	}
+
+	if (Config::instance()->j2k_cache ()) {
+		LOG_GENERAL (N_("J2K cache: %1 hits, %2 misses"), _cache_hits, _cache_misses);
 	}
 
 	lock.unlock ();
@@ -115,8 +140,6 @@ J2KEncoder::end ()
 
 	terminate_threads ();
 
-	LOG_GENERAL (N_("Mopping up %1"), _queue.size());
-
 	/* The following sequence of events can occur in the above code:
 	     1. a remote worker takes the last image off the queue
 	     2. the loop above terminates
@@ -126,15 +149,53 @@ J2KEncoder::end ()
 	     So just mop up anything left in the queue here.
 	*/
 
-	for (list<shared_ptr<DCPVideo> >::iterator i = _queue.begin(); i != _queue.end(); ++i) {
-		LOG_GENERAL (N_("Encode left-over frame %1"), (*i)->index ());
+	lock.lock ();
+	list<shared_ptr<DCPVideo> > left = _scheduler.take_all ();
+	lock.unlock ();
+
+	LOG_GENERAL (N_("Mopping up %1"), left.size());
+
+	if (left.empty ()) {
+		return;
+	}
+
+	/* Encode the left-overs using as many local threads as we would normally use */
+	boost::mutex left_mutex;
+	boost::thread_group mop_up;
+	int const threads = std::min (std::max (1, Config::instance()->master_encoding_threads ()), static_cast<int> (left.size ()));
+	for (int i = 0; i < threads; ++i) {
+		mop_up.create_thread (boost::bind (&J2KEncoder::mop_up_thread, this, &left, &left_mutex));
+	}
+	mop_up.join_all ();
+}
+
+/** Thread to encode some frames locally at the end of a run.
+ *  @param frames Frames to encode; this thread removes them as it takes them.
+ *  @param mutex Mutex for frames.
+ */
+void
+J2KEncoder::mop_up_thread (list<shared_ptr<DCPVideo> >* frames, boost::mutex* mutex)
+{
+	while (true) {
+		shared_ptr<DCPVideo> vf;
+		{
+			boost::mutex::scoped_lock lm (*mutex);
+			if (frames->empty ()) {
+				return;
+			}
+			vf = frames->front ();
+			frames->pop_front ();
+		}
+
+		LOG_GENERAL (N_("Encode left-over frame %1"), vf->index ());
 		try {
-			_writer->write (
-				(*i)->encode_locally(),
-				(*i)->index(),
-				(*i)->eyes()
-				);
-			frame_done ();
+			optional<Data> encoded = from_cache (vf);
+			if (!encoded) {
+				encoded = vf->encode_locally ();
+				to_cache (vf, *encoded);
+			}
+			_writer->write (*encoded, vf->index(), vf->eyes());
+			_history.event ();
 		} catch (std::exception& e) {
 			LOG_ERROR (N_("Local encode failed (%1)"), e.what ());
 		}
@@ -154,20 +215,77 @@ J2KEncoder::current_encoding_rate () const
 int
 J2KEncoder::video_frames_enqueued () const
 {
-	if (!_last_player_video_time) {
-		return 0;
-	}
+	boost::mutex::scoped_lock lm (_queue_mutex);
+	return _video_frames_enqueued;
+}
+
+/** @return Number of video frames that were taken from an earlier encode rather than being encoded again */
+int
+J2KEncoder::video_frames_reused () const
+{
+	boost::mutex::scoped_lock lm (_queue_mutex);
+	return _video_frames_reused;
+}
 
-	return _last_player_video_time->frames_floor (_film->video_frame_rate ());
+/** @return Details of what each of our local threads and remote server threads has been doing */
+vector<EncodeWorkerStatus>
+J2KEncoder::worker_status () const
+{
+	boost::mutex::scoped_lock lm (_queue_mutex);
+	return _scheduler.status ();
 }
 
-/** Should be called when a frame has been encoded successfully */
+/** Should be called when a worker has encoded a frame successfully.  The result is written
+ *  unless another worker has already finished the same frame.
+ *  @param worker EncodeScheduler ID of the worker that encoded the frame.
+ *  @param frame Frame that was encoded.
+ *  @param encoded J2K data.
+ */
 void
-J2KEncoder::frame_done ()
+J2KEncoder::frame_done (int worker, shared_ptr<DCPVideo> frame, Data encoded)
 {
+	{
+		boost::mutex::scoped_lock lm (_queue_mutex);
+		if (!_scheduler.finish (worker, frame)) {
+			LOG_GENERAL (N_("Frame %1 was already finished by another worker"), frame->index());
+			return;
+		}
+	}
+
+	to_cache (frame, encoded);
+	_writer->write (encoded, frame->index(), frame->eyes());
 	_history.event ();
 }
 
+/** @return J2K data for a frame from the J2K cache, if the cache is enabled and has it */
+optional<Data>
+J2KEncoder::from_cache (shared_ptr<DCPVideo> frame)
+{
+	if (!Config::instance()->j2k_cache ()) {
+		return optional<Data> ();
+	}
+
+	optional<Data> data = J2KCache::instance()->get (frame->digest ());
+
+	boost::mutex::scoped_lock lm (_queue_mutex);
+	if (data) {
+		++_cache_hits;
+	} else {
+		++_cache_misses;
+	}
+
+	return data;
+}
+
+/** Add J2K data for a frame to the J2K cache, if it is enabled */
+void
+J2KEncoder::to_cache (shared_ptr<DCPVideo> frame, Data encoded)
+{
+	if (Config::instance()->j2k_cache ()) {
+		J2KCache::instance()->put (frame->digest (), encoded);
+	}
+}
+
 /** Called to request encoding of the next video frame in the DCP.  This is called in order,
  *  so each time the supplied frame is the one after the previous one.
  *  pv represents one video frame, and could be empty if there is nothing to encode
@@ -181,21 +299,35 @@ J2KEncoder::encode (shared_ptr<PlayerVideo> pv, DCPTime time)
 {
 	_waker.nudge ();
 
-	size_t threads = 0;
+	Frame const position = time.frames_floor(_film->video_frame_rate());
+
+	size_t const reel = _writer->video_reel (position);
+	shared_ptr<PlayerVideo> last;
 	{
-		boost::mutex::scoped_lock threads_lock (_threads_mutex);
-		threads = _threads.size ();
+		boost::mutex::scoped_lock lm (_queue_mutex);
+		last = _last_player_video[pv->eyes()][reel];
 	}
 
-	boost::mutex::scoped_lock queue_lock (_queue_mutex);
+	bool const fake = _writer->can_fake_write (position);
+	bool const j2k = !fake && pv->has_j2k() && !_film->reencode_j2k();
+	bool const repeat = !fake && !j2k && last && _writer->can_repeat(position) && pv->same (last);
 
-	/* Wait until the queue has gone down a bit.  Allow one thing in the queue even
-	   when there are no threads.
+	/* Reading a frame from an earlier encode's picture asset means disk I/O and
+	   a hash, so only do it if we would otherwise encode this frame, and do it
+	   before taking the lock that the workers need.
 	*/
-	while (_queue.size() >= (threads * 2) + 1) {
-		LOG_TIMING ("decoder-sleep queue=%1 threads=%2", _queue.size(), threads);
+	optional<Data> previous;
+	if (!fake && !j2k && !repeat) {
+		previous = _writer->previous_frame (position, pv->eyes ());
+	}
+
+	boost::mutex::scoped_lock queue_lock (_queue_mutex);
+
+	/* Wait until the queues have gone down a bit */
+	while (_scheduler.full ()) {
+		LOG_TIMING ("decoder-sleep queue=%1", _scheduler.size());
 		_full_condition.wait (queue_lock);
-		LOG_TIMING ("decoder-wake queue=%1 threads=%2", _queue.size(), threads);
+		LOG_TIMING ("decoder-wake queue=%1", _scheduler.size());
 	}
 
 	_writer->rethrow ();
@@ -205,42 +337,45 @@ J2KEncoder::encode (shared_ptr<PlayerVideo> pv, DCPTime time)
 	*/
 	rethrow ();
 
-	Frame const position = time.frames_floor(_film->video_frame_rate());
-
-	if (_writer->can_fake_write (position)) {
+	if (fake) {
 		/* We can fake-write this frame */
 		LOG_DEBUG_ENCODE("Frame @ %1 FAKE", to_string(time));
 		_writer->fake_write (position, pv->eyes ());
-		frame_done ();
-	} else if (pv->has_j2k() && !_film->reencode_j2k()) {
+		_history.event ();
+	} else if (j2k) {
 		LOG_DEBUG_ENCODE("Frame @ %1 J2K", to_string(time));
 		/* This frame already has J2K data, so just write it */
 		_writer->write (pv->j2k(), position, pv->eyes ());
-	} else if (_last_player_video[pv->eyes()] && _writer->can_repeat(position) && pv->same (_last_player_video[pv->eyes()])) {
+	} else if (repeat) {
 		LOG_DEBUG_ENCODE("Frame @ %1 REPEAT", to_string(time));
 		_writer->repeat (position, pv->eyes ());
+	} else if (previous) {
+		/* The picture here has not changed since an earlier encode, so use what we made then */
+		LOG_DEBUG_ENCODE("Frame @ %1 REUSE", to_string(time));
+		_writer->write (*previous, position, pv->eyes ());
+		_history.event ();
+		++_video_frames_reused;
 	} else {
 		LOG_DEBUG_ENCODE("Frame @ %1 ENCODE", to_string(time));
-		/* Queue this new frame for encoding */
-		LOG_TIMING ("add-frame-to-queue queue=%1", _queue.size ());
-		_queue.push_back (shared_ptr<DCPVideo> (
-					  new DCPVideo (
-						  pv,
-						  position,
-						  _film->video_frame_rate(),
-						  _film->j2k_bandwidth(),
-						  _film->resolution()
-						  )
-					  ));
-
-		/* The queue might not be empty any more, so notify anything which is
-		   waiting on that.
+		/* Queue this new frame for encoding; the scheduler will wake whichever
+		   worker it gives the frame to.
 		*/
-		_empty_condition.notify_all ();
+		LOG_TIMING ("add-frame-to-queue queue=%1", _scheduler.size ());
+		_scheduler.push (shared_ptr<DCPVideo> (
+					 new DCPVideo (
+						 pv,
+						 position,
+						 _film->video_frame_rate(),
+						 _film->j2k_bandwidth(),
+						 _film->resolution()
+						 )
+					 ));
 	}
 
-	_last_player_video[pv->eyes()] = pv;
-	_last_player_video_time = time;
+	_last_player_video[pv->eyes()][reel] = pv;
+	if (pv->eyes() != EYES_RIGHT) {
+		++_video_frames_enqueued;
+	}
 }
 
 void
@@ -248,33 +383,77 @@ J2KEncoder::terminate_threads ()
 {
 	boost::mutex::scoped_lock threads_lock (_threads_mutex);
 
+	/* Threads which have already been retired are included here; they may still be finishing off */
+	_retired_threads.splice (_retired_threads.end(), _threads);
+
 	int n = 0;
-	for (list<boost::thread *>::iterator i = _threads.begin(); i != _threads.end(); ++i) {
-		/* Be careful not to throw in here otherwise _threads will not be clear()ed */
-		LOG_GENERAL ("Terminating thread %1 of %2", n + 1, _threads.size ());
-		(*i)->interrupt ();
-		if (!(*i)->joinable()) {
-			LOG_ERROR_NC ("About to join() a non-joinable thread");
-		}
-		try {
-			(*i)->join ();
-		} catch (boost::thread_interrupted& e) {
-			/* This is to be expected (I think?) */
-		} catch (exception& e) {
-			LOG_ERROR ("join() threw an exception: %1", e.what());
-		} catch (...) {
-			LOG_ERROR_NC ("join() threw an exception");
-		}
-		delete *i;
+	for (list<WorkerThread>::iterator i = _retired_threads.begin(); i != _retired_threads.end(); ++i) {
+		/* Be careful not to throw in here otherwise _retired_threads will not be clear()ed */
+		LOG_GENERAL ("Terminating thread %1 of %2", n + 1, _retired_threads.size ());
+		i->thread->interrupt ();
+		join_thread (i->thread);
 		LOG_GENERAL_NC ("Thread terminated");
 		++n;
 	}
 
-	_threads.clear ();
+	/* Now that the threads have gone, anything left in their queues can be given to any new ones */
+	boost::mutex::scoped_lock queue_lock (_queue_mutex);
+	BOOST_FOREACH (WorkerThread const& i, _retired_threads) {
+		_scheduler.remove_worker (i.worker);
+	}
+
+	_retired_threads.clear ();
+}
+
+/** Join and delete a thread which has been interrupted; must not throw */
+void
+J2KEncoder::join_thread (boost::thread* thread)
+{
+	if (!thread->joinable()) {
+		LOG_ERROR_NC ("About to join() a non-joinable thread");
+	}
+	try {
+		thread->join ();
+	} catch (boost::thread_interrupted& e) {
+		/* This is to be expected (I think?) */
+	} catch (exception& e) {
+		LOG_ERROR ("join() threw an exception: %1", e.what());
+	} catch (...) {
+		LOG_ERROR_NC ("join() threw an exception");
+	}
+	delete thread;
+}
+
+/** Ask a thread to finish the frames that it has taken and then stop, without waiting
+ *  for it to do so.  It is joined by the next call to terminate_threads().  _threads_mutex
+ *  must be held.
+ */
+void
+J2KEncoder::retire_thread (list<WorkerThread>::iterator i)
+{
+	{
+		boost::mutex::scoped_lock lm (_queue_mutex);
+		_scheduler.retire (i->worker);
+	}
+
+	i->thread->interrupt ();
+	_retired_threads.splice (_retired_threads.end(), _threads, i);
+}
+
+/** Take the next frame for a worker, waiting until there is one.  _queue_mutex must be held. */
+static shared_ptr<DCPVideo>
+wait_for_frame (EncodeScheduler& scheduler, int worker, boost::mutex::scoped_lock& lock)
+{
+	shared_ptr<DCPVideo> vf = scheduler.pop (worker);
+	while (!vf) {
+		scheduler.wait (worker, lock);
+		vf = scheduler.pop (worker);
+	}
+	return vf;
 }
 
 void
-J2KEncoder::encoder_thread (optional<EncodeServerDescription> server)
+J2KEncoder::encoder_thread (int worker, optional<EncodeServerDescription> server)
 try
 {
 	if (server) {
@@ -291,14 +470,13 @@ try
 
 	while (true) {
 
+		/* Stop here if we have been retired */
+		boost::this_thread::interruption_point ();
+
 		LOG_TIMING ("encoder-sleep thread=%1", thread_id ());
 		boost::mutex::scoped_lock lock (_queue_mutex);
-		while (_queue.empty ()) {
-			_empty_condition.wait (lock);
-		}
-
-		LOG_TIMING ("encoder-wake thread=%1 queue=%2", thread_id(), _queue.size());
-		shared_ptr<DCPVideo> vf = _queue.front ();
+		shared_ptr<DCPVideo> vf = wait_for_frame (_scheduler, worker, lock);
+		LOG_TIMING ("encoder-wake thread=%1 queue=%2", thread_id(), _scheduler.size());
 
 		/* We're about to commit to either encoding this frame or putting it back onto the queue,
 		   so we must not be interrupted until one or other of these things have happened.  This
@@ -308,19 +486,22 @@ try
 			boost::this_thread::disable_interruption dis;
 
 			LOG_TIMING ("encoder-pop thread=%1 frame=%2 eyes=%3", thread_id(), vf->index(), (int) vf->eyes ());
-			_queue.pop_front ();
 
 			lock.unlock ();
 
-			optional<Data> encoded;
+			optional<Data> encoded = from_cache (vf);
 
-			/* We need to encode this input */
-			if (server) {
+			if (encoded) {
+				LOG_DEBUG_ENCODE (N_("Frame %1 from J2K cache"), vf->index());
+			} else if (server) {
 				try {
 					encoded = vf->encode_remotely (server.get ());
 
 					if (remote_backoff > 0) {
 						LOG_GENERAL ("%1 was lost, but now she is found; removing backoff", server->host_name ());
+						lock.lock ();
+						_scheduler.set_backoff (worker, false);
+						lock.unlock ();
 					}
 
 					/* This job succeeded, so remove any backoff */
@@ -350,12 +531,12 @@ try
 			}
 
 			if (encoded) {
-				_writer->write (encoded.get(), vf->index (), vf->eyes ());
-				frame_done ();
+				frame_done (worker, vf, encoded.get());
 			} else {
 				lock.lock ();
 				LOG_GENERAL (N_("[%1] J2KEncoder thread pushes frame %2 back onto queue after failure"), thread_id(), vf->index());
-				_queue.push_front (vf);
+				_scheduler.set_backoff (worker, true);
+				_scheduler.push_back (worker, vf);
 				lock.unlock ();
 			}
 		}
@@ -380,13 +561,174 @@ catch (...)
 	_full_condition.notify_all ();
 }
 
+/** Thread to send frames to a server which supports pipelined sessions.  We keep one
+ *  connection open and try to have pipeline_window frames in flight on it, so
+ *  that sending one frame overlaps the encoding of others.
+ */
 void
-J2KEncoder::servers_list_changed ()
+J2KEncoder::pipelined_encoder_thread (int worker, EncodeServerDescription server)
+try
 {
-	terminate_threads ();
+	LOG_TIMING ("start-pipelined-encoder-thread thread=%1 server=%2", thread_id (), server.host_name ());
 
-	/* XXX: could re-use threads */
+	/* Number of seconds that we currently wait between attempts
+	   to connect to the server.
+	*/
+	int remote_backoff = 0;
+
+	shared_ptr<EncodeServerConnection> connection;
+
+	while (true) {
+
+		/* Frame that we have taken but not yet sent */
+		shared_ptr<DCPVideo> first;
+
+		if (!connection || connection->idle ()) {
+			/* We have nothing in flight, so it is safe to be interrupted here */
+			boost::this_thread::interruption_point ();
+			LOG_TIMING ("encoder-sleep thread=%1", thread_id ());
+			boost::mutex::scoped_lock lock (_queue_mutex);
+			first = wait_for_frame (_scheduler, worker, lock);
+			LOG_TIMING ("encoder-wake thread=%1 queue=%2", thread_id(), _scheduler.size());
+			_full_condition.notify_all ();
+		}
+
+		/* Frames that we have in flight must either be written or put back on the queue,
+		   so we must not be interrupted until one or other of these things have happened.
+		*/
+		boost::this_thread::disable_interruption dis;
+
+		optional<pair<shared_ptr<DCPVideo>, Data> > encoded;
+
+		try {
+			if (connection && connection->stale ()) {
+				/* The server may have given up on this connection, so start again */
+				connection.reset ();
+			}
+
+			if (!connection) {
+				connection.reset (new EncodeServerConnection (server, pipeline_window));
+			}
+
+			if (first) {
+				optional<Data> cached = from_cache (first);
+				if (cached) {
+					frame_done (worker, first, *cached);
+				} else {
+					connection->send (first);
+				}
+				first.reset ();
+			}
+
+			/* Fill up the window with whatever we can get, unless we have been asked to
+			   stop, in which case we just finish what we have in flight.
+			*/
+			while (!connection->full () && !boost::this_thread::interruption_requested ()) {
+				shared_ptr<DCPVideo> vf;
+				{
+					boost::mutex::scoped_lock lock (_queue_mutex);
+					vf = _scheduler.pop (worker);
+					if (!vf) {
+						break;
+					}
+					LOG_TIMING ("encoder-pop thread=%1 frame=%2 eyes=%3", thread_id(), vf->index(), (int) vf->eyes ());
+					/* The queue might not be full any more, so notify anything that is waiting on that */
+					_full_condition.notify_all ();
+				}
+
+				optional<Data> cached = from_cache (vf);
+				if (cached) {
+					frame_done (worker, vf, *cached);
+				} else {
+					connection->send (vf);
+				}
+			}
+
+			if (!connection->idle ()) {
+				encoded = connection->receive ();
+			}
+
+			if (remote_backoff > 0) {
+				LOG_GENERAL ("%1 was lost, but now she is found; removing backoff", server.host_name ());
+				boost::mutex::scoped_lock lock (_queue_mutex);
+				_scheduler.set_backoff (worker, false);
+			}
+
+			/* This job succeeded, so remove any backoff */
+			remote_backoff = 0;
+
+		} catch (std::exception& e) {
+			if (remote_backoff < 60) {
+				/* back off more */
+				remote_backoff += 10;
+			}
+			LOG_ERROR (
+				N_("Remote encode on %1 failed (%2); thread sleeping for %3s"),
+				server.host_name(), e.what(), remote_backoff
+				);
+
+			list<shared_ptr<DCPVideo> > lost;
+			if (connection) {
+				lost = connection->in_flight ();
+				connection.reset ();
+			}
+			if (first) {
+				lost.push_back (first);
+			}
+
+			boost::mutex::scoped_lock lock (_queue_mutex);
+			_scheduler.set_backoff (worker, true);
+			BOOST_FOREACH (shared_ptr<DCPVideo> i, lost) {
+				LOG_GENERAL (N_("[%1] J2KEncoder thread pushes frame %2 back onto queue after failure"), thread_id(), i->index());
+				_scheduler.push_back (worker, i);
+			}
+		}
+
+		if (encoded) {
+			frame_done (worker, encoded->first, encoded->second);
+		}
+
+		if (remote_backoff > 0) {
+			boost::this_thread::restore_interruption ri (dis);
+			boost::this_thread::sleep (boost::posix_time::seconds (remote_backoff));
+		}
+	}
+}
+catch (boost::thread_interrupted& e) {
+	/* Ignore these and just stop the thread */
+	_full_condition.notify_all ();
+}
+catch (...)
+{
+	store_current ();
+	/* Wake anything waiting on _full_condition so it can see the exception */
+	_full_condition.notify_all ();
+}
+
+/** Register a worker with the scheduler and start a thread for it.  _threads_mutex must be held.
+ *  @param name Name of the worker, for logging.
+ *  @param server Server that the thread will send frames to, or none if it encodes locally.
+ *  @param function Thread function, which will be passed the worker's scheduler ID.
+ */
+void
+J2KEncoder::add_thread (string name, optional<EncodeServerDescription> server, boost::function<void (int)> function)
+{
+	int worker;
+	{
+		boost::mutex::scoped_lock lm (_queue_mutex);
+		worker = _scheduler.add_worker (name);
+	}
 
+	_threads.push_back (WorkerThread (new boost::thread (boost::bind (function, worker)), worker, server));
+}
+
+/** Bring our threads into line with the current configuration and list of servers.  Threads
+ *  for servers which have gone away (or changed) are asked to finish what they are doing
+ *  and stop, threads are started for new servers, and all others are left alone.
+ */
+void
+J2KEncoder::servers_list_changed ()
+{
 	boost::mutex::scoped_lock lm (_threads_mutex);
 
 #ifdef BOOST_THREAD_PLATFORM_WIN32
@@ -399,29 +741,86 @@ J2KEncoder::servers_list_changed ()
 	}
 #endif
 
-	if (!Config::instance()->only_servers_encode ()) {
-		for (int i = 0; i < Config::instance()->master_encoding_threads (); ++i) {
-			boost::thread* t = new boost::thread (boost::bind (&J2KEncoder::encoder_thread, this, optional<EncodeServerDescription> ()));
+	/* Local threads */
+
+	int const local_wanted = Config::instance()->only_servers_encode() ? 0 : Config::instance()->master_encoding_threads();
+	int local = 0;
+	for (list<WorkerThread>::iterator i = _threads.begin(); i != _threads.end(); ) {
+		list<WorkerThread>::iterator j = i;
+		++i;
+		if (!j->server) {
+			if (local < local_wanted) {
+				++local;
+			} else {
+				retire_thread (j);
+			}
+		}
+	}
+
+	for (int i = local; i < local_wanted; ++i) {
+		add_thread (String::compose ("localhost/%1", i), optional<EncodeServerDescription> (), boost::bind (&J2KEncoder::encoder_thread, this, _1, optional<EncodeServerDescription> ()));
+		boost::thread* t = _threads.back().thread;
 #ifdef DCPOMATIC_LINUX
-			pthread_setname_np (t->native_handle(), "encode-worker");
+		pthread_setname_np (t->native_handle(), "encode-worker");
 #endif
-			_threads.push_back (t);
 #ifdef BOOST_THREAD_PLATFORM_WIN32
-			if (windows_xp) {
-				SetThreadAffinityMask (t->native_handle(), 1 << i);
-			}
-#endif
+		if (windows_xp) {
+			SetThreadAffinityMask (t->native_handle(), 1 << i);
 		}
+#endif
 	}
 
+	/* Remote threads */
+
+	list<EncodeServerDescription> servers;
 	BOOST_FOREACH (EncodeServerDescription i, EncodeServerFinder::instance()->servers()) {
-		if (!i.current_link_version()) {
+		if (i.current_link_version()) {
+			servers.push_back (i);
+		}
+	}
+
+	/* Retire threads for servers that have gone or changed */
+	for (list<WorkerThread>::iterator i = _threads.begin(); i != _threads.end(); ) {
+		list<WorkerThread>::iterator j = i;
+		++i;
+		if (!j->server) {
+			continue;
+		}
+
+		bool found = false;
+		BOOST_FOREACH (EncodeServerDescription const& k, servers) {
+			if (k.host_name() == j->server->host_name() && k.threads() == j->server->threads() && k.link_version() == j->server->link_version()) {
+				found = true;
+			}
+		}
+
+		if (!found) {
+			LOG_GENERAL (N_("Retiring worker thread for remote %1"), j->server->host_name());
+			retire_thread (j);
+		}
+	}
+
+	/* Start threads for new servers */
+	BOOST_FOREACH (EncodeServerDescription const& i, servers) {
+		bool found = false;
+		BOOST_FOREACH (WorkerThread const& j, _threads) {
+			if (j.server && j.server->host_name() == i.host_name()) {
+				found = true;
+			}
+		}
+
+		if (found) {
 			continue;
 		}
 
 		LOG_GENERAL (N_("Adding %1 worker threads for remote %2"), i.threads(), i.host_name ());
 		for (int j = 0; j < i.threads(); ++j) {
-			_threads.push_back (new boost::thread (boost::bind (&J2KEncoder::encoder_thread, this, i)));
+			string const name = String::compose ("%1/%2", i.host_name(), j);
+			if (i.pipelined ()) {
+				add_thread (name, i, boost::bind (&J2KEncoder::pipelined_encoder_thread, this, _1, i));
+			} else {
+				add_thread (name, i, boost::bind (&J2KEncoder::encoder_thread, this, _1, i));
+			}
 		}
 	}
 
@@ -29,18 +29,23 @@
 #include "cross.h"
 #include "event_history.h"
 #include "exception_store.h"
+#include "encode_scheduler.h"
+#include "encode_server_description.h"
+#include <dcp/data.h>
 #include <boost/shared_ptr.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/condition.hpp>
 #include <boost/thread.hpp>
 #include <boost/optional.hpp>
 #include <boost/signals2.hpp>
+#include <boost/function.hpp>
 #include <boost/enable_shared_from_this.hpp>
 #include <list>
+#include <map>
+#include <vector>
 #include <stdint.h>
 
 class Film;
-class EncodeServerDescription;
 class DCPVideo;
 class Writer;
 class Job;
@@ -50,7 +55,7 @@ class PlayerVideo;
  *  @brief Class to manage encoding to J2K.
  *
  *  This class keeps a queue of frames to be encoded and distributes
- *  the work around threads and encoding servers.
+ *  the work around threads and encoding servers using an EncodeScheduler.
  */
 
 class J2KEncoder : public boost::noncopyable, public ExceptionStore, public boost::enable_shared_from_this<J2KEncoder>
@@ -70,38 +75,74 @@ public:
 
 	float current_encoding_rate () const;
 	int video_frames_enqueued () const;
+	int video_frames_reused () const;
+	std::vector<EncodeWorkerStatus> worker_status () const;
 
 	void servers_list_changed ();
 
 private:
 
+	/** A thread which is encoding frames for us */
+	struct WorkerThread
+	{
+		WorkerThread (boost::thread* t, int w, boost::optional<EncodeServerDescription> s)
+			: thread (t)
+			, worker (w)
+			, server (s)
+		{}
+
+		boost::thread* thread;
+		/** EncodeScheduler ID of this thread */
+		int worker;
+		/** Server that this thread sends frames to, or none if it encodes locally */
+		boost::optional<EncodeServerDescription> server;
+	};
+
 	static void call_servers_list_changed (boost::weak_ptr<J2KEncoder> encoder);
 
-	void frame_done ();
+	void frame_done (int worker, boost::shared_ptr<DCPVideo> frame, dcp::Data encoded);
 
-	void encoder_thread (boost::optional<EncodeServerDescription>);
+	void encoder_thread (int worker, boost::optional<EncodeServerDescription>);
+	void pipelined_encoder_thread (int worker, EncodeServerDescription);
 	void terminate_threads ();
+	void add_thread (std::string name, boost::optional<EncodeServerDescription> server, boost::function<void (int)> function);
+	void retire_thread (std::list<WorkerThread>::iterator i);
+	void join_thread (boost::thread* thread);
+	boost::optional<dcp::Data> from_cache (boost::shared_ptr<DCPVideo> frame);
+	void to_cache (boost::shared_ptr<DCPVideo> frame, dcp::Data encoded);
+	void mop_up_thread (std::list<boost::shared_ptr<DCPVideo> >* frames, boost::mutex* mutex);
 
 	/** Film that we are encoding */
 	boost::shared_ptr<const Film> _film;
 
 	EventHistory _history;
 
-	/** Mutex for _threads */
+	/** Mutex for _threads and _retired_threads */
 	mutable boost::mutex _threads_mutex;
-	std::list<boost::thread *> _threads;
+	std::list<WorkerThread> _threads;
+	/** Threads which have been asked to finish what they are doing and then stop */
+	std::list<WorkerThread> _retired_threads;
+	/** Mutex for _scheduler */
 	mutable boost::mutex _queue_mutex;
-	std::list<boost::shared_ptr<DCPVideo> > _queue;
-	/** condition to manage thread wakeups when we have nothing to do */
-	boost::condition _empty_condition;
+	EncodeScheduler _scheduler;
+	/** Number of frames found in the J2K cache; protected by _queue_mutex */
+	int _cache_hits;
+	/** Number of frames not found in the J2K cache; protected by _queue_mutex */
+	int _cache_misses;
 	/** condition to manage thread wakeups when we have too much to do */
 	boost::condition _full_condition;
 
 	boost::shared_ptr<Writer> _writer;
 	Waker _waker;
 
-	boost::shared_ptr<PlayerVideo> _last_player_video[EYES_COUNT];
-	boost::optional<DCPTime> _last_player_video_time;
+	/** The last PlayerVideo for each eye, indexed by reel, since reels may be given to us
+	    at the same time; protected by _queue_mutex
+	*/
+	std::map<size_t, boost::shared_ptr<PlayerVideo> > _last_player_video[EYES_COUNT];
+	/** Number of video frames that we have been given; protected by _queue_mutex */
+	int _video_frames_enqueued;
+	/** Number of video frames taken from Writer::previous_frame(); protected by _queue_mutex */
+	int _video_frames_reused;
 
 	boost::signals2::scoped_connection _server_found_connection;
 };
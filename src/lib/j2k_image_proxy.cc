@@ -19,6 +19,7 @@
 */
 
 #include "j2k_image_proxy.h"
+#include "digester.h"
 #include "dcpomatic_socket.h"
 #include "image.h"
 #include "dcpomatic_assert.h"
@@ -190,7 +191,7 @@ J2KImageProxy::add_metadata (xmlpp::Node* node) const
 }
 
 void
-J2KImageProxy::send_binary (shared_ptr<Socket> socket) const
+J2KImageProxy::send_binary (shared_ptr<Socket> socket, TransportCompression) const
 {
 	socket->write (_data.data().get(), _data.size());
 }
@@ -210,6 +211,18 @@ J2KImageProxy::same (shared_ptr<const ImageProxy> other) const
 	return memcmp (_data.data().get(), jp->_data.data().get(), _data.size()) == 0;
 }
 
+void
+J2KImageProxy::add_digest (Digester& digester) const
+{
+	digester.add (string ("J2K"));
+	digester.add (_size.width);
+	digester.add (_size.height);
+	digester.add (static_cast<int> (_pixel_format));
+	digester.add (_eye ? static_cast<int> (*_eye) : -1);
+	digester.add (_forced_reduction.get_value_or (-1));
+	digester.add (_data.data().get(), _data.size());
+}
+
 J2KImageProxy::J2KImageProxy (Data data, dcp::Size size, AVPixelFormat pixel_format)
 	: _data (data)
 	, _size (size)
@@ -55,9 +55,10 @@ public:
 		) const;
 
 	void add_metadata (xmlpp::Node *) const;
-	void send_binary (boost::shared_ptr<Socket>) const;
+	void send_binary (boost::shared_ptr<Socket>, TransportCompression) const;
 	/** @return true if our image is definitely the same as another, false if it is probably not */
 	bool same (boost::shared_ptr<const ImageProxy>) const;
+	void add_digest (Digester& digester) const;
 	int prepare (boost::optional<dcp::Size> = boost::optional<dcp::Size>()) const;
 
 	dcp::Data j2k () const {
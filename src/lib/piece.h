@@ -26,6 +26,7 @@
 
 class Content;
 class Decoder;
+class DecoderThread;
 
 class Piece
 {
@@ -39,6 +40,8 @@ public:
 
 	boost::shared_ptr<Content> content;
 	boost::shared_ptr<Decoder> decoder;
+	/** thread running decoder ahead of the Player, or 0 */
+	boost::shared_ptr<DecoderThread> decoder_thread;
 	FrameRateChange frc;
 	bool done;
 };
@@ -38,6 +38,7 @@
 #include "referenced_reel_asset.h"
 #include "decoder_factory.h"
 #include "decoder.h"
+#include "decoder_thread.h"
 #include "video_decoder.h"
 #include "audio_decoder.h"
 #include "text_content.h"
@@ -45,6 +46,7 @@
 #include "ffmpeg_content.h"
 #include "audio_content.h"
 #include "dcp_decoder.h"
+#include "ffmpeg_decoder.h"
 #include "image_decoder.h"
 #include "compose.hpp"
 #include "shuffler.h"
@@ -82,6 +84,9 @@ int const PlayerProperty::FILM_CONTAINER = 702;
 int const PlayerProperty::FILM_VIDEO_FRAME_RATE = 703;
 int const PlayerProperty::DCP_DECODE_REDUCTION = 704;
 
+/** Number of passes that a DecoderThread may run ahead of us */
+static int const decode_ahead_passes = 8;
+
 Player::Player (shared_ptr<const Film> film, shared_ptr<const Playlist> playlist)
 	: _film (film)
 	, _playlist (playlist)
@@ -91,6 +96,7 @@ Player::Player (shared_ptr<const Film> film, shared_ptr<const Playlist> playlist
 	, _ignore_text (false)
 	, _always_burn_open_subtitles (false)
 	, _fast (false)
+	, _defer_video_decoding (false)
 	, _play_referenced (false)
 	, _audio_merger (_film->audio_frame_rate())
 	, _shuffler (0)
@@ -133,6 +139,37 @@ have_audio (shared_ptr<Piece> piece)
 	return piece->decoder && piece->decoder->audio;
 }
 
+/** @return The position of a piece's decoder as far as we are concerned */
+static ContentTime
+decoder_position (shared_ptr<const Piece> piece)
+{
+	return piece->decoder_thread ? piece->decoder_thread->position() : piece->decoder->position();
+}
+
+static bool
+decoder_pass (shared_ptr<Piece> piece)
+{
+	return piece->decoder_thread ? piece->decoder_thread->pass() : piece->decoder->pass();
+}
+
+static void
+decoder_seek (shared_ptr<Piece> piece, ContentTime time, bool accurate)
+{
+	if (piece->decoder_thread) {
+		piece->decoder_thread->seek (time, accurate);
+	} else {
+		piece->decoder->seek (time, accurate);
+	}
+}
+
+/** @return handler, or a version of it which will be called via thread if there is one */
+template <class F>
+static F
+maybe_defer (shared_ptr<DecoderThread> thread, F handler)
+{
+	return thread ? thread->defer (handler) : handler;
+}
+
 void
 Player::setup_pieces_unlocked ()
 {
@@ -183,37 +220,58 @@ Player::setup_pieces_unlocked ()
 			}
 		}
 
+		shared_ptr<FFmpegDecoder> ffmpeg = dynamic_pointer_cast<FFmpegDecoder> (decoder);
+		if (ffmpeg) {
+			ffmpeg->set_defer_video_decoding (_defer_video_decoding);
+		}
+
 		shared_ptr<Piece> piece (new Piece (i, decoder, frc));
 		_pieces.push_back (piece);
 
+		if (Config::instance()->parallel_content_decoding()) {
+			/* Anything that the decoder emits will be passed to our handlers when we call
+			   the thread's pass(), in the same order as if we were calling the decoder's.
+			*/
+			piece->decoder_thread.reset (new DecoderThread (decoder, decode_ahead_passes));
+		}
+
+		shared_ptr<DecoderThread> thread = piece->decoder_thread;
+
 		if (decoder->video) {
+			boost::function<void (ContentVideo)> handler;
 			if (i->video->frame_type() == VIDEO_FRAME_TYPE_3D_LEFT || i->video->frame_type() == VIDEO_FRAME_TYPE_3D_RIGHT) {
 				/* We need a Shuffler to cope with 3D L/R video data arriving out of sequence */
-				decoder->video->Data.connect (bind (&Shuffler::video, _shuffler, weak_ptr<Piece>(piece), _1));
+				handler = bind (&Shuffler::video, _shuffler, weak_ptr<Piece>(piece), _1);
 			} else {
-				decoder->video->Data.connect (bind (&Player::video, this, weak_ptr<Piece>(piece), _1));
+				handler = bind (&Player::video, this, weak_ptr<Piece>(piece), _1);
 			}
+			decoder->video->Data.connect (maybe_defer (thread, handler));
 		}
 
 		if (decoder->audio) {
-			decoder->audio->Data.connect (bind (&Player::audio, this, weak_ptr<Piece> (piece), _1, _2));
+			boost::function<void (AudioStreamPtr, ContentAudio)> handler = bind (&Player::audio, this, weak_ptr<Piece> (piece), _1, _2);
+			decoder->audio->Data.connect (maybe_defer (thread, handler));
 		}
 
 		list<shared_ptr<TextDecoder> >::const_iterator j = decoder->text.begin();
 
 		while (j != decoder->text.end()) {
-			(*j)->BitmapStart.connect (
-				bind(&Player::bitmap_text_start, this, weak_ptr<Piece>(piece), weak_ptr<const TextContent>((*j)->content()), _1)
-				);
-			(*j)->PlainStart.connect (
-				bind(&Player::plain_text_start, this, weak_ptr<Piece>(piece), weak_ptr<const TextContent>((*j)->content()), _1)
-				);
-			(*j)->Stop.connect (
-				bind(&Player::subtitle_stop, this, weak_ptr<Piece>(piece), weak_ptr<const TextContent>((*j)->content()), _1)
-				);
+			boost::function<void (ContentBitmapText)> bitmap_start =
+				bind(&Player::bitmap_text_start, this, weak_ptr<Piece>(piece), weak_ptr<const TextContent>((*j)->content()), _1);
+			(*j)->BitmapStart.connect (maybe_defer (thread, bitmap_start));
+			boost::function<void (ContentStringText)> plain_start =
+				bind(&Player::plain_text_start, this, weak_ptr<Piece>(piece), weak_ptr<const TextContent>((*j)->content()), _1);
+			(*j)->PlainStart.connect (maybe_defer (thread, plain_start));
+			boost::function<void (ContentTime)> stop =
+				bind(&Player::subtitle_stop, this, weak_ptr<Piece>(piece), weak_ptr<const TextContent>((*j)->content()), _1);
+			(*j)->Stop.connect (maybe_defer (thread, stop));
 
 			++j;
 		}
+
+		if (thread) {
+			thread->start ();
+		}
 	}
 
 	_stream_states.clear ();
@@ -453,6 +511,19 @@ Player::set_fast ()
 	setup_pieces_unlocked ();
 }
 
+/** Sets up the player to pass on compressed frames of intra-frame video (e.g. ProRes)
+ *  where it can, so that they are decoded by whatever calls PlayerVideo::image().
+ *  This is only worthwhile when encoding, where that happens in the J2K encoder
+ *  threads or on encoding servers.
+ */
+void
+Player::set_defer_video_decoding ()
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	_defer_video_decoding = true;
+	setup_pieces_unlocked ();
+}
+
 void
 Player::set_play_referenced ()
 {
@@ -571,7 +642,7 @@ Player::pass ()
 			continue;
 		}
 
-		DCPTime const t = content_time_to_dcp (i, max(i->decoder->position(), i->content->trim_start()));
+		DCPTime const t = content_time_to_dcp (i, max(decoder_position(i), i->content->trim_start()));
 		if (t > i->content->end(_film)) {
 			i->done = true;
 		} else {
@@ -612,7 +683,7 @@ Player::pass ()
 	switch (which) {
 	case CONTENT:
 	{
-		earliest_content->done = earliest_content->decoder->pass ();
+		earliest_content->done = decoder_pass (earliest_content);
 		shared_ptr<DCPContent> dcp = dynamic_pointer_cast<DCPContent>(earliest_content->content);
 		if (dcp && !_play_referenced && dcp->reference_audio()) {
 			/* We are skipping some referenced DCP audio content, so we need to update _last_audio_time
@@ -1055,11 +1126,11 @@ Player::seek (DCPTime time, bool accurate)
 	BOOST_FOREACH (shared_ptr<Piece> i, _pieces) {
 		if (time < i->content->position()) {
 			/* Before; seek to the start of the content */
-			i->decoder->seek (dcp_to_content_time (i, i->content->position()), accurate);
+			decoder_seek (i, dcp_to_content_time (i, i->content->position()), accurate);
 			i->done = false;
 		} else if (i->content->position() <= time && time < i->content->end(_film)) {
 			/* During; seek to position */
-			i->decoder->seek (dcp_to_content_time (i, time), accurate);
+			decoder_seek (i, dcp_to_content_time (i, time), accurate);
 			i->done = false;
 		} else {
 			/* After; this piece is done */
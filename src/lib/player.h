@@ -84,6 +84,7 @@ public:
 	void set_ignore_text ();
 	void set_always_burn_open_subtitles ();
 	void set_fast ();
+	void set_defer_video_decoding ();
 	void set_play_referenced ();
 	void set_dcp_decode_reduction (boost::optional<int> reduction);
 
@@ -162,6 +163,8 @@ private:
 	bool _always_burn_open_subtitles;
 	/** true if we should try to be fast rather than high quality */
 	bool _fast;
+	/** true if decoders may leave decoding of intra-frame video to whoever asks for the image */
+	bool _defer_video_decoding;
 	/** true if we should `play' (i.e output) referenced DCP data (e.g. for preview) */
 	bool _play_referenced;
 
@@ -24,8 +24,12 @@
 #include "image.h"
 #include "image_proxy.h"
 #include "j2k_image_proxy.h"
+#include "raw_image_proxy.h"
 #include "film.h"
+#include "digester.h"
+#include "direct_xyz.h"
 #include <dcp/raw_convert.h>
+#include <dcp/openjpeg_image.h>
 extern "C" {
 #include <libavutil/pixfmt.h>
 }
@@ -82,7 +86,11 @@ PlayerVideo::PlayerVideo (shared_ptr<cxml::Node> node, shared_ptr<Socket> socket
 	/* Assume that the ColourConversion uses the current state version */
 	_colour_conversion = ColourConversion::from_xml (node, Film::current_state_version);
 
-	_in = image_proxy_factory (node->node_child ("In"), socket);
+	TransportCompression const compression = string_to_transport_compression (
+		node->optional_string_child("TransportCompression").get_value_or(transport_compression_to_string(TRANSPORT_COMPRESSION_NONE))
+		);
+
+	_in = image_proxy_factory (node->node_child ("In"), socket, compression);
 
 	if (node->optional_number_child<int> ("SubtitleX")) {
 
@@ -90,7 +98,7 @@ PlayerVideo::PlayerVideo (shared_ptr<cxml::Node> node, shared_ptr<Socket> socket
 			new Image (AV_PIX_FMT_BGRA, dcp::Size (node->number_child<int> ("SubtitleWidth"), node->number_child<int> ("SubtitleHeight")), true)
 			);
 
-		image->read_from_socket (socket);
+		image->read_from_socket (socket, compression);
 
 		_text = PositionImage (image, Position<int> (node->number_child<int> ("SubtitleX"), node->number_child<int> ("SubtitleY")));
 	}
@@ -109,43 +117,32 @@ PlayerVideo::image (function<AVPixelFormat (AVPixelFormat)> pixel_format, bool a
 
 	boost::mutex::scoped_lock lm (_mutex);
 	if (!_image || _crop != _image_crop || _inter_size != _image_inter_size || _out_size != _image_out_size || _fade != _image_fade) {
-		make_image (pixel_format, aligned, fast);
+		make_image (pixel_format, aligned, fast, _in->image (_inter_size));
 	}
 	return _image;
 }
 
-/** Create an image for this frame.  A lock must be held on _mutex.
- *  @param pixel_format Function which is called to decide what pixel format the output image should be;
- *  it is passed the pixel format of the input image from the ImageProxy, and should return the desired
- *  output pixel format.  Two functions force and keep_xyz_or_rgb are provided for use here.
- *  @param aligned true if the output image should be aligned to 32-byte boundaries.
- *  @param fast true to be fast at the expense of quality.
+/** @return Crop to apply to an image that we have got from _in, taking into account
+ *  the part of the image that we want and any reduction that the ImageProxy has done.
+ *  @param in_size Size of the image from _in.
+ *  @param reduce Reduction factor that the ImageProxy applied.
  */
-void
-PlayerVideo::make_image (function<AVPixelFormat (AVPixelFormat)> pixel_format, bool aligned, bool fast) const
+Crop
+PlayerVideo::total_crop (dcp::Size in_size, int reduce) const
 {
-	_image_crop = _crop;
-	_image_inter_size = _inter_size;
-	_image_out_size = _out_size;
-	_image_fade = _fade;
-
-	pair<shared_ptr<Image>, int> prox = _in->image (_inter_size);
-	shared_ptr<Image> im = prox.first;
-	int const reduce = prox.second;
-
-	Crop total_crop = _crop;
+	Crop crop = _crop;
 	switch (_part) {
 	case PART_LEFT_HALF:
-		total_crop.right += im->size().width / 2;
+		crop.right += in_size.width / 2;
 		break;
 	case PART_RIGHT_HALF:
-		total_crop.left += im->size().width / 2;
+		crop.left += in_size.width / 2;
 		break;
 	case PART_TOP_HALF:
-		total_crop.bottom += im->size().height / 2;
+		crop.bottom += in_size.height / 2;
 		break;
 	case PART_BOTTOM_HALF:
-		total_crop.top += im->size().height / 2;
+		crop.top += in_size.height / 2;
 		break;
 	default:
 		break;
@@ -154,19 +151,76 @@ PlayerVideo::make_image (function<AVPixelFormat (AVPixelFormat)> pixel_format, b
 	if (reduce > 0) {
 		/* Scale the crop down to account for the scaling that has already happened in ImageProxy::image */
 		int const r = pow(2, reduce);
-		total_crop.left /= r;
-		total_crop.right /= r;
-		total_crop.top /= r;
-		total_crop.bottom /= r;
+		crop.left /= r;
+		crop.right /= r;
+		crop.top /= r;
+		crop.bottom /= r;
+	}
+
+	return crop;
+}
+
+/** Convert this frame straight to XYZ for JPEG2000 encoding, if that can be done without
+ *  going through an RGB image.
+ *  @return XYZ image, or 0 if this frame must be converted by the usual route (for example
+ *  because it has no colour conversion, because it has a subtitle burnt into it, or because
+ *  its pixel format is not supported by convert_directly_to_xyz()).  In the last case the
+ *  image that has been fetched from _in is used to make the RGB image that the usual route
+ *  will ask for, so that _in does not have to decode it again.
+ */
+shared_ptr<dcp::OpenJPEGImage>
+PlayerVideo::direct_xyz (dcp::NoteHandler note) const
+{
+	if (!_colour_conversion || _text) {
+		return shared_ptr<dcp::OpenJPEGImage> ();
 	}
 
+	pair<shared_ptr<Image>, int> prox = _in->image (_inter_size);
+	shared_ptr<const Image> im = prox.first;
+	if (!can_convert_directly_to_xyz (im->pixel_format())) {
+		boost::mutex::scoped_lock lm (_mutex);
+		make_image (&PlayerVideo::keep_xyz_or_rgb, true, false, prox);
+		return shared_ptr<dcp::OpenJPEGImage> ();
+	}
+
+	Crop crop = total_crop (im->size(), prox.second);
+	dcp::YUVToRGB const yuv_to_rgb = _colour_conversion.get().yuv_to_rgb();
+
+	if (crop.apply (im->size()) != _inter_size) {
+		/* We need to scale, so do that (and the crop) first without changing the pixel format */
+		im = im->crop_scale_window (crop, _inter_size, _inter_size, yuv_to_rgb, im->pixel_format(), true, false);
+		crop = Crop ();
+	}
+
+	return convert_directly_to_xyz (im, crop, _out_size, yuv_to_rgb, _colour_conversion.get(), _fade, note);
+}
+
+/** Create an image for this frame.  A lock must be held on _mutex.
+ *  @param pixel_format Function which is called to decide what pixel format the output image should be;
+ *  it is passed the pixel format of the input image from the ImageProxy, and should return the desired
+ *  output pixel format.  Two functions force and keep_xyz_or_rgb are provided for use here.
+ *  @param aligned true if the output image should be aligned to 32-byte boundaries.
+ *  @param fast true to be fast at the expense of quality.
+ *  @param prox Image and reduction factor from _in.
+ */
+void
+PlayerVideo::make_image (function<AVPixelFormat (AVPixelFormat)> pixel_format, bool aligned, bool fast, pair<shared_ptr<Image>, int> prox) const
+{
+	_image_crop = _crop;
+	_image_inter_size = _inter_size;
+	_image_out_size = _out_size;
+	_image_fade = _fade;
+
+	shared_ptr<Image> im = prox.first;
+	int const reduce = prox.second;
+
 	dcp::YUVToRGB yuv_to_rgb = dcp::YUV_TO_RGB_REC601;
 	if (_colour_conversion) {
 		yuv_to_rgb = _colour_conversion.get().yuv_to_rgb();
 	}
 
 	_image = im->crop_scale_window (
-		total_crop, _inter_size, _out_size, yuv_to_rgb, pixel_format (im->pixel_format()), aligned, fast
+		total_crop (im->size(), reduce), _inter_size, _out_size, yuv_to_rgb, pixel_format (im->pixel_format()), aligned, fast
 		);
 
 	if (_text) {
@@ -204,11 +258,11 @@ PlayerVideo::add_metadata (xmlpp::Node* node) const
 }
 
 void
-PlayerVideo::send_binary (shared_ptr<Socket> socket) const
+PlayerVideo::send_binary (shared_ptr<Socket> socket, TransportCompression compression) const
 {
-	_in->send_binary (socket);
+	_in->send_binary (socket, compression);
 	if (_text) {
-		_text->image->write_to_socket (socket);
+		_text->image->write_to_socket (socket, compression);
 	}
 }
 
@@ -286,7 +340,7 @@ PlayerVideo::prepare (function<AVPixelFormat (AVPixelFormat)> pixel_format, bool
 	_in->prepare (_inter_size);
 	boost::mutex::scoped_lock lm (_mutex);
 	if (!_image) {
-		make_image (pixel_format, aligned, fast);
+		make_image (pixel_format, aligned, fast, _in->image (_inter_size));
 	}
 }
 
@@ -316,6 +370,64 @@ PlayerVideo::shallow_copy () const
 		);
 }
 
+/** @return A copy of this PlayerVideo (including any text) whose image has been decoded
+ *  and is held in a RawImageProxy.
+ */
+shared_ptr<PlayerVideo>
+PlayerVideo::decoded_copy () const
+{
+	shared_ptr<PlayerVideo> copy (
+		new PlayerVideo(
+			shared_ptr<ImageProxy> (new RawImageProxy (_in->image().first)),
+			_crop,
+			_fade,
+			_inter_size,
+			_out_size,
+			_eyes,
+			_part,
+			_colour_conversion,
+			_content,
+			_video_frame
+			)
+		);
+
+	copy->_text = _text;
+	return copy;
+}
+
+/** Add everything that affects the image that we will produce to a Digester */
+void
+PlayerVideo::add_digest (Digester& digester) const
+{
+	_in->add_digest (digester);
+	digester.add (_crop.left);
+	digester.add (_crop.right);
+	digester.add (_crop.top);
+	digester.add (_crop.bottom);
+	digester.add (_fade.get_value_or (-1));
+	digester.add (_inter_size.width);
+	digester.add (_inter_size.height);
+	digester.add (_out_size.width);
+	digester.add (_out_size.height);
+	digester.add (static_cast<int> (_eyes));
+	digester.add (static_cast<int> (_part));
+	digester.add (_colour_conversion ? _colour_conversion->identifier() : string ("none"));
+	if (_text) {
+		_text->image->add_digest (digester);
+		digester.add (_text->position.x);
+		digester.add (_text->position.y);
+	} else {
+		digester.add (string ("no text"));
+	}
+}
+
+/** @return the oldest server link version which can accept this PlayerVideo */
+int
+PlayerVideo::minimum_link_version () const
+{
+	return _in->minimum_link_version ();
+}
+
 /** Re-read crop, fade, inter/out size and colour conversion from our content.
  *  @return true if this was possible, false if not.
  */
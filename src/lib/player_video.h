@@ -37,6 +37,11 @@ class Image;
 class ImageProxy;
 class Film;
 class Socket;
+class Digester;
+
+namespace dcp {
+	class OpenJPEGImage;
+}
 
 /** Everything needed to describe a video frame coming out of the player, but with the
  *  bits still their raw form.  We may want to combine the bits on a remote machine,
@@ -61,20 +66,25 @@ public:
 	PlayerVideo (boost::shared_ptr<cxml::Node>, boost::shared_ptr<Socket>);
 
 	boost::shared_ptr<PlayerVideo> shallow_copy () const;
+	boost::shared_ptr<PlayerVideo> decoded_copy () const;
 
 	void set_text (PositionImage);
 
 	void prepare (boost::function<AVPixelFormat (AVPixelFormat)> pixel_format, bool aligned, bool fast);
 	boost::shared_ptr<Image> image (boost::function<AVPixelFormat (AVPixelFormat)> pixel_format, bool aligned, bool fast) const;
 
+	boost::shared_ptr<dcp::OpenJPEGImage> direct_xyz (dcp::NoteHandler note) const;
+
 	static AVPixelFormat force (AVPixelFormat, AVPixelFormat);
 	static AVPixelFormat keep_xyz_or_rgb (AVPixelFormat);
 
 	void add_metadata (xmlpp::Node* node) const;
-	void send_binary (boost::shared_ptr<Socket> socket) const;
+	void send_binary (boost::shared_ptr<Socket> socket, TransportCompression compression) const;
 
 	bool reset_metadata (boost::shared_ptr<const Film> film, dcp::Size video_container_size, dcp::Size film_frame_size);
 
+	int minimum_link_version () const;
+
 	bool has_j2k () const;
 	dcp::Data j2k () const;
 
@@ -99,6 +109,7 @@ public:
 	}
 
 	bool same (boost::shared_ptr<const PlayerVideo> other) const;
+	void add_digest (Digester& digester) const;
 
 	size_t memory_used () const;
 
@@ -107,7 +118,8 @@ public:
 	}
 
 private:
-	void make_image (boost::function<AVPixelFormat (AVPixelFormat)> pixel_format, bool aligned, bool fast) const;
+	Crop total_crop (dcp::Size in_size, int reduce) const;
+	void make_image (boost::function<AVPixelFormat (AVPixelFormat)> pixel_format, bool aligned, bool fast, std::pair<boost::shared_ptr<Image>, int> prox) const;
 
 	boost::shared_ptr<const ImageProxy> _in;
 	Crop _crop;
@@ -47,6 +47,7 @@ using std::min;
 using std::max;
 using std::string;
 using std::pair;
+using std::make_pair;
 using boost::optional;
 using boost::shared_ptr;
 using boost::weak_ptr;
@@ -172,19 +173,32 @@ Playlist::maybe_sequence (shared_ptr<const Film> film)
 	_sequencing = false;
 }
 
+/** @return true if a piece of content affects the DCP's picture, either because
+ *  it has video or because it has burnt-in text.
+ */
+static bool
+contributes_to_video (shared_ptr<const Content> content)
+{
+	if (content->video) {
+		return true;
+	}
+
+	BOOST_FOREACH (shared_ptr<TextContent> i, content->text) {
+		if (i->burn()) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
 string
 Playlist::video_identifier () const
 {
 	string t;
 
 	BOOST_FOREACH (shared_ptr<const Content> i, content()) {
-		bool burn = false;
-		BOOST_FOREACH (shared_ptr<TextContent> j, i->text) {
-			if (j->burn()) {
-				burn = true;
-			}
-		}
-		if (i->video || burn) {
+		if (contributes_to_video (i)) {
 			t += i->identifier ();
 		}
 	}
@@ -194,6 +208,63 @@ Playlist::video_identifier () const
 	return digester.get ();
 }
 
+/** Split a period of the DCP into segments at every point where some content which
+ *  affects the picture starts or stops, and give each segment an identifier made from
+ *  the content that is visible during it.  A segment whose identifier has not changed
+ *  between two encodes will produce the same picture both times.
+ *  @param film Film that this Playlist is for.
+ *  @param period Period to split.
+ *  @return Segments, in order, covering the whole of period.
+ */
+list<pair<DCPTimePeriod, string> >
+Playlist::video_segments (shared_ptr<const Film> film, DCPTimePeriod period) const
+{
+	ContentList cl;
+	BOOST_FOREACH (shared_ptr<Content> i, content()) {
+		if (contributes_to_video (i)) {
+			cl.push_back (i);
+		}
+	}
+
+	list<DCPTime> edges;
+	edges.push_back (period.from);
+	edges.push_back (period.to);
+	BOOST_FOREACH (shared_ptr<Content> i, cl) {
+		DCPTime const e[] = { i->position(), i->end(film) };
+		BOOST_FOREACH (DCPTime j, e) {
+			if (j > period.from && j < period.to) {
+				edges.push_back (j);
+			}
+		}
+	}
+
+	edges.sort ();
+	edges.unique ();
+
+	list<pair<DCPTimePeriod, string> > segments;
+	for (list<DCPTime>::const_iterator i = edges.begin(); i != edges.end(); ++i) {
+		list<DCPTime>::const_iterator j = i;
+		++j;
+		if (j == edges.end()) {
+			break;
+		}
+
+		DCPTimePeriod const segment (*i, *j);
+		string t;
+		BOOST_FOREACH (shared_ptr<Content> k, cl) {
+			if (DCPTimePeriod(k->position(), k->end(film)).overlap(segment)) {
+				t += k->identifier ();
+			}
+		}
+
+		Digester digester;
+		digester.add (t.c_str(), t.length());
+		segments.push_back (make_pair (segment, digester.get()));
+	}
+
+	return segments;
+}
+
 /** @param film Film that this Playlist is for.
  *  @param node &lt;Playlist&gt; node.
  *  @param version Metadata version number.
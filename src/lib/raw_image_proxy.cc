@@ -19,6 +19,7 @@
 */
 
 #include "raw_image_proxy.h"
+#include "digester.h"
 #include "image.h"
 #include <dcp/raw_convert.h>
 #include <dcp/util.h>
@@ -44,14 +45,14 @@ RawImageProxy::RawImageProxy (shared_ptr<Image> image)
 
 }
 
-RawImageProxy::RawImageProxy (shared_ptr<cxml::Node> xml, shared_ptr<Socket> socket)
+RawImageProxy::RawImageProxy (shared_ptr<cxml::Node> xml, shared_ptr<Socket> socket, TransportCompression compression)
 {
 	dcp::Size size (
 		xml->number_child<int> ("Width"), xml->number_child<int> ("Height")
 		);
 
 	_image.reset (new Image (static_cast<AVPixelFormat> (xml->number_child<int> ("PixelFormat")), size, true));
-	_image->read_from_socket (socket);
+	_image->read_from_socket (socket, compression);
 }
 
 pair<shared_ptr<Image>, int>
@@ -70,9 +71,9 @@ RawImageProxy::add_metadata (xmlpp::Node* node) const
 }
 
 void
-RawImageProxy::send_binary (shared_ptr<Socket> socket) const
+RawImageProxy::send_binary (shared_ptr<Socket> socket, TransportCompression compression) const
 {
-	_image->write_to_socket (socket);
+	_image->write_to_socket (socket, compression);
 }
 
 bool
@@ -86,6 +87,13 @@ RawImageProxy::same (shared_ptr<const ImageProxy> other) const
 	return (*_image.get()) == (*rp->image().first.get());
 }
 
+void
+RawImageProxy::add_digest (Digester& digester) const
+{
+	digester.add (string ("Raw"));
+	_image->add_digest (digester);
+}
+
 size_t
 RawImageProxy::memory_used () const
 {
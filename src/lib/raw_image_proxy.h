@@ -27,15 +27,16 @@ class RawImageProxy : public ImageProxy
 {
 public:
 	explicit RawImageProxy (boost::shared_ptr<Image>);
-	RawImageProxy (boost::shared_ptr<cxml::Node> xml, boost::shared_ptr<Socket> socket);
+	RawImageProxy (boost::shared_ptr<cxml::Node> xml, boost::shared_ptr<Socket> socket, TransportCompression compression);
 
 	std::pair<boost::shared_ptr<Image>, int> image (
 		boost::optional<dcp::Size> size = boost::optional<dcp::Size> ()
 		) const;
 
 	void add_metadata (xmlpp::Node *) const;
-	void send_binary (boost::shared_ptr<Socket>) const;
+	void send_binary (boost::shared_ptr<Socket>, TransportCompression) const;
 	bool same (boost::shared_ptr<const ImageProxy>) const;
+	void add_digest (Digester& digester) const;
 	size_t memory_used () const;
 
 private:
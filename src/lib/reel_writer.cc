@@ -29,6 +29,10 @@
 #include "compose.hpp"
 #include "audio_buffers.h"
 #include "image.h"
+#include "util.h"
+#include "config.h"
+#include "resume_verifier.h"
+#include "frame_info_index.h"
 #include <dcp/mono_picture_asset.h>
 #include <dcp/stereo_picture_asset.h>
 #include <dcp/sound_asset.h>
@@ -47,6 +51,8 @@
 #include <dcp/raw_convert.h>
 #include <dcp/subtitle_image.h>
 #include <boost/foreach.hpp>
+#include <boost/scoped_array.hpp>
+#include <cstring>
 
 #include "i18n.h"
 
@@ -55,17 +61,29 @@ using std::string;
 using std::cout;
 using std::exception;
 using std::map;
+using std::pair;
+using std::make_pair;
+using std::vector;
 using boost::shared_ptr;
 using boost::optional;
 using boost::dynamic_pointer_cast;
+using boost::scoped_array;
 using dcp::Data;
 using dcp::raw_convert;
 
-int const ReelWriter::_info_size = 48;
 
-/** @param job Related job, or 0 */
+static void
+ignore_progress (float)
+{
+
+}
+
+/** @param job Related job, or 0.
+ *  @param attempt If set, make only the picture asset, writing it and its info file to files
+ *  named for this attempt by a master to get the reel made on an encode server.
+ */
 ReelWriter::ReelWriter (
-	shared_ptr<const Film> film, DCPTimePeriod period, shared_ptr<Job> job, int reel_index, int reel_count, optional<string> content_summary
+	shared_ptr<const Film> film, DCPTimePeriod period, shared_ptr<Job> job, int reel_index, int reel_count, optional<string> content_summary, optional<string> attempt
 	)
 	: _film (film)
 	, _period (period)
@@ -75,7 +93,27 @@ ReelWriter::ReelWriter (
 	, _reel_count (reel_count)
 	, _content_summary (content_summary)
 	, _job (job)
+	, _attempt (attempt)
+	, _picture_finalized (false)
 {
+	if (_attempt) {
+		/* Nothing else may be using this attempt's info file, so don't share an index for it */
+		boost::filesystem::path const info = _film->info_file (_period);
+		boost::filesystem::path const attempt_info = attempt_file (info, *_attempt);
+		boost::filesystem::path const asset = _film->internal_video_asset_dir() / _film->internal_video_asset_filename (_period);
+		boost::filesystem::remove (attempt_info);
+		boost::filesystem::remove (picture_file ());
+		if (boost::filesystem::exists (asset) && boost::filesystem::exists (info)) {
+			/* Start from a copy of whatever has already been written, so that we can carry on from it */
+			CopyMethod const method = copy_file_quickly (asset, picture_file (), &ignore_progress);
+			LOG_GENERAL ("Copied existing picture asset %1 for attempt %2 using %3", asset.string(), *_attempt, copy_method_to_string (method));
+			boost::filesystem::copy_file (info, attempt_info);
+		}
+		_info.reset (new FrameInfoIndex (attempt_info));
+	} else {
+		_info = film->frame_info_index (period);
+	}
+
 	/* Create our picture asset in a subdirectory, named according to those
 	   film's parameters which affect the video output.  We will hard-link
 	   it into the DCP later.
@@ -96,18 +134,19 @@ ReelWriter::ReelWriter (
 		_picture_asset->set_context_id (_film->context_id ());
 	}
 
-	_picture_asset->set_file (
-		_film->internal_video_asset_dir() / _film->internal_video_asset_filename(_period)
-		);
+	_picture_asset->set_file (picture_file ());
 
 	_first_nonexistant_frame = check_existing_picture_asset ();
 
-	_picture_asset_writer = _picture_asset->start_write (
-		_film->internal_video_asset_dir() / _film->internal_video_asset_filename(_period),
-		_first_nonexistant_frame > 0
-		);
+	open_previous_picture_asset ();
+	if (!_attempt) {
+		/* The master will write this when it makes its own ReelWriter for the reel */
+		_film->write_video_segments (_period);
+	}
+
+	_picture_asset_writer = _picture_asset->start_write (picture_file (), _first_nonexistant_frame > 0);
 
-	if (_film->audio_channels ()) {
+	if (!_attempt && _film->audio_channels ()) {
 		_sound_asset.reset (
 			new dcp::SoundAsset (dcp::Fraction (_film->video_frame_rate(), 1), _film->audio_frame_rate (), _film->audio_channels (), standard)
 			);
@@ -121,9 +160,8 @@ ReelWriter::ReelWriter (
 		/* Write the sound asset into the film directory so that we leave the creation
 		   of the DCP directory until the last minute.
 		*/
-		_sound_asset_writer = _sound_asset->start_write (
-			_film->directory().get() / audio_asset_filename (_sound_asset, _reel_index, _reel_count, _content_summary)
-			);
+		_sound_file = _film->directory().get() / audio_asset_filename (_sound_asset, _reel_index, _reel_count, _content_summary);
+		_sound_asset_writer = _sound_asset->start_write (_sound_file.get ());
 	}
 }
 
@@ -131,44 +169,19 @@ ReelWriter::ReelWriter (
 void
 ReelWriter::write_frame_info (Frame frame, Eyes eyes, dcp::FrameInfo info) const
 {
-	shared_ptr<InfoFileHandle> handle = _film->info_file_handle(_period, false);
-	dcpomatic_fseek (handle->get(), frame_info_position(frame, eyes), SEEK_SET);
-	checked_fwrite (&info.offset, sizeof(info.offset), handle->get(), handle->file());
-	checked_fwrite (&info.size, sizeof (info.size), handle->get(), handle->file());
-	checked_fwrite (info.hash.c_str(), info.hash.size(), handle->get(), handle->file());
+	_info->set (frame, eyes, info);
 }
 
+/** @param frame reel-relative frame */
 dcp::FrameInfo
-ReelWriter::read_frame_info (shared_ptr<InfoFileHandle> info, Frame frame, Eyes eyes) const
-{
-	dcp::FrameInfo frame_info;
-	dcpomatic_fseek (info->get(), frame_info_position(frame, eyes), SEEK_SET);
-	checked_fread (&frame_info.offset, sizeof(frame_info.offset), info->get(), info->file());
-	checked_fread (&frame_info.size, sizeof(frame_info.size), info->get(), info->file());
-
-	char hash_buffer[33];
-	checked_fread (hash_buffer, 32, info->get(), info->file());
-	hash_buffer[32] = '\0';
-	frame_info.hash = hash_buffer;
-
-	return frame_info;
-}
-
-long
-ReelWriter::frame_info_position (Frame frame, Eyes eyes) const
+ReelWriter::read_frame_info (Frame frame, Eyes eyes) const
 {
-	switch (eyes) {
-	case EYES_BOTH:
-		return frame * _info_size;
-	case EYES_LEFT:
-		return frame * _info_size * 2;
-	case EYES_RIGHT:
-		return frame * _info_size * 2 + _info_size;
-	default:
-		DCPOMATIC_ASSERT (false);
+	optional<dcp::FrameInfo> info = _info->get (frame, eyes);
+	if (!info) {
+		throw ReadFileError (_info->file());
 	}
 
-	DCPOMATIC_ASSERT (false);
+	return *info;
 }
 
 Frame
@@ -184,69 +197,70 @@ ReelWriter::check_existing_picture_asset ()
 	*/
 
 	if (boost::filesystem::exists(asset) && boost::filesystem::hard_link_count(asset) > 1) {
+		boost::filesystem::path const temp = asset.string() + ".tmp";
+		/* This can only be left over from an earlier copy that did not finish */
+		boost::filesystem::remove (temp);
 		if (job) {
 			job->sub (_("Copying old video file"));
-			copy_in_bits (asset, asset.string() + ".tmp", bind(&Job::set_progress, job.get(), _1, false));
-		} else {
-			boost::filesystem::copy_file (asset, asset.string() + ".tmp");
 		}
+		CopyMethod const method = copy_file_quickly (
+			asset, temp, job ? boost::function<void (float)> (bind(&Job::set_progress, job.get(), _1, false)) : &ignore_progress
+			);
+		LOG_GENERAL ("Copied old video file %1 using %2", asset.string(), copy_method_to_string (method));
 		boost::filesystem::remove (asset);
-		boost::filesystem::rename (asset.string() + ".tmp", asset);
+		boost::filesystem::rename (temp, asset);
 	}
 
 	if (job) {
 		job->sub (_("Checking existing image data"));
 	}
 
-	/* Try to open the existing asset */
-	FILE* asset_file = fopen_boost (asset, "rb");
-	if (!asset_file) {
-		LOG_GENERAL ("Could not open existing asset at %1 (errno=%2)", asset.string(), errno);
-		return 0;
-	} else {
-		LOG_GENERAL ("Opened existing asset at %1", asset.string());
-	}
-
-	shared_ptr<InfoFileHandle> info_file;
-
-	try {
-		info_file = _film->info_file_handle (_period, true);
-	} catch (OpenFileError) {
-		LOG_GENERAL_NC ("Could not open film info file");
-		fclose (asset_file);
+	if (!boost::filesystem::exists (asset)) {
+		LOG_GENERAL ("No existing asset at %1", asset.string());
 		return 0;
 	}
 
-	/* Offset of the last dcp::FrameInfo in the info file */
-	int const n = (boost::filesystem::file_size(info_file->file()) / _info_size) - 1;
-	LOG_GENERAL ("The last FI is %1; info file is %2, info size %3", n, boost::filesystem::file_size(info_file->file()), _info_size);
-
-	Frame first_nonexistant_frame;
-	if (_film->three_d ()) {
-		/* Start looking at the last left frame */
-		first_nonexistant_frame = n / 2;
-	} else {
-		first_nonexistant_frame = n;
-	}
+	vector<dcp::FrameInfo> const frames = read_existing_frame_info ();
 
-	while (!existing_picture_frame_ok(asset_file, info_file, first_nonexistant_frame) && first_nonexistant_frame > 0) {
-		--first_nonexistant_frame;
-	}
+	ResumeVerifier verifier (asset, frames);
+	optional<Frame> const last_good = verifier.last_good_frame (Config::instance()->master_encoding_threads());
 
-	if (!_film->three_d() && first_nonexistant_frame > 0) {
+	Frame first_nonexistant_frame = 0;
+	if (last_good) {
 		/* If we are doing 3D we might have found a good L frame with no R, so only
-		   do this if we're in 2D and we've just found a good B(oth) frame.
+		   move past the last good frame if we're in 2D.
 		*/
-		++first_nonexistant_frame;
+		first_nonexistant_frame = _film->three_d() ? *last_good : *last_good + 1;
 	}
 
-	LOG_GENERAL ("Proceeding with first nonexistant frame %1", first_nonexistant_frame);
-
-	fclose (asset_file);
+	LOG_GENERAL (
+		"Proceeding with first nonexistant frame %1; %2 of %3 frames in the existing asset are reusable (checked %4)",
+		first_nonexistant_frame, first_nonexistant_frame, frames.size(), verifier.checked()
+		);
 
 	return first_nonexistant_frame;
 }
 
+/** @return Info for each frame that an earlier encode wrote to our picture asset; for 3D, only the left-eye frames */
+vector<dcp::FrameInfo>
+ReelWriter::read_existing_frame_info () const
+{
+	vector<dcp::FrameInfo> frames;
+
+	if (_film->three_d ()) {
+		/* Left and right frames are interleaved, and we only want the left ones */
+		for (Frame i = 0; i < (_info->size() + 1) / 2; ++i) {
+			frames.push_back (*_info->get (i, EYES_LEFT));
+		}
+	} else {
+		for (Frame i = 0; i < _info->size(); ++i) {
+			frames.push_back (*_info->get (i, EYES_BOTH));
+		}
+	}
+
+	return frames;
+}
+
 void
 ReelWriter::write (optional<Data> encoded, Frame frame, Eyes eyes)
 {
@@ -277,20 +291,46 @@ ReelWriter::repeat_write (Frame frame, Eyes eyes)
 	_last_written_eyes = eyes;
 }
 
+/** Finish writing the picture asset, if we have not already done so.  No more
+ *  frames may be written after this has been called.
+ */
 void
-ReelWriter::finish ()
+ReelWriter::finalize_picture ()
 {
+	if (_picture_finalized) {
+		return;
+	}
+
+	_picture_finalized = true;
+	_info->flush ();
+
 	if (!_picture_asset_writer->finalize ()) {
 		/* Nothing was written to the picture asset */
 		LOG_GENERAL ("Nothing was written to reel %1 of %2", _reel_index, _reel_count);
 		_picture_asset.reset ();
 	}
+}
 
+/** Finish writing the sound asset, if we have not already done so.  No more
+ *  audio may be written after this has been called.
+ */
+void
+ReelWriter::finalize_sound ()
+{
 	if (_sound_asset_writer && !_sound_asset_writer->finalize ()) {
 		/* Nothing was written to the sound asset */
 		_sound_asset.reset ();
 	}
 
+	_sound_asset_writer.reset ();
+}
+
+void
+ReelWriter::finish ()
+{
+	finalize_picture ();
+	finalize_sound ();
+
 	/* Hard-link any video asset file into the DCP */
 	if (_picture_asset) {
 		DCPOMATIC_ASSERT (_picture_asset->file());
@@ -310,22 +350,25 @@ ReelWriter::finish ()
 			shared_ptr<Job> job = _job.lock ();
 			if (job) {
 				job->sub (_("Copying video file into DCP"));
-				try {
-					copy_in_bits (video_from, video_to, bind(&Job::set_progress, job.get(), _1, false));
-				} catch (exception& e) {
-					LOG_ERROR ("Failed to copy video file from %1 to %2 (%3)", video_from.string(), video_to.string(), e.what());
-					throw FileError (e.what(), video_from);
-				}
-			} else {
-				boost::filesystem::copy_file (video_from, video_to, ec);
-				if (ec) {
-					LOG_ERROR ("Failed to copy video file from %1 to %2 (%3)", video_from.string(), video_to.string(), ec.message ());
-					throw FileError (ec.message(), video_from);
-				}
+			}
+			try {
+				CopyMethod const method = copy_file_quickly (
+					video_from, video_to, job ? boost::function<void (float)> (bind(&Job::set_progress, job.get(), _1, false)) : &ignore_progress
+					);
+				LOG_GENERAL ("Copied video file %1 into DCP using %2", video_from.string(), copy_method_to_string (method));
+			} catch (exception& e) {
+				LOG_ERROR ("Failed to copy video file from %1 to %2 (%3)", video_from.string(), video_to.string(), e.what());
+				throw FileError (e.what(), video_from);
 			}
 		}
 
 		_picture_asset->set_file (video_to);
+		if (_picture_digest) {
+			/* set_file() forgets the digest, but the file's contents are the same so we
+			   can put it back rather than reading the whole file again.
+			*/
+			_picture_asset->set_hash (*_picture_digest);
+		}
 	}
 
 	/* Move the audio asset into the DCP */
@@ -540,6 +583,22 @@ ReelWriter::create_reel (list<ReferencedReelAsset> const & refs, list<shared_ptr
 	return reel;
 }
 
+/** Calculate the digest of our picture asset, which must have been finalized.  We keep
+ *  the digest so that calculate_digests() will not need to read the file again, even
+ *  after finish() has moved the asset into the DCP.
+ */
+void
+ReelWriter::calculate_picture_digest (boost::function<void (float)> set_progress)
+{
+	DCPOMATIC_ASSERT (_picture_finalized);
+	if (_picture_asset) {
+		_picture_digest = _picture_asset->hash (set_progress);
+	}
+}
+
+/** Calculate the digests of our assets.  This does not re-read the picture asset if
+ *  calculate_picture_digest() has already been called.
+ */
 void
 ReelWriter::calculate_digests (boost::function<void (float)> set_progress)
 {
@@ -652,35 +711,156 @@ ReelWriter::write (PlayerText subs, TextType type, optional<DCPTextTrack> track,
 	}
 }
 
-bool
-ReelWriter::existing_picture_frame_ok (FILE* asset_file, shared_ptr<InfoFileHandle> info_file, Frame frame) const
+/** Read a frame's data from a picture asset and check it against its hash.
+ *  @return The data, or none if it could not be read or its hash is wrong.
+ */
+optional<Data>
+ReelWriter::read_frame (FILE* asset_file, dcp::FrameInfo const & info)
 {
-	LOG_GENERAL ("Checking existing picture frame %1", frame);
+	dcpomatic_fseek (asset_file, info.offset, SEEK_SET);
+	Data data (info.size);
+	if (fread (data.data().get(), 1, data.size(), asset_file) != static_cast<size_t> (data.size ())) {
+		return optional<Data> ();
+	}
 
-	/* Read the data from the info file; for 3D we just check the left
-	   frames until we find a good one.
-	*/
-	dcp::FrameInfo const info = read_frame_info (info_file, frame, _film->three_d () ? EYES_LEFT : EYES_BOTH);
+	Digester digester;
+	digester.add (data.data().get(), data.size());
+	if (digester.get() != info.hash) {
+		return optional<Data> ();
+	}
 
-	bool ok = true;
+	return data;
+}
 
-	/* Read the data from the asset and hash it */
-	dcpomatic_fseek (asset_file, info.offset, SEEK_SET);
-	Data data (info.size);
-	size_t const read = fread (data.data().get(), 1, data.size(), asset_file);
-	LOG_GENERAL ("Read %1 bytes of asset data; wanted %2", read, info.size);
-	if (read != static_cast<size_t> (data.size ())) {
-		LOG_GENERAL ("Existing frame %1 is incomplete", frame);
-		ok = false;
-	} else {
-		Digester digester;
-		digester.add (data.data().get(), data.size());
-		LOG_GENERAL ("Hash %1 vs %2", digester.get(), info.hash);
-		if (digester.get() != info.hash) {
-			LOG_GENERAL ("Existing frame %1 failed hash check", frame);
-			ok = false;
+/** Get the encoded data for a frame from our picture asset as it was when we started,
+ *  checking it against the hash in the info file.
+ *  @param frame reel-relative frame.
+ *  @return Encoded data, or none if the frame is not there or is not valid.
+ */
+optional<Data>
+ReelWriter::existing_frame (Frame frame, Eyes eyes) const
+{
+	if (_film->three_d() && eyes == EYES_BOTH) {
+		eyes = EYES_LEFT;
+	}
+
+	DCPOMATIC_ASSERT (_picture_asset->file());
+	FILE* f = fopen_boost (_picture_asset->file().get(), "rb");
+	if (!f) {
+		return optional<Data> ();
+	}
+	shared_ptr<FILE> asset (f, fclose);
+
+	try {
+		return read_frame (asset.get(), read_frame_info (frame, eyes));
+	} catch (FileError& e) {
+		LOG_GENERAL ("Could not read info for frame %1 (%2)", frame, e.what());
+	}
+
+	return optional<Data> ();
+}
+
+/** @return The file that our picture asset is written to before it is put into the DCP */
+boost::filesystem::path
+ReelWriter::picture_file () const
+{
+	boost::filesystem::path const p = _film->internal_video_asset_dir() / _film->internal_video_asset_filename(_period);
+	if (_attempt) {
+		return attempt_file (p, *_attempt);
+	}
+	return p;
+}
+
+/** @return The file that an encode server writes to, instead of file, when it is making
+ *  a reel for a master.  Each attempt that the master makes at getting a reel made uses
+ *  its own files, so a server that the master has given up on can never write to a file
+ *  that anybody else is using; the master moves the files into place once it has accepted
+ *  a server's result.
+ */
+boost::filesystem::path
+ReelWriter::attempt_file (boost::filesystem::path file, string attempt)
+{
+	file += "." + attempt;
+	return file;
+}
+
+/** @return Reel-relative index of the first frame at or after a time */
+Frame
+ReelWriter::reel_frame (DCPTime t) const
+{
+	return (t - _period.from).frames_ceil (_film->video_frame_rate ());
+}
+
+/** Look for a picture asset from an earlier encode of this reel which has some
+ *  frames that we can use instead of encoding them again, and open it if so.
+ */
+void
+ReelWriter::open_previous_picture_asset ()
+{
+	optional<PreviousVideoAsset> previous = _film->previous_video_asset (_period);
+	if (!previous) {
+		return;
+	}
+
+	FILE* asset = fopen_boost (previous->asset, "rb");
+	if (!asset) {
+		LOG_GENERAL ("Could not open previous asset at %1 (errno=%2)", previous->asset.string(), errno);
+		return;
+	}
+	_previous_asset.reset (asset, fclose);
+
+	try {
+		_previous_info.reset (new FrameInfoIndex (previous->info));
+	} catch (FileError& e) {
+		LOG_GENERAL ("Could not open previous info file at %1 (%2)", previous->info.string(), e.what());
+		_previous_asset.reset ();
+		return;
+	}
+
+	Frame total = 0;
+	BOOST_FOREACH (DCPTimePeriod i, previous->unchanged) {
+		Frame const from = reel_frame (i.from);
+		Frame const to = reel_frame (i.to);
+		if (to > from) {
+			_previous_frames.push_back (make_pair (from, to));
+			total += to - from;
+		}
+	}
+
+	LOG_GENERAL ("Up to %1 frames can be taken from previous asset %2", total, previous->asset.string());
+}
+
+/** Get the encoded data for a frame from a picture asset written by an earlier
+ *  encode of this reel, if the picture at that frame has not changed since then.
+ *  This must not be called from more than one thread at once.
+ *  @param frame reel-relative frame.
+ *  @return Encoded data, or none if we must encode the frame.
+ */
+optional<Data>
+ReelWriter::previous_frame (Frame frame, Eyes eyes) const
+{
+	bool unchanged = false;
+	typedef pair<Frame, Frame> Range;
+	BOOST_FOREACH (Range const& i, _previous_frames) {
+		if (i.first <= frame && frame < i.second) {
+			unchanged = true;
+			break;
 		}
 	}
 
-	return ok;
+	if (!unchanged) {
+		return optional<Data> ();
+	}
+
+	if (_film->three_d() && eyes == EYES_BOTH) {
+		/* 2D material in a 3D DCP; both eyes will have been written with the same data */
+		eyes = EYES_LEFT;
+	}
+
+	optional<dcp::FrameInfo> info = _previous_info->get (frame, eyes);
+	if (!info) {
+		return optional<Data> ();
+	}
+
+	return read_frame (_previous_asset.get(), *info);
 }
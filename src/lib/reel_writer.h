@@ -31,8 +31,9 @@ class Film;
 class Job;
 class Font;
 class AudioBuffers;
-class InfoFileHandle;
+class FrameInfoIndex;
 struct write_frame_info_test;
+struct reel_writer_attempt_test;
 
 namespace dcp {
 	class MonoPictureAsset;
@@ -57,17 +58,23 @@ public:
 		boost::shared_ptr<Job> job,
 		int reel_index,
 		int reel_count,
-		boost::optional<std::string> content_summary
+		boost::optional<std::string> content_summary,
+		boost::optional<std::string> attempt = boost::optional<std::string> ()
 		);
 
 	void write (boost::optional<dcp::Data> encoded, Frame frame, Eyes eyes);
+	boost::optional<dcp::Data> previous_frame (Frame frame, Eyes eyes) const;
+	boost::optional<dcp::Data> existing_frame (Frame frame, Eyes eyes) const;
 	void fake_write (Frame frame, Eyes eyes, int size);
 	void repeat_write (Frame frame, Eyes eyes);
 	void write (boost::shared_ptr<const AudioBuffers> audio);
 	void write (PlayerText text, TextType type, boost::optional<DCPTextTrack> track, DCPTimePeriod period);
 
+	void finalize_picture ();
+	void finalize_sound ();
 	void finish ();
 	boost::shared_ptr<dcp::Reel> create_reel (std::list<ReferencedReelAsset> const & refs, std::list<boost::shared_ptr<Font> > const & fonts);
+	void calculate_picture_digest (boost::function<void (float)> set_progress);
 	void calculate_digests (boost::function<void (float)> set_progress);
 
 	Frame start () const;
@@ -84,20 +91,34 @@ public:
 		return _last_written_eyes;
 	}
 
+	boost::filesystem::path picture_file () const;
+
+	/** @return The file that our sound asset is written to before it is put into the DCP,
+	 *  or none if we have no sound asset.
+	 */
+	boost::optional<boost::filesystem::path> sound_file () const {
+		return _sound_file;
+	}
+
 	int first_nonexistant_frame () const {
 		return _first_nonexistant_frame;
 	}
 
-	dcp::FrameInfo read_frame_info (boost::shared_ptr<InfoFileHandle> info, Frame frame, Eyes eyes) const;
+	dcp::FrameInfo read_frame_info (Frame frame, Eyes eyes) const;
+
+	static boost::optional<dcp::Data> read_frame (FILE* asset_file, dcp::FrameInfo const & info);
+	static boost::filesystem::path attempt_file (boost::filesystem::path file, std::string attempt);
 
 private:
 
 	friend struct ::write_frame_info_test;
+	friend struct ::reel_writer_attempt_test;
 
 	void write_frame_info (Frame frame, Eyes eyes, dcp::FrameInfo info) const;
-	long frame_info_position (Frame frame, Eyes eyes) const;
+	void open_previous_picture_asset ();
 	Frame check_existing_picture_asset ();
-	bool existing_picture_frame_ok (FILE* asset_file, boost::shared_ptr<InfoFileHandle> info_file, Frame frame) const;
+	std::vector<dcp::FrameInfo> read_existing_frame_info () const;
+	Frame reel_frame (DCPTime t) const;
 
 	boost::shared_ptr<const Film> _film;
 
@@ -115,13 +136,29 @@ private:
 	int _reel_count;
 	boost::optional<std::string> _content_summary;
 	boost::weak_ptr<Job> _job;
+	/** if set, we are an encode server making only the picture asset for a master, and this
+	 *  identifies the master's attempt at getting the reel made; see attempt_file().
+	 */
+	boost::optional<std::string> _attempt;
+	/** info about each frame that has been written to our picture asset */
+	boost::shared_ptr<FrameInfoIndex> _info;
+
+	/** picture asset from an earlier encode of this reel, if we have one with usable frames */
+	boost::shared_ptr<FILE> _previous_asset;
+	/** info file for _previous_asset */
+	boost::shared_ptr<FrameInfoIndex> _previous_info;
+	/** reel-relative frame ranges [first, second) of _previous_asset which are still valid */
+	std::list<std::pair<Frame, Frame> > _previous_frames;
 
 	boost::shared_ptr<dcp::PictureAsset> _picture_asset;
 	boost::shared_ptr<dcp::PictureAssetWriter> _picture_asset_writer;
+	/** true if _picture_asset_writer has been finalized */
+	bool _picture_finalized;
+	/** digest of _picture_asset if calculate_picture_digest() has worked it out */
+	boost::optional<std::string> _picture_digest;
 	boost::shared_ptr<dcp::SoundAsset> _sound_asset;
 	boost::shared_ptr<dcp::SoundAssetWriter> _sound_asset_writer;
+	boost::optional<boost::filesystem::path> _sound_file;
 	boost::shared_ptr<dcp::SubtitleAsset> _subtitle_asset;
 	std::map<DCPTextTrack, boost::shared_ptr<dcp::SubtitleAsset> > _closed_caption_assets;
-
-	static int const _info_size;
 };
@@ -0,0 +1,279 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/remote_reel_encoder.cc
+ *  @brief RemoteReelEncoder class.
+ */
+
+#include "remote_reel_encoder.h"
+#include "encode_server_finder.h"
+#include "dcpomatic_socket.h"
+#include "film.h"
+#include "job.h"
+#include "config.h"
+#include "exceptions.h"
+#include "compose.hpp"
+#include "dcpomatic_log.h"
+#include "reel_writer.h"
+#include <dcp/raw_convert.h>
+#include <libcxml/cxml.h>
+#include <libxml++/libxml++.h>
+#include <boost/scoped_array.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/foreach.hpp>
+#include <boost/thread.hpp>
+
+#include "i18n.h"
+
+using std::set;
+using std::list;
+using std::string;
+using boost::shared_ptr;
+using boost::weak_ptr;
+using boost::optional;
+using boost::scoped_array;
+using dcp::raw_convert;
+
+/** Seconds to wait for a server to say something; they report progress every few seconds */
+static int const timeout = 60;
+/** Longest message that we will accept from a server */
+static uint32_t const maximum_message_length = 65536;
+
+RemoteReelEncoder::RemoteReelEncoder (shared_ptr<const Film> film, weak_ptr<Job> job)
+	: _film (film)
+	, _job (job)
+	, _frames_done (0)
+	, _frames_total (0)
+{
+
+}
+
+/** Give reels to any servers which can make them, and wait for them to finish.
+ *  @return Indices of the reels whose picture assets were made by servers.
+ */
+set<size_t>
+RemoteReelEncoder::go ()
+{
+	if (_film->encrypted ()) {
+		/* We would have to re-write every frame anyway to get the asset's HMACs right */
+		return set<size_t> ();
+	}
+
+	list<EncodeServerDescription> servers;
+	BOOST_FOREACH (EncodeServerDescription i, EncodeServerFinder::instance()->servers()) {
+		if (i.current_link_version() && i.reel_encoding()) {
+			servers.push_back (i);
+		}
+	}
+
+	if (servers.empty ()) {
+		return set<size_t> ();
+	}
+
+	size_t n = 0;
+	BOOST_FOREACH (DCPTimePeriod i, _film->reels ()) {
+		_todo.push_back (n++);
+		_frames_total += i.duration().frames_round (_film->video_frame_rate ());
+	}
+
+	_metadata = _film->metadata()->write_to_string ("UTF-8");
+
+	shared_ptr<Job> job = _job.lock ();
+	if (job) {
+		job->sub (_("Encoding reels on servers"));
+	}
+
+	LOG_GENERAL ("Sending %1 reels to %2 servers", _todo.size(), servers.size());
+
+	boost::thread_group threads;
+
+	try {
+		BOOST_FOREACH (EncodeServerDescription i, servers) {
+			threads.create_thread (boost::bind (&RemoteReelEncoder::thread, this, i));
+		}
+		threads.join_all ();
+	} catch (...) {
+		threads.interrupt_all ();
+		threads.join_all ();
+		throw;
+	}
+
+	LOG_GENERAL ("Servers made %1 of %2 reels", _done.size(), n);
+	return _done;
+}
+
+/** Thread to give reels to one server until there are none left or the server fails */
+void
+RemoteReelEncoder::thread (EncodeServerDescription server)
+{
+	while (true) {
+		size_t reel;
+
+		{
+			boost::mutex::scoped_lock lm (_mutex);
+			if (_todo.empty ()) {
+				return;
+			}
+			reel = _todo.front ();
+			_todo.pop_front ();
+		}
+
+		try {
+			encode (server, reel);
+			boost::mutex::scoped_lock lm (_mutex);
+			_done.insert (reel);
+		} catch (boost::thread_interrupted &) {
+			return;
+		} catch (std::exception& e) {
+			LOG_ERROR ("Server %1 could not make reel %2 (%3)", server.host_name(), reel + 1, e.what());
+			/* Give the reel back so that another server (or the master) can make it, and
+			   don't use this server again.
+			*/
+			boost::mutex::scoped_lock lm (_mutex);
+			_todo.push_back (reel);
+			return;
+		}
+	}
+}
+
+static void
+write_message (shared_ptr<Socket> socket, string xml)
+{
+	socket->write (xml.length() + 1);
+	socket->write ((uint8_t *) xml.c_str(), xml.length() + 1);
+}
+
+static shared_ptr<cxml::Document>
+read_message (shared_ptr<Socket> socket)
+{
+	uint32_t const length = socket->read_uint32 ();
+	if (length == 0 || length > maximum_message_length) {
+		throw NetworkError (String::compose ("bad message length %1 from server", length));
+	}
+
+	scoped_array<char> buffer (new char[length]);
+	socket->read (reinterpret_cast<uint8_t*> (buffer.get()), length);
+	buffer[length - 1] = '\0';
+
+	shared_ptr<cxml::Document> xml (new cxml::Document ());
+	xml->read_string (string (buffer.get()));
+	return xml;
+}
+
+/** Ask a server to make one reel and wait for it to finish.  Throws an exception on failure.
+ *  The server writes to files of its own for this attempt, which we move into place only if
+ *  it succeeds, so that if we give up on it (and perhaps give the reel to someone else) it
+ *  cannot interfere with whoever makes the reel instead.  Closing the connection tells the
+ *  server that we have given up.
+ */
+void
+RemoteReelEncoder::encode (EncodeServerDescription server, size_t reel)
+{
+	list<DCPTimePeriod> const reels = _film->reels ();
+	list<DCPTimePeriod>::const_iterator period = reels.begin ();
+	std::advance (period, reel);
+	Frame const expected = period->duration().frames_round (_film->video_frame_rate ());
+
+	string const attempt = boost::filesystem::unique_path("%%%%%%%%%%%%%%%%").string();
+	boost::filesystem::path const asset = _film->internal_video_asset_dir() / _film->internal_video_asset_filename (*period);
+	boost::filesystem::path const info = _film->info_file (*period);
+
+	try {
+		encode_attempt (server, reel, attempt, expected);
+	} catch (...) {
+		/* Tidy up if the server could not */
+		boost::system::error_code ec;
+		boost::filesystem::remove (ReelWriter::attempt_file (asset, attempt), ec);
+		boost::filesystem::remove (ReelWriter::attempt_file (info, attempt), ec);
+		throw;
+	}
+
+	boost::filesystem::rename (ReelWriter::attempt_file (asset, attempt), asset);
+	boost::filesystem::rename (ReelWriter::attempt_file (info, attempt), info);
+}
+
+/** Ask a server to make one reel, writing to the files for an attempt, and wait for it to finish */
+void
+RemoteReelEncoder::encode_attempt (EncodeServerDescription server, size_t reel, string attempt, Frame expected)
+{
+	shared_ptr<Socket> socket (new Socket (timeout));
+
+	boost::asio::io_service io_service;
+	boost::asio::ip::tcp::resolver resolver (io_service);
+	boost::asio::ip::tcp::resolver::query query (server.host_name(), raw_convert<string> (ENCODE_FRAME_PORT));
+	socket->connect (*resolver.resolve (query));
+
+	DCPOMATIC_ASSERT (_film->directory ());
+
+	xmlpp::Document doc;
+	xmlpp::Element* root = doc.create_root_node ("ReelEncodingRequest");
+	root->add_child("Version")->add_child_text (raw_convert<string> (server.link_version()));
+	root->add_child("Film")->add_child_text (_film->directory()->string());
+	root->add_child("Reel")->add_child_text (raw_convert<string> (reel));
+	root->add_child("Attempt")->add_child_text (attempt);
+	root->add_child("Metadata")->add_child_text (_metadata);
+	write_message (socket, doc.write_to_string ("UTF-8"));
+
+	LOG_GENERAL ("Sent reel %1 to %2", reel + 1, server.host_name());
+
+	Frame reported = 0;
+	while (true) {
+		boost::this_thread::interruption_point ();
+
+		shared_ptr<cxml::Document> reply = read_message (socket);
+		if (reply->name() == "ReelEncodingProgress") {
+			Frame const frames = reply->number_child<Frame> ("Frames");
+			add_progress (frames - reported);
+			reported = frames;
+		} else if (reply->name() == "ReelEncodingResponse") {
+			optional<string> error = reply->optional_string_child ("Error");
+			if (error) {
+				throw NetworkError (*error);
+			}
+
+			Frame const frames = reply->number_child<Frame> ("Frames");
+			if (frames != expected) {
+				throw NetworkError (String::compose ("server wrote %1 frames of %2", frames, expected));
+			}
+
+			LOG_GENERAL ("%1 made reel %2", server.host_name(), reel + 1);
+			add_progress (frames - reported);
+			return;
+		} else {
+			throw NetworkError (String::compose ("unexpected message %1 when encoding a reel", reply->name()));
+		}
+	}
+}
+
+void
+RemoteReelEncoder::add_progress (Frame frames)
+{
+	float progress;
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		_frames_done += frames;
+		progress = float (_frames_done) / std::max (Frame (1), _frames_total);
+	}
+
+	shared_ptr<Job> job = _job.lock ();
+	if (job) {
+		job->set_progress (progress);
+	}
+}
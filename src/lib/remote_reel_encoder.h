@@ -0,0 +1,79 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef DCPOMATIC_REMOTE_REEL_ENCODER_H
+#define DCPOMATIC_REMOTE_REEL_ENCODER_H
+
+/** @file  src/lib/remote_reel_encoder.h
+ *  @brief RemoteReelEncoder class.
+ */
+
+#include "types.h"
+#include "encode_server_description.h"
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <list>
+#include <set>
+#include <string>
+
+class Film;
+class Job;
+
+/** @class RemoteReelEncoder
+ *  @brief Ask encoding servers to make the picture assets for whole reels of a film.
+ *
+ *  The servers must be able to see the film's directory and content at the same
+ *  paths as we do.  Each server decodes, encodes and writes the picture asset
+ *  for a reel into the film's directory, where the Writer will find it as if it
+ *  were left over from an earlier encode.
+ */
+class RemoteReelEncoder : public boost::noncopyable
+{
+public:
+	RemoteReelEncoder (boost::shared_ptr<const Film> film, boost::weak_ptr<Job> job);
+
+	std::set<size_t> go ();
+
+private:
+	void thread (EncodeServerDescription server);
+	void encode (EncodeServerDescription server, size_t reel);
+	void encode_attempt (EncodeServerDescription server, size_t reel, std::string attempt, Frame expected);
+	void add_progress (Frame frames);
+
+	boost::shared_ptr<const Film> _film;
+	boost::weak_ptr<Job> _job;
+	/** the film's metadata, to send to the servers */
+	std::string _metadata;
+
+	/** mutex for the things below */
+	boost::mutex _mutex;
+	/** reels that have not yet been made */
+	std::list<size_t> _todo;
+	/** reels whose picture assets have been made */
+	std::set<size_t> _done;
+	/** number of frames that servers have reported as written */
+	Frame _frames_done;
+	/** total number of frames in the film */
+	Frame _frames_total;
+};
+
+#endif
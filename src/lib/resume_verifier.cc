@@ -0,0 +1,135 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/resume_verifier.cc
+ *  @brief ResumeVerifier class.
+ */
+
+#include "resume_verifier.h"
+#include "reel_writer.h"
+#include "cross.h"
+#include "dcpomatic_log.h"
+#include "compose.hpp"
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+#include <boost/scoped_array.hpp>
+#include <algorithm>
+#include <set>
+
+using std::vector;
+using std::set;
+using std::max;
+using boost::optional;
+using boost::scoped_array;
+
+/** @param asset Picture asset.
+ *  @param frames Info for each frame that the asset should contain; for a 3D asset,
+ *  just the left-eye frames.
+ */
+ResumeVerifier::ResumeVerifier (boost::filesystem::path asset, vector<dcp::FrameInfo> const & frames)
+	: _asset (asset)
+	, _frames (frames)
+	, _checked (0)
+{
+
+}
+
+/** @param threads Number of frames to check at the same time.
+ *  @return Index of the last frame which is in the asset with the correct hash, or none
+ *  if there is no such frame.
+ */
+optional<Frame>
+ResumeVerifier::last_good_frame (int threads)
+{
+	threads = max (1, threads);
+	_checked = 0;
+
+	/* The last frame which we know to be good; -1 for none */
+	Frame good = -1;
+	/* The first frame which we know to be bad */
+	Frame bad = _frames.size ();
+
+	bool first = true;
+	while (bad - good > 1) {
+		set<Frame> candidates;
+		if (first) {
+			/* If the earlier encode finished writing everything that is in its info file
+			   the last frame will be good, and it is the only one that we need to look at.
+			*/
+			candidates.insert (bad - 1);
+			first = false;
+		} else {
+			/* Check some frames spread evenly between good and bad */
+			for (int i = 1; i <= threads; ++i) {
+				candidates.insert (good + (bad - good) * i / (threads + 1));
+			}
+			candidates.erase (good);
+		}
+
+		vector<Frame> frames (candidates.begin(), candidates.end());
+		scoped_array<bool> ok (new bool[frames.size()]);
+
+		boost::thread_group group;
+		for (size_t i = 0; i < frames.size(); ++i) {
+			group.create_thread (boost::bind (&ResumeVerifier::check, this, frames[i], &ok[i]));
+		}
+		group.join_all ();
+
+		_checked += frames.size ();
+
+		/* Everything up to the first bad candidate is assumed good */
+		for (size_t i = 0; i < frames.size(); ++i) {
+			if (!ok[i]) {
+				bad = frames[i];
+				break;
+			}
+			good = frames[i];
+		}
+
+		LOG_GENERAL ("Resume check of %1: frames up to %2 good, from %3 bad", _asset.string(), good, bad);
+	}
+
+	if (good < 0) {
+		return optional<Frame> ();
+	}
+
+	return good;
+}
+
+/** Check one frame; this is run in its own thread, so it uses its own file handle */
+void
+ResumeVerifier::check (Frame frame, bool* ok) const
+{
+	*ok = false;
+
+	FILE* file = fopen_boost (_asset, "rb");
+	if (!file) {
+		return;
+	}
+
+	try {
+		/* A damaged info file could give us a silly size, so be prepared for allocation to fail */
+		*ok = static_cast<bool> (ReelWriter::read_frame (file, _frames[frame]));
+	} catch (...) {
+
+	}
+
+	fclose (file);
+}
@@ -0,0 +1,64 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef DCPOMATIC_RESUME_VERIFIER_H
+#define DCPOMATIC_RESUME_VERIFIER_H
+
+/** @file  src/lib/resume_verifier.h
+ *  @brief ResumeVerifier class.
+ */
+
+#include "types.h"
+#include <dcp/picture_asset_writer.h>
+#include <boost/filesystem.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/optional.hpp>
+#include <vector>
+
+/** @class ResumeVerifier
+ *  @brief Find out how much of a picture asset left by an earlier encode can be kept.
+ *
+ *  We assume that the asset's frames are good up to some point and bad (or missing)
+ *  after it, as they will be if the earlier encode was stopped part-way through.
+ *  That point is found by checking the hashes of a few frames at a time, in parallel,
+ *  and narrowing down the range that it must be in.
+ */
+class ResumeVerifier : public boost::noncopyable
+{
+public:
+	ResumeVerifier (boost::filesystem::path asset, std::vector<dcp::FrameInfo> const & frames);
+
+	boost::optional<Frame> last_good_frame (int threads);
+
+	/** @return number of frames whose hashes were checked by the last call to last_good_frame() */
+	int checked () const {
+		return _checked;
+	}
+
+private:
+	void check (Frame frame, bool* ok) const;
+
+	boost::filesystem::path _asset;
+	/** info for each frame that the asset should contain */
+	std::vector<dcp::FrameInfo> _frames;
+	int _checked;
+};
+
+#endif
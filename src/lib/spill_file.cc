@@ -0,0 +1,137 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/spill_file.cc
+ *  @brief SpillFile class.
+ */
+
+#include "spill_file.h"
+#include "cross.h"
+#include "exceptions.h"
+#include "dcpomatic_assert.h"
+#ifdef DCPOMATIC_POSIX
+#include <unistd.h>
+#endif
+#include <cerrno>
+
+using std::make_pair;
+using std::map;
+using std::pair;
+using dcp::Data;
+
+/** Size of the buffer used when writing to the file */
+static int const buffer_size = 16 * 1024 * 1024;
+
+/** @param path File to use, which will be overwritten if it exists */
+SpillFile::SpillFile (boost::filesystem::path path)
+	: _path (path)
+	, _file (0)
+	, _buffer (new char[buffer_size])
+	, _length (0)
+	, _flushed (0)
+	, _at_end (true)
+{
+	_file = fopen_boost (_path, "w+b");
+	if (!_file) {
+		throw OpenFileError (_path, errno, OpenFileError::READ_WRITE);
+	}
+
+	setvbuf (_file, _buffer.get(), _IOFBF, buffer_size);
+}
+
+SpillFile::~SpillFile ()
+{
+	fclose (_file);
+
+	boost::system::error_code ec;
+	boost::filesystem::remove (_path, ec);
+}
+
+/** Append a frame to the file.
+ *  @param frame Frame index within the reel.
+ */
+void
+SpillFile::write (Frame frame, Eyes eyes, Data const & data)
+{
+	/* Seeking flushes the stream's buffer, so only do it if a read has moved us */
+	if (!_at_end) {
+		if (dcpomatic_fseek (_file, _length, SEEK_SET)) {
+			throw WriteFileError (_path, errno);
+		}
+		_at_end = true;
+	}
+
+	if (fwrite (data.data().get(), 1, data.size(), _file) != static_cast<size_t> (data.size())) {
+		throw WriteFileError (_path, errno);
+	}
+
+	_index[make_pair(frame, eyes)] = Extent (_length, data.size());
+	_length += data.size ();
+}
+
+/** Read a frame back from the file, and forget about it.
+ *  @param frame Frame index within the reel.
+ */
+Data
+SpillFile::read (Frame frame, Eyes eyes)
+{
+	map<pair<Frame, Eyes>, Extent>::iterator i = _index.find (make_pair (frame, eyes));
+	DCPOMATIC_ASSERT (i != _index.end ());
+	Extent const extent = i->second;
+	_index.erase (i);
+
+	if (extent.offset + extent.size > _flushed) {
+		flush ();
+	}
+
+	Data data (extent.size);
+
+#ifdef DCPOMATIC_POSIX
+	/* Read without disturbing the stream's position or buffer */
+	int64_t done = 0;
+	while (done < extent.size) {
+		ssize_t const r = pread (fileno (_file), data.data().get() + done, extent.size - done, extent.offset + done);
+		if (r <= 0) {
+			throw ReadFileError (_path, r < 0 ? errno : 0);
+		}
+		done += r;
+	}
+#else
+	_at_end = false;
+	if (dcpomatic_fseek (_file, extent.offset, SEEK_SET)) {
+		throw ReadFileError (_path, errno);
+	}
+	if (fread (data.data().get(), 1, extent.size, _file) != static_cast<size_t> (extent.size)) {
+		throw ReadFileError (_path, errno);
+	}
+#endif
+
+	return data;
+}
+
+void
+SpillFile::flush ()
+{
+	if (fflush (_file)) {
+		throw WriteFileError (_path, errno);
+	}
+
+	_flushed = _length;
+}
@@ -0,0 +1,91 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef DCPOMATIC_SPILL_FILE_H
+#define DCPOMATIC_SPILL_FILE_H
+
+/** @file  src/lib/spill_file.h
+ *  @brief SpillFile class.
+ */
+
+#include "types.h"
+#include <dcp/data.h>
+#include <boost/filesystem.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/cstdint.hpp>
+#include <map>
+#include <utility>
+
+/** @class SpillFile
+ *  @brief An append-only file of JPEG2000 frames which the Writer cannot hold in memory.
+ *
+ *  Frames are appended to the end of the file, and an index of where each one is
+ *  kept in memory so that it can be read back when it is needed.  The file is deleted
+ *  when the SpillFile is destroyed.
+ */
+class SpillFile : public boost::noncopyable
+{
+public:
+	explicit SpillFile (boost::filesystem::path path);
+	~SpillFile ();
+
+	void write (Frame frame, Eyes eyes, dcp::Data const & data);
+	dcp::Data read (Frame frame, Eyes eyes);
+
+	/** @return true if there are no frames in the file which have not been read back */
+	bool empty () const {
+		return _index.empty ();
+	}
+
+private:
+	void flush ();
+
+	struct Extent
+	{
+		Extent ()
+			: offset (0)
+			, size (0)
+		{}
+
+		Extent (int64_t o, int s)
+			: offset (o)
+			, size (s)
+		{}
+
+		int64_t offset;
+		int size;
+	};
+
+	boost::filesystem::path _path;
+	FILE* _file;
+	/** buffer for _file, so that our writes reach the disk in large chunks */
+	boost::scoped_array<char> _buffer;
+	/** where each frame that has not yet been read back is in the file */
+	std::map<std::pair<Frame, Eyes>, Extent> _index;
+	/** length of the file, including anything still in _buffer */
+	int64_t _length;
+	/** amount of the file that has been flushed from _buffer */
+	int64_t _flushed;
+	/** true if _file is positioned at its end, ready for the next write */
+	bool _at_end;
+};
+
+#endif
@@ -0,0 +1,146 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/sws_context_cache.cc
+ *  @brief SwsContextCache class.
+ */
+
+#include "sws_context_cache.h"
+#include "dcpomatic_assert.h"
+extern "C" {
+#include <libswscale/swscale.h>
+}
+#include <boost/thread.hpp>
+#include <stdexcept>
+
+#include "i18n.h"
+
+using std::runtime_error;
+using std::max;
+using std::make_pair;
+
+SwsContextCache::SwsContextCache ()
+	/* Enough for every encoding thread to have a context for a couple of different scales */
+	: _maximum_idle (max (16U, boost::thread::hardware_concurrency() * 2))
+{
+
+}
+
+/** @return A context set up according to `key'; this must be given back with put() once
+ *  it is finished with, and must not be used by more than one thread at once.
+ */
+SwsContext*
+SwsContextCache::get (Key const & key)
+{
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		for (Idle::iterator i = _idle.begin(); i != _idle.end(); ++i) {
+			if (i->first == key) {
+				SwsContext* context = i->second;
+				_idle.erase (i);
+				return context;
+			}
+		}
+	}
+
+	SwsContext* context = sws_getContext (
+		key.in_size.width, key.in_size.height, key.in_format,
+		key.out_size.width, key.out_size.height, key.out_format,
+		key.flags, 0, 0, 0
+		);
+
+	if (!context) {
+		throw runtime_error (N_("Could not allocate SwsContext"));
+	}
+
+	DCPOMATIC_ASSERT (key.yuv_to_rgb < dcp::YUV_TO_RGB_COUNT);
+	int const lut[dcp::YUV_TO_RGB_COUNT] = {
+		SWS_CS_ITU601,
+		SWS_CS_ITU709
+	};
+
+	/* The 3rd parameter here is:
+	   0 -> source range MPEG (i.e. "video", 16-235)
+	   1 -> source range JPEG (i.e. "full", 0-255)
+	   And the 5th:
+	   0 -> destination range MPEG (i.e. "video", 16-235)
+	   1 -> destination range JPEG (i.e. "full", 0-255)
+
+	   But remember: sws_setColorspaceDetails ignores
+	   these parameters unless the image isYUV or isGray
+	   (if it's neither, it uses video range for source
+	   and destination).
+	*/
+	sws_setColorspaceDetails (
+		context,
+		sws_getCoefficients (lut[key.yuv_to_rgb]), 0,
+		sws_getCoefficients (lut[key.yuv_to_rgb]), 0,
+		0, 1 << 16, 1 << 16
+		);
+
+	return context;
+}
+
+/** Give back a context that was obtained from get() so that it can be used again.
+ *  If we already have enough idle contexts the least recently used one is freed.
+ */
+void
+SwsContextCache::put (Key const & key, SwsContext* context)
+{
+	SwsContext* oldest = 0;
+
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		_idle.push_front (make_pair (key, context));
+		if (_idle.size() > _maximum_idle) {
+			oldest = _idle.back().second;
+			_idle.pop_back ();
+		}
+	}
+
+	sws_freeContext (oldest);
+}
+
+/** Free all idle contexts */
+void
+SwsContextCache::clear ()
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	for (Idle::iterator i = _idle.begin(); i != _idle.end(); ++i) {
+		sws_freeContext (i->second);
+	}
+	_idle.clear ();
+}
+
+SwsContextCache*
+SwsContextCache::instance ()
+{
+	/* Images are scaled in many threads, so this must be safe to call from any of them */
+	static SwsContextCache* instance = new SwsContextCache ();
+	return instance;
+}
+
+bool
+operator== (SwsContextCache::Key const & a, SwsContextCache::Key const & b)
+{
+	return a.in_size == b.in_size && a.in_format == b.in_format &&
+		a.out_size == b.out_size && a.out_format == b.out_format &&
+		a.flags == b.flags && a.yuv_to_rgb == b.yuv_to_rgb;
+}
@@ -0,0 +1,116 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/sws_context_cache.h
+ *  @brief SwsContextCache and ScopedSwsContext classes.
+ */
+
+#ifndef DCPOMATIC_SWS_CONTEXT_CACHE_H
+#define DCPOMATIC_SWS_CONTEXT_CACHE_H
+
+extern "C" {
+#include <libavutil/pixfmt.h>
+}
+#include <dcp/types.h>
+#include <boost/thread/mutex.hpp>
+#include <boost/noncopyable.hpp>
+#include <list>
+#include <utility>
+
+struct SwsContext;
+
+/** @class SwsContextCache
+ *  @brief A singleton store of idle swscale contexts, so that scaling every frame of a piece of
+ *  content does not mean setting up a new context every time.
+ *
+ *  A context can only be used by one thread at once, so get() takes a context out of the cache
+ *  (making a new one if there is no suitable idle context) and put() gives it back.
+ *  ScopedSwsContext does this automatically.
+ */
+class SwsContextCache : public boost::noncopyable
+{
+public:
+	/** Everything that a SwsContext is set up with */
+	struct Key
+	{
+		Key (dcp::Size in_size_, AVPixelFormat in_format_, dcp::Size out_size_, AVPixelFormat out_format_, int flags_, dcp::YUVToRGB yuv_to_rgb_)
+			: in_size (in_size_)
+			, in_format (in_format_)
+			, out_size (out_size_)
+			, out_format (out_format_)
+			, flags (flags_)
+			, yuv_to_rgb (yuv_to_rgb_)
+		{}
+
+		dcp::Size in_size;
+		AVPixelFormat in_format;
+		dcp::Size out_size;
+		AVPixelFormat out_format;
+		int flags;
+		dcp::YUVToRGB yuv_to_rgb;
+	};
+
+	SwsContext* get (Key const & key);
+	void put (Key const & key, SwsContext* context);
+	void clear ();
+
+	static SwsContextCache* instance ();
+
+private:
+	SwsContextCache ();
+
+	typedef std::list<std::pair<Key, SwsContext*> > Idle;
+
+	/** Mutex for _idle */
+	boost::mutex _mutex;
+	/** Idle contexts, most recently used first */
+	Idle _idle;
+	/** Maximum length of _idle */
+	size_t _maximum_idle;
+};
+
+extern bool operator== (SwsContextCache::Key const & a, SwsContextCache::Key const & b);
+
+/** @class ScopedSwsContext
+ *  @brief A SwsContext from the SwsContextCache which is given back when this object is destroyed.
+ */
+class ScopedSwsContext : public boost::noncopyable
+{
+public:
+	explicit ScopedSwsContext (SwsContextCache::Key const & key)
+		: _key (key)
+		, _context (SwsContextCache::instance()->get(key))
+	{}
+
+	~ScopedSwsContext ()
+	{
+		SwsContextCache::instance()->put (_key, _context);
+	}
+
+	SwsContext* get () const {
+		return _context;
+	}
+
+private:
+	SwsContextCache::Key _key;
+	SwsContext* _context;
+};
+
+#endif
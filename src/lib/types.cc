@@ -21,6 +21,7 @@
 #include "types.h"
 #include "compose.hpp"
 #include "dcpomatic_assert.h"
+#include "exceptions.h"
 #include <dcp/raw_convert.h>
 #include <dcp/cpl.h>
 #include <dcp/dcp.h>
@@ -81,6 +82,38 @@ string_to_resolution (string s)
 	return RESOLUTION_2K;
 }
 
+/** @param c TransportCompression.
+ *  @return Untranslated string representation.
+ */
+string
+transport_compression_to_string (TransportCompression c)
+{
+	switch (c) {
+	case TRANSPORT_COMPRESSION_NONE:
+		return "none";
+	case TRANSPORT_COMPRESSION_ZLIB:
+		return "zlib";
+	}
+
+	DCPOMATIC_ASSERT (false);
+	return "";
+}
+
+TransportCompression
+string_to_transport_compression (string s)
+{
+	if (s == "none") {
+		return TRANSPORT_COMPRESSION_NONE;
+	}
+
+	if (s == "zlib") {
+		return TRANSPORT_COMPRESSION_ZLIB;
+	}
+
+	/* This comes from the network, so don't trust it */
+	throw NetworkError (String::compose ("Unknown transport compression %1", s));
+}
+
 Crop::Crop (shared_ptr<cxml::Node> node)
 {
 	left = node->number_child<int> ("LeftCrop");
@@ -46,7 +46,26 @@ namespace xmlpp {
  *  with servers.  Intended to be bumped when incompatibilities
  *  are introduced.  v2 uses 64+n
  */
-#define SERVER_LINK_VERSION (64+0)
+#define SERVER_LINK_VERSION (64+4)
+
+/** The oldest server link version that we can still talk to; servers
+ *  older than SERVER_LINK_VERSION are sent one frame per connection.
+ */
+#define MINIMUM_SERVER_LINK_VERSION (64+0)
+
+/** The first server link version which supports pipelined sessions, where
+ *  a single connection carries several in-flight frames.
+ */
+#define PIPELINED_SERVER_LINK_VERSION (64+1)
+
+/** The first server link version which can accept compressed image data */
+#define COMPRESSED_TRANSPORT_SERVER_LINK_VERSION (64+2)
+
+/** The first server link version which can decode compressed video packets itself */
+#define PACKET_TRANSPORT_SERVER_LINK_VERSION (64+3)
+
+/** The first server link version which can encode whole reels of a film on shared storage */
+#define REEL_SERVER_LINK_VERSION (64+4)
 
 /** A film of F seconds at f FPS will be Ff frames;
     Consider some delta FPS d, so if we run the same
@@ -236,6 +255,16 @@ enum Resolution {
 std::string resolution_to_string (Resolution);
 Resolution string_to_resolution (std::string);
 
+/** Lossless compression that can be applied to image data sent to encode servers */
+enum TransportCompression {
+	TRANSPORT_COMPRESSION_NONE,
+	/** horizontal byte-delta filter followed by fast zlib deflate */
+	TRANSPORT_COMPRESSION_ZLIB
+};
+
+std::string transport_compression_to_string (TransportCompression);
+TransportCompression string_to_transport_compression (std::string);
+
 enum FileTransferProtocol {
 	FILE_TRANSFER_PROTOCOL_SCP,
 	FILE_TRANSFER_PROTOCOL_FTP
@@ -45,6 +45,7 @@
 #include "image.h"
 #include "text_decoder.h"
 #include "job_manager.h"
+#include "dcpomatic_log.h"
 #include <dcp/locale_convert.h>
 #include <dcp/util.h>
 #include <dcp/raw_convert.h>
@@ -1066,6 +1067,48 @@ copy_in_bits (boost::filesystem::path from, boost::filesystem::path to, boost::f
 	free (buffer);
 }
 
+/** Copy a file in the quickest way that we can: by making a copy-on-write clone,
+ *  then by asking the kernel to do it, then with copy_in_bits().  Like
+ *  boost::filesystem::copy_file(), this will not overwrite an existing file.
+ *  @return The method that was used.
+ */
+CopyMethod
+copy_file_quickly (boost::filesystem::path from, boost::filesystem::path to, boost::function<void (float)> progress)
+{
+	if (boost::filesystem::exists (to)) {
+		throw FileError (_("Destination file already exists"), to);
+	}
+
+	CopyMethod method = COPY_STREAM;
+
+	if (clone_file (from, to)) {
+		method = COPY_CLONE;
+	} else if (kernel_copy_file (from, to, progress)) {
+		method = COPY_KERNEL;
+	} else {
+		copy_in_bits (from, to, progress);
+	}
+
+	LOG_GENERAL ("Copied %1 to %2 using %3", from.string(), to.string(), copy_method_to_string (method));
+	return method;
+}
+
+string
+copy_method_to_string (CopyMethod method)
+{
+	switch (method) {
+	case COPY_CLONE:
+		return _("a copy-on-write clone");
+	case COPY_KERNEL:
+		return _("a kernel copy");
+	case COPY_STREAM:
+		return _("a normal copy");
+	}
+
+	DCPOMATIC_ASSERT (false);
+	return "";
+}
+
 #ifdef DCPOMATIC_VARIANT_SWAROOP
 
 /* Make up a key from the machine UUID */
@@ -108,6 +108,20 @@ extern std::string day_of_week_to_string (boost::gregorian::greg_weekday d);
 extern void emit_subtitle_image (ContentTimePeriod period, dcp::SubtitleImage sub, dcp::Size size, boost::shared_ptr<TextDecoder> decoder);
 extern bool show_jobs_on_console (bool progress);
 extern void copy_in_bits (boost::filesystem::path from, boost::filesystem::path to, boost::function<void (float)>);
+
+/** Ways in which copy_file_quickly() can copy a file */
+enum CopyMethod
+{
+	/** copy-on-write clone */
+	COPY_CLONE,
+	/** copy done by the kernel */
+	COPY_KERNEL,
+	/** copy_in_bits() */
+	COPY_STREAM
+};
+
+extern CopyMethod copy_file_quickly (boost::filesystem::path from, boost::filesystem::path to, boost::function<void (float)> progress);
+extern std::string copy_method_to_string (CopyMethod method);
 #ifdef DCPOMATIC_VARIANT_SWAROOP
 extern boost::shared_ptr<dcp::CertificateChain> read_swaroop_chain (boost::filesystem::path path);
 extern void write_swaroop_chain (boost::shared_ptr<const dcp::CertificateChain> chain, boost::filesystem::path output);
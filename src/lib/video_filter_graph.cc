@@ -44,7 +44,9 @@ VideoFilterGraph::VideoFilterGraph (dcp::Size s, AVPixelFormat p, dcp::Fraction
 }
 
 /** Take an AVFrame and process it using our configured filters, returning a
- *  set of Images.  Caller handles memory management of the input frame.
+ *  set of Images.  Caller handles memory management of the input frame.  Where
+ *  possible the Images refer to the data in the input or filtered frames rather than
+ *  holding copies of it.
  */
 list<pair<shared_ptr<Image>, int64_t> >
 VideoFilterGraph::process (AVFrame* frame)
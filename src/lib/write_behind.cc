@@ -0,0 +1,223 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/write_behind.cc
+ *  @brief WriteBehind class.
+ */
+
+#include "write_behind.h"
+#include "cross.h"
+#include "util.h"
+#include "dcpomatic_log.h"
+#include <boost/bind.hpp>
+#include <sys/time.h>
+#include <algorithm>
+
+using std::map;
+using std::max;
+
+static double
+now ()
+{
+	struct timeval tv;
+	gettimeofday (&tv, 0);
+	return seconds (tv);
+}
+
+/** @param buffer_size Maximum number of bytes to have waiting to be written; write() and close()
+ *  will block when this is exceeded.  With FSYNC_PERIODIC this is also the number of bytes to write
+ *  to a file between syncs.
+ *  @param fsync_policy When to sync files to disk.
+ */
+WriteBehind::WriteBehind (uint64_t buffer_size, Config::FsyncPolicy fsync_policy)
+	: _buffer_size (buffer_size)
+	, _fsync_policy (fsync_policy)
+	, _queued_bytes (0)
+	, _failed (false)
+	, _finish (false)
+	, _thread (boost::bind (&WriteBehind::thread, this))
+{
+#ifdef DCPOMATIC_LINUX
+	pthread_setname_np (_thread.native_handle(), "write-behind");
+#endif
+}
+
+/** Stop our thread; anything which has not yet been written is abandoned */
+WriteBehind::~WriteBehind ()
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	_finish = true;
+	_work_condition.notify_all ();
+	lm.unlock ();
+
+	_thread.join ();
+}
+
+/** Queue a write to a file.  Writes to any one file are done in the order that they are queued.
+ *  @param file File that will be written to; this is used for the counters and for syncing the file.
+ *  @param size Number of bytes that will be written, or that job holds in memory until it is done.
+ *  @param job Function to do the write.
+ */
+void
+WriteBehind::write (boost::filesystem::path file, uint64_t size, boost::function<void ()> job)
+{
+	Item item;
+	item.file = file;
+	item.size = size;
+	item.job = job;
+	item.close = false;
+	item.queued = now ();
+	add (item);
+}
+
+/** Queue the last thing to be done to a file, after which it will be synced unless
+ *  the policy is FSYNC_NEVER.
+ *  @param file File.
+ *  @param job Function to finish writing to the file.
+ */
+void
+WriteBehind::close (boost::filesystem::path file, boost::function<void ()> job)
+{
+	Item item;
+	item.file = file;
+	item.size = 0;
+	item.job = job;
+	item.close = true;
+	item.queued = now ();
+	add (item);
+}
+
+void
+WriteBehind::add (Item const & item)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+
+	/* Always accept an item when nothing is queued, otherwise one which is
+	   bigger than the buffer would never get in.
+	*/
+	while (!_failed && _queued_bytes > 0 && (_queued_bytes + item.size) > _buffer_size) {
+		_done_condition.wait (lm);
+	}
+
+	if (_failed) {
+		boost::rethrow_exception (_exception);
+	}
+
+	_queue.push_back (item);
+	_queued_bytes += item.size;
+
+	Counters& c = _counters[item.file];
+	++c.queued;
+	c.max_queued = max (c.max_queued, c.queued);
+
+	_work_condition.notify_all ();
+}
+
+/** Wait until everything that has been queued has been written */
+void
+WriteBehind::flush ()
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	while (!_queue.empty ()) {
+		_done_condition.wait (lm);
+	}
+
+	if (_failed) {
+		boost::rethrow_exception (_exception);
+	}
+}
+
+/** @return Counters for each file that has been written to */
+map<boost::filesystem::path, WriteBehind::Counters>
+WriteBehind::counters () const
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	return _counters;
+}
+
+void
+WriteBehind::thread ()
+{
+	while (true) {
+		boost::mutex::scoped_lock lm (_mutex);
+		while (!_finish && _queue.empty ()) {
+			_work_condition.wait (lm);
+		}
+
+		if (_finish) {
+			return;
+		}
+
+		/* Leave the item in the queue until it is done, so that flush() waits for it */
+		Item const item = _queue.front ();
+		bool const skip = _failed;
+		lm.unlock ();
+
+		uint64_t& unsynced = _unsynced[item.file];
+		bool const sync =
+			(item.close && _fsync_policy != Config::FSYNC_NEVER) ||
+			(_fsync_policy == Config::FSYNC_PERIODIC && (unsynced + item.size) >= _buffer_size);
+
+		boost::exception_ptr exception;
+		bool synced = false;
+		if (!skip) {
+			try {
+				item.job ();
+				unsynced += item.size;
+				if (sync) {
+					synced = sync_file (item.file);
+					if (synced) {
+						unsynced = 0;
+					} else {
+						LOG_WARNING ("Could not sync %1 to disk", item.file.string());
+					}
+				}
+			} catch (...) {
+				exception = boost::current_exception ();
+			}
+		}
+
+		double const latency = now() - item.queued;
+
+		lm.lock ();
+
+		_queue.pop_front ();
+		_queued_bytes -= item.size;
+
+		Counters& c = _counters[item.file];
+		--c.queued;
+		if (!skip && !exception) {
+			++c.writes;
+			c.bytes += item.size;
+			c.total_latency += latency;
+			c.max_latency = max (c.max_latency, latency);
+			if (synced) {
+				++c.syncs;
+			}
+		}
+
+		if (exception && !_failed) {
+			_exception = exception;
+			_failed = true;
+		}
+
+		_done_condition.notify_all ();
+	}
+}
@@ -0,0 +1,136 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef DCPOMATIC_WRITE_BEHIND_H
+#define DCPOMATIC_WRITE_BEHIND_H
+
+/** @file  src/lib/write_behind.h
+ *  @brief WriteBehind class.
+ */
+
+#include "config.h"
+#include <boost/filesystem.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/condition.hpp>
+#include <boost/exception_ptr.hpp>
+#include <boost/cstdint.hpp>
+#include <list>
+#include <map>
+
+/** @class WriteBehind
+ *  @brief A thread which writes to files on behalf of other threads.
+ *
+ *  Writes are queued and then done, in the order that they were queued, by our
+ *  own thread.  Callers only have to wait for the disk when the writes that are
+ *  already queued hold more than a given amount of data, so a short stall in
+ *  the storage does not hold up whatever is producing the data.
+ *
+ *  If any write fails, the exception that it threw will be thrown from every
+ *  subsequent call to write(), close() or flush(), and any writes which are still
+ *  queued will be abandoned.
+ */
+class WriteBehind : public boost::noncopyable
+{
+public:
+	WriteBehind (uint64_t buffer_size, Config::FsyncPolicy fsync_policy);
+	~WriteBehind ();
+
+	void write (boost::filesystem::path file, uint64_t size, boost::function<void ()> job);
+	void close (boost::filesystem::path file, boost::function<void ()> job);
+	void flush ();
+
+	/** @struct Counters
+	 *  @brief Statistics about the writes to one file.
+	 */
+	struct Counters
+	{
+		Counters ()
+			: queued (0)
+			, max_queued (0)
+			, writes (0)
+			, bytes (0)
+			, total_latency (0)
+			, max_latency (0)
+			, syncs (0)
+		{}
+
+		/** number of writes which are queued or in progress */
+		int queued;
+		/** largest value that queued has had */
+		int max_queued;
+		/** number of writes that have been done */
+		int64_t writes;
+		/** number of bytes that have been written */
+		uint64_t bytes;
+		/** total time between writes being queued and being done, in seconds */
+		double total_latency;
+		/** longest time between a write being queued and being done, in seconds */
+		double max_latency;
+		/** number of times that the file has been synced to disk */
+		int syncs;
+	};
+
+	std::map<boost::filesystem::path, Counters> counters () const;
+
+private:
+	struct Item
+	{
+		boost::filesystem::path file;
+		uint64_t size;
+		boost::function<void ()> job;
+		/** true if this is the last thing that will be done to the file */
+		bool close;
+		/** time that the item was queued */
+		double queued;
+	};
+
+	void add (Item const & item);
+	void thread ();
+
+	/** maximum number of bytes to have queued */
+	uint64_t _buffer_size;
+	Config::FsyncPolicy _fsync_policy;
+
+	/** mutex for everything below here apart from _unsynced */
+	mutable boost::mutex _mutex;
+	/** condition to wake our thread when there is something to do */
+	boost::condition _work_condition;
+	/** condition to wake other threads when something has been written */
+	boost::condition _done_condition;
+	/** things to write; the first of these is being written if our thread is busy */
+	std::list<Item> _queue;
+	/** total size of the items in _queue */
+	uint64_t _queued_bytes;
+	std::map<boost::filesystem::path, Counters> _counters;
+	/** first exception thrown by a write, if there has been one */
+	boost::exception_ptr _exception;
+	bool _failed;
+	/** true if our thread should finish */
+	bool _finish;
+
+	/** bytes written to each file since it was last synced; only used by our thread */
+	std::map<boost::filesystem::path, uint64_t> _unsynced;
+
+	boost::thread _thread;
+};
+
+#endif
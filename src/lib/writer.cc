@@ -36,6 +36,9 @@
 #include "util.h"
 #include "reel_writer.h"
 #include "text_content.h"
+#include "spill_file.h"
+#include "write_behind.h"
+#include "buffer_pool.h"
 #include <dcp/cpl.h>
 #include <dcp/locale_convert.h>
 #include <boost/foreach.hpp>
@@ -43,6 +46,7 @@
 #include <cerrno>
 #include <iostream>
 #include <cfloat>
+#include <limits>
 
 #include "i18n.h"
 
@@ -58,6 +62,7 @@ using std::map;
 using std::min;
 using std::max;
 using std::vector;
+using std::set;
 using boost::shared_ptr;
 using boost::weak_ptr;
 using boost::dynamic_pointer_cast;
@@ -69,9 +74,10 @@ Writer::Writer (shared_ptr<const Film> film, weak_ptr<Job> j)
 	, _job (j)
 	, _thread (0)
 	, _finish (false)
-	, _queued_full_in_memory (0)
+	, _queue_size (0)
+	, _queued_bytes_in_memory (0)
 	/* These will be reset to sensible values when J2KEncoder is created */
-	, _maximum_frames_in_memory (8)
+	, _maximum_bytes_in_memory (8 * frame_size_estimate (film))
 	, _maximum_queue_size (8)
 	, _full_written (0)
 	, _fake_written (0)
@@ -87,6 +93,16 @@ Writer::Writer (shared_ptr<const Film> film, weak_ptr<Job> j)
 		_reels.push_back (ReelWriter (film, p, job, reel_index++, reels.size(), _film->content_summary(p)));
 	}
 
+	_queue.resize (_reels.size ());
+	_spill_files.resize (_reels.size ());
+	BOOST_FOREACH (ReelWriter const & i, _reels) {
+		_last_sequenced.push_back (Position (i.last_written_video_frame(), i.last_written_eyes()));
+	}
+
+	_write_behind.reset (
+		new WriteBehind (uint64_t (Config::instance()->write_behind_buffer()) * 1024 * 1024, Config::instance()->fsync_policy())
+		);
+
 	/* We can keep track of the current audio, subtitle and closed caption reels easily because audio
 	   and captions arrive to the Writer in sequence.  This is not so for video.
 	*/
@@ -115,6 +131,14 @@ Writer::start ()
 Writer::~Writer ()
 {
 	terminate_thread (false);
+
+	/* This may be finalizing a picture asset and starting its digest thread,
+	   so stop it before we stop those.
+	*/
+	_write_behind.reset ();
+
+	_picture_digest_threads.interrupt_all ();
+	_picture_digest_threads.join_all ();
 }
 
 /** Pass a video frame to the writer for writing to disk at some point.
@@ -128,8 +152,8 @@ Writer::write (Data encoded, Frame frame, Eyes eyes)
 {
 	boost::mutex::scoped_lock lock (_state_mutex);
 
-	while (_queued_full_in_memory > _maximum_frames_in_memory) {
-		/* There are too many full frames in memory; wake the main writer thread and
+	while (_queued_bytes_in_memory > _maximum_bytes_in_memory) {
+		/* There is too much JPEG2000 data in memory; wake the main writer thread and
 		   wait until it sorts everything out */
 		_empty_condition.notify_all ();
 		_full_condition.wait (lock);
@@ -144,15 +168,12 @@ Writer::write (Data encoded, Frame frame, Eyes eyes)
 	if (_film->three_d() && eyes == EYES_BOTH) {
 		/* 2D material in a 3D DCP; fake the 3D */
 		qi.eyes = EYES_LEFT;
-		_queue.push_back (qi);
-		++_queued_full_in_memory;
+		push (qi);
 		qi.eyes = EYES_RIGHT;
-		_queue.push_back (qi);
-		++_queued_full_in_memory;
+		push (qi);
 	} else {
 		qi.eyes = eyes;
-		_queue.push_back (qi);
-		++_queued_full_in_memory;
+		push (qi);
 	}
 
 	/* Now there's something to do: wake anything wait()ing on _empty_condition */
@@ -174,7 +195,7 @@ Writer::repeat (Frame frame, Eyes eyes)
 {
 	boost::mutex::scoped_lock lock (_state_mutex);
 
-	while (_queue.size() > _maximum_queue_size && have_sequenced_image_at_queue_head()) {
+	while (_queue_size > _maximum_queue_size && next_sequenced_reel()) {
 		/* The queue is too big, and the main writer thread can run and fix it, so
 		   wake it and wait until it has done.
 		*/
@@ -188,12 +209,12 @@ Writer::repeat (Frame frame, Eyes eyes)
 	qi.frame = frame - _reels[qi.reel].start ();
 	if (_film->three_d() && eyes == EYES_BOTH) {
 		qi.eyes = EYES_LEFT;
-		_queue.push_back (qi);
+		push (qi);
 		qi.eyes = EYES_RIGHT;
-		_queue.push_back (qi);
+		push (qi);
 	} else {
 		qi.eyes = eyes;
-		_queue.push_back (qi);
+		push (qi);
 	}
 
 	/* Now there's something to do: wake anything wait()ing on _empty_condition */
@@ -205,7 +226,7 @@ Writer::fake_write (Frame frame, Eyes eyes)
 {
 	boost::mutex::scoped_lock lock (_state_mutex);
 
-	while (_queue.size() > _maximum_queue_size && have_sequenced_image_at_queue_head()) {
+	while (_queue_size > _maximum_queue_size && next_sequenced_reel()) {
 		/* The queue is too big, and the main writer thread can run and fix it, so
 		   wake it and wait until it has done.
 		*/
@@ -219,21 +240,18 @@ Writer::fake_write (Frame frame, Eyes eyes)
 	QueueItem qi;
 	qi.type = QueueItem::FAKE;
 
-	{
-		shared_ptr<InfoFileHandle> info_file = _film->info_file_handle(_reels[reel].period(), true);
-		qi.size = _reels[reel].read_frame_info(info_file, reel_frame, eyes).size;
-	}
+	qi.size = _reels[reel].read_frame_info(reel_frame, eyes).size;
 
 	qi.reel = reel;
 	qi.frame = reel_frame;
 	if (_film->three_d() && eyes == EYES_BOTH) {
 		qi.eyes = EYES_LEFT;
-		_queue.push_back (qi);
+		push (qi);
 		qi.eyes = EYES_RIGHT;
-		_queue.push_back (qi);
+		push (qi);
 	} else {
 		qi.eyes = eyes;
-		_queue.push_back (qi);
+		push (qi);
 	}
 
 	/* Now there's something to do: wake anything wait()ing on _empty_condition */
@@ -266,7 +284,7 @@ Writer::write (shared_ptr<const AudioBuffers> audio, DCPTime const time)
 
 		if (end <= _audio_reel->period().to) {
 			/* Easy case: we can write all the audio to this reel */
-			_audio_reel->write (audio);
+			queue_audio (*_audio_reel, audio);
 			t = end;
 		} else if (_audio_reel->period().to <= t) {
 			/* This reel is entirely before the start of our audio; just skip the reel */
@@ -286,7 +304,7 @@ Writer::write (shared_ptr<const AudioBuffers> audio, DCPTime const time)
 			if (part_frames[0]) {
 				shared_ptr<AudioBuffers> part (new AudioBuffers (audio->channels(), part_frames[0]));
 				part->copy_from (audio.get(), part_frames[0], 0, 0);
-				_audio_reel->write (part);
+				queue_audio (*_audio_reel, part);
 			}
 
 			if (part_frames[1]) {
@@ -303,39 +321,159 @@ Writer::write (shared_ptr<const AudioBuffers> audio, DCPTime const time)
 	}
 }
 
-/** This must be called from Writer::thread() with an appropriate lock held */
-bool
-Writer::have_sequenced_image_at_queue_head ()
+/** Write some audio frames to a particular reel.  This is for when reels are
+ *  being filled at the same time; calls for any one reel must be made in order,
+ *  but calls for different reels may be made from different threads.
+ *  @param audio Audio data, which must lie entirely within the reel.
+ *  @param reel Reel index.
+ */
+void
+Writer::write (shared_ptr<const AudioBuffers> audio, size_t reel)
 {
-	if (_queue.empty ()) {
-		return false;
+	DCPOMATIC_ASSERT (reel < _reels.size());
+	queue_audio (_reels[reel], audio);
+}
+
+/** Queue some audio to be written to a reel's sound asset by _write_behind */
+void
+Writer::queue_audio (ReelWriter& reel, shared_ptr<const AudioBuffers> audio)
+{
+	optional<boost::filesystem::path> file = reel.sound_file ();
+	if (!file) {
+		/* This reel has no sound asset */
+		return;
 	}
 
-	_queue.sort ();
+	void (ReelWriter::*write) (shared_ptr<const AudioBuffers>) = &ReelWriter::write;
+	_write_behind->write (*file, uint64_t (audio->frames()) * audio->channels() * sizeof (float), boost::bind (write, &reel, audio));
+}
 
-	QueueItem const & f = _queue.front();
-	ReelWriter const & reel = _reels[f.reel];
+/** @return true if f is the next thing to be written to its reel.  This must be called with _state_mutex held. */
+bool
+Writer::is_sequenced (QueueItem const & f) const
+{
+	Position const & last = _last_sequenced[f.reel];
 
 	/* The queue should contain only EYES_LEFT/EYES_RIGHT pairs or EYES_BOTH */
 
 	if (f.eyes == EYES_BOTH) {
 		/* 2D */
-		return f.frame == (reel.last_written_video_frame() + 1);
+		return f.frame == (last.first + 1);
 	}
 
 	/* 3D */
 
-	if (reel.last_written_eyes() == EYES_LEFT && f.frame == reel.last_written_video_frame() && f.eyes == EYES_RIGHT) {
+	if (last.second == EYES_LEFT && f.frame == last.first && f.eyes == EYES_RIGHT) {
 		return true;
 	}
 
-	if (reel.last_written_eyes() == EYES_RIGHT && f.frame == (reel.last_written_video_frame() + 1) && f.eyes == EYES_LEFT) {
+	if (last.second == EYES_RIGHT && f.frame == (last.first + 1) && f.eyes == EYES_LEFT) {
 		return true;
 	}
 
 	return false;
 }
 
+/** Add an item to the queue.  This must be called with _state_mutex held.
+ *  @param qi Item to add.
+ */
+void
+Writer::push (QueueItem const & qi)
+{
+	Position const position (qi.frame, qi.eyes);
+	if (!_queue[qi.reel].insert(make_pair(position, qi)).second) {
+		/* We already have this frame; it must have been encoded twice */
+		LOG_WARNING ("Writer was given frame %1 (%2) of reel %3 twice", qi.frame, static_cast<int>(qi.eyes), qi.reel);
+		return;
+	}
+
+	++_queue_size;
+	if (qi.type == QueueItem::FULL && qi.encoded) {
+		_in_memory.insert (make_pair(qi.reel, position));
+		_queued_bytes_in_memory += qi.encoded->size();
+	}
+}
+
+/** Take the first item for a reel from the queue.  This must be called with _state_mutex held.
+ *  @param reel Reel index, which must have something in the queue.
+ */
+QueueItem
+Writer::pop (size_t reel)
+{
+	map<Position, QueueItem>::iterator i = _queue[reel].begin ();
+	DCPOMATIC_ASSERT (i != _queue[reel].end());
+
+	QueueItem qi = i->second;
+	if (qi.type == QueueItem::FULL && qi.encoded) {
+		_in_memory.erase (make_pair(reel, i->first));
+		_queued_bytes_in_memory -= qi.encoded->size();
+	}
+
+	_queue[reel].erase (i);
+	--_queue_size;
+	return qi;
+}
+
+/** Find a reel whose next item in the queue can be written now.  Reels may be being
+ *  filled at the same time, so this looks at the first item for each reel; as the queue
+ *  for each reel is ordered this is the only one that can be written next.
+ *  This must be called with _state_mutex held.
+ *  @return Reel index, or none if there is nothing to write.
+ */
+optional<size_t>
+Writer::next_sequenced_reel () const
+{
+	for (size_t i = 0; i < _queue.size(); ++i) {
+		if (!_queue[i].empty() && is_sequenced(_queue[i].begin()->second)) {
+			return i;
+		}
+	}
+
+	return optional<size_t> ();
+}
+
+/** Choose a FULL item whose data should be pushed to disk to make room in memory.
+ *  Reels are written at the same time, so this is the last in-memory item of whichever
+ *  reel has it furthest ahead of what that reel last wrote, as it will be needed last.
+ *  This must be called with _state_mutex held, and _in_memory must not be empty.
+ */
+Writer::Key
+Writer::spill_victim () const
+{
+	DCPOMATIC_ASSERT (!_in_memory.empty());
+
+	optional<Key> victim;
+	int victim_distance = 0;
+
+	for (size_t i = 0; i < _queue.size(); ++i) {
+		/* Find the last in-memory item for this reel */
+		set<Key>::const_iterator j = _in_memory.lower_bound (Key (i + 1, Position (std::numeric_limits<int>::min(), EYES_BOTH)));
+		if (j == _in_memory.begin()) {
+			continue;
+		}
+		--j;
+		if (j->first != i) {
+			continue;
+		}
+
+		int const distance = j->second.first - _last_sequenced[i].first;
+		if (!victim || distance > victim_distance) {
+			victim = *j;
+			victim_distance = distance;
+		}
+	}
+
+	DCPOMATIC_ASSERT (victim);
+	return *victim;
+}
+
+/** @return A rough upper bound for the size of an encoded frame of a film, in bytes */
+uint64_t
+Writer::frame_size_estimate (shared_ptr<const Film> film)
+{
+	return uint64_t (film->j2k_bandwidth()) / film->video_frame_rate() / 8;
+}
+
 void
 Writer::thread ()
 try
@@ -346,18 +484,18 @@ try
 
 		while (true) {
 
-			if (_finish || _queued_full_in_memory > _maximum_frames_in_memory || have_sequenced_image_at_queue_head ()) {
+			if (_finish || _queued_bytes_in_memory > _maximum_bytes_in_memory || next_sequenced_reel()) {
 				/* We've got something to do: go and do it */
 				break;
 			}
 
 			/* Nothing to do: wait until something happens which may indicate that we do */
-			LOG_TIMING (N_("writer-sleep queue=%1"), _queue.size());
+			LOG_TIMING (N_("writer-sleep queue=%1"), _queue_size);
 			_empty_condition.wait (lock);
-			LOG_TIMING (N_("writer-wake queue=%1"), _queue.size());
+			LOG_TIMING (N_("writer-wake queue=%1"), _queue_size);
 		}
 
-		if (_finish && _queue.empty()) {
+		if (_finish && _queue_size == 0) {
 			return;
 		}
 
@@ -366,15 +504,15 @@ try
 		   case we will never terminate as no new frames will be sent once
 		   _finish is true).
 		*/
-		if (_finish && (!have_sequenced_image_at_queue_head() || _queue.empty())) {
+		if (_finish && !next_sequenced_reel()) {
 			/* (Hopefully temporarily) log anything that was not written */
-			if (!_queue.empty() && !have_sequenced_image_at_queue_head()) {
-				LOG_WARNING (N_("Finishing writer with a left-over queue of %1:"), _queue.size());
-				for (list<QueueItem>::const_iterator i = _queue.begin(); i != _queue.end(); ++i) {
-					if (i->type == QueueItem::FULL) {
-						LOG_WARNING (N_("- type FULL, frame %1, eyes %2"), i->frame, (int) i->eyes);
+			LOG_WARNING (N_("Finishing writer with a left-over queue of %1:"), _queue_size);
+			for (size_t i = 0; i < _queue.size(); ++i) {
+				for (map<Position, QueueItem>::const_iterator j = _queue[i].begin(); j != _queue[i].end(); ++j) {
+					if (j->second.type == QueueItem::FULL) {
+						LOG_WARNING (N_("- type FULL, frame %1, eyes %2"), j->second.frame, (int) j->second.eyes);
 					} else {
-						LOG_WARNING (N_("- type FAKE, size %1, frame %2, eyes %3"), i->size, i->frame, (int) i->eyes);
+						LOG_WARNING (N_("- type FAKE, size %1, frame %2, eyes %3"), j->second.size, j->second.frame, (int) j->second.eyes);
 					}
 				}
 			}
@@ -382,75 +520,70 @@ try
 		}
 
 		/* Write any frames that we can write; i.e. those that are in sequence. */
-		while (have_sequenced_image_at_queue_head ()) {
-			QueueItem qi = _queue.front ();
-			_queue.pop_front ();
-			if (qi.type == QueueItem::FULL && qi.encoded) {
-				--_queued_full_in_memory;
-			}
+		for (optional<size_t> r = next_sequenced_reel(); r; r = next_sequenced_reel()) {
+			QueueItem qi = pop (*r);
+			_last_sequenced[qi.reel] = Position (qi.frame, qi.eyes);
 
 			lock.unlock ();
 
 			ReelWriter& reel = _reels[qi.reel];
 
-			switch (qi.type) {
-			case QueueItem::FULL:
-				LOG_DEBUG_ENCODE (N_("Writer FULL-writes %1 (%2)"), qi.frame, (int) qi.eyes);
+			uint64_t size = 0;
+			if (qi.type == QueueItem::FULL) {
 				if (!qi.encoded) {
-					qi.encoded = Data (_film->j2c_path (qi.reel, qi.frame, qi.eyes, false));
+					DCPOMATIC_ASSERT (_spill_files[qi.reel]);
+					qi.encoded = _spill_files[qi.reel]->read (qi.frame, qi.eyes);
 				}
-				reel.write (qi.encoded, qi.frame, qi.eyes);
-				++_full_written;
-				break;
-			case QueueItem::FAKE:
-				LOG_DEBUG_ENCODE (N_("Writer FAKE-writes %1"), qi.frame);
-				reel.fake_write (qi.frame, qi.eyes, qi.size);
-				++_fake_written;
-				break;
-			case QueueItem::REPEAT:
-				LOG_DEBUG_ENCODE (N_("Writer REPEAT-writes %1"), qi.frame);
-				reel.repeat_write (qi.frame, qi.eyes);
-				++_repeat_written;
-				break;
+				size = qi.encoded->size ();
+			}
+
+			/* This will only wait if there is already a lot of data waiting to go to disk */
+			_write_behind->write (reel.picture_file(), size, boost::bind (&Writer::write_frame, this, qi));
+
+			if (qi.eyes != EYES_LEFT && qi.frame == reel.period().duration().frames_round(_film->video_frame_rate()) - 1) {
+				/* That was the last frame of the reel, so we have finished with its spill file */
+				if (_spill_files[qi.reel] && _spill_files[qi.reel]->empty()) {
+					_spill_files[qi.reel].reset ();
+				}
+				/* and we can finish its picture asset and start calculating its digest
+				   while the data is probably still in the cache, rather than waiting
+				   for the rest of the DCP.
+				*/
+				_write_behind->close (reel.picture_file(), boost::bind (&Writer::finalize_picture, this, qi.reel));
 			}
 
 			lock.lock ();
 			_full_condition.notify_all ();
 		}
 
-		while (_queued_full_in_memory > _maximum_frames_in_memory) {
-			/* Too many frames in memory which can't yet be written to the stream.
-			   Write some FULL frames to disk.
+		while (_queued_bytes_in_memory > _maximum_bytes_in_memory) {
+			/* Too much data in memory which can't yet be written to the stream.
+			   Write the FULL frame which will be needed last to disk.
 			*/
 
-			/* Find one from the back of the queue */
-			_queue.sort ();
-			list<QueueItem>::reverse_iterator i = _queue.rbegin ();
-			while (i != _queue.rend() && (i->type != QueueItem::FULL || !i->encoded)) {
-				++i;
-			}
-
-			DCPOMATIC_ASSERT (i != _queue.rend());
+			Key const key = spill_victim ();
+			QueueItem& qi = _queue[key.first][key.second];
 			++_pushed_to_disk;
 			/* For the log message below */
-			int const awaiting = _reels[_queue.front().reel].last_written_video_frame() + 1;
+			int const awaiting = _last_sequenced[key.first].first + 1;
 			lock.unlock ();
 
-			/* i is valid here, even though we don't hold a lock on the mutex,
-			   since list iterators are unaffected by insertion and only this
-			   thread could erase the last item in the list.
+			/* qi is valid here, even though we don't hold a lock on the mutex,
+			   since map references are unaffected by insertion and only this
+			   thread erases things from the queue.
 			*/
 
-			LOG_GENERAL ("Writer full; pushes %1 to disk while awaiting %2", i->frame, awaiting);
+			LOG_GENERAL ("Writer full; pushes %1 to disk while awaiting %2", qi.frame, awaiting);
 
-			i->encoded->write_via_temp (
-				_film->j2c_path (i->reel, i->frame, i->eyes, true),
-				_film->j2c_path (i->reel, i->frame, i->eyes, false)
-				);
+			if (!_spill_files[qi.reel]) {
+				_spill_files[qi.reel].reset (new SpillFile (_film->spill_path (qi.reel)));
+			}
+			_spill_files[qi.reel]->write (qi.frame, qi.eyes, *qi.encoded);
 
 			lock.lock ();
-			i->encoded.reset ();
-			--_queued_full_in_memory;
+			_in_memory.erase (key);
+			_queued_bytes_in_memory -= qi.encoded->size();
+			qi.encoded.reset ();
 			_full_condition.notify_all ();
 		}
 	}
@@ -460,6 +593,63 @@ catch (...)
 	store_current ();
 }
 
+/** Write an item that our thread has taken from the queue to its reel.  This is called by _write_behind's thread.
+ *  @param qi Item, with its encoded data in memory if it is FULL.
+ */
+void
+Writer::write_frame (QueueItem qi)
+{
+	ReelWriter& reel = _reels[qi.reel];
+
+	switch (qi.type) {
+	case QueueItem::FULL:
+		LOG_DEBUG_ENCODE (N_("Writer FULL-writes %1 (%2)"), qi.frame, (int) qi.eyes);
+		reel.write (qi.encoded, qi.frame, qi.eyes);
+		++_full_written;
+		break;
+	case QueueItem::FAKE:
+		LOG_DEBUG_ENCODE (N_("Writer FAKE-writes %1"), qi.frame);
+		reel.fake_write (qi.frame, qi.eyes, qi.size);
+		++_fake_written;
+		break;
+	case QueueItem::REPEAT:
+		LOG_DEBUG_ENCODE (N_("Writer REPEAT-writes %1"), qi.frame);
+		reel.repeat_write (qi.frame, qi.eyes);
+		++_repeat_written;
+		break;
+	}
+}
+
+/** Finish a reel's picture asset and start calculating its digest.  This is called by _write_behind's thread.
+ *  @param reel Reel index.
+ */
+void
+Writer::finalize_picture (size_t reel)
+{
+	_reels[reel].finalize_picture ();
+	_picture_digest_threads.create_thread (boost::bind (&Writer::calculate_picture_digest, this, &_reels[reel]));
+}
+
+void
+Writer::log_write_behind_counters () const
+{
+	typedef map<boost::filesystem::path, WriteBehind::Counters> CountersMap;
+	CountersMap const counters = _write_behind->counters ();
+	for (CountersMap::const_iterator i = counters.begin(); i != counters.end(); ++i) {
+		WriteBehind::Counters const & c = i->second;
+		LOG_GENERAL (
+			N_("%1: %2 writes of %3 bytes; maximum queue depth %4; latency mean %5s, maximum %6s; %7 syncs"),
+			i->first.filename().string(),
+			c.writes,
+			c.bytes,
+			c.max_queued,
+			c.writes ? (c.total_latency / c.writes) : 0,
+			c.max_latency,
+			c.syncs
+			);
+	}
+}
+
 void
 Writer::terminate_thread (bool can_throw)
 {
@@ -496,6 +686,26 @@ Writer::finish ()
 
 	terminate_thread (true);
 
+	LOG_GENERAL_NC ("Waiting for assets to be written");
+
+	/* Finish the sound assets in the same way as the picture ones so that they are synced, if required */
+	BOOST_FOREACH (ReelWriter& i, _reels) {
+		optional<boost::filesystem::path> sound = i.sound_file ();
+		if (sound) {
+			_write_behind->close (*sound, boost::bind (&ReelWriter::finalize_sound, &i));
+		}
+	}
+
+	_write_behind->flush ();
+	log_write_behind_counters ();
+
+	BufferPool::Counters const pool = BufferPool::instance()->counters ();
+	LOG_GENERAL (N_("Buffer pool: %1 hits, %2 misses, %3 bytes resident"), pool.hits, pool.misses, pool.resident);
+
+	/* ReelWriter::finish changes the picture asset's file, so we must wait for these first */
+	_picture_digest_threads.join_all ();
+	rethrow ();
+
 	LOG_GENERAL_NC ("Finishing ReelWriters");
 
 	BOOST_FOREACH (ReelWriter& i, _reels) {
@@ -671,6 +881,28 @@ Writer::can_fake_write (Frame frame) const
 	return (frame != 0 && frame < reel.first_nonexistant_frame());
 }
 
+/** @param frame Frame index within the DCP.
+ *  @return Encoded data for this frame taken from an earlier encode, if its picture
+ *  has not changed since then, otherwise none.
+ */
+optional<Data>
+Writer::previous_frame (Frame frame, Eyes eyes) const
+{
+	ReelWriter const & reel = _reels[video_reel(frame)];
+	return reel.previous_frame (frame - reel.start(), eyes);
+}
+
+/** @param frame Frame index within the DCP.
+ *  @return Encoded data for this frame from the picture asset that was already on disk
+ *  when we started, or none if it is not there.
+ */
+optional<Data>
+Writer::existing_frame (Frame frame, Eyes eyes) const
+{
+	ReelWriter const & reel = _reels[video_reel(frame)];
+	return reel.existing_frame (frame - reel.start(), eyes);
+}
+
 /** @param track Closed caption track if type == TEXT_CLOSED_CAPTION */
 void
 Writer::write (PlayerText text, TextType type, optional<DCPTextTrack> track, DCPTimePeriod period)
@@ -699,6 +931,17 @@ Writer::write (PlayerText text, TextType type, optional<DCPTextTrack> track, DCP
 	(*reel)->write (text, type, track, period);
 }
 
+/** Write some text to a particular reel, with the same threading rules as
+ *  write (shared_ptr<const AudioBuffers>, size_t).
+ *  @param reel Reel index.
+ */
+void
+Writer::write (PlayerText text, TextType type, optional<DCPTextTrack> track, DCPTimePeriod period, size_t reel)
+{
+	DCPOMATIC_ASSERT (reel < _reels.size());
+	_reels[reel].write (text, type, track, period);
+}
+
 void
 Writer::write (list<shared_ptr<Font> > fonts)
 {
@@ -718,31 +961,11 @@ Writer::write (list<shared_ptr<Font> > fonts)
 	}
 }
 
-bool
-operator< (QueueItem const & a, QueueItem const & b)
-{
-	if (a.reel != b.reel) {
-		return a.reel < b.reel;
-	}
-
-	if (a.frame != b.frame) {
-		return a.frame < b.frame;
-	}
-
-	return static_cast<int> (a.eyes) < static_cast<int> (b.eyes);
-}
-
-bool
-operator== (QueueItem const & a, QueueItem const & b)
-{
-	return a.reel == b.reel && a.frame == b.frame && a.eyes == b.eyes;
-}
-
 void
 Writer::set_encoder_threads (int threads)
 {
 	boost::mutex::scoped_lock lm (_state_mutex);
-	_maximum_frames_in_memory = lrint (threads * Config::instance()->frames_in_memory_multiplier());
+	_maximum_bytes_in_memory = uint64_t (threads) * Config::instance()->frames_in_memory_multiplier() * frame_size_estimate (_film);
 	_maximum_queue_size = threads * 16;
 }
 
@@ -765,6 +988,28 @@ Writer::video_reel (int frame) const
 	return i;
 }
 
+static void
+digest_interruption_point (float)
+{
+	boost::this_thread::interruption_point ();
+}
+
+/** Thread to calculate the digest of a reel's picture asset whose last frame has been written */
+void
+Writer::calculate_picture_digest (ReelWriter* reel)
+try
+{
+	reel->calculate_picture_digest (boost::bind (&digest_interruption_point, _1));
+}
+catch (boost::thread_interrupted &)
+{
+	/* The Writer is being destroyed */
+}
+catch (...)
+{
+	store_current ();
+}
+
 void
 Writer::set_digest_progress (Job* job, float progress)
 {
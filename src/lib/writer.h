@@ -31,6 +31,8 @@
 #include <boost/thread.hpp>
 #include <boost/thread/condition.hpp>
 #include <list>
+#include <map>
+#include <set>
 
 namespace dcp {
 	class Data;
@@ -42,6 +44,10 @@ class Job;
 class Font;
 class ReferencedReelAsset;
 class ReelWriter;
+class SpillFile;
+class WriteBehind;
+struct writer_spill_victim_test;
+struct writer_spill_test;
 
 struct QueueItem
 {
@@ -76,9 +82,6 @@ public:
 	Eyes eyes;
 };
 
-bool operator< (QueueItem const & a, QueueItem const & b);
-bool operator== (QueueItem const & a, QueueItem const & b);
-
 /** @class Writer
  *  @brief Class to manage writing JPEG2000 and audio data to assets on disk.
  *
@@ -99,25 +102,48 @@ public:
 	void start ();
 
 	bool can_fake_write (Frame) const;
+	boost::optional<dcp::Data> previous_frame (Frame, Eyes) const;
+	boost::optional<dcp::Data> existing_frame (Frame, Eyes) const;
 
 	void write (dcp::Data, Frame, Eyes);
 	void fake_write (Frame, Eyes);
 	bool can_repeat (Frame) const;
 	void repeat (Frame, Eyes);
 	void write (boost::shared_ptr<const AudioBuffers>, DCPTime time);
+	void write (boost::shared_ptr<const AudioBuffers>, size_t reel);
 	void write (PlayerText text, TextType type, boost::optional<DCPTextTrack>, DCPTimePeriod period);
+	void write (PlayerText text, TextType type, boost::optional<DCPTextTrack>, DCPTimePeriod period, size_t reel);
 	void write (std::list<boost::shared_ptr<Font> > fonts);
 	void write (ReferencedReelAsset asset);
 	void finish ();
 
 	void set_encoder_threads (int threads);
 
+	size_t video_reel (int frame) const;
+
 private:
+	friend struct ::writer_spill_victim_test;
+	friend struct ::writer_spill_test;
+
 	void thread ();
 	void terminate_thread (bool);
-	bool have_sequenced_image_at_queue_head ();
-	size_t video_reel (int frame) const;
+	/** frame index within a reel and eyes; ordered in the same way as they must be written */
+	typedef std::pair<int, Eyes> Position;
+	/** reel index and Position */
+	typedef std::pair<size_t, Position> Key;
+
+	void push (QueueItem const & qi);
+	QueueItem pop (size_t reel);
+	bool is_sequenced (QueueItem const & f) const;
+	boost::optional<size_t> next_sequenced_reel () const;
+	Key spill_victim () const;
+	void write_frame (QueueItem qi);
+	void finalize_picture (size_t reel);
+	void queue_audio (ReelWriter& reel, boost::shared_ptr<const AudioBuffers> audio);
+	void log_write_behind_counters () const;
+	static uint64_t frame_size_estimate (boost::shared_ptr<const Film> film);
 	void set_digest_progress (Job* job, float progress);
+	void calculate_picture_digest (ReelWriter* reel);
 	void write_cover_sheet ();
 
 	/** our Film */
@@ -132,21 +158,36 @@ private:
 	boost::thread* _thread;
 	/** true if our thread should finish */
 	bool _finish;
-	/** queue of things to write to disk */
-	std::list<QueueItem> _queue;
-	/** number of FULL frames whose JPEG200 data is currently held in RAM */
-	int _queued_full_in_memory;
+	/** things to write to disk for each reel, indexed by their position within the reel */
+	std::vector<std::map<Position, QueueItem> > _queue;
+	/** total number of items in _queue */
+	size_t _queue_size;
+	/** FULL items in _queue whose JPEG2000 data is currently held in RAM */
+	std::set<Key> _in_memory;
+	/** total size of the JPEG2000 data of the items in _in_memory */
+	uint64_t _queued_bytes_in_memory;
+	/** files holding the JPEG2000 data of FULL items which are not in _in_memory, for each
+	 *  reel; these are created when they are first needed and only used by our thread.
+	 */
+	std::vector<boost::shared_ptr<SpillFile> > _spill_files;
+	/** position of the last item for each reel that our thread has taken from _queue and given to _write_behind */
+	std::vector<Position> _last_sequenced;
 	/** mutex for thread state */
 	mutable boost::mutex _state_mutex;
 	/** condition to manage thread wakeups when we have nothing to do  */
 	boost::condition _empty_condition;
 	/** condition to manage thread wakeups when we have too much to do */
 	boost::condition _full_condition;
-	/** maximum number of frames to hold in memory, for when we are managing
-	 *  ordering
+	/** maximum number of bytes of JPEG2000 data to hold in memory, for when we are
+	 *  managing ordering
+	 */
+	uint64_t _maximum_bytes_in_memory;
+	size_t _maximum_queue_size;
+
+	/** thread which writes our picture and sound assets, so that a slow disk
+	 *  holds up our thread (and hence the encoders) as little as possible
 	 */
-	int _maximum_frames_in_memory;
-	unsigned int _maximum_queue_size;
+	boost::shared_ptr<WriteBehind> _write_behind;
 
 	/** number of FULL written frames */
 	int _full_written;
@@ -158,6 +199,9 @@ private:
 	*/
 	int _pushed_to_disk;
 
+	/** threads calculating the digests of picture assets which were finished before finish() was called */
+	boost::thread_group _picture_digest_threads;
+
 	boost::mutex _digest_progresses_mutex;
 	std::map<boost::thread::id, float> _digest_progresses;
 
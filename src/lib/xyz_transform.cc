@@ -0,0 +1,167 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/xyz_transform.cc
+ *  @brief XYZTransform class.
+ */
+
+#include "xyz_transform.h"
+#include "colour_conversion.h"
+#include <dcp/colour_conversion.h>
+#include <dcp/transfer_function.h>
+#include <dcp/rgb_xyz.h>
+#include <algorithm>
+#include <cmath>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using std::min;
+using std::max;
+using std::string;
+using std::make_pair;
+using boost::shared_ptr;
+
+boost::mutex XYZTransform::_cache_mutex;
+XYZTransform::Cache XYZTransform::_cache;
+
+/** Number of transforms that get() keeps; a film rarely has more than one or two different
+ *  colour conversions, but the colour conversion editor may make a few as it goes.
+ */
+static size_t const cache_size = 8;
+
+/** @return x rounded to the nearest integer in the same way as lrint(), but without the library
+ *  call that lrint() often becomes.
+ */
+static inline int
+round_to_int (double x)
+{
+#ifdef __SSE2__
+	return _mm_cvtsd_si32 (_mm_set_sd (x));
+#else
+	return lrint (x);
+#endif
+}
+
+XYZTransform::XYZTransform (dcp::ColourConversion const & conversion)
+{
+	double const * lut_in = conversion.in()->lut (12, false);
+	double const * lut_out = conversion.out()->lut (16, true);
+	double matrix[9];
+	dcp::combined_rgb_to_xyz (conversion, matrix);
+
+	for (int c = 0; c < 3; ++c) {
+		_in[c].resize (4096 * 4);
+		for (int i = 0; i < 4096; ++i) {
+			for (int j = 0; j < 3; ++j) {
+				_in[c][i * 4 + j] = lut_in[i] * matrix[j * 3 + c];
+			}
+		}
+	}
+
+	_out.resize (65536);
+	for (int i = 0; i < 65536; ++i) {
+		_out[i] = lrint (lut_out[i] * 4095);
+	}
+}
+
+/** Transform a row of pixels.
+ *  @param r Red values (12-bit); similarly g and b.
+ *  @param X Array to write X values (12-bit) to; similarly Y and Z.
+ *  @param width Number of pixels.
+ *  @return Number of pixels that had XYZ values which were clamped.
+ */
+int
+XYZTransform::transform_row (int const * r, int const * g, int const * b, int* X, int* Y, int* Z, int width) const
+{
+	double const * in_r = &_in[0][0];
+	double const * in_g = &_in[1][0];
+	double const * in_b = &_in[2][0];
+	int const * out = &_out[0];
+
+	int clamped = 0;
+	for (int x = 0; x < width; ++x) {
+		double const * pr = in_r + r[x] * 4;
+		double const * pg = in_g + g[x] * 4;
+		double const * pb = in_b + b[x] * 4;
+
+		/* Summed in the same order as dcp::rgb_to_xyz so that we get the same answer */
+		double dx = pr[0] + pg[0] + pb[0];
+		double dy = pr[1] + pg[1] + pb[1];
+		double dz = pr[2] + pg[2] + pb[2];
+
+		if (dx < 0 || dy < 0 || dz < 0 || dx > 65535 || dy > 65535 || dz > 65535) {
+			++clamped;
+		}
+
+		dx = max (0.0, min (65535.0, dx));
+		dy = max (0.0, min (65535.0, dy));
+		dz = max (0.0, min (65535.0, dz));
+
+		X[x] = out[round_to_int(dx)];
+		Y[x] = out[round_to_int(dy)];
+		Z[x] = out[round_to_int(dz)];
+	}
+
+	return clamped;
+}
+
+/** @return Transform for a colour conversion.  This may be called from any thread */
+shared_ptr<const XYZTransform>
+XYZTransform::get (ColourConversion const & conversion)
+{
+	string const key = conversion.identifier ();
+
+	{
+		boost::mutex::scoped_lock lm (_cache_mutex);
+		for (Cache::iterator i = _cache.begin(); i != _cache.end(); ++i) {
+			if (i->first == key) {
+				_cache.splice (_cache.begin(), _cache, i);
+				return _cache.front().second;
+			}
+		}
+	}
+
+	/* Build the tables without holding the lock; if another thread does the same thing
+	   at the same time, whichever finishes second uses the first one's transform.
+	*/
+	shared_ptr<const XYZTransform> transform (new XYZTransform (conversion));
+
+	boost::mutex::scoped_lock lm (_cache_mutex);
+	for (Cache::iterator i = _cache.begin(); i != _cache.end(); ++i) {
+		if (i->first == key) {
+			return i->second;
+		}
+	}
+
+	_cache.push_front (make_pair (key, transform));
+	if (_cache.size() > cache_size) {
+		_cache.pop_back ();
+	}
+
+	return transform;
+}
+
+void
+XYZTransform::clear_cache ()
+{
+	boost::mutex::scoped_lock lm (_cache_mutex);
+	_cache.clear ();
+}
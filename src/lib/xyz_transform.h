@@ -0,0 +1,79 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/xyz_transform.h
+ *  @brief XYZTransform class.
+ */
+
+#ifndef DCPOMATIC_XYZ_TRANSFORM_H
+#define DCPOMATIC_XYZ_TRANSFORM_H
+
+#include <boost/shared_ptr.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <list>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace dcp {
+	class ColourConversion;
+}
+
+class ColourConversion;
+
+/** @class XYZTransform
+ *  @brief Precomputed tables to convert 12-bit RGB to 12-bit XYZ according to a colour conversion.
+ *
+ *  The input transfer function is folded into the RGB to XYZ matrix, giving a table of the
+ *  contribution of each possible value of each input component to each output component, and
+ *  the output transfer function is tabulated as integers, so each pixel is just some lookups,
+ *  additions and a clamp.  The result is the same as dcp::rgb_to_xyz gives.
+ *
+ *  XYZTransforms take a little while to build, so get() keeps the most recently used ones; once
+ *  built they are never changed, so they can be used by any number of threads at once.
+ */
+class XYZTransform : public boost::noncopyable
+{
+public:
+	explicit XYZTransform (dcp::ColourConversion const & conversion);
+
+	int transform_row (int const * r, int const * g, int const * b, int* X, int* Y, int* Z, int width) const;
+
+	static boost::shared_ptr<const XYZTransform> get (ColourConversion const & conversion);
+	static void clear_cache ();
+
+private:
+	/** Matrix contributions of each input component: entry [c][i * 4 + j] is the
+	 *  contribution of 12-bit value i of input component c to output component j, before clamping.
+	 *  Each entry is padded to 4 values to keep it within a cache line.
+	 */
+	std::vector<double> _in[3];
+	/** Output transfer function for a clamped 16-bit value, giving a 12-bit result */
+	std::vector<int> _out;
+
+	typedef std::list<std::pair<std::string, boost::shared_ptr<const XYZTransform> > > Cache;
+
+	static boost::mutex _cache_mutex;
+	/** Recently used transforms, most recent first */
+	static Cache _cache;
+};
+
+#endif
@@ -1365,9 +1365,21 @@ public:
 	AdvancedPage (wxSize panel_size, int border)
 		: StockPage (Kind_Advanced, panel_size, border)
 		, _maximum_j2k_bandwidth (0)
+		, _write_behind_buffer (0)
+		, _fsync_policy (0)
+		, _buffer_pool_size (0)
 		, _allow_any_dcp_frame_rate (0)
 		, _allow_any_container (0)
 		, _only_servers_encode (0)
+		, _compress_server_transfers (0)
+		, _defer_video_decoding (0)
+		, _j2k_cache (0)
+		, _j2k_cache_size (0)
+		, _parallel_reels (0)
+		, _parallel_content_decoding (0)
+		, _distribute_reels (0)
+		, _video_decode_threads (0)
+		, _video_decode_thread_type (0)
 		, _log_general (0)
 		, _log_warning (0)
 		, _log_error (0)
@@ -1423,6 +1435,55 @@ private:
 		table->Add (_only_servers_encode, 1, wxEXPAND | wxALL);
 		table->AddSpacer (0);
 
+		_compress_server_transfers = new CheckBox (_panel, _("Compress frames sent to encoding servers"));
+		table->Add (_compress_server_transfers, 1, wxEXPAND | wxALL);
+		table->AddSpacer (0);
+
+		_defer_video_decoding = new CheckBox (_panel, _("Decode intra-frame video in encoding threads and servers"));
+		table->Add (_defer_video_decoding, 1, wxEXPAND | wxALL);
+		table->AddSpacer (0);
+
+		_j2k_cache = new CheckBox (_panel, _("Keep encoded frames to re-use when the same frame is encoded again"));
+		table->Add (_j2k_cache, 1, wxEXPAND | wxALL);
+		table->AddSpacer (0);
+
+		{
+			add_label_to_sizer (table, _panel, _("Maximum size of encoded frame cache"), true);
+			wxBoxSizer* s = new wxBoxSizer (wxHORIZONTAL);
+			_j2k_cache_size = new wxSpinCtrl (_panel);
+			s->Add (_j2k_cache_size, 1);
+			add_label_to_sizer (s, _panel, _("GB"), false);
+			table->Add (s, 1);
+		}
+
+		_parallel_reels = new CheckBox (_panel, _("Decode each reel in its own thread"));
+		table->Add (_parallel_reels, 1, wxEXPAND | wxALL);
+		table->AddSpacer (0);
+
+		_parallel_content_decoding = new CheckBox (_panel, _("Decode each piece of content in its own thread"));
+		table->Add (_parallel_content_decoding, 1, wxEXPAND | wxALL);
+		table->AddSpacer (0);
+
+		_distribute_reels = new CheckBox (_panel, _("Send whole reels to encoding servers which share the film's storage"));
+		table->Add (_distribute_reels, 1, wxEXPAND | wxALL);
+		table->AddSpacer (0);
+
+		{
+			add_label_to_sizer (table, _panel, _("Threads to decode each video stream"), true);
+			wxBoxSizer* s = new wxBoxSizer (wxHORIZONTAL);
+			_video_decode_threads = new wxSpinCtrl (_panel);
+			s->Add (_video_decode_threads, 1);
+			add_label_to_sizer (s, _panel, _("(0 for automatic)"), false);
+			table->Add (s, 1);
+		}
+
+		add_label_to_sizer (table, _panel, _("Decode video using"), true);
+		_video_decode_thread_type = new wxChoice (_panel, wxID_ANY);
+		_video_decode_thread_type->Append (_("Frame and slice threads"));
+		_video_decode_thread_type->Append (_("Frame threads"));
+		_video_decode_thread_type->Append (_("Slice threads"));
+		table->Add (_video_decode_thread_type, 1);
+
 		{
 			add_label_to_sizer (table, _panel, _("Maximum number of frames to store per thread"), true);
 			wxBoxSizer* s = new wxBoxSizer (wxHORIZONTAL);
@@ -1431,6 +1492,31 @@ private:
 			table->Add (s, 1);
 		}
 
+		{
+			add_label_to_sizer (table, _panel, _("Maximum data waiting to be written to assets"), true);
+			wxBoxSizer* s = new wxBoxSizer (wxHORIZONTAL);
+			_write_behind_buffer = new wxSpinCtrl (_panel);
+			s->Add (_write_behind_buffer, 1);
+			add_label_to_sizer (s, _panel, _("MB"), false);
+			table->Add (s, 1);
+		}
+
+		add_label_to_sizer (table, _panel, _("Sync assets to disk"), true);
+		_fsync_policy = new wxChoice (_panel, wxID_ANY);
+		_fsync_policy->Append (_("Never"));
+		_fsync_policy->Append (_("When each asset is finished"));
+		_fsync_policy->Append (_("Periodically and when each asset is finished"));
+		table->Add (_fsync_policy, 1);
+
+		{
+			add_label_to_sizer (table, _panel, _("Memory to keep for re-use by images and audio"), true);
+			wxBoxSizer* s = new wxBoxSizer (wxHORIZONTAL);
+			_buffer_pool_size = new wxSpinCtrl (_panel);
+			s->Add (_buffer_pool_size, 1);
+			add_label_to_sizer (s, _panel, _("MB"), false);
+			table->Add (s, 1);
+		}
+
 		{
 			add_top_aligned_label_to_sizer (table, _panel, _("DCP metadata filename format"));
 			dcp::NameFormat::Map titles;
@@ -1493,7 +1579,23 @@ private:
 		_allow_any_dcp_frame_rate->Bind (wxEVT_CHECKBOX, boost::bind (&AdvancedPage::allow_any_dcp_frame_rate_changed, this));
 		_allow_any_container->Bind (wxEVT_CHECKBOX, boost::bind (&AdvancedPage::allow_any_container_changed, this));
 		_only_servers_encode->Bind (wxEVT_CHECKBOX, boost::bind (&AdvancedPage::only_servers_encode_changed, this));
+		_compress_server_transfers->Bind (wxEVT_CHECKBOX, boost::bind (&AdvancedPage::compress_server_transfers_changed, this));
+		_defer_video_decoding->Bind (wxEVT_CHECKBOX, boost::bind (&AdvancedPage::defer_video_decoding_changed, this));
+		_j2k_cache->Bind (wxEVT_CHECKBOX, boost::bind (&AdvancedPage::j2k_cache_changed, this));
+		_j2k_cache_size->SetRange (1, 10000);
+		_j2k_cache_size->Bind (wxEVT_SPINCTRL, boost::bind (&AdvancedPage::j2k_cache_size_changed, this));
+		_parallel_reels->Bind (wxEVT_CHECKBOX, boost::bind (&AdvancedPage::parallel_reels_changed, this));
+		_parallel_content_decoding->Bind (wxEVT_CHECKBOX, boost::bind (&AdvancedPage::parallel_content_decoding_changed, this));
+		_distribute_reels->Bind (wxEVT_CHECKBOX, boost::bind (&AdvancedPage::distribute_reels_changed, this));
+		_video_decode_threads->SetRange (0, 64);
+		_video_decode_threads->Bind (wxEVT_SPINCTRL, boost::bind (&AdvancedPage::video_decode_threads_changed, this));
+		_video_decode_thread_type->Bind (wxEVT_CHOICE, boost::bind (&AdvancedPage::video_decode_thread_type_changed, this));
 		_frames_in_memory_multiplier->Bind (wxEVT_SPINCTRL, boost::bind(&AdvancedPage::frames_in_memory_multiplier_changed, this));
+		_write_behind_buffer->SetRange (16, 16384);
+		_write_behind_buffer->Bind (wxEVT_SPINCTRL, boost::bind(&AdvancedPage::write_behind_buffer_changed, this));
+		_fsync_policy->Bind (wxEVT_CHOICE, boost::bind(&AdvancedPage::fsync_policy_changed, this));
+		_buffer_pool_size->SetRange (0, 65536);
+		_buffer_pool_size->Bind (wxEVT_SPINCTRL, boost::bind(&AdvancedPage::buffer_pool_size_changed, this));
 		_dcp_metadata_filename_format->Changed.connect (boost::bind (&AdvancedPage::dcp_metadata_filename_format_changed, this));
 		_dcp_asset_filename_format->Changed.connect (boost::bind (&AdvancedPage::dcp_asset_filename_format_changed, this));
 		_log_general->Bind (wxEVT_CHECKBOX, boost::bind (&AdvancedPage::log_changed, this));
@@ -1516,6 +1618,16 @@ private:
 		checked_set (_allow_any_dcp_frame_rate, config->allow_any_dcp_frame_rate ());
 		checked_set (_allow_any_container, config->allow_any_container ());
 		checked_set (_only_servers_encode, config->only_servers_encode ());
+		checked_set (_compress_server_transfers, config->compress_server_transfers ());
+		checked_set (_defer_video_decoding, config->defer_video_decoding ());
+		checked_set (_j2k_cache, config->j2k_cache ());
+		checked_set (_j2k_cache_size, config->j2k_cache_size ());
+		_j2k_cache_size->Enable (config->j2k_cache ());
+		checked_set (_parallel_reels, config->parallel_reels ());
+		checked_set (_parallel_content_decoding, config->parallel_content_decoding ());
+		checked_set (_distribute_reels, config->distribute_reels ());
+		checked_set (_video_decode_threads, config->video_decode_threads ());
+		checked_set (_video_decode_thread_type, static_cast<int>(config->video_decode_thread_type()));
 		checked_set (_log_general, config->log_types() & LogEntry::TYPE_GENERAL);
 		checked_set (_log_warning, config->log_types() & LogEntry::TYPE_WARNING);
 		checked_set (_log_error, config->log_types() & LogEntry::TYPE_ERROR);
@@ -1524,6 +1636,9 @@ private:
 		checked_set (_log_debug_encode, config->log_types() & LogEntry::TYPE_DEBUG_ENCODE);
 		checked_set (_log_debug_email, config->log_types() & LogEntry::TYPE_DEBUG_EMAIL);
 		checked_set (_frames_in_memory_multiplier, config->frames_in_memory_multiplier());
+		checked_set (_write_behind_buffer, config->write_behind_buffer());
+		checked_set (_fsync_policy, static_cast<int>(config->fsync_policy()));
+		checked_set (_buffer_pool_size, config->buffer_pool_size());
 #ifdef DCPOMATIC_WINDOWS
 		checked_set (_win32_console, config->win32_console());
 #endif
@@ -1539,6 +1654,21 @@ private:
 		Config::instance()->set_frames_in_memory_multiplier (_frames_in_memory_multiplier->GetValue());
 	}
 
+	void write_behind_buffer_changed ()
+	{
+		Config::instance()->set_write_behind_buffer (_write_behind_buffer->GetValue());
+	}
+
+	void fsync_policy_changed ()
+	{
+		Config::instance()->set_fsync_policy (static_cast<Config::FsyncPolicy>(_fsync_policy->GetSelection()));
+	}
+
+	void buffer_pool_size_changed ()
+	{
+		Config::instance()->set_buffer_pool_size (_buffer_pool_size->GetValue());
+	}
+
 	void allow_any_dcp_frame_rate_changed ()
 	{
 		Config::instance()->set_allow_any_dcp_frame_rate (_allow_any_dcp_frame_rate->GetValue ());
@@ -1554,6 +1684,51 @@ private:
 		Config::instance()->set_only_servers_encode (_only_servers_encode->GetValue ());
 	}
 
+	void compress_server_transfers_changed ()
+	{
+		Config::instance()->set_compress_server_transfers (_compress_server_transfers->GetValue ());
+	}
+
+	void defer_video_decoding_changed ()
+	{
+		Config::instance()->set_defer_video_decoding (_defer_video_decoding->GetValue ());
+	}
+
+	void j2k_cache_changed ()
+	{
+		Config::instance()->set_j2k_cache (_j2k_cache->GetValue ());
+	}
+
+	void j2k_cache_size_changed ()
+	{
+		Config::instance()->set_j2k_cache_size (_j2k_cache_size->GetValue ());
+	}
+
+	void parallel_reels_changed ()
+	{
+		Config::instance()->set_parallel_reels (_parallel_reels->GetValue ());
+	}
+
+	void parallel_content_decoding_changed ()
+	{
+		Config::instance()->set_parallel_content_decoding (_parallel_content_decoding->GetValue ());
+	}
+
+	void distribute_reels_changed ()
+	{
+		Config::instance()->set_distribute_reels (_distribute_reels->GetValue ());
+	}
+
+	void video_decode_threads_changed ()
+	{
+		Config::instance()->set_video_decode_threads (_video_decode_threads->GetValue ());
+	}
+
+	void video_decode_thread_type_changed ()
+	{
+		Config::instance()->set_video_decode_thread_type (static_cast<Config::VideoDecodeThreadType>(_video_decode_thread_type->GetSelection()));
+	}
+
 	void dcp_metadata_filename_format_changed ()
 	{
 		Config::instance()->set_dcp_metadata_filename_format (_dcp_metadata_filename_format->get ());
@@ -1600,9 +1775,21 @@ private:
 
 	wxSpinCtrl* _maximum_j2k_bandwidth;
 	wxSpinCtrl* _frames_in_memory_multiplier;
+	wxSpinCtrl* _write_behind_buffer;
+	wxChoice* _fsync_policy;
+	wxSpinCtrl* _buffer_pool_size;
 	wxCheckBox* _allow_any_dcp_frame_rate;
 	wxCheckBox* _allow_any_container;
 	wxCheckBox* _only_servers_encode;
+	wxCheckBox* _compress_server_transfers;
+	wxCheckBox* _defer_video_decoding;
+	wxCheckBox* _j2k_cache;
+	wxSpinCtrl* _j2k_cache_size;
+	wxCheckBox* _parallel_reels;
+	wxCheckBox* _parallel_content_decoding;
+	wxCheckBox* _distribute_reels;
+	wxSpinCtrl* _video_decode_threads;
+	wxChoice* _video_decode_thread_type;
 	NameFormatEditor* _dcp_metadata_filename_format;
 	NameFormatEditor* _dcp_asset_filename_format;
 	wxCheckBox* _log_general;
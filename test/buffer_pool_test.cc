@@ -0,0 +1,96 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  test/buffer_pool_test.cc
+ *  @brief Test BufferPool class.
+ *  @ingroup selfcontained
+ */
+
+#include "lib/buffer_pool.h"
+#include "lib/config.h"
+#include "lib/image.h"
+#include "lib/audio_buffers.h"
+#include <boost/test/unit_test.hpp>
+
+using boost::shared_ptr;
+
+BOOST_AUTO_TEST_CASE (buffer_pool_size_class_test)
+{
+	BOOST_CHECK_EQUAL (BufferPool::size_class(0), 64U);
+	BOOST_CHECK_EQUAL (BufferPool::size_class(1), 64U);
+	BOOST_CHECK_EQUAL (BufferPool::size_class(64), 64U);
+	BOOST_CHECK_EQUAL (BufferPool::size_class(65), 80U);
+	BOOST_CHECK_EQUAL (BufferPool::size_class(1000), 1024U);
+	BOOST_CHECK_EQUAL (BufferPool::size_class(4097), 5120U);
+	BOOST_CHECK_EQUAL (BufferPool::size_class(8192), 8192U);
+	BOOST_CHECK_EQUAL (BufferPool::size_class(8193), 10240U);
+}
+
+/** Check that blocks are re-used and counted, and that the pool respects its size limit */
+BOOST_AUTO_TEST_CASE (buffer_pool_test)
+{
+	BufferPool* pool = BufferPool::instance ();
+	pool->clear ();
+
+	BufferPool::Counters const before = pool->counters ();
+	void* a = pool->get (1000);
+	pool->put (a, 1000);
+	BOOST_CHECK_EQUAL (pool->counters().resident, 1024U);
+	/* 1010 is in the same size class as 1000 */
+	void* b = pool->get (1010);
+	BOOST_CHECK (a == b);
+	BOOST_CHECK_EQUAL (pool->counters().hits, before.hits + 1);
+	BOOST_CHECK_EQUAL (pool->counters().misses, before.misses + 1);
+	BOOST_CHECK_EQUAL (pool->counters().resident, 0U);
+
+	int const size = Config::instance()->buffer_pool_size ();
+	Config::instance()->set_buffer_pool_size (0);
+	pool->put (b, 1010);
+	BOOST_CHECK_EQUAL (pool->counters().resident, 0U);
+	Config::instance()->set_buffer_pool_size (size);
+}
+
+/** Check that Image and AudioBuffers get their memory from the pool */
+BOOST_AUTO_TEST_CASE (buffer_pool_image_test)
+{
+	BufferPool* pool = BufferPool::instance ();
+	pool->clear ();
+
+	shared_ptr<Image> image (new Image (AV_PIX_FMT_RGB24, dcp::Size (1998, 1080), true));
+	uint8_t* data = image->data()[0];
+	image.reset ();
+	BOOST_CHECK (pool->counters().resident > 0);
+
+	BufferPool::Counters const before = pool->counters ();
+	image.reset (new Image (AV_PIX_FMT_RGB24, dcp::Size (1998, 1080), true));
+	BOOST_CHECK (image->data()[0] == data);
+	BOOST_CHECK_EQUAL (pool->counters().hits, before.hits + 1);
+
+	shared_ptr<AudioBuffers> audio (new AudioBuffers (6, 2000));
+	audio->make_silent ();
+	audio->ensure_size (3000);
+	for (int i = 0; i < 6; ++i) {
+		for (int j = 0; j < 4096; ++j) {
+			BOOST_REQUIRE_EQUAL (audio->data(i)[j], 0);
+		}
+	}
+	audio.reset ();
+	BOOST_CHECK (pool->counters().resident > before.resident);
+}
@@ -35,12 +35,15 @@
 #include "lib/raw_image_proxy.h"
 #include "lib/j2k_image_proxy.h"
 #include "lib/encode_server_description.h"
+#include "lib/encode_server_connection.h"
 #include "lib/file_log.h"
 #include "lib/dcpomatic_log.h"
+#include "lib/config.h"
 #include <boost/test/unit_test.hpp>
 #include <boost/thread.hpp>
 
 using std::list;
+using std::pair;
 using boost::shared_ptr;
 using boost::thread;
 using boost::optional;
@@ -324,3 +327,149 @@ BOOST_AUTO_TEST_CASE (client_server_test_j2k)
 	delete server_thread;
 	delete server;
 }
+
+/** Send several frames down one pipelined session and check that they all come back correctly */
+BOOST_AUTO_TEST_CASE (client_server_test_pipelined)
+{
+	shared_ptr<Image> image (new Image (AV_PIX_FMT_RGB24, dcp::Size (1998, 1080), true));
+	uint8_t* p = image->data()[0];
+
+	for (int y = 0; y < 1080; ++y) {
+		uint8_t* q = p;
+		for (int x = 0; x < 1998; ++x) {
+			*q++ = x % 256;
+			*q++ = y % 256;
+			*q++ = (x + y) % 256;
+		}
+		p += image->stride()[0];
+	}
+
+	dcpomatic_log.reset (new FileLog("build/test/client_server_test_pipelined.log"));
+
+	shared_ptr<PlayerVideo> pvf (
+		new PlayerVideo (
+			shared_ptr<ImageProxy> (new RawImageProxy (image)),
+			Crop (),
+			optional<double> (),
+			dcp::Size (1998, 1080),
+			dcp::Size (1998, 1080),
+			EYES_BOTH,
+			PART_WHOLE,
+			ColourConversion(),
+			weak_ptr<Content>(),
+			optional<Frame>()
+			)
+		);
+
+	list<shared_ptr<DCPVideo> > frames;
+	for (int i = 0; i < 8; ++i) {
+		frames.push_back (shared_ptr<DCPVideo> (new DCPVideo (pvf, i, 24, 200000000, RESOLUTION_2K)));
+	}
+
+	Data locally_encoded = frames.front()->encode_locally ();
+
+	EncodeServer* server = new EncodeServer (true, 2);
+
+	thread* server_thread = new thread (boost::bind (&EncodeServer::run, server));
+
+	/* Let the server get itself ready */
+	dcpomatic_sleep (1);
+
+	EncodeServerDescription description ("127.0.0.1", 2, SERVER_LINK_VERSION);
+	BOOST_REQUIRE (description.pipelined ());
+
+	{
+		EncodeServerConnection connection (description, 3, 1200);
+
+		int received = 0;
+		list<shared_ptr<DCPVideo> >::const_iterator i = frames.begin ();
+		while (received < 8) {
+			while (i != frames.end() && !connection.full()) {
+				connection.send (*i);
+				++i;
+			}
+
+			pair<shared_ptr<DCPVideo>, Data> r = connection.receive ();
+			BOOST_REQUIRE_EQUAL (locally_encoded.size(), r.second.size());
+			BOOST_CHECK_EQUAL (memcmp (locally_encoded.data().get(), r.second.data().get(), locally_encoded.size()), 0);
+			++received;
+		}
+
+		BOOST_CHECK (connection.idle ());
+	}
+
+	server->stop ();
+	server_thread->join ();
+	delete server_thread;
+	delete server;
+}
+
+/** Check that frames sent with compressed transport are encoded the same as local ones */
+BOOST_AUTO_TEST_CASE (client_server_test_compressed)
+{
+	shared_ptr<Image> image (new Image (AV_PIX_FMT_YUV420P10LE, dcp::Size (1998, 1080), true));
+
+	for (int i = 0; i < image->planes(); ++i) {
+		uint16_t* p = reinterpret_cast<uint16_t*> (image->data()[i]);
+		for (int j = 0; j < image->line_size()[i] / 2; ++j) {
+			*p++ = (j * 3) % 1024;
+		}
+	}
+
+	shared_ptr<Image> sub_image (new Image (AV_PIX_FMT_BGRA, dcp::Size (100, 200), true));
+	uint8_t* p = sub_image->data()[0];
+	for (int y = 0; y < 200; ++y) {
+		uint8_t* q = p;
+		for (int x = 0; x < 100; ++x) {
+			*q++ = y % 256;
+			*q++ = x % 256;
+			*q++ = (x + y) % 256;
+			*q++ = 1;
+		}
+		p += sub_image->stride()[0];
+	}
+
+	dcpomatic_log.reset (new FileLog("build/test/client_server_test_compressed.log"));
+
+	shared_ptr<PlayerVideo> pvf (
+		new PlayerVideo (
+			shared_ptr<ImageProxy> (new RawImageProxy (image)),
+			Crop (),
+			optional<double> (),
+			dcp::Size (1998, 1080),
+			dcp::Size (1998, 1080),
+			EYES_BOTH,
+			PART_WHOLE,
+			ColourConversion(),
+			weak_ptr<Content>(),
+			optional<Frame>()
+			)
+		);
+
+	pvf->set_text (PositionImage (sub_image, Position<int> (50, 60)));
+
+	shared_ptr<DCPVideo> frame (new DCPVideo (pvf, 0, 24, 200000000, RESOLUTION_2K));
+
+	Data locally_encoded = frame->encode_locally ();
+
+	Config::instance()->set_compress_server_transfers (true);
+
+	EncodeServer* server = new EncodeServer (true, 2);
+
+	thread* server_thread = new thread (boost::bind (&EncodeServer::run, server));
+
+	/* Let the server get itself ready */
+	dcpomatic_sleep (1);
+
+	EncodeServerDescription description ("127.0.0.1", 2, SERVER_LINK_VERSION);
+	BOOST_REQUIRE (description.compressed_transport ());
+
+	do_remote_encode (frame, description, locally_encoded);
+
+	server->stop ();
+	server_thread->join ();
+	delete server_thread;
+	delete server;
+
+	Config::instance()->set_compress_server_transfers (false);
+}
@@ -0,0 +1,165 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  test/direct_xyz_test.cc
+ *  @brief Test convert_directly_to_xyz() against the usual RGB48LE route.
+ *  @ingroup selfcontained
+ */
+
+#include "lib/direct_xyz.h"
+#include "lib/image.h"
+#include "lib/colour_conversion.h"
+#include <dcp/openjpeg_image.h>
+#include <dcp/rgb_xyz.h>
+#include <boost/test/unit_test.hpp>
+#include <boost/bind.hpp>
+#include <cstdlib>
+
+using std::abs;
+using std::max;
+using boost::shared_ptr;
+using boost::optional;
+
+static void
+ignore_note (dcp::NoteType, std::string)
+{
+
+}
+
+/** @return XYZ image made the usual way, by going through RGB48LE */
+static shared_ptr<dcp::OpenJPEGImage>
+via_rgb (shared_ptr<const Image> image, Crop crop, dcp::Size out_size, ColourConversion const & conversion, optional<double> fade)
+{
+	dcp::Size const inter_size = crop.apply (image->size ());
+	shared_ptr<Image> rgb = image->crop_scale_window (crop, inter_size, out_size, dcp::YUV_TO_RGB_REC709, AV_PIX_FMT_RGB48LE, true, false);
+	if (fade) {
+		rgb->fade (fade.get ());
+	}
+	return dcp::rgb_to_xyz (rgb->data()[0], rgb->size(), rgb->stride()[0], conversion, boost::bind (&ignore_note, _1, _2));
+}
+
+/** @return largest difference between any two corresponding values in two XYZ images of the same size */
+static int
+max_difference (shared_ptr<dcp::OpenJPEGImage> a, shared_ptr<dcp::OpenJPEGImage> b)
+{
+	BOOST_REQUIRE (a->size() == b->size());
+
+	int diff = 0;
+	for (int c = 0; c < 3; ++c) {
+		for (int i = 0; i < a->size().width * a->size().height; ++i) {
+			diff = max (diff, abs (a->data(c)[i] - b->data(c)[i]));
+		}
+	}
+	return diff;
+}
+
+/** RGB48LE should give exactly the same result as dcp::rgb_to_xyz, with or without a fade and borders */
+BOOST_AUTO_TEST_CASE (direct_xyz_rgb48_test)
+{
+	dcp::Size const size (256, 64);
+	shared_ptr<Image> image (new Image (AV_PIX_FMT_RGB48LE, size, true));
+	srand (1);
+	for (int y = 0; y < size.height; ++y) {
+		uint16_t* p = reinterpret_cast<uint16_t*> (image->data()[0] + y * image->stride()[0]);
+		for (int x = 0; x < size.width * 3; ++x) {
+			*p++ = rand() & 0xffff;
+		}
+	}
+
+	ColourConversion const conversion (dcp::ColourConversion::srgb_to_xyz ());
+	dcp::NoteHandler note = boost::bind (&ignore_note, _1, _2);
+
+	BOOST_CHECK_EQUAL (
+		max_difference (
+			convert_directly_to_xyz (image, Crop(), size, dcp::YUV_TO_RGB_REC709, conversion, optional<double>(), note),
+			via_rgb (image, Crop(), size, conversion, optional<double>())
+			),
+		0
+		);
+
+	BOOST_CHECK_EQUAL (
+		max_difference (
+			convert_directly_to_xyz (image, Crop(), size, dcp::YUV_TO_RGB_REC709, conversion, 0.37, note),
+			via_rgb (image, Crop(), size, conversion, 0.37)
+			),
+		0
+		);
+
+	Crop crop;
+	crop.left = 6;
+	crop.right = 10;
+	crop.top = 2;
+	crop.bottom = 4;
+	dcp::Size const out_size (300, 80);
+	BOOST_CHECK_EQUAL (
+		max_difference (
+			convert_directly_to_xyz (image, crop, out_size, dcp::YUV_TO_RGB_REC709, conversion, optional<double>(), note),
+			via_rgb (image, crop, out_size, conversion, optional<double>())
+			),
+		0
+		);
+}
+
+/** YUV should be close to the result that we get by way of swscale.  There are small differences
+ *  because swscale interpolates chroma and uses fixed-point arithmetic, so use smooth content and
+ *  allow up to 16 12-bit code values of difference.
+ */
+BOOST_AUTO_TEST_CASE (direct_xyz_yuv_test)
+{
+	AVPixelFormat const formats[] = { AV_PIX_FMT_YUV420P, AV_PIX_FMT_YUV422P, AV_PIX_FMT_YUV444P, AV_PIX_FMT_YUV422P10LE };
+	dcp::Size const size (256, 64);
+	ColourConversion const conversion (dcp::ColourConversion::rec709_to_xyz ());
+	dcp::NoteHandler note = boost::bind (&ignore_note, _1, _2);
+
+	for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); ++i) {
+		BOOST_REQUIRE (can_convert_directly_to_xyz (formats[i]));
+
+		shared_ptr<Image> image (new Image (formats[i], size, true));
+		bool const sixteen = image->bytes_per_pixel(0) > 1;
+		int const scale = sixteen ? 4 : 1;
+		for (int c = 0; c < 3; ++c) {
+			int const w = image->sample_size(c).width;
+			for (int y = 0; y < image->sample_size(c).height; ++y) {
+				uint8_t* p = image->data()[c] + y * image->stride()[c];
+				for (int x = 0; x < w; ++x) {
+					/* Gentle ramps in the legal range, avoiding black where the output transfer function is steepest */
+					int const v = c == 0 ? (32 + x * 180 / w) : (128 + (c == 1 ? 1 : -1) * (x * 40 / w - 20));
+					if (sixteen) {
+						reinterpret_cast<uint16_t*>(p)[x] = v * scale;
+					} else {
+						p[x] = v;
+					}
+				}
+			}
+		}
+
+		BOOST_CHECK_LE (
+			max_difference (
+				convert_directly_to_xyz (image, Crop(), size, dcp::YUV_TO_RGB_REC709, conversion, optional<double>(), note),
+				via_rgb (image, Crop(), size, conversion, optional<double>())
+				),
+			16
+			);
+	}
+
+	BOOST_CHECK (!can_convert_directly_to_xyz (AV_PIX_FMT_XYZ12LE));
+	BOOST_CHECK (!can_convert_directly_to_xyz (AV_PIX_FMT_NV12));
+	BOOST_CHECK (!can_convert_directly_to_xyz (AV_PIX_FMT_YUV420P10BE));
+}
@@ -0,0 +1,194 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  test/encode_scheduler_test.cc
+ *  @brief Test EncodeScheduler.
+ *  @ingroup specific
+ */
+
+#include "lib/encode_scheduler.h"
+#include "lib/dcp_video.h"
+#include "lib/player_video.h"
+#include "lib/raw_image_proxy.h"
+#include "lib/image.h"
+#include "lib/cross.h"
+#include <boost/test/unit_test.hpp>
+
+using std::list;
+using boost::shared_ptr;
+using boost::weak_ptr;
+using boost::optional;
+
+static shared_ptr<DCPVideo>
+frame (int index)
+{
+	shared_ptr<Image> image (new Image (AV_PIX_FMT_RGB24, dcp::Size (64, 64), true));
+	shared_ptr<PlayerVideo> pv (
+		new PlayerVideo (
+			shared_ptr<ImageProxy> (new RawImageProxy (image)),
+			Crop (),
+			optional<double> (),
+			dcp::Size (64, 64),
+			dcp::Size (64, 64),
+			EYES_BOTH,
+			PART_WHOLE,
+			optional<ColourConversion> (),
+			weak_ptr<Content> (),
+			optional<Frame> ()
+			)
+		);
+
+	return shared_ptr<DCPVideo> (new DCPVideo (pv, index, 24, 100000000, RESOLUTION_2K));
+}
+
+/** Check that frames are spread between workers, and that a worker with nothing
+ *  to do steals the lowest-indexed frame that is waiting.
+ */
+BOOST_AUTO_TEST_CASE (encode_scheduler_test_steal)
+{
+	EncodeScheduler scheduler;
+	int const a = scheduler.add_worker ("a");
+	int const b = scheduler.add_worker ("b");
+
+	/* Each worker starts off with a depth of 2, so we can queue 5 frames */
+	for (int i = 0; i < 5; ++i) {
+		BOOST_CHECK (!scheduler.full ());
+		scheduler.push (frame (i));
+	}
+	BOOST_CHECK (scheduler.full ());
+	BOOST_CHECK_EQUAL (scheduler.size(), 5U);
+
+	/* Frames go alternately to a and b */
+	BOOST_CHECK_EQUAL (scheduler.pop(a)->index(), 0);
+	BOOST_CHECK_EQUAL (scheduler.pop(b)->index(), 1);
+	BOOST_CHECK_EQUAL (scheduler.pop(a)->index(), 2);
+	BOOST_CHECK_EQUAL (scheduler.pop(a)->index(), 4);
+
+	/* a has nothing left, so it takes b's */
+	BOOST_CHECK_EQUAL (scheduler.pop(a)->index(), 3);
+	BOOST_CHECK (!scheduler.pop(a));
+	BOOST_CHECK (!scheduler.pop(b));
+	BOOST_CHECK (scheduler.empty ());
+
+	BOOST_CHECK_EQUAL (scheduler.status()[0].stolen, 1);
+	BOOST_CHECK_EQUAL (scheduler.status()[1].stolen, 0);
+}
+
+/** Check that frames returned after failure, or left by a worker which is backing off,
+ *  are taken first and in index order.
+ */
+BOOST_AUTO_TEST_CASE (encode_scheduler_test_backoff)
+{
+	EncodeScheduler scheduler;
+	int const a = scheduler.add_worker ("a");
+	int const b = scheduler.add_worker ("b");
+
+	for (int i = 0; i < 4; ++i) {
+		scheduler.push (frame (i));
+	}
+
+	shared_ptr<DCPVideo> f = scheduler.pop (b);
+	BOOST_CHECK_EQUAL (f->index(), 1);
+
+	/* b fails, gives back its frame and backs off */
+	scheduler.set_backoff (b, true);
+	scheduler.push_back (b, f);
+
+	/* b now gets nothing new */
+	scheduler.push (frame (4));
+	scheduler.push (frame (5));
+
+	list<int> order;
+	while (shared_ptr<DCPVideo> g = scheduler.pop (a)) {
+		order.push_back (g->index ());
+	}
+
+	int const expected[] = { 0, 1, 2, 3, 4, 5 };
+	BOOST_CHECK_EQUAL_COLLECTIONS (order.begin(), order.end(), expected, expected + 6);
+
+	/* b's depth is 0 while it is backing off, so a (depth 2) limits the queue to 3 frames */
+	for (int i = 6; i < 9; ++i) {
+		BOOST_CHECK (!scheduler.full ());
+		scheduler.push (frame (i));
+	}
+	BOOST_CHECK (scheduler.full ());
+
+	scheduler.remove_worker (a);
+	BOOST_CHECK_EQUAL (scheduler.take_all().size(), 3U);
+}
+
+/** Check that a retired worker gives up its queue and is given no more frames */
+BOOST_AUTO_TEST_CASE (encode_scheduler_test_retire)
+{
+	EncodeScheduler scheduler;
+	int const a = scheduler.add_worker ("a");
+	int const b = scheduler.add_worker ("b");
+
+	for (int i = 0; i < 4; ++i) {
+		scheduler.push (frame (i));
+	}
+
+	scheduler.retire (b);
+	/* Success after a failure does not bring a retired worker back */
+	scheduler.set_backoff (b, false);
+	scheduler.push (frame (4));
+
+	BOOST_CHECK_EQUAL (scheduler.status()[1].queued, 0);
+	BOOST_CHECK_EQUAL (scheduler.status()[1].depth, 0);
+	BOOST_CHECK_EQUAL (scheduler.status()[0].queued, 3);
+
+	for (int i = 0; i < 5; ++i) {
+		BOOST_CHECK_EQUAL (scheduler.pop(a)->index(), i);
+	}
+}
+
+/** Check that an idle worker is given a copy of a frame which is overdue elsewhere,
+ *  and that only the first copy to be finished is used.
+ */
+BOOST_AUTO_TEST_CASE (encode_scheduler_test_speculate)
+{
+	EncodeScheduler scheduler;
+	int const a = scheduler.add_worker ("a");
+	int const b = scheduler.add_worker ("b");
+
+	/* Give b a history of finishing frames very quickly */
+	for (int i = 0; i < 4; ++i) {
+		shared_ptr<DCPVideo> f = frame (i);
+		scheduler.push (f);
+		BOOST_REQUIRE (scheduler.pop (b) == f);
+		BOOST_CHECK (scheduler.finish (b, f));
+	}
+
+	shared_ptr<DCPVideo> slow = frame (4);
+	scheduler.push (slow);
+	BOOST_REQUIRE (scheduler.pop (b) == slow);
+
+	/* Not overdue yet */
+	BOOST_CHECK (!scheduler.pop (a));
+
+	dcpomatic_sleep (3);
+
+	BOOST_CHECK (scheduler.pop (a) == slow);
+	BOOST_CHECK_EQUAL (scheduler.in_progress(), 1U);
+	BOOST_CHECK (scheduler.finish (a, slow));
+	BOOST_CHECK (!scheduler.finish (b, slow));
+	BOOST_CHECK_EQUAL (scheduler.in_progress(), 0U);
+	BOOST_CHECK_EQUAL (scheduler.status()[0].speculated, 1);
+}
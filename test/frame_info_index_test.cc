@@ -0,0 +1,152 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  test/frame_info_index_test.cc
+ *  @brief Test FrameInfoIndex class.
+ *  @ingroup selfcontained
+ */
+
+#include "lib/frame_info_index.h"
+#include "lib/cross.h"
+#include <boost/test/unit_test.hpp>
+
+using boost::optional;
+
+static void
+check (FrameInfoIndex const & index, Frame frame, Eyes eyes, dcp::FrameInfo const & ref)
+{
+	optional<dcp::FrameInfo> info = index.get (frame, eyes);
+	BOOST_REQUIRE (info);
+	BOOST_CHECK_EQUAL (info->offset, ref.offset);
+	BOOST_CHECK_EQUAL (info->size, ref.size);
+	BOOST_CHECK_EQUAL (info->hash, ref.hash);
+}
+
+/** Write some info, and check that it is still there when the index is opened again */
+BOOST_AUTO_TEST_CASE (frame_info_index_test1)
+{
+	boost::filesystem::path const file = "build/test/frame_info_index_test1.info";
+	boost::filesystem::remove (file);
+
+	dcp::FrameInfo const a (0, 1234, "0123456789abcdef0123456789abcdef");
+	dcp::FrameInfo const b (1234, 99999, "ffffffffffffffff0000000000000000");
+
+	{
+		FrameInfoIndex index (file);
+		BOOST_CHECK_EQUAL (index.size(), 0);
+		BOOST_CHECK (!index.get (0, EYES_LEFT));
+		index.set (0, EYES_LEFT, a);
+		index.set (4, EYES_RIGHT, b);
+		BOOST_CHECK_EQUAL (index.size(), 10);
+		check (index, 0, EYES_LEFT, a);
+		check (index, 4, EYES_RIGHT, b);
+	}
+
+	/* 16-byte header and 28 bytes per record */
+	BOOST_CHECK_EQUAL (boost::filesystem::file_size (file), 16U + 10 * 28);
+
+	FrameInfoIndex index (file);
+	BOOST_CHECK_EQUAL (index.size(), 10);
+	check (index, 0, EYES_LEFT, a);
+	check (index, 4, EYES_RIGHT, b);
+}
+
+/** Check that a file written by an earlier version, with no header and
+ *  48-byte records, is read and converted.
+ */
+BOOST_AUTO_TEST_CASE (frame_info_index_test2)
+{
+	boost::filesystem::path const file = "build/test/frame_info_index_test2.info";
+	boost::filesystem::remove (file);
+
+	dcp::FrameInfo const a (0, 4096, "00112233445566778899aabbccddeeff");
+	dcp::FrameInfo const b (4096, 8192, "ffeeddccbbaa99887766554433221100");
+
+	FILE* f = fopen_boost (file, "wb");
+	BOOST_REQUIRE (f);
+	dcp::FrameInfo const infos[2] = { a, b };
+	for (int i = 0; i < 2; ++i) {
+		uint64_t const offset = infos[i].offset;
+		int64_t const size = infos[i].size;
+		fwrite (&offset, sizeof(offset), 1, f);
+		fwrite (&size, sizeof(size), 1, f);
+		fwrite (infos[i].hash.c_str(), 32, 1, f);
+	}
+	fclose (f);
+
+	{
+		FrameInfoIndex index (file);
+		BOOST_CHECK_EQUAL (index.size(), 2);
+		check (index, 0, EYES_BOTH, a);
+		check (index, 1, EYES_BOTH, b);
+	}
+
+	/* It should have been re-written in the new format */
+	BOOST_CHECK_EQUAL (boost::filesystem::file_size (file), 16U + 2 * 28);
+
+	FrameInfoIndex index (file);
+	check (index, 0, EYES_BOTH, a);
+	check (index, 1, EYES_BOTH, b);
+}
+
+/** Check that a file from an unknown version is left alone until something is written
+ *  to the index, and then kept alongside the new one.
+ */
+BOOST_AUTO_TEST_CASE (frame_info_index_test3)
+{
+	boost::filesystem::path const file = "build/test/frame_info_index_test3.info";
+	boost::filesystem::path const aside = "build/test/frame_info_index_test3.info.v99";
+	boost::filesystem::remove (file);
+	boost::filesystem::remove (aside);
+
+	FILE* f = fopen_boost (file, "wb");
+	BOOST_REQUIRE (f);
+	char const magic[8] = { 'D', 'O', 'M', 'I', 'N', 'F', 'O', '\0' };
+	uint32_t const version = 99;
+	uint32_t const size = 40;
+	fwrite (magic, sizeof(magic), 1, f);
+	fwrite (&version, sizeof(version), 1, f);
+	fwrite (&size, sizeof(size), 1, f);
+	uint8_t record[40];
+	memset (record, 42, sizeof(record));
+	fwrite (record, sizeof(record), 1, f);
+	fclose (f);
+
+	{
+		FrameInfoIndex index (file);
+		BOOST_CHECK_EQUAL (index.size(), 0);
+	}
+
+	BOOST_CHECK_EQUAL (boost::filesystem::file_size (file), 16U + 40);
+	BOOST_CHECK (!boost::filesystem::exists (aside));
+
+	dcp::FrameInfo const a (0, 4096, "00112233445566778899aabbccddeeff");
+
+	{
+		FrameInfoIndex index (file);
+		index.set (0, EYES_BOTH, a);
+	}
+
+	BOOST_CHECK_EQUAL (boost::filesystem::file_size (aside), 16U + 40);
+	BOOST_CHECK_EQUAL (boost::filesystem::file_size (file), 16U + 28);
+
+	FrameInfoIndex index (file);
+	check (index, 0, EYES_BOTH, a);
+}
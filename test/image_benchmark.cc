@@ -0,0 +1,166 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  test/image_benchmark.cc
+ *  @brief Time some Image operations.
+ *
+ *  These only print timings, so they are not built into the unit tests by default;
+ *  add this file to the list in test/wscript to run them.
+ */
+
+#include "lib/image.h"
+#include "lib/sws_context_cache.h"
+#include "lib/image_kernels.h"
+#include "lib/util.h"
+#include <boost/test/unit_test.hpp>
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <sys/time.h>
+#include <iostream>
+
+using std::cout;
+using std::vector;
+using boost::shared_ptr;
+
+/** @return Average time in milliseconds that run takes over a few calls */
+static double
+time_per_frame (boost::function<void ()> run)
+{
+	int const frames = 8;
+	struct timeval start;
+	gettimeofday (&start, 0);
+	for (int i = 0; i < frames; ++i) {
+		run ();
+	}
+	struct timeval end;
+	gettimeofday (&end, 0);
+	return (seconds(end) - seconds(start)) * 1000 / frames;
+}
+
+static void
+crop_scale_window_frame (shared_ptr<const Image> in, dcp::Size inter_size, dcp::Size out_size, bool cached)
+{
+	if (!cached) {
+		/* Make crop_scale_window set up its scale context from scratch, as it used to */
+		SwsContextCache::instance()->clear ();
+	}
+	in->crop_scale_window (Crop(), inter_size, out_size, dcp::YUV_TO_RGB_REC709, AV_PIX_FMT_RGB48LE, false, false);
+}
+
+/** Compare the time taken by crop_scale_window with and without cached scale contexts, for
+ *  flat and scope HD sources in 2K and 4K flat containers.
+ */
+BOOST_AUTO_TEST_CASE (crop_scale_window_benchmark)
+{
+	shared_ptr<Image> in (new Image(AV_PIX_FMT_YUV420P, dcp::Size(1920, 1080), true));
+	in->make_black ();
+
+	dcp::Size const outs[] = { dcp::Size(1998, 1080), dcp::Size(3996, 2160) };
+	for (int i = 0; i < 2; ++i) {
+		dcp::Size const inters[] = { outs[i], dcp::Size(outs[i].width, outs[i].width * 100 / 239) };
+		for (int j = 0; j < 2; ++j) {
+			double const uncached = time_per_frame (boost::bind (&crop_scale_window_frame, in, inters[j], outs[i], false));
+			double const cached = time_per_frame (boost::bind (&crop_scale_window_frame, in, inters[j], outs[i], true));
+			cout << "crop_scale_window " << inters[j].width << "x" << inters[j].height << " in " << outs[i].width << "x" << outs[i].height
+			     << ": " << uncached << "ms per frame uncached, " << cached << "ms cached\n";
+		}
+	}
+}
+
+static void
+alpha_blend_frame (
+	ImageKernels const * kernels, void (* ImageKernels::* kernel) (uint8_t *, uint8_t const *, int, bool),
+	shared_ptr<Image> image, shared_ptr<const Image> overlay
+	)
+{
+	for (int y = 0; y < image->size().height; ++y) {
+		(kernels->*kernel) (image->data()[0] + y * image->stride()[0], overlay->data()[0] + y * overlay->stride()[0], image->size().width, false);
+	}
+}
+
+static void
+fade_frame (ImageKernels const * kernels, shared_ptr<Image> image, bool sixteen)
+{
+	for (int c = 0; c < image->planes(); ++c) {
+		for (int y = 0; y < image->sample_size(c).height; ++y) {
+			uint8_t* p = image->data()[c] + y * image->stride()[c];
+			if (sixteen) {
+				kernels->fade_16 (reinterpret_cast<uint16_t*> (p), image->line_size()[c] / 2, 0.5, 0);
+			} else {
+				kernels->fade_8 (p, image->line_size()[c], 0.5, 0);
+			}
+		}
+	}
+}
+
+/** Time the alpha blends and fades of a 2K frame in each pixel format with each set of ImageKernels */
+BOOST_AUTO_TEST_CASE (image_kernels_benchmark)
+{
+	dcp::Size const size (1998, 1080);
+	shared_ptr<Image> overlay (new Image (AV_PIX_FMT_BGRA, size, true));
+	for (int y = 0; y < size.height; ++y) {
+		uint8_t* p = overlay->data()[0] + y * overlay->stride()[0];
+		for (int x = 0; x < size.width * 4; ++x) {
+			p[x] = (x * 7 + y) & 0xff;
+		}
+	}
+
+	struct Blend {
+		AVPixelFormat format;
+		char const * name;
+		void (* ImageKernels::* kernel) (uint8_t *, uint8_t const *, int, bool);
+	};
+
+	Blend const blends[] = {
+		{ AV_PIX_FMT_RGB24, "RGB24", &ImageKernels::alpha_blend_24 },
+		{ AV_PIX_FMT_BGRA, "BGRA", &ImageKernels::alpha_blend_32 },
+		{ AV_PIX_FMT_RGB48LE, "RGB48LE", &ImageKernels::alpha_blend_48 }
+	};
+
+	struct Fade {
+		AVPixelFormat format;
+		char const * name;
+		bool sixteen;
+	};
+
+	Fade const fades[] = {
+		{ AV_PIX_FMT_YUV420P, "YUV420P", false },
+		{ AV_PIX_FMT_RGB24, "RGB24", false },
+		{ AV_PIX_FMT_RGB48LE, "RGB48LE", true },
+		{ AV_PIX_FMT_YUV422P10LE, "YUV422P10LE", true }
+	};
+
+	vector<ImageKernels const *> all = ImageKernels::all ();
+	for (size_t i = 0; i < all.size(); ++i) {
+		for (size_t j = 0; j < sizeof(blends) / sizeof(Blend); ++j) {
+			shared_ptr<Image> image (new Image (blends[j].format, size, true));
+			image->make_black ();
+			double const t = time_per_frame (boost::bind (&alpha_blend_frame, all[i], blends[j].kernel, image, overlay));
+			cout << all[i]->name << " alpha_blend onto " << blends[j].name << ": " << t << "ms per frame\n";
+		}
+
+		for (size_t j = 0; j < sizeof(fades) / sizeof(Fade); ++j) {
+			shared_ptr<Image> image (new Image (fades[j].format, size, true));
+			image->make_black ();
+			double const t = time_per_frame (boost::bind (&fade_frame, all[i], image, fades[j].sixteen));
+			cout << all[i]->name << " fade of " << fades[j].name << ": " << t << "ms per frame\n";
+		}
+	}
+}
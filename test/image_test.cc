@@ -26,13 +26,19 @@
 
 #include "lib/image.h"
 #include "lib/ffmpeg_image_proxy.h"
+#include "lib/sws_context_cache.h"
+#include "lib/image_kernels.h"
 #include "test.h"
+extern "C" {
+#include <libavutil/frame.h>
+}
 #include <boost/test/unit_test.hpp>
 #include <iostream>
 
 using std::string;
 using std::list;
 using std::cout;
+using std::vector;
 using boost::shared_ptr;
 
 BOOST_AUTO_TEST_CASE (aligned_image_test)
@@ -134,6 +140,69 @@ BOOST_AUTO_TEST_CASE (compact_image_test)
 	delete u;
 }
 
+static AVFrame*
+rgb24_frame (dcp::Size size, int stride, int buffer_size)
+{
+	AVFrame* frame = av_frame_alloc ();
+	BOOST_REQUIRE (frame);
+	frame->format = AV_PIX_FMT_RGB24;
+	frame->width = size.width;
+	frame->height = size.height;
+	frame->buf[0] = av_buffer_alloc (buffer_size);
+	BOOST_REQUIRE (frame->buf[0]);
+	frame->data[0] = frame->buf[0]->data;
+	frame->linesize[0] = stride;
+
+	for (int y = 0; y < size.height; ++y) {
+		for (int x = 0; x < size.width * 3; ++x) {
+			frame->data[0][y * stride + x] = (x + y) & 0xff;
+		}
+	}
+
+	return frame;
+}
+
+/** Check that Image uses an AVFrame's data without copying when it can, and that
+ *  it does not write to that data while the frame is still in use elsewhere.
+ */
+BOOST_AUTO_TEST_CASE (image_from_frame_test)
+{
+	/* A frame with enough padding to be used directly */
+	AVFrame* frame = rgb24_frame (dcp::Size(50, 50), 160, 160 * 51 + 32);
+	shared_ptr<Image> image (new Image (frame));
+	BOOST_CHECK (image->data()[0] == frame->data[0]);
+	BOOST_CHECK_EQUAL (image->stride()[0], 160);
+	BOOST_CHECK_EQUAL (image->line_size()[0], 150);
+	BOOST_CHECK (image->aligned());
+
+	/* Writing to the image must take a copy since `frame' still refers to the data */
+	image->make_black ();
+	BOOST_CHECK (image->data()[0] != frame->data[0]);
+	BOOST_CHECK_EQUAL (frame->data[0][161], 2);
+	BOOST_CHECK_EQUAL (image->data()[0][image->stride()[0] + 1], 0);
+
+	/* Once we are the only user we can write to the frame's data directly */
+	shared_ptr<Image> image2 (new Image (frame));
+	av_frame_free (&frame);
+	uint8_t* before = image2->data()[0];
+	image2->make_black ();
+	BOOST_CHECK (image2->data()[0] == before);
+
+	/* A frame without enough padding must be copied */
+	frame = rgb24_frame (dcp::Size(50, 50), 160, 160 * 50);
+	shared_ptr<Image> image3 (new Image (frame));
+	BOOST_CHECK (image3->data()[0] != frame->data[0]);
+	BOOST_CHECK_EQUAL (image3->data()[0][image3->stride()[0] + 1], 2);
+	av_frame_free (&frame);
+
+	/* So must a frame whose stride is not a multiple of 32 */
+	frame = rgb24_frame (dcp::Size(50, 50), 150, 150 * 51 + 32);
+	shared_ptr<Image> image4 (new Image (frame));
+	BOOST_CHECK (image4->data()[0] != frame->data[0]);
+	BOOST_CHECK_EQUAL (image4->stride()[0], 160);
+	av_frame_free (&frame);
+}
+
 void
 alpha_blend_test_one (AVPixelFormat format, string suffix)
 {
@@ -307,6 +376,81 @@ BOOST_AUTO_TEST_CASE (crop_scale_window_test6)
 	write_image(cropped, "build/test/crop_scale_window_test6.png", "RGB", MagickCore::ShortPixel);
 }
 
+/** Check that crop_scale_window blackens the borders around the scaled image even when the
+ *  output image's memory has been used before.
+ */
+BOOST_AUTO_TEST_CASE (crop_scale_window_border_test)
+{
+	shared_ptr<Image> white (new Image(AV_PIX_FMT_RGB24, dcp::Size(100, 50), true));
+	for (int y = 0; y < 50; ++y) {
+		memset (white->data()[0] + y * white->stride()[0], 255, white->line_size()[0]);
+	}
+
+	AVPixelFormat const formats[] = { AV_PIX_FMT_RGB24, AV_PIX_FMT_YUV420P };
+	for (int i = 0; i < 2; ++i) {
+		/* Give some dirty memory back to the pool so that the output may get it */
+		shared_ptr<Image> dirty (new Image(formats[i], dcp::Size(200, 100), true));
+		for (int c = 0; c < dirty->planes(); ++c) {
+			memset (dirty->data()[c], 0xaa, dirty->stride()[c] * dirty->sample_size(c).height);
+		}
+		dirty.reset ();
+
+		shared_ptr<Image> out = white->crop_scale_window (
+			Crop(), dcp::Size(100, 50), dcp::Size(200, 100), dcp::YUV_TO_RGB_REC709, formats[i], true, false
+			);
+
+		for (int c = 0; c < out->planes(); ++c) {
+			/* Black for RGB and Y is 0, and for U and V is 127 */
+			int const black = c == 0 ? 0 : 127;
+			/* The edges of sub-sampled components may be a little outside the rectangle */
+			int const margin = c == 0 ? 0 : 4;
+			int const bytes_per_sample = out->line_size()[c] / out->sample_size(c).width;
+			for (int y = 0; y < out->sample_size(c).height; ++y) {
+				uint8_t const * p = out->data()[c] + y * out->stride()[c];
+				for (int x = 0; x < out->line_size()[c]; ++x) {
+					/* Position of this byte in the full-size image */
+					int const pixel_x = (x / bytes_per_sample) * out->horizontal_factor(c);
+					int const pixel_y = y * out->vertical_factor(c);
+					if (pixel_x < (50 - margin) || pixel_x >= (150 + margin) || pixel_y < (25 - margin) || pixel_y >= (75 + margin)) {
+						BOOST_REQUIRE_EQUAL (p[x], black);
+					} else if (c == 0 && pixel_x >= 50 && pixel_x < 150 && pixel_y >= 25 && pixel_y < 75) {
+						BOOST_REQUIRE (p[x] > 200);
+					}
+				}
+			}
+		}
+	}
+}
+
+/** Check that crop_scale_window gives the same result whether or not its scale context comes
+ *  from the cache, for flat and scope images in 2K and 4K flat containers.
+ *  @see test/image_benchmark.cc for the time that the cache saves.
+ */
+BOOST_AUTO_TEST_CASE (crop_scale_window_cache_test)
+{
+	shared_ptr<Image> in (new Image(AV_PIX_FMT_YUV420P, dcp::Size(1920, 1080), true));
+	for (int c = 0; c < in->planes(); ++c) {
+		for (int y = 0; y < in->sample_size(c).height; ++y) {
+			uint8_t* p = in->data()[c] + y * in->stride()[c];
+			for (int x = 0; x < in->line_size()[c]; ++x) {
+				p[x] = (x * 3 + y + c * 50) & 0xff;
+			}
+		}
+	}
+
+	dcp::Size const outs[] = { dcp::Size(1998, 1080), dcp::Size(3996, 2160) };
+	for (int i = 0; i < 2; ++i) {
+		/* Flat fills the container; scope is 2.39:1 across its full width */
+		dcp::Size const inters[] = { outs[i], dcp::Size(outs[i].width, outs[i].width * 100 / 239) };
+		for (int j = 0; j < 2; ++j) {
+			SwsContextCache::instance()->clear ();
+			shared_ptr<Image> uncached = in->crop_scale_window (Crop(), inters[j], outs[i], dcp::YUV_TO_RGB_REC709, AV_PIX_FMT_RGB48LE, false, false);
+			shared_ptr<Image> cached = in->crop_scale_window (Crop(), inters[j], outs[i], dcp::YUV_TO_RGB_REC709, AV_PIX_FMT_RGB48LE, false, false);
+			BOOST_CHECK (*uncached == *cached);
+		}
+	}
+}
+
 BOOST_AUTO_TEST_CASE (as_png_test)
 {
 	shared_ptr<FFmpegImageProxy> proxy(new FFmpegImageProxy("test/data/3d_test/000001.png"));
@@ -367,3 +511,135 @@ BOOST_AUTO_TEST_CASE (fade_test)
 	fade_test_format_red   (AV_PIX_FMT_RGB48LE,   0.5, "rgb48le_50");
 	fade_test_format_red   (AV_PIX_FMT_RGB48LE,   1,   "rgb48le_100");
 }
+
+/** Check that every set of ImageKernels that this CPU can run gives the same fades as the plain
+ *  versions, for every sample value, with some lengths that leave odd samples at the end.
+ */
+BOOST_AUTO_TEST_CASE (image_kernels_fade_test)
+{
+	vector<ImageKernels const *> all = ImageKernels::all ();
+	ImageKernels const * plain = all.front ();
+	float const fades[] = { 0, 0.001, 0.25, 1.0 / 3, 0.5, 0.77, 0.999, 1 };
+	int const centres_8[] = { 0, 127, 128 };
+	int const centres_16[] = { 0, 511, 32767 };
+
+	for (size_t i = 1; i < all.size(); ++i) {
+		for (size_t j = 0; j < sizeof(fades) / sizeof(float); ++j) {
+			for (int k = 0; k < 3; ++k) {
+				for (int n = 256; n < 256 + 33; ++n) {
+					vector<uint8_t> a (n);
+					for (int x = 0; x < n; ++x) {
+						a[x] = x & 0xff;
+					}
+					vector<uint8_t> b = a;
+					plain->fade_8 (&a[0], n, fades[j], centres_8[k]);
+					all[i]->fade_8 (&b[0], n, fades[j], centres_8[k]);
+					BOOST_REQUIRE_MESSAGE (a == b, all[i]->name << " fade_8 differs");
+				}
+
+				for (int n = 65536; n < 65536 + 17; ++n) {
+					vector<uint16_t> a (n);
+					for (int x = 0; x < n; ++x) {
+						a[x] = x & 0xffff;
+					}
+					vector<uint16_t> b = a;
+					plain->fade_16 (&a[0], n, fades[j], centres_16[k]);
+					all[i]->fade_16 (&b[0], n, fades[j], centres_16[k]);
+					BOOST_REQUIRE_MESSAGE (a == b, all[i]->name << " fade_16 differs");
+				}
+			}
+		}
+
+		for (int n = 0; n < 33; ++n) {
+			vector<uint16_t> a (n + 1, 42);
+			vector<uint16_t> b = a;
+			plain->fill_16 (&a[0], n, 0x1234);
+			all[i]->fill_16 (&b[0], n, 0x1234);
+			BOOST_REQUIRE_MESSAGE (a == b, all[i]->name << " fill_16 differs");
+		}
+	}
+}
+
+/** Check that every set of ImageKernels that this CPU can run gives the same alpha blends as the
+ *  plain versions, for every combination of alpha, overlay value and background value.
+ */
+BOOST_AUTO_TEST_CASE (image_kernels_alpha_blend_test)
+{
+	vector<ImageKernels const *> all = ImageKernels::all ();
+	ImageKernels const * plain = all.front ();
+
+	/* Every pair of 8-bit values, and some odd pixels at the end */
+	int const n = 65536 + 5;
+
+	for (size_t i = 1; i < all.size(); ++i) {
+		for (int swap = 0; swap < 2; ++swap) {
+			for (int alpha = 0; alpha < 256; ++alpha) {
+				vector<uint8_t> other (n * 4);
+				for (int x = 0; x < n; ++x) {
+					other[x * 4] = x & 0xff;
+					other[x * 4 + 1] = (x >> 8) & 0xff;
+					other[x * 4 + 2] = (x * 13) & 0xff;
+					other[x * 4 + 3] = alpha;
+				}
+
+				vector<uint8_t> a (n * 4);
+				for (int x = 0; x < n; ++x) {
+					a[x * 4] = (x >> 8) & 0xff;
+					a[x * 4 + 1] = x & 0xff;
+					a[x * 4 + 2] = (x * 7) & 0xff;
+					a[x * 4 + 3] = (x * 3) & 0xff;
+				}
+				vector<uint8_t> b = a;
+				plain->alpha_blend_32 (&a[0], &other[0], n, swap);
+				all[i]->alpha_blend_32 (&b[0], &other[0], n, swap);
+				BOOST_REQUIRE_MESSAGE (a == b, all[i]->name << " alpha_blend_32 differs with alpha " << alpha);
+
+				a.resize (n * 3);
+				for (int x = 0; x < n; ++x) {
+					a[x * 3] = (x >> 8) & 0xff;
+					a[x * 3 + 1] = x & 0xff;
+					a[x * 3 + 2] = (x * 7) & 0xff;
+				}
+				b = a;
+				plain->alpha_blend_24 (&a[0], &other[0], n, swap);
+				all[i]->alpha_blend_24 (&b[0], &other[0], n, swap);
+				BOOST_REQUIRE_MESSAGE (a == b, all[i]->name << " alpha_blend_24 differs with alpha " << alpha);
+
+				a.resize (n * 6);
+				for (int x = 0; x < n; ++x) {
+					a[x * 6] = x & 0xff;
+					a[x * 6 + 1] = (x >> 8) & 0xff;
+					a[x * 6 + 2] = (x * 5) & 0xff;
+					a[x * 6 + 3] = x & 0xff;
+					a[x * 6 + 4] = (x * 11) & 0xff;
+					a[x * 6 + 5] = (x * 7) & 0xff;
+				}
+				b = a;
+				plain->alpha_blend_48 (&a[0], &other[0], n, swap);
+				all[i]->alpha_blend_48 (&b[0], &other[0], n, swap);
+				BOOST_REQUIRE_MESSAGE (a == b, all[i]->name << " alpha_blend_48 differs with alpha " << alpha);
+			}
+		}
+	}
+}
+
+/** Check that alpha_blend uses the right part of the overlay when it is off the left of the image */
+BOOST_AUTO_TEST_CASE (alpha_blend_negative_position_test)
+{
+	shared_ptr<Image> overlay (new Image (AV_PIX_FMT_BGRA, dcp::Size(4, 1), true));
+	for (int x = 0; x < 4; ++x) {
+		uint8_t* p = overlay->data()[0] + x * 4;
+		p[0] = 0;
+		p[1] = 0;
+		p[2] = x * 50;
+		p[3] = 255;
+	}
+
+	shared_ptr<Image> image (new Image (AV_PIX_FMT_RGB24, dcp::Size(4, 1), true));
+	image->make_black ();
+	image->alpha_blend (overlay, Position<int> (-2, 0));
+
+	BOOST_CHECK_EQUAL (image->data()[0][0], 100);
+	BOOST_CHECK_EQUAL (image->data()[0][3], 150);
+	BOOST_CHECK_EQUAL (image->data()[0][6], 0);
+}
@@ -0,0 +1,103 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  test/incremental_encode_test.cc
+ *  @brief Check re-use of frames from an earlier encode after part of a film is changed.
+ *  @ingroup specific
+ */
+
+#include "test.h"
+#include "lib/film.h"
+#include "lib/playlist.h"
+#include "lib/dcp_content_type.h"
+#include "lib/image_content.h"
+#include "lib/video_content.h"
+#include "lib/ratio.h"
+#include "lib/transcode_job.h"
+#include "lib/dcp_encoder.h"
+#include <boost/test/unit_test.hpp>
+
+using std::list;
+using std::pair;
+using std::string;
+using boost::shared_ptr;
+using boost::optional;
+
+static shared_ptr<ImageContent>
+add (shared_ptr<Film> film, string image)
+{
+	shared_ptr<ImageContent> c (new ImageContent("test/data/" + image));
+	film->examine_and_add_content (c);
+	BOOST_REQUIRE (!wait_for_jobs());
+	c->video->set_length (24);
+	return c;
+}
+
+/** Check that changing the middle one of three pieces of content leaves the picture of the
+ *  other two available for re-use.
+ */
+BOOST_AUTO_TEST_CASE (incremental_encode_test1)
+{
+	shared_ptr<Film> film = new_test_film2 ("incremental_encode_test1");
+	film->set_dcp_content_type (DCPContentType::from_isdcf_name ("TST"));
+	add (film, "flat_red.png");
+	shared_ptr<ImageContent> green = add (film, "flat_green.png");
+	add (film, "flat_blue.png");
+	film->set_reel_type (REELTYPE_SINGLE);
+
+	DCPTimePeriod const reel = film->reels().front();
+	DCPTime const second = DCPTime::from_seconds (1);
+
+	typedef pair<DCPTimePeriod, string> Segment;
+	list<Segment> segments = film->playlist()->video_segments (film, reel);
+	BOOST_REQUIRE_EQUAL (segments.size(), 3U);
+	BOOST_CHECK (segments.front().first == DCPTimePeriod (DCPTime(), second));
+	BOOST_CHECK (segments.back().first == DCPTimePeriod (DCPTime::from_seconds(2), DCPTime::from_seconds(3)));
+
+	film->make_dcp ();
+	BOOST_REQUIRE (!wait_for_jobs());
+
+	/* Nothing has changed, and the only asset is the one that we would write again */
+	BOOST_CHECK (!film->previous_video_asset (reel));
+
+	green->video->set_left_crop (8);
+
+	list<Segment> changed = film->playlist()->video_segments (film, reel);
+	BOOST_REQUIRE_EQUAL (changed.size(), 3U);
+	BOOST_CHECK (changed.front().second == segments.front().second);
+	BOOST_CHECK (changed.back().second == segments.back().second);
+	BOOST_CHECK ((++changed.begin())->second != (++segments.begin())->second);
+
+	optional<PreviousVideoAsset> previous = film->previous_video_asset (reel);
+	BOOST_REQUIRE (previous);
+	BOOST_REQUIRE_EQUAL (previous->unchanged.size(), 2U);
+	BOOST_CHECK (previous->unchanged.front() == DCPTimePeriod (DCPTime(), second));
+	BOOST_CHECK (previous->unchanged.back() == DCPTimePeriod (DCPTime::from_seconds(2), DCPTime::from_seconds(3)));
+
+	/* Run the encoder ourselves so that we can see what it did */
+	shared_ptr<Job> job (new TranscodeJob (film));
+	DCPEncoder encoder (film, job);
+	encoder.go ();
+
+	/* The first frame of the red and blue sections should come from the first encode, and the
+	   rest of each section are repeats of their first frame.
+	*/
+	BOOST_CHECK_EQUAL (encoder.frames_reused(), 2);
+}
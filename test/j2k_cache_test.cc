@@ -0,0 +1,104 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  test/j2k_cache_test.cc
+ *  @brief Test J2KCache and DCPVideo::digest().
+ *  @ingroup specific
+ */
+
+#include "lib/j2k_cache.h"
+#include "lib/config.h"
+#include "lib/dcp_video.h"
+#include "lib/player_video.h"
+#include "lib/raw_image_proxy.h"
+#include "lib/image.h"
+#include <boost/test/unit_test.hpp>
+
+using std::string;
+using boost::shared_ptr;
+using boost::weak_ptr;
+using boost::optional;
+using dcp::Data;
+
+static shared_ptr<DCPVideo>
+frame (int index, uint8_t value, int bandwidth)
+{
+	shared_ptr<Image> image (new Image (AV_PIX_FMT_RGB24, dcp::Size (64, 64), true));
+	for (int y = 0; y < 64; ++y) {
+		memset (image->data()[0] + y * image->stride()[0], value, image->line_size()[0]);
+	}
+
+	shared_ptr<PlayerVideo> pv (
+		new PlayerVideo (
+			shared_ptr<ImageProxy> (new RawImageProxy (image)),
+			Crop (),
+			optional<double> (),
+			dcp::Size (64, 64),
+			dcp::Size (64, 64),
+			EYES_BOTH,
+			PART_WHOLE,
+			optional<ColourConversion> (),
+			weak_ptr<Content> (),
+			optional<Frame> ()
+			)
+		);
+
+	return shared_ptr<DCPVideo> (new DCPVideo (pv, index, 24, bandwidth, RESOLUTION_2K));
+}
+
+/** Check that DCPVideo digests depend on the image and encoding parameters but not the frame index */
+BOOST_AUTO_TEST_CASE (j2k_cache_test_digest)
+{
+	BOOST_CHECK_EQUAL (frame(0, 42, 100000000)->digest(), frame(1, 42, 100000000)->digest());
+	BOOST_CHECK (frame(0, 42, 100000000)->digest() != frame(0, 43, 100000000)->digest());
+	BOOST_CHECK (frame(0, 42, 100000000)->digest() != frame(0, 42, 150000000)->digest());
+}
+
+/** Check that data can be put into the cache and got back out again */
+BOOST_AUTO_TEST_CASE (j2k_cache_test_put_get)
+{
+	Config::instance()->set_j2k_cache_directory ("build/test/j2k_cache");
+	J2KCache::instance()->clear ();
+
+	string const digest = frame(0, 42, 100000000)->digest();
+	BOOST_CHECK (!J2KCache::instance()->get (digest));
+
+	Data data (1024);
+	for (int i = 0; i < 1024; ++i) {
+		data.data().get()[i] = i & 0xff;
+	}
+	J2KCache::instance()->put (digest, data);
+
+	optional<Data> back = J2KCache::instance()->get (digest);
+	BOOST_REQUIRE (back);
+	BOOST_REQUIRE_EQUAL (back->size(), 1024);
+	BOOST_CHECK_EQUAL (memcmp (back->data().get(), data.data().get(), 1024), 0);
+	/* The file is named by a key made from the digest and the encoder's version, not the digest itself */
+	int files = 0;
+	for (boost::filesystem::directory_iterator i ("build/test/j2k_cache"); i != boost::filesystem::directory_iterator(); ++i) {
+		BOOST_CHECK_EQUAL (i->path().extension().string(), ".j2c");
+		BOOST_CHECK (i->path().stem().string() != digest);
+		++files;
+	}
+	BOOST_CHECK_EQUAL (files, 1);
+
+	J2KCache::instance()->clear ();
+	BOOST_CHECK (!J2KCache::instance()->get (digest));
+}
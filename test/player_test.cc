@@ -38,6 +38,7 @@
 #include "lib/butler.h"
 #include "lib/compose.hpp"
 #include "lib/cross.h"
+#include "lib/config.h"
 #include "test.h"
 #include <boost/test/unit_test.hpp>
 #include <boost/algorithm/string.hpp>
@@ -46,6 +47,8 @@
 using std::cout;
 using std::list;
 using std::pair;
+using std::vector;
+using std::make_pair;
 using boost::shared_ptr;
 using boost::bind;
 using boost::optional;
@@ -398,3 +401,64 @@ BOOST_AUTO_TEST_CASE (player_silence_at_end_crash)
 	film2->make_dcp ();
 	BOOST_REQUIRE (!wait_for_jobs());
 }
+
+static void
+record_video (vector<DCPTime>* times, shared_ptr<PlayerVideo>, DCPTime time)
+{
+	times->push_back (time);
+}
+
+static void
+record_audio (vector<pair<DCPTime, int> >* blocks, shared_ptr<AudioBuffers> audio, DCPTime time)
+{
+	blocks->push_back (make_pair (time, audio->frames()));
+}
+
+static void
+record_text (vector<DCPTimePeriod>* periods, PlayerText, TextType, optional<DCPTextTrack>, DCPTimePeriod period)
+{
+	periods->push_back (period);
+}
+
+/** Check that decoding each piece of content in its own thread gives exactly the same output,
+ *  in the same order, as decoding everything in the player's thread.
+ */
+BOOST_AUTO_TEST_CASE (player_parallel_content_decoding_test)
+{
+	shared_ptr<Film> film = new_test_film2 ("player_parallel_content_decoding_test");
+	shared_ptr<Content> video = content_factory("test/data/test.mp4").front();
+	film->examine_and_add_content (video);
+	shared_ptr<Content> audio = content_factory("test/data/impulse_train.wav").front();
+	film->examine_and_add_content (audio);
+	shared_ptr<Content> text = content_factory("test/data/subrip.srt").front();
+	film->examine_and_add_content (text);
+	BOOST_REQUIRE (!wait_for_jobs());
+	audio->set_position (film, DCPTime::from_seconds(0.5));
+
+	vector<DCPTime> video_times[2];
+	vector<pair<DCPTime, int> > audio_blocks[2];
+	vector<DCPTimePeriod> text_periods[2];
+
+	for (int i = 0; i < 2; ++i) {
+		Config::instance()->set_parallel_content_decoding (i == 1);
+		shared_ptr<Player> player (new Player(film, film->playlist()));
+		player->Video.connect (bind (&record_video, &video_times[i], _1, _2));
+		player->Audio.connect (bind (&record_audio, &audio_blocks[i], _1, _2));
+		player->Text.connect (bind (&record_text, &text_periods[i], _1, _2, _3, _4));
+		/* Seek part-way through to check that the threads cope */
+		for (int j = 0; j < 12; ++j) {
+			player->pass ();
+		}
+		player->seek (DCPTime::from_seconds(0.25), true);
+		while (!player->pass ()) {}
+	}
+
+	Config::instance()->set_parallel_content_decoding (false);
+
+	BOOST_CHECK (!video_times[0].empty());
+	BOOST_CHECK (!audio_blocks[0].empty());
+	BOOST_CHECK (video_times[0] == video_times[1]);
+	BOOST_CHECK (audio_blocks[0] == audio_blocks[1]);
+	BOOST_CHECK (text_periods[0] == text_periods[1]);
+}
+
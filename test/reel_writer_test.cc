@@ -26,16 +26,19 @@
 #include "lib/reel_writer.h"
 #include "lib/film.h"
 #include "lib/cross.h"
+#include "lib/digester.h"
+#include "lib/resume_verifier.h"
 #include "test.h"
 #include <boost/test/unit_test.hpp>
 
 using std::string;
+using std::vector;
 using boost::shared_ptr;
 using boost::optional;
 
-static bool equal (dcp::FrameInfo a, ReelWriter const & writer, shared_ptr<InfoFileHandle> file, Frame frame, Eyes eyes)
+static bool equal (dcp::FrameInfo a, ReelWriter const & writer, Frame frame, Eyes eyes)
 {
-	dcp::FrameInfo b = writer.read_frame_info(file, frame, eyes);
+	dcp::FrameInfo b = writer.read_frame_info(frame, eyes);
 	return a.offset == b.offset && a.size == b.size && a.hash == b.hash;
 }
 
@@ -50,41 +53,107 @@ BOOST_AUTO_TEST_CASE (write_frame_info_test)
 	dcp::FrameInfo info1(0, 123, "12345678901234567890123456789012");
 	writer.write_frame_info (0, EYES_LEFT, info1);
 
-	{
-		shared_ptr<InfoFileHandle> file = film->info_file_handle(period, true);
-		BOOST_CHECK (equal(info1, writer, file, 0, EYES_LEFT));
-	}
+	BOOST_CHECK (equal(info1, writer, 0, EYES_LEFT));
 
 	/* Write some more */
 
-	dcp::FrameInfo info2(596, 14921, "123acb789f1234ae782012n456339522");
+	dcp::FrameInfo info2(596, 14921, "123acb789f1234ae782012e456339522");
 	writer.write_frame_info (5, EYES_RIGHT, info2);
 
-	{
-		shared_ptr<InfoFileHandle> file = film->info_file_handle(period, true);
-		BOOST_CHECK (equal(info1, writer, file, 0, EYES_LEFT));
-		BOOST_CHECK (equal(info2, writer, file, 5, EYES_RIGHT));
-	}
+	BOOST_CHECK (equal(info1, writer, 0, EYES_LEFT));
+	BOOST_CHECK (equal(info2, writer, 5, EYES_RIGHT));
 
-	dcp::FrameInfo info3(12494, 99157123, "xxxxyyyyabc12356ffsfdsf456339522");
+	dcp::FrameInfo info3(12494, 99157123, "0000ffffabc12356ffafdaf456339522");
 	writer.write_frame_info (10, EYES_LEFT, info3);
 
-	{
-		shared_ptr<InfoFileHandle> file = film->info_file_handle(period, true);
-		BOOST_CHECK (equal(info1, writer, file, 0, EYES_LEFT));
-		BOOST_CHECK (equal(info2, writer, file, 5, EYES_RIGHT));
-		BOOST_CHECK (equal(info3, writer, file, 10, EYES_LEFT));
-	}
+	BOOST_CHECK (equal(info1, writer, 0, EYES_LEFT));
+	BOOST_CHECK (equal(info2, writer, 5, EYES_RIGHT));
+	BOOST_CHECK (equal(info3, writer, 10, EYES_LEFT));
 
 	/* Overwrite one */
 
-	dcp::FrameInfo info4(55512494, 123599157123, "ABCDEFGyabc12356ffsfdsf4563395ZZ");
+	dcp::FrameInfo info4(55512494, 123599157, "abcdef0eabc12356ffafdaf456339500");
 	writer.write_frame_info (5, EYES_RIGHT, info4);
 
-	{
-		shared_ptr<InfoFileHandle> file = film->info_file_handle(period, true);
-		BOOST_CHECK (equal(info1, writer, file, 0, EYES_LEFT));
-		BOOST_CHECK (equal(info4, writer, file, 5, EYES_RIGHT));
-		BOOST_CHECK (equal(info3, writer, file, 10, EYES_LEFT));
+	BOOST_CHECK (equal(info1, writer, 0, EYES_LEFT));
+	BOOST_CHECK (equal(info4, writer, 5, EYES_RIGHT));
+	BOOST_CHECK (equal(info3, writer, 10, EYES_LEFT));
+}
+
+/** Check that a ReelWriter for an attempt at making a reel on an encode server only
+ *  uses that attempt's files.
+ */
+BOOST_AUTO_TEST_CASE (reel_writer_attempt_test)
+{
+	shared_ptr<Film> film = new_test_film2 ("reel_writer_attempt_test");
+	DCPTimePeriod const period (DCPTime(0), DCPTime(96000));
+	boost::filesystem::path const asset = film->internal_video_asset_dir() / film->internal_video_asset_filename(period);
+	boost::filesystem::path const info = film->info_file (period);
+
+	ReelWriter writer (film, period, shared_ptr<Job>(), 0, 1, optional<string>(), string("0123abcd"));
+	BOOST_CHECK_EQUAL (writer.picture_file().string(), asset.string() + ".0123abcd");
+	BOOST_CHECK (!writer.sound_file());
+
+	writer.write_frame_info (0, EYES_BOTH, dcp::FrameInfo (0, 123, "12345678901234567890123456789012"));
+	writer.finalize_picture ();
+
+	BOOST_CHECK (boost::filesystem::exists (ReelWriter::attempt_file (info, "0123abcd")));
+	BOOST_CHECK (!boost::filesystem::exists (asset));
+	BOOST_CHECK (!boost::filesystem::exists (info));
+}
+
+/** Make an `asset' of frames, truncate it part-way through a frame, and check that
+ *  ResumeVerifier finds the last complete frame with any number of threads.
+ */
+BOOST_AUTO_TEST_CASE (resume_verifier_test)
+{
+	boost::filesystem::path const dir = "build/test/resume_verifier_test";
+	boost::filesystem::remove_all (dir);
+	boost::filesystem::create_directories (dir);
+	boost::filesystem::path const asset = dir / "asset";
+
+	int const frames = 100;
+	int const size = 1000;
+	vector<dcp::FrameInfo> info;
+
+	FILE* f = fopen_boost (asset, "wb");
+	BOOST_REQUIRE (f);
+	uint8_t data[size];
+	for (int i = 0; i < frames; ++i) {
+		for (int j = 0; j < size; ++j) {
+			data[j] = (i * 7 + j) & 0xff;
+		}
+		Digester digester;
+		digester.add (data, size);
+		info.push_back (dcp::FrameInfo (i * size, size, digester.get()));
+		fwrite (data, 1, size, f);
+	}
+	fclose (f);
+
+	for (int threads = 1; threads <= 16; threads *= 4) {
+		ResumeVerifier verifier (asset, info);
+		optional<Frame> last = verifier.last_good_frame (threads);
+		BOOST_REQUIRE (last);
+		BOOST_CHECK_EQUAL (*last, frames - 1);
+		/* Everything is good so we only need to look at the last frame */
+		BOOST_CHECK_EQUAL (verifier.checked(), 1);
+	}
+
+	/* Chop the asset off in the middle of frame 73 */
+	boost::filesystem::resize_file (asset, 73 * size + size / 2);
+
+	for (int threads = 1; threads <= 16; threads *= 4) {
+		ResumeVerifier verifier (asset, info);
+		optional<Frame> last = verifier.last_good_frame (threads);
+		BOOST_REQUIRE (last);
+		BOOST_CHECK_EQUAL (*last, 72);
+	}
+
+	/* Make the first frame bad too */
+	boost::filesystem::resize_file (asset, size / 2);
+
+	for (int threads = 1; threads <= 16; threads *= 4) {
+		ResumeVerifier verifier (asset, info);
+		BOOST_CHECK (!verifier.last_good_frame (threads));
 	}
 }
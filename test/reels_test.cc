@@ -32,6 +32,7 @@
 #include "lib/video_content.h"
 #include "lib/string_text_file_content.h"
 #include "lib/content_factory.h"
+#include "lib/config.h"
 #include "test.h"
 #include <boost/test/unit_test.hpp>
 #include <boost/foreach.hpp>
@@ -481,3 +482,32 @@ BOOST_AUTO_TEST_CASE (reels_test12)
 	BOOST_CHECK_EQUAL (i->from.get(), DCPTime::from_seconds(14).get());
 	BOOST_CHECK_EQUAL (i->to.get(),   DCPTime::from_seconds(19).get());
 }
+
+/** Check that encoding each reel with its own Player gives the same DCP as reels_test2 */
+BOOST_AUTO_TEST_CASE (reels_test13)
+{
+	shared_ptr<Film> film = new_test_film ("reels_test13");
+	film->set_name ("reels_test2");
+	film->set_container (Ratio::from_id ("185"));
+	film->set_interop (false);
+	film->set_dcp_content_type (DCPContentType::from_isdcf_name ("TST"));
+
+	char const * images[] = { "flat_red.png", "flat_green.png", "flat_blue.png" };
+	BOOST_FOREACH (char const * i, images) {
+		shared_ptr<ImageContent> c (new ImageContent(boost::filesystem::path("test/data") / i));
+		film->examine_and_add_content (c);
+		BOOST_REQUIRE (!wait_for_jobs());
+		c->video->set_length (24);
+	}
+
+	film->set_reel_type (REELTYPE_BY_VIDEO_CONTENT);
+	BOOST_REQUIRE_EQUAL (film->reels().size(), 3U);
+
+	Config::instance()->set_parallel_reels (true);
+	film->make_dcp ();
+	bool const failed = wait_for_jobs ();
+	Config::instance()->set_parallel_reels (false);
+	BOOST_REQUIRE (!failed);
+
+	check_dcp ("test/data/reels_test2", film->dir (film->dcp_name()));
+}
@@ -0,0 +1,109 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** @file  test/spill_file_test.cc
+ *  @brief Test SpillFile class.
+ *  @ingroup selfcontained
+ */
+
+#include "lib/spill_file.h"
+#include <boost/test/unit_test.hpp>
+#include <cstring>
+
+using dcp::Data;
+
+static Data
+frame (int index, int size)
+{
+	Data d (size);
+	for (int i = 0; i < size; ++i) {
+		d.data().get()[i] = (index * 13 + i) & 0xff;
+	}
+	return d;
+}
+
+static bool
+equal (Data const & a, Data const & b)
+{
+	return a.size() == b.size() && memcmp (a.data().get(), b.data().get(), a.size()) == 0;
+}
+
+/** Check that frames come back as they were written, in any order, when reads and
+ *  writes are mixed up, and that the file goes away afterwards.
+ */
+BOOST_AUTO_TEST_CASE (spill_file_test1)
+{
+	boost::filesystem::path const path = "build/test/spill_file_test1.spill";
+
+	{
+		SpillFile spill (path);
+		BOOST_CHECK (spill.empty ());
+		BOOST_CHECK (boost::filesystem::exists (path));
+
+		for (int i = 0; i < 10; ++i) {
+			spill.write (i, EYES_BOTH, frame(i, 1000 + i));
+		}
+		BOOST_CHECK (!spill.empty ());
+
+		/* Some of these are still in the buffer and some not */
+		BOOST_CHECK (equal (spill.read (7, EYES_BOTH), frame(7, 1007)));
+		BOOST_CHECK (equal (spill.read (2, EYES_BOTH), frame(2, 1002)));
+
+		/* Writing after reading must still append */
+		spill.write (10, EYES_LEFT, frame(10, 500));
+		spill.write (10, EYES_RIGHT, frame(11, 600));
+
+		BOOST_CHECK (equal (spill.read (10, EYES_RIGHT), frame(11, 600)));
+		BOOST_CHECK (equal (spill.read (10, EYES_LEFT), frame(10, 500)));
+		for (int i = 0; i < 10; ++i) {
+			if (i != 7 && i != 2) {
+				BOOST_CHECK (equal (spill.read (i, EYES_BOTH), frame(i, 1000 + i)));
+			}
+		}
+
+		BOOST_CHECK (spill.empty ());
+	}
+
+	BOOST_CHECK (!boost::filesystem::exists (path));
+}
+
+/** Check that frames are read back correctly when there is much more than fits in the
+ *  SpillFile's write buffer, so that most of them have gone to disk.
+ */
+BOOST_AUTO_TEST_CASE (spill_file_test2)
+{
+	boost::filesystem::path const path = "build/test/spill_file_test2.spill";
+
+	int const frames = 48;
+	int const size = 1024 * 1024 + 17;
+
+	SpillFile spill (path);
+	for (int i = 0; i < frames; ++i) {
+		spill.write (i, EYES_BOTH, frame(i, size));
+	}
+
+	/* The buffer should have been written out in large chunks by now */
+	BOOST_CHECK (boost::filesystem::file_size (path) >= 16 * 1024 * 1024);
+
+	for (int i = frames - 1; i >= 0; --i) {
+		BOOST_CHECK (equal (spill.read (i, EYES_BOTH), frame(i, size)));
+	}
+
+	BOOST_CHECK (spill.empty ());
+}
@@ -152,3 +152,43 @@ BOOST_AUTO_TEST_CASE (copy_in_bits_test)
 		check_file ("build/test/random.dat", "build/test/random.dat2");
 	}
 }
+
+/** Check each of the ways that copy_file_quickly() can copy, and that none of them
+ *  overwrites an existing file.  Cloning and kernel copies may not be possible here,
+ *  in which case they must leave nothing behind.
+ */
+BOOST_AUTO_TEST_CASE (copy_file_quickly_test)
+{
+	boost::filesystem::path const from = "build/test/copy_file_quickly.dat";
+	boost::filesystem::path const to = "build/test/copy_file_quickly.dat2";
+	make_random_file (from, 64 * 1024 * 1024 + 7);
+
+	boost::filesystem::remove (to);
+	if (clone_file (from, to)) {
+		check_file (from, to);
+	} else {
+		BOOST_CHECK (!boost::filesystem::exists (to));
+	}
+
+	boost::filesystem::remove (to);
+	progress_values.clear ();
+	if (kernel_copy_file (from, to, boost::bind(&progress, _1))) {
+		check_file (from, to);
+		BOOST_REQUIRE (!progress_values.empty());
+		BOOST_CHECK_CLOSE (progress_values.back(), 1, 0.01);
+	} else {
+		BOOST_CHECK (!boost::filesystem::exists (to));
+	}
+
+	boost::filesystem::remove (to);
+	progress_values.clear ();
+	copy_file_quickly (from, to, boost::bind(&progress, _1));
+	check_file (from, to);
+
+	/* None of these should touch an existing file */
+	make_random_file (to, 1024);
+	BOOST_CHECK (!clone_file (from, to));
+	BOOST_CHECK (!kernel_copy_file (from, to, boost::bind(&progress, _1)));
+	BOOST_CHECK_THROW (copy_file_quickly (from, to, boost::bind(&progress, _1)), FileError);
+	BOOST_CHECK_EQUAL (boost::filesystem::file_size (to), 1024U);
+}
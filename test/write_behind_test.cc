@@ -0,0 +1,90 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  test/write_behind_test.cc
+ *  @brief Test WriteBehind class.
+ *  @ingroup selfcontained
+ */
+
+#include "lib/write_behind.h"
+#include "lib/exceptions.h"
+#include <boost/test/unit_test.hpp>
+#include <boost/bind.hpp>
+#include <vector>
+
+using std::vector;
+using std::map;
+
+static void
+append (vector<int>* v, int n)
+{
+	v->push_back (n);
+}
+
+static void
+fail ()
+{
+	throw EncodeError ("write_behind_test");
+}
+
+/** Check that writes are done in order, that flush() waits for them, and that they are counted */
+BOOST_AUTO_TEST_CASE (write_behind_test1)
+{
+	vector<int> done;
+
+	WriteBehind wb (1000, Config::FSYNC_NEVER);
+	for (int i = 0; i < 100; ++i) {
+		wb.write (i < 50 ? "a" : "b", 100, boost::bind (&append, &done, i));
+	}
+	wb.close ("b", boost::bind (&append, &done, 100));
+	wb.flush ();
+
+	BOOST_REQUIRE_EQUAL (done.size(), 101U);
+	for (int i = 0; i <= 100; ++i) {
+		BOOST_CHECK_EQUAL (done[i], i);
+	}
+
+	map<boost::filesystem::path, WriteBehind::Counters> counters = wb.counters ();
+	BOOST_REQUIRE_EQUAL (counters.size(), 2U);
+	BOOST_CHECK_EQUAL (counters["a"].writes, 50);
+	BOOST_CHECK_EQUAL (counters["a"].bytes, 5000U);
+	BOOST_CHECK_EQUAL (counters["a"].queued, 0);
+	BOOST_CHECK (counters["a"].max_queued >= 1);
+	BOOST_CHECK (counters["a"].max_queued <= 10);
+	BOOST_CHECK_EQUAL (counters["b"].writes, 51);
+	BOOST_CHECK_EQUAL (counters["b"].syncs, 0);
+}
+
+/** Check that a failed write is reported, and that later writes are abandoned */
+BOOST_AUTO_TEST_CASE (write_behind_test2)
+{
+	vector<int> done;
+
+	WriteBehind wb (1000, Config::FSYNC_NEVER);
+	wb.write ("a", 100, boost::bind (&append, &done, 0));
+	wb.write ("a", 100, &fail);
+	BOOST_CHECK_THROW (wb.flush(), std::exception);
+
+	BOOST_CHECK_THROW (wb.write ("a", 100, boost::bind (&append, &done, 1)), std::exception);
+	BOOST_CHECK_THROW (wb.flush(), std::exception);
+
+	BOOST_REQUIRE_EQUAL (done.size(), 1U);
+	BOOST_CHECK_EQUAL (done[0], 0);
+}
@@ -0,0 +1,179 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  test/writer_test.cc
+ *  @brief Test the Writer's handling of frames which arrive out of order.
+ *  @ingroup specific
+ */
+
+#include "lib/writer.h"
+#include "lib/reel_writer.h"
+#include "lib/write_behind.h"
+#include "lib/film.h"
+#include "lib/image_content.h"
+#include "lib/video_content.h"
+#include "lib/transcode_job.h"
+#include "lib/dcp_video.h"
+#include "lib/player_video.h"
+#include "lib/raw_image_proxy.h"
+#include "lib/image.h"
+#include "lib/digester.h"
+#include "test.h"
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+
+using std::string;
+using std::vector;
+using boost::shared_ptr;
+using boost::weak_ptr;
+using boost::optional;
+using dcp::Data;
+
+static shared_ptr<Film>
+film_with_reels (string name, int reels)
+{
+	shared_ptr<Film> film = new_test_film2 (name);
+	for (int i = 0; i < reels; ++i) {
+		shared_ptr<ImageContent> c (new ImageContent("test/data/flat_red.png"));
+		film->examine_and_add_content (c);
+		BOOST_REQUIRE (!wait_for_jobs());
+		c->video->set_length (24);
+	}
+	film->set_reel_type (REELTYPE_BY_VIDEO_CONTENT);
+	BOOST_REQUIRE_EQUAL (film->reels().size(), static_cast<size_t>(reels));
+	return film;
+}
+
+/** @return J2K data for a flat frame of the film's size */
+static Data
+encoded (shared_ptr<const Film> film, uint8_t value)
+{
+	dcp::Size const size = film->frame_size ();
+	shared_ptr<Image> image (new Image (AV_PIX_FMT_RGB24, size, true));
+	for (int y = 0; y < size.height; ++y) {
+		memset (image->data()[0] + y * image->stride()[0], value, image->line_size()[0]);
+	}
+
+	shared_ptr<PlayerVideo> pv (
+		new PlayerVideo (
+			shared_ptr<ImageProxy> (new RawImageProxy (image)),
+			Crop (),
+			optional<double> (),
+			size,
+			size,
+			EYES_BOTH,
+			PART_WHOLE,
+			optional<ColourConversion> (),
+			weak_ptr<Content> (),
+			optional<Frame> ()
+			)
+		);
+
+	return DCPVideo (pv, 0, film->video_frame_rate(), film->j2k_bandwidth(), RESOLUTION_2K).encode_locally ();
+}
+
+/** Check that when reels are being filled at the same time the Writer pushes the frame
+ *  that will be written last to disk, rather than the last frame of the last reel.
+ */
+BOOST_AUTO_TEST_CASE (writer_spill_victim_test)
+{
+	shared_ptr<Film> film = film_with_reels ("writer_spill_victim_test", 2);
+	shared_ptr<Job> job (new TranscodeJob (film));
+	Writer writer (film, job);
+
+	/* Reel 0 is waiting for frame 2 and has frames up to 20; reel 1 is
+	   waiting for frame 0 and has frames up to 5.  Reel 0's frame 20 is
+	   19 frames away from being written, and reel 1's frame 5 only 6.
+	*/
+	writer._last_sequenced[0] = Writer::Position (1, EYES_BOTH);
+	writer._last_sequenced[1] = Writer::Position (-1, EYES_BOTH);
+
+	QueueItem qi;
+	qi.type = QueueItem::FULL;
+	qi.encoded = Data (1);
+	qi.eyes = EYES_BOTH;
+	qi.reel = 0;
+	for (qi.frame = 3; qi.frame <= 20; ++qi.frame) {
+		writer.push (qi);
+	}
+	qi.reel = 1;
+	for (qi.frame = 1; qi.frame <= 5; ++qi.frame) {
+		writer.push (qi);
+	}
+
+	Writer::Key key = writer.spill_victim ();
+	BOOST_CHECK_EQUAL (key.first, 0U);
+	BOOST_CHECK_EQUAL (key.second.first, 20);
+
+	/* Once reel 0 has caught up, reel 1's last frame is the one to spill */
+	writer._last_sequenced[0] = Writer::Position (18, EYES_BOTH);
+	key = writer.spill_victim ();
+	BOOST_CHECK_EQUAL (key.first, 1U);
+	BOOST_CHECK_EQUAL (key.second.first, 5);
+}
+
+/** Give the Writer a reel's frames in reverse order with room in memory for only a few,
+ *  and check that they are pushed to disk and come back intact.
+ */
+BOOST_AUTO_TEST_CASE (writer_spill_test)
+{
+	shared_ptr<Film> film = film_with_reels ("writer_spill_test", 1);
+	shared_ptr<Job> job (new TranscodeJob (film));
+	Writer writer (film, job);
+
+	vector<Data> frames;
+	for (int i = 0; i < 4; ++i) {
+		frames.push_back (encoded (film, i * 64));
+	}
+
+	{
+		boost::mutex::scoped_lock lm (writer._state_mutex);
+		writer._maximum_bytes_in_memory = 4 * frames.front().size();
+	}
+
+	writer.start ();
+
+	for (int i = 23; i >= 0; --i) {
+		writer.write (frames[i % 4], i, EYES_BOTH);
+	}
+
+	/* Wait for the Writer's thread to give everything to the write-behind thread */
+	while (true) {
+		boost::mutex::scoped_lock lm (writer._state_mutex);
+		if (writer._queue_size == 0) {
+			break;
+		}
+		lm.unlock ();
+		writer.rethrow ();
+		boost::this_thread::sleep (boost::posix_time::milliseconds (10));
+	}
+
+	writer._write_behind->flush ();
+	writer.rethrow ();
+
+	BOOST_CHECK (writer._pushed_to_disk > 0);
+	BOOST_CHECK_EQUAL (writer._full_written, 24);
+
+	for (int i = 0; i < 24; ++i) {
+		Digester digester;
+		digester.add (frames[i % 4].data().get(), frames[i % 4].size());
+		BOOST_CHECK_EQUAL (writer._reels[0].read_frame_info(i, EYES_BOTH).hash, digester.get());
+	}
+}
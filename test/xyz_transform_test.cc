@@ -0,0 +1,102 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  test/xyz_transform_test.cc
+ *  @brief Test XYZTransform class.
+ *  @ingroup selfcontained
+ */
+
+#include "lib/xyz_transform.h"
+#include "lib/colour_conversion.h"
+#include <dcp/rgb_xyz.h>
+#include <dcp/openjpeg_image.h>
+#include <boost/test/unit_test.hpp>
+#include <boost/bind.hpp>
+#include <vector>
+
+using std::vector;
+using boost::shared_ptr;
+
+static void
+ignore_note (dcp::NoteType, std::string)
+{
+
+}
+
+/** Check that XYZTransform gives the same answer as dcp::rgb_to_xyz for every 12-bit grey and
+ *  for saturated primaries.
+ */
+BOOST_AUTO_TEST_CASE (xyz_transform_test)
+{
+	ColourConversion const conversion (dcp::ColourConversion::p3_to_xyz ());
+
+	int const width = 4096 + 3;
+	vector<uint16_t> rgb (width * 3);
+	vector<int> r (width);
+	vector<int> g (width);
+	vector<int> b (width);
+	for (int i = 0; i < 4096; ++i) {
+		rgb[i * 3] = rgb[i * 3 + 1] = rgb[i * 3 + 2] = i << 4;
+		r[i] = g[i] = b[i] = i;
+	}
+
+	/* Saturated primaries */
+	for (int i = 0; i < 3; ++i) {
+		int const x = 4096 + i;
+		for (int j = 0; j < 3; ++j) {
+			rgb[x * 3 + j] = i == j ? 0xfff0 : 0;
+		}
+		r[x] = i == 0 ? 4095 : 0;
+		g[x] = i == 1 ? 4095 : 0;
+		b[x] = i == 2 ? 4095 : 0;
+	}
+
+	shared_ptr<dcp::OpenJPEGImage> ref = dcp::rgb_to_xyz (
+		reinterpret_cast<uint8_t*> (&rgb[0]), dcp::Size (width, 1), width * 6, conversion, boost::bind (&ignore_note, _1, _2)
+		);
+
+	vector<int> X (width);
+	vector<int> Y (width);
+	vector<int> Z (width);
+	XYZTransform::get(conversion)->transform_row (&r[0], &g[0], &b[0], &X[0], &Y[0], &Z[0], width);
+
+	for (int i = 0; i < width; ++i) {
+		BOOST_REQUIRE_EQUAL (X[i], ref->data(0)[i]);
+		BOOST_REQUIRE_EQUAL (Y[i], ref->data(1)[i]);
+		BOOST_REQUIRE_EQUAL (Z[i], ref->data(2)[i]);
+	}
+}
+
+/** Check that transforms are shared between identical conversions */
+BOOST_AUTO_TEST_CASE (xyz_transform_cache_test)
+{
+	XYZTransform::clear_cache ();
+
+	ColourConversion const a (dcp::ColourConversion::srgb_to_xyz ());
+	ColourConversion const b (dcp::ColourConversion::rec709_to_xyz ());
+
+	shared_ptr<const XYZTransform> ta = XYZTransform::get (a);
+	BOOST_CHECK (XYZTransform::get(ColourConversion(dcp::ColourConversion::srgb_to_xyz())) == ta);
+	BOOST_CHECK (XYZTransform::get(b) != ta);
+	BOOST_CHECK (XYZTransform::get(a) == ta);
+
+	XYZTransform::clear_cache ();
+	BOOST_CHECK (XYZTransform::get(a) != ta);
+}